@@ -0,0 +1,194 @@
+#ifndef PGV_BENCH_COMMON_H
+#define PGV_BENCH_COMMON_H
+
+// Shared pieces of the benchmark programs: latency histograms, dataset
+// readers for the TEXMEX formats (SIFT1M, GIST1M) and memory probes.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline uint64_t elapsed_ns(Clock::time_point start, Clock::time_point end) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// HdrHistogram-style log-linear histogram: values up to ~18 minutes in ns are
+// kept with 3 significant digits (0.1% error) at any magnitude, in fixed
+// memory, so millions of samples cost nothing to record or merge.
+class Histogram {
+public:
+    Histogram() : counts_(kBuckets * kHalf + kHalf, 0), total_(0), max_(0) {}
+
+    void record(uint64_t value) {
+        value = std::min(value, kMaxValue);
+        ++counts_[index_of(value)];
+        ++total_;
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+        total_ += other.total_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+
+    // Smallest recorded value v such that a fraction q of samples are <= v
+    uint64_t quantile(double q) const {
+        if (total_ == 0) return 0;
+        uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * total_)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= target) return std::min(highest_equivalent(i), max_);
+        }
+        return max_;
+    }
+
+    double mean() const {
+        if (total_ == 0) return 0.0;
+        double sum = 0.0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            if (counts_[i]) sum += static_cast<double>(counts_[i]) * lowest_equivalent(i);
+        }
+        return sum / total_;
+    }
+
+private:
+    static const int kSubBits = 11;                         // 2048 sub-buckets: 3 significant digits
+    static const uint64_t kHalf = uint64_t(1) << (kSubBits - 1);
+    static const int kBuckets = 40 - kSubBits + 1;          // up to 2^40 ns
+    static constexpr uint64_t kMaxValue = (uint64_t(1) << 40) - 1;
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t max_;
+
+    static size_t index_of(uint64_t value) {
+        int bucket = 63 - __builtin_clzll(value | ((uint64_t(1) << kSubBits) - 1)) - (kSubBits - 1);
+        uint64_t sub = value >> bucket;
+        return static_cast<size_t>((static_cast<uint64_t>(bucket) + 1) * kHalf + (sub - kHalf));
+    }
+
+    static uint64_t lowest_equivalent(size_t index) {
+        int64_t bucket = static_cast<int64_t>(index / kHalf) - 1;
+        uint64_t sub = index % kHalf + kHalf;
+        if (bucket < 0) {
+            sub -= kHalf;
+            bucket = 0;
+        }
+        return sub << bucket;
+    }
+
+    static uint64_t highest_equivalent(size_t index) {
+        int64_t bucket = std::max<int64_t>(0, static_cast<int64_t>(index / kHalf) - 1);
+        return lowest_equivalent(index) + (uint64_t(1) << bucket) - 1;
+    }
+};
+
+// Latency summary in microseconds, as written to the JSON report
+inline std::string latency_json(const Histogram& h) {
+    std::ostringstream out;
+    out << "{\"count\": " << h.count()
+        << ", \"mean_us\": " << h.mean() / 1e3
+        << ", \"p50_us\": " << h.quantile(0.50) / 1e3
+        << ", \"p95_us\": " << h.quantile(0.95) / 1e3
+        << ", \"p99_us\": " << h.quantile(0.99) / 1e3
+        << ", \"p999_us\": " << h.quantile(0.999) / 1e3
+        << ", \"max_us\": " << h.max() / 1e3 << "}";
+    return out.str();
+}
+
+inline std::string json_string(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Peak resident set size of this process so far
+inline size_t peak_rss_bytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;     // kilobytes on Linux
+}
+
+inline size_t current_rss_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// TEXMEX vector files: every record is an int32 dimension followed by that
+// many components (float for .fvecs, uint8 for .bvecs, int32 for .ivecs).
+// Reads at most `limit` records (0 = all); returns false on malformed input.
+template <typename Component, typename Out>
+bool read_vecs(const std::string& path, std::vector<Out>& data, int& dimension, size_t limit) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+
+    data.clear();
+    dimension = 0;
+    std::vector<Component> record;
+    for (size_t n = 0; limit == 0 || n < limit; ++n) {
+        int32_t d;
+        if (std::fread(&d, sizeof(d), 1, file) != 1) break;
+        if (d <= 0 || (dimension != 0 && d != dimension)) {
+            std::cerr << path << ": inconsistent dimension at record " << n << std::endl;
+            std::fclose(file);
+            return false;
+        }
+        dimension = d;
+        record.resize(d);
+        if (std::fread(record.data(), sizeof(Component), d, file) != static_cast<size_t>(d)) {
+            std::cerr << path << ": truncated record " << n << std::endl;
+            std::fclose(file);
+            return false;
+        }
+        data.insert(data.end(), record.begin(), record.end());
+    }
+    std::fclose(file);
+    return dimension > 0;
+}
+
+inline bool ends_with(const std::string& value, const std::string& suffix) {
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// .fvecs or .bvecs by extension, as floats
+inline bool read_vectors(const std::string& path, std::vector<float>& data, int& dimension, size_t limit = 0) {
+    if (ends_with(path, ".bvecs")) {
+        return read_vecs<uint8_t>(path, data, dimension, limit);
+    }
+    if (ends_with(path, ".fvecs")) {
+        return read_vecs<float>(path, data, dimension, limit);
+    }
+    std::cerr << path << ": expected a .fvecs or .bvecs file" << std::endl;
+    return false;
+}
+
+} // namespace bench
+
+#endif
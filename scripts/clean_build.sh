@@ -103,6 +103,7 @@ clean_result_files() {
     
     # Benchmark results
     find . -name "*benchmark_results*.csv" -type f -delete 2>/dev/null || true
+    find . -name "*benchmark_results*.json" -type f -delete 2>/dev/null || true
     find . -name "*test_results*.txt" -type f -delete 2>/dev/null || true
     find . -name "*output*.log" -type f -delete 2>/dev/null || true
     
@@ -3,7 +3,16 @@
 
 // TODO: Add API versioning macros (PGV_FAISS_VERSION_MAJOR, etc.)
 // TODO: Add feature detection macros (PGV_FAISS_HAS_GPU, etc.)
-// TODO: Add thread safety documentation and guarantees
+
+// Thread safety: search functions may be called concurrently with each other,
+// with pgv_faiss_add_vectors and with pgv_faiss_load_from_db on the same index.
+// A reload builds the new index off to the side and swaps it in atomically;
+// searches already running finish on the previous version. Adds and reloads
+// are serialized internally. pgv_faiss_save_to_db, pgv_faiss_load_from_db and
+// pgv_faiss_hybrid_search share the index's single database connection and are
+// serialized on it. pgv_faiss_enable_batching and pgv_faiss_destroy must not
+// race with other calls on the same index.
+
 // TODO: Consider adding async/callback-based API for large operations
 
 #ifdef __cplusplus
@@ -13,43 +22,459 @@ extern "C" {
 #include <stdint.h>
 #include <stddef.h>
 
+// Distance the index ranks by. Reported distances are smaller-is-better and
+// equal pgvector's operators: squared L2 (the square of <->), -a.b (<#>) and
+// 1 - cos (<=>). Cosine normalizes vectors and queries itself; hybrid search
+// re-ranks with the matching operator.
+typedef enum pgv_faiss_metric {
+    PGV_FAISS_METRIC_L2 = 0,
+    PGV_FAISS_METRIC_INNER_PRODUCT = 1,
+    PGV_FAISS_METRIC_COSINE = 2,
+} pgv_faiss_metric_t;
+
+// Element types for pgv_faiss_add_vectors_typed and pgv_faiss_convert_vectors.
+// FLOAT16 is IEEE binary16 (pgvector's halfvec), BFLOAT16 the upper half of a
+// float32 and INT8 a symmetric code with value = code * scale. 16-bit values
+// are in host byte order.
+typedef enum pgv_faiss_vector_type {
+    PGV_FAISS_FLOAT32 = 0,
+    PGV_FAISS_FLOAT16 = 1,
+    PGV_FAISS_BFLOAT16 = 2,
+    PGV_FAISS_INT8 = 3,
+} pgv_faiss_vector_type_t;
+
+// pgvector type of the table's embedding column. Loads read any of them;
+// writes and table creation use this one.
+typedef enum pgv_faiss_column_type {
+    PGV_FAISS_COLUMN_VECTOR = 0,
+    PGV_FAISS_COLUMN_HALFVEC = 1,
+    PGV_FAISS_COLUMN_SPARSEVEC = 2,
+} pgv_faiss_column_type_t;
+
 // TODO: Add more configuration options:
 // - connection_timeout, retry_count, connection_pool_size
 // - index_parameters (M for HNSW, ncentroids for IVF, etc.)
 // - memory_limits, batch_sizes, threading_options
 // - logging_level, progress_callback, error_callback
 typedef struct pgv_faiss_config {
-    char* connection_string;
+    char* connection_string;    // NULL for an in-memory index without database persistence
     int dimension;
     int use_gpu;
     int gpu_device_id;
     char* index_type;
     int nprobe;
+    const char* cache_dir;      // local copy of indexes loaded from the database; NULL disables
+    int cache_mmap;             // map cached indexes read-only instead of reading them into memory
+    pgv_faiss_column_type_t column_type;    // 0 = vector
+
+    // Index structure; zero values pick defaults. index_type also accepts
+    // SQfp16, SQ8, IVFPQ, OPQ, IVFSQ8, IVFSQfp16, IVFHNSW and HNSWSQ.
+    const char* index_factory;  // FAISS index_factory string overriding index_type; "{nlist}"/"{m}" are filled in
+    size_t expected_vectors;    // dataset size for nlist and memory budgeting (0 = training set size)
+    size_t memory_budget_mb;    // memory for PQ codes and ids; picks the PQ code size
+    int pq_m;                   // PQ sub-quantizers (0 = derived)
+    int hnsw_m;                 // HNSW graph degree (0 = 32)
+    int hnsw_ef_construction;   // HNSW build beam width (0 = 40)
+    int refine;                 // re-rank candidates with exact distances
+
+    // Deletes and updates
+    int fast_remove;            // IVF: id -> list hash table so removes cost O(batch), more memory per vector
+    double compaction_threshold; // HNSW: tombstone share that triggers a background rebuild (0 = 0.2, < 0 never)
+
+    // Sharding: vectors are spread over independent indexes searched in
+    // parallel. Adds then require ids; hybrid search, batching and change sync
+    // need a single index.
+    int shards;                 // number of shards (0 or 1 = a single index)
+    int shard_by_vector;        // route vectors to the nearest shard centroid instead of by id hash;
+                                // training refits the centroids only while the index is empty
+    int shard_probe;            // shard_by_vector: shards searched per query, nearest first (0 = all)
+
+    // Several GPUs (use_gpu = 1). By default the index is copied to every
+    // device and batches are split across the copies; gpu_shard splits the
+    // vectors across the devices instead, for indexes too large for one.
+    const int* gpu_devices;     // devices to use; NULL = gpu_device_id alone
+    int gpu_device_count;
+    int gpu_shard;
+    const size_t* gpu_temp_memory_mb;   // scratch memory per device in gpu_devices (NULL or 0 = min(free / 4, 1.5 GB))
+    size_t gpu_pinned_memory_mb;        // pinned host memory per device for query/result copies (0 = FAISS default)
+    int gpu_disable_float16;            // never fall back to float16 storage to make an index fit
+
+    // Results of repeated single-query searches without an id filter
+    // (pgv_faiss_search, _with_params, _into), of hybrid search's FAISS
+    // candidates and of its exact database scans. Adds, removes, reloads and
+    // writes through the index's connection clear it; writes by other
+    // clients of the table are only bounded by the TTL.
+    size_t result_cache_mb;             // 0 disables
+    int result_cache_ttl_ms;            // 0 = entries never expire
+    float result_cache_epsilon;         // > 0 also reuses a recent query's results within this L2 distance
+
+    // Appended so the fields above keep the offsets of earlier releases
+    pgv_faiss_metric_t metric;          // 0 = L2
 } pgv_faiss_config_t;
 
 typedef struct pgv_faiss_index pgv_faiss_index_t;
 
+// Result buffers come from a per-thread pool that pgv_faiss_free_result and
+// pgv_faiss_free_batch_result return them to; never pass them to free().
 typedef struct pgv_faiss_result {
     int64_t* ids;
     float* distances;
     size_t count;
 } pgv_faiss_result_t;
 
+// Row-major nq x k results; slots without a neighbour have id -1.
+// ids and distances share one allocation released by pgv_faiss_free_batch_result.
+typedef struct pgv_faiss_batch_result {
+    int64_t* ids;
+    float* distances;
+    size_t nq;
+    size_t k;
+} pgv_faiss_batch_result_t;
+
+// Range search hits of nq queries in one flat layout: query i owns entries
+// lims[i] .. lims[i + 1] of ids and distances, nearest first. The arrays are
+// the index's own result buffers handed over without a copy; release them
+// with pgv_faiss_free_range_result.
+typedef struct pgv_faiss_range_result {
+    size_t nq;
+    size_t* lims;       // nq + 1 offsets
+    int64_t* ids;
+    float* distances;
+} pgv_faiss_range_result_t;
+
+// Pages through the neighbours of one query. IVF indexes open further lists
+// per page and never scan a list twice; other indexes search again with a
+// larger k and skip what was already returned.
+typedef struct pgv_faiss_iterator pgv_faiss_iterator_t;
+
+// Immutable set of allowed ids, built once and passed to any number of
+// searches (from any thread) through pgv_faiss_search_params_t.filter.
+// Stored as a compressed bitmap, so large allow-lists stay cheap to probe.
+typedef struct pgv_faiss_id_filter pgv_faiss_id_filter_t;
+
+// Per-call search parameters; 0 keeps the index default (config nprobe for IVF).
+// Applied per call, so concurrent searches may use different values.
+typedef struct pgv_faiss_search_params {
+    int nprobe;        // IVF lists to probe
+    int ef_search;     // HNSW beam width
+    float k_factor;    // refine indexes: candidates per result before exact re-ranking
+    const pgv_faiss_id_filter_t* filter;    // only return these ids; NULL = no filter
+} pgv_faiss_search_params_t;
+
+// Hybrid search: FAISS proposes k * oversample candidates, then one SQL query
+// keeps those matching `filter` and re-ranks them by exact pgvector distance.
+// If fewer than k survive, a filtered pgvector scan answers instead; filters
+// observed to pass fewer than fallback_selectivity of the candidates go to
+// pgvector directly. The filter is SQL over the table's columns and is
+// embedded verbatim (trusted code only); values go in filter_args as text for
+// $1..$n, e.g. filter = "tenant_id = $1", filter_args = {"42"}.
+typedef struct pgv_faiss_hybrid_params {
+    const char* filter;                         // NULL = exact re-rank only
+    const char* const* filter_args;
+    int filter_nargs;
+    size_t oversample;                          // 0 = 10
+    double fallback_selectivity;                // 0 = 0.01
+    const pgv_faiss_search_params_t* search;    // FAISS parameters, may be NULL
+} pgv_faiss_hybrid_params_t;
+
+// Where an index was placed, best first. Before moving an index to the GPU
+// its footprint is estimated, and each placement is tried when the one before
+// does not fit the free device memory.
+typedef enum pgv_faiss_gpu_placement {
+    PGV_FAISS_PLACEMENT_CPU = 0,            // no GPU, or nothing fitted
+    PGV_FAISS_PLACEMENT_GPU = 1,
+    PGV_FAISS_PLACEMENT_GPU_FLOAT16 = 2,    // float16 vectors / lookup tables
+    PGV_FAISS_PLACEMENT_GPU_QUANTIZER = 3,  // IVF coarse quantizer on the GPU, inverted lists in host memory
+} pgv_faiss_gpu_placement_t;
+
+typedef struct pgv_faiss_gpu_device_stats {
+    int device;
+    size_t total_bytes;
+    size_t used_bytes;      // whole device, sampled by the call
+    // Highest used_bytes among the samples taken at placements and stats
+    // calls; a peak reached between two samples is not seen
+    size_t sampled_peak_bytes;
+    size_t index_bytes;     // estimated footprint of this index on the device
+} pgv_faiss_gpu_device_stats_t;
+
+// Training sample drawn by pgv_faiss_train_from_db. SYSTEM reads only the
+// sampled pages and is the cheapest, but rows stored together are sampled
+// together; BERNOULLI samples rows independently and RESERVOIR streams the
+// whole table, both reading every page.
+typedef enum pgv_faiss_sample_method {
+    PGV_FAISS_SAMPLE_SYSTEM = 0,
+    PGV_FAISS_SAMPLE_BERNOULLI = 1,
+    PGV_FAISS_SAMPLE_RESERVOIR = 2,
+} pgv_faiss_sample_method_t;
+
+// Zero values pick defaults
+typedef struct pgv_faiss_train_params {
+    pgv_faiss_sample_method_t method;
+    size_t samples_per_centroid;    // sample = nlist * this (0 = 256)
+    size_t max_samples;             // cap on the sample (0 = none)
+    int batches;                    // IVF: fit the coarse quantizer over this many slices of the sample,
+                                    // each warm-starting from the last (0 = 1)
+    int iterations;                 // k-means iterations per slice (0 = FAISS default)
+    int cpu_kmeans;                 // run k-means on the CPU even for GPU indexes
+    uint64_t seed;                  // sampling and k-means seed (0 = fixed default)
+    int persist;                    // pgv_faiss_train_from_db: also store the trained, empty index
+} pgv_faiss_train_params_t;
+
+typedef struct pgv_faiss_train_stats {
+    size_t table_rows;          // planner estimate
+    size_t sample_rows;
+    size_t nlist;               // per shard for sharded indexes
+    double sample_seconds;
+    double train_seconds;
+} pgv_faiss_train_stats_t;
+
+// Indexes of many tables in one process, one per table, all created from
+// the `index` template (whose connection_string is ignored). A table's index
+// is loaded on its first use over a pool of `threads` connections shared by
+// every table, and GPU indexes share one set of device resources.
+typedef struct pgv_faiss_registry pgv_faiss_registry_t;
+
+typedef struct pgv_faiss_registry_config {
+    const char* connection_string;      // required
+    pgv_faiss_config_t index;
+    size_t memory_budget_mb;            // host memory of resident indexes; least recently used ones are
+                                        // evicted beyond it (0 = unlimited)
+    int threads;                        // parallel loads and builds, one pooled connection each (0 = 4)
+    int build_missing;                  // build from the table rows when nothing is stored for it yet
+    int persist_builds;                 // store built indexes, so that later loads need not rebuild them
+} pgv_faiss_registry_config_t;
+
+typedef struct pgv_faiss_registry_stats {
+    size_t tables;              // tables used at least once
+    size_t resident;
+    size_t resident_bytes;
+    size_t acquired;            // indexes acquired and not yet released
+    uint64_t hits;              // acquires answered without loading
+    uint64_t loads;             // loads and builds, lazy or through pgv_faiss_registry_load
+    uint64_t evictions;
+} pgv_faiss_registry_stats_t;
+
+// Operations counted by the metrics below. DB_QUERY is one round trip to
+// PostgreSQL, DB_COPY one COPY stream; the others are the API calls of the
+// same name (SERIALIZE / DESERIALIZE: pgv_faiss_save_to_db / load_from_db)
+// and TRAIN runs in pgv_faiss_train / pgv_faiss_train_from_db or inside the
+// first add to an untrained index.
+typedef enum pgv_faiss_op {
+    PGV_FAISS_OP_SEARCH = 0,
+    PGV_FAISS_OP_BATCH_SEARCH,
+    PGV_FAISS_OP_HYBRID_SEARCH,
+    PGV_FAISS_OP_ADD,
+    PGV_FAISS_OP_REMOVE,
+    PGV_FAISS_OP_UPSERT,
+    PGV_FAISS_OP_COMPACT,
+    PGV_FAISS_OP_TRAIN,
+    PGV_FAISS_OP_SERIALIZE,
+    PGV_FAISS_OP_DESERIALIZE,
+    PGV_FAISS_OP_DB_QUERY,
+    PGV_FAISS_OP_DB_COPY,
+    PGV_FAISS_OP_RANGE_SEARCH,
+    PGV_FAISS_OP_COUNT
+} pgv_faiss_op_t;
+
+// Latency percentiles are the upper bounds of power-of-two buckets, so they
+// overstate by up to 2x; total_ns / count is exact.
+typedef struct pgv_faiss_op_stats {
+    uint64_t count;
+    uint64_t errors;        // calls that returned an error code
+    uint64_t items;         // queries, vectors or rows handled
+    uint64_t bytes;         // index bytes streamed, COPY payload, fetched embeddings
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t p50_ns;
+    uint64_t p95_ns;
+    uint64_t p99_ns;
+} pgv_faiss_op_stats_t;
+
+typedef struct pgv_faiss_stats {
+    // The index (zero when pgv_faiss_get_stats is given no index)
+    size_t ntotal;
+    int dimension;
+    size_t memory_bytes;            // host memory for codes, ids, quantizers and links; estimated
+    size_t tombstones;              // deleted vectors waiting for compaction
+    size_t shards;                  // 1 for unsharded indexes
+    size_t nlist;                   // IVF inverted lists (0 otherwise)
+    size_t list_min;
+    size_t list_max;
+    double list_imbalance;          // nlist * sum(size^2) / ntotal^2; 1 = even lists
+    pgv_faiss_gpu_placement_t gpu_placement;
+    size_t gpu_index_bytes;         // summed over devices
+    size_t gpu_used_bytes;
+    size_t gpu_sampled_peak_bytes;
+    size_t result_cache_entries;    // zero without a result cache
+    size_t result_cache_bytes;
+    uint64_t result_cache_hits;     // including near hits
+    uint64_t result_cache_near_hits;
+    uint64_t result_cache_misses;
+
+    // Process-wide, since start-up, indexed by pgv_faiss_op_t
+    pgv_faiss_op_stats_t ops[PGV_FAISS_OP_COUNT];
+} pgv_faiss_stats_t;
+
+// One finished operation, shaped after an OpenTelemetry span: operations
+// started inside another one on the same thread (a DB round trip during a
+// save) share its trace_id and carry its span_id as parent_span_id.
+typedef struct pgv_faiss_span {
+    const char* name;               // pgv_faiss_op_name of the operation
+    uint8_t trace_id[16];
+    uint8_t span_id[8];
+    uint8_t parent_span_id[8];      // all zero for root spans
+    uint64_t start_unix_ns;
+    uint64_t end_unix_ns;
+    int status;                     // 0, or the error code the operation returned
+    uint64_t items;
+    uint64_t bytes;
+} pgv_faiss_span_t;
+
+typedef void (*pgv_faiss_span_callback_t)(const pgv_faiss_span_t* span, void* user_data);
+
 // Core API functions
 int pgv_faiss_init(pgv_faiss_config_t* config, pgv_faiss_index_t** index);
 int pgv_faiss_add_vectors(pgv_faiss_index_t* index, const float* vectors, const int64_t* ids, size_t count);
 int pgv_faiss_search(pgv_faiss_index_t* index, const float* query, size_t k, pgv_faiss_result_t* result);
+// Adds count x dimension elements of `type`, widened to float32 a block at a
+// time with SIMD; scale (> 0) applies to INT8 only and is ignored otherwise.
+// A failure may leave earlier blocks added.
+int pgv_faiss_add_vectors_typed(pgv_faiss_index_t* index, const void* vectors, pgv_faiss_vector_type_t type,
+                                float scale, const int64_t* ids, size_t count);
+// Converts `count` elements between types, e.g. to keep float16 or int8 copies
+// of float32 embeddings; scale (> 0) is the INT8 step on either side and is
+// ignored when neither side is INT8
+int pgv_faiss_convert_vectors(const void* in, pgv_faiss_vector_type_t in_type, void* out,
+                              pgv_faiss_vector_type_t out_type, size_t count, float scale);
+
+// Deletes and upserts (insert or replace by id). With a table_name the rows
+// are changed in that pgvector table first and the index only if that
+// succeeded; NULL changes the index alone. Indexes that cannot delete in place
+// (HNSW) hide deleted vectors until they are compacted. An upsert whose index
+// add fails (-4) leaves its ids deleted from the index until it is retried.
+// Custom factory strings without an IDMap or IVF store no ids and refuse
+// deletes with -4.
+int pgv_faiss_remove_vectors(pgv_faiss_index_t* index, const char* table_name, const int64_t* ids, size_t count);
+int pgv_faiss_upsert_vectors(pgv_faiss_index_t* index, const char* table_name, const float* vectors,
+                             const int64_t* ids, size_t count);
+// Rebuilds the index without deleted vectors now instead of in the background
+int pgv_faiss_compact(pgv_faiss_index_t* index);
+
+// Batch search: queries is nq x dimension, answered with a single index call
+int pgv_faiss_batch_search(pgv_faiss_index_t* index, const float* queries, size_t nq, size_t k, pgv_faiss_batch_result_t* result);
+// Same as above but writes into caller-owned nq x k arrays
+int pgv_faiss_batch_search_into(pgv_faiss_index_t* index, const float* queries, size_t nq, size_t k, int64_t* ids, float* distances);
+// Variants taking per-call parameters; params may be NULL
+int pgv_faiss_search_with_params(pgv_faiss_index_t* index, const float* query, size_t k,
+                                 const pgv_faiss_search_params_t* params, pgv_faiss_result_t* result);
+// Writes into caller-owned arrays of k slots, hits first and the rest id -1;
+// count (may be NULL) receives the hits. Without batching enabled no heap
+// memory is allocated once the calling thread has warmed up.
+int pgv_faiss_search_into(pgv_faiss_index_t* index, const float* query, size_t k,
+                          const pgv_faiss_search_params_t* params, int64_t* ids, float* distances, size_t* count);
+int pgv_faiss_batch_search_with_params(pgv_faiss_index_t* index, const float* queries, size_t nq, size_t k,
+                                       const pgv_faiss_search_params_t* params, pgv_faiss_batch_result_t* result);
+// Every vector strictly within radius of each query, in the index's distance
+// units (squared L2, negated inner product or 1 - cosine), so smaller radii
+// are stricter for every metric. params may be NULL; -4 when the index type
+// cannot answer range queries (GPU and refine indexes).
+int pgv_faiss_range_search(pgv_faiss_index_t* index, const float* queries, size_t nq, float radius,
+                           const pgv_faiss_search_params_t* params, pgv_faiss_range_result_t* result);
+// The index, and params->filter if set, must outlive the iterator. next writes
+// up to k results and stores how many in count, fewer than k only once the
+// index has nothing more for the query.
+int pgv_faiss_iterator_create(pgv_faiss_index_t* index, const float* query,
+                              const pgv_faiss_search_params_t* params, pgv_faiss_iterator_t** iterator);
+int pgv_faiss_iterator_next(pgv_faiss_iterator_t* iterator, size_t k, int64_t* ids, float* distances,
+                            size_t* count);
+void pgv_faiss_iterator_destroy(pgv_faiss_iterator_t* iterator);
+// Filters must outlive every search using them
+int pgv_faiss_id_filter_create(const int64_t* ids, size_t count, pgv_faiss_id_filter_t** filter);
+size_t pgv_faiss_id_filter_size(const pgv_faiss_id_filter_t* filter);
+void pgv_faiss_id_filter_destroy(pgv_faiss_id_filter_t* filter);
+// Needs a database connection; table_name is the pgvector table the index mirrors.
+// Returns -2 when the database fails, also if FAISS already found candidates.
+int pgv_faiss_hybrid_search(pgv_faiss_index_t* index, const char* table_name, const float* query, size_t k,
+                            const pgv_faiss_hybrid_params_t* params, pgv_faiss_result_t* result);
+// Change-data capture: a trigger on table_name logs changed ids and a
+// background thread applies them to the index in batches, on NOTIFY or every
+// poll_interval_ms (0 = 1000). pgv_faiss_save_to_db records how far the saved
+// index is in sync, so after pgv_faiss_load_from_db syncing resumes from there.
+// For a fresh index, start syncing before loading vectors from the table.
+// Needs PostgreSQL 13+ and a connection string; one table per index.
+int pgv_faiss_sync_start(pgv_faiss_index_t* index, const char* table_name, int poll_interval_ms);
+// Applies pending changes now; applied (may be NULL) receives the number of ids
+int pgv_faiss_sync_flush(pgv_faiss_index_t* index, size_t* applied);
+int pgv_faiss_sync_stop(pgv_faiss_index_t* index);
+// Coalesce concurrent pgv_faiss_search calls into batched index calls: a batch is
+// issued once max_batch queries wait or the oldest waited max_delay_us.
+// max_batch = 0 disables batching. Call before searching from multiple threads.
+int pgv_faiss_enable_batching(pgv_faiss_index_t* index, size_t max_batch, int max_delay_us);
+
+// Dedicated training stage for IVF and PQ indexes, run before the first add
+// so that it only encodes; -1 once the index holds vectors. Indexes that are
+// already trained or need no training are left as they are. params may be NULL.
+int pgv_faiss_train(pgv_faiss_index_t* index, const float* vectors, size_t count,
+                    const pgv_faiss_train_params_t* params);
+// Trains an empty index on a random sample of table_name sized to its nlist.
+// With params->persist the trained, empty index is stored under
+// "<table>_trained", from where pgv_faiss_load_training restores it for
+// rebuilds without training again. stats may be NULL.
+int pgv_faiss_train_from_db(pgv_faiss_index_t* index, const char* table_name,
+                            const pgv_faiss_train_params_t* params, pgv_faiss_train_stats_t* stats);
+// Replaces an empty index with the one stored by pgv_faiss_train_from_db;
+// -1 when the index is not empty or nothing is stored
+int pgv_faiss_load_training(pgv_faiss_index_t* index, const char* table_name);
+
+// Multi-table registry. An acquired index stays resident until released and
+// takes every pgv_faiss_* call except those needing a connection of its own
+// (save, hybrid search, sync), which return -2; never destroy it.
+int pgv_faiss_registry_create(const pgv_faiss_registry_config_t* config, pgv_faiss_registry_t** registry);
+int pgv_faiss_registry_acquire(pgv_faiss_registry_t* registry, const char* table_name, pgv_faiss_index_t** index);
+void pgv_faiss_registry_release(pgv_faiss_registry_t* registry, pgv_faiss_index_t* index);
+// Acquire, pgv_faiss_search_with_params and release in one call
+int pgv_faiss_registry_search(pgv_faiss_registry_t* registry, const char* table_name, const float* query,
+                              size_t k, const pgv_faiss_search_params_t* params, pgv_faiss_result_t* result);
+// Reloads the latest stored index of every table, resident or not, or with
+// rebuild builds them from their rows; `threads` tables at a time. status
+// (may be NULL) receives count codes; returns the first error.
+int pgv_faiss_registry_load(pgv_faiss_registry_t* registry, const char* const* table_names, size_t count,
+                            int rebuild, int* status);
+// -1 when the table's index is not resident or still acquired
+int pgv_faiss_registry_evict(pgv_faiss_registry_t* registry, const char* table_name);
+int pgv_faiss_registry_get_stats(pgv_faiss_registry_t* registry, pgv_faiss_registry_stats_t* stats);
+// Every acquired index must have been released
+void pgv_faiss_registry_destroy(pgv_faiss_registry_t* registry);
+
+// A sharded index stores shard i under "<table>_shard<i>" and its layout under
+// "<table>_shards" instead of under table_name itself.
 int pgv_faiss_save_to_db(pgv_faiss_index_t* index, const char* table_name);
 int pgv_faiss_load_from_db(pgv_faiss_index_t* index, const char* table_name);
+// Fills up to capacity device entries; count receives the number of devices
+// the index uses (0 for CPU indexes). Either output may be NULL.
+int pgv_faiss_get_gpu_stats(pgv_faiss_index_t* index, pgv_faiss_gpu_placement_t* placement,
+                            pgv_faiss_gpu_device_stats_t* devices, size_t capacity, size_t* count);
+// Index figures plus the process-wide operation counters; index may be NULL.
+// IVF list statistics walk every list, so poll this rather than call it per query.
+int pgv_faiss_get_stats(pgv_faiss_index_t* index, pgv_faiss_stats_t* stats);
+const char* pgv_faiss_op_name(pgv_faiss_op_t op);
+// Same figures in the Prometheus text exposition format, NUL-terminated.
+// length receives the size needed without the NUL; returns -3 (writing
+// nothing) when capacity is too small. index may be NULL.
+int pgv_faiss_export_prometheus(pgv_faiss_index_t* index, char* buffer, size_t capacity, size_t* length);
+// Metrics are on by default and cost two clock reads per operation; disabled,
+// an operation pays one relaxed load. Affects all indexes in the process.
+void pgv_faiss_set_metrics_enabled(int enabled);
+// Receives every finished operation on the thread that ran it, whether or
+// not metrics are enabled; NULL turns tracing off. Set it before the traced
+// calls start: a callback replaced while calls run may still be invoked once.
+void pgv_faiss_set_span_callback(pgv_faiss_span_callback_t callback, void* user_data);
 void pgv_faiss_free_result(pgv_faiss_result_t* result);
+void pgv_faiss_free_batch_result(pgv_faiss_batch_result_t* result);
+void pgv_faiss_free_range_result(pgv_faiss_range_result_t* result);
 void pgv_faiss_destroy(pgv_faiss_index_t* index);
 
 // TODO: Add missing API functions:
-// - pgv_faiss_get_stats() for index statistics
-// - pgv_faiss_batch_search() for multiple queries
-// - pgv_faiss_range_search() for radius-based search
-// - pgv_faiss_remove_vectors() for vector deletion
-// - pgv_faiss_update_vector() for vector modification
 // - pgv_faiss_get_vector() for vector retrieval
 // - pgv_faiss_validate_config() for configuration validation
 // - pgv_faiss_get_version() for version information
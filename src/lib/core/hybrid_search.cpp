@@ -0,0 +1,108 @@
+#include "hybrid_search.h"
+#include <algorithm>
+
+namespace {
+
+// Weight of the newest observation in the selectivity moving average
+const double kSelectivityAlpha = 0.2;
+
+// The pgvector scan knows only the SQL filter, so an id filter is applied on the way out
+void to_results(const std::vector<std::pair<int64_t, float>>& rows, std::vector<SearchResult>& results,
+                const IdFilter* ids = nullptr) {
+    results.clear();
+    results.reserve(rows.size());
+    for (const auto& row : rows) {
+        if (!ids || ids->contains(row.first)) {
+            results.push_back({row.first, row.second});
+        }
+    }
+}
+
+} // namespace
+
+HybridSearcher::HybridSearcher(FAISSWrapper& index, pgvector::PGVConnection& connection)
+    : index_(index), connection_(connection) {
+}
+
+bool HybridSearcher::search(const std::string& table_name, const float* query, size_t k,
+                            const pgvector::SqlFilter& filter, std::vector<SearchResult>& results,
+                            const HybridSearchOptions& options, HybridSearchStats* stats) {
+    HybridSearchStats local;
+    HybridSearchStats& out = stats ? *stats : local;
+    out = HybridSearchStats();
+    results.clear();
+
+    if (!query || k == 0) {
+        return true;
+    }
+
+    const int dimension = index_.get_dimension();
+    const std::string key = table_name + '\0' + filter.predicate;
+    std::vector<std::pair<int64_t, float>> rows;
+
+    if (!filter.predicate.empty() && should_skip_faiss(key, options)) {
+        out.used_fallback = true;
+        if (!connection_.similarity_search(table_name, query, dimension, k, filter, rows)) {
+            return false;
+        }
+        to_results(rows, results, options.search.filter);
+        return true;
+    }
+
+    size_t wanted = std::max(k, std::min(k * std::max<size_t>(options.oversample, 1), options.max_candidates));
+    std::vector<SearchResult> hits = index_.search(query, wanted, options.search);
+    out.candidates = hits.size();
+
+    if (!hits.empty()) {
+        std::vector<int64_t> ids;
+        ids.reserve(hits.size());
+        for (const auto& hit : hits) {
+            ids.push_back(hit.id);
+        }
+        if (!connection_.rerank_candidates(table_name, query, dimension, ids.data(), ids.size(), k,
+                                           filter, rows, &out.matched)) {
+            return false;
+        }
+        if (!filter.predicate.empty()) {
+            record_selectivity(key, static_cast<double>(out.matched) / hits.size());
+        }
+    }
+
+    // A short answer is only final if FAISS had no further candidates to offer
+    if (rows.size() < k && (hits.empty() || hits.size() == wanted)) {
+        out.used_fallback = true;
+        if (!connection_.similarity_search(table_name, query, dimension, k, filter, rows)) {
+            return false;
+        }
+        to_results(rows, results, options.search.filter);
+        return true;
+    }
+
+    to_results(rows, results);
+    return true;
+}
+
+bool HybridSearcher::should_skip_faiss(const std::string& key, const HybridSearchOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = predicates_.find(key);
+    if (it == predicates_.end() || it->second.samples == 0 ||
+        it->second.selectivity >= options.fallback_selectivity) {
+        return false;
+    }
+
+    // Probe through FAISS now and then in case the data distribution changed
+    if (++it->second.skipped >= std::max<size_t>(options.reprobe_interval, 1)) {
+        it->second.skipped = 0;
+        return false;
+    }
+    return true;
+}
+
+void HybridSearcher::record_selectivity(const std::string& key, double selectivity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PredicateStats& entry = predicates_[key];
+    entry.selectivity = entry.samples == 0
+        ? selectivity
+        : (1.0 - kSelectivityAlpha) * entry.selectivity + kSelectivityAlpha * selectivity;
+    ++entry.samples;
+}
@@ -0,0 +1,63 @@
+#ifndef PGV_HYBRID_SEARCH_H
+#define PGV_HYBRID_SEARCH_H
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pgvector/pgv_connection.h"
+#include "faiss/faiss_wrapper.h"
+
+struct HybridSearchOptions {
+    size_t oversample = 10;                 // FAISS candidates fetched per requested result
+    size_t max_candidates = 10000;          // cap on the candidate id array sent to the database
+    double fallback_selectivity = 0.01;     // filters passing fewer candidates go straight to pgvector
+    size_t reprobe_interval = 64;           // every n-th such query re-measures through FAISS
+    SearchOptions search;                   // FAISS per-call knobs for candidate generation
+};
+
+struct HybridSearchStats {
+    size_t candidates = 0;      // ids FAISS proposed
+    size_t matched = 0;         // candidates that passed the filter
+    bool used_fallback = false; // answered by a filtered pgvector scan
+};
+
+// Filtered, exactly ranked search over a FAISS index mirrored from a pgvector
+// table. FAISS proposes k * oversample candidates; one SQL statement filters
+// them with the caller's predicate and re-ranks them with exact pgvector
+// distances. When fewer than k candidates survive, the query is answered by a
+// filtered pgvector scan instead, and the predicate's selectivity is tracked
+// so later queries with a very selective predicate skip FAISS altogether.
+// An id filter in the search options restricts the FAISS candidates and is
+// applied to fallback rows afterwards, which may then number fewer than k.
+// search returns false on database errors, leaving `results` empty and the
+// selectivity statistics untouched.
+//
+// The connection is not locked here; callers serialize access to it.
+class HybridSearcher {
+public:
+    HybridSearcher(FAISSWrapper& index, pgvector::PGVConnection& connection);
+
+    bool search(const std::string& table_name, const float* query, size_t k, const pgvector::SqlFilter& filter,
+                std::vector<SearchResult>& results, const HybridSearchOptions& options = HybridSearchOptions(),
+                HybridSearchStats* stats = nullptr);
+
+private:
+    struct PredicateStats {
+        double selectivity = 1.0;   // moving average of matched / candidates
+        size_t samples = 0;
+        size_t skipped = 0;         // queries sent straight to pgvector since the last probe
+    };
+
+    FAISSWrapper& index_;
+    pgvector::PGVConnection& connection_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, PredicateStats> predicates_;   // keyed by table and predicate text
+
+    bool should_skip_faiss(const std::string& key, const HybridSearchOptions& options);
+    void record_selectivity(const std::string& key, double selectivity);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "index_build_pipeline.h"
+#include "bounded_queue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+IndexBuildPipeline::IndexBuildPipeline(pgvector::PGVConnection& connection, FAISSWrapper& index,
+                                       const IndexBuildOptions& options)
+    : connection_(connection), index_(index), options_(options) {
+    options_.chunk_rows = std::max<size_t>(options_.chunk_rows, 1);
+    options_.queue_depth = std::max<size_t>(options_.queue_depth, 1);
+}
+
+int IndexBuildPipeline::run(const std::string& table_name) {
+    stats_ = IndexBuildStats();
+    
+    if (!connection_.is_connected()) {
+        return -2;
+    }
+    
+    if (index_.requires_training()) {
+        options_.training.chunk_rows = options_.chunk_rows;
+        IndexTrainer trainer(connection_, options_.training);
+        int status = trainer.run(table_name, index_);
+        stats_.rows_scanned_for_training = trainer.stats().rows_scanned;
+        stats_.training_rows = trainer.stats().sample_rows;
+        stats_.training_seconds = trainer.stats().sample_seconds + trainer.stats().train_seconds;
+        if (status != 0 || stats_.training_rows == 0) {
+            return status;
+        }
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    int status = stream_table(table_name, &IndexBuildPipeline::add_chunk);
+    stats_.build_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    
+    return status;
+}
+
+int IndexBuildPipeline::stream_table(const std::string& table_name, ChunkConsumer consume) {
+    const int dimension = index_.get_dimension();
+    const size_t chunk_rows = options_.chunk_rows;
+    const size_t depth = options_.queue_depth;
+    const std::string cursor_name = "pgv_build_cursor";
+    
+    if (!connection_.open_vector_cursor(table_name, cursor_name)) {
+        return -2;
+    }
+    
+    // One chunk per queue slot plus the ones held by the decoder and the consumer
+    std::vector<Chunk> chunks(depth + 2);
+    BoundedQueue<Chunk*> free_chunks(chunks.size());
+    for (auto& chunk : chunks) {
+        chunk.vectors.resize(chunk_rows * static_cast<size_t>(dimension));
+        chunk.ids.resize(chunk_rows);
+        free_chunks.push(&chunk);
+    }
+    
+    BoundedQueue<PGresult*> fetched(depth);
+    BoundedQueue<Chunk*> decoded(depth);
+    std::atomic<int> status(0);
+    
+    auto fail = [&](int code) {
+        int expected = 0;
+        status.compare_exchange_strong(expected, code);
+        fetched.close();
+        decoded.close();
+        free_chunks.close();
+    };
+    
+    // Stage 1: network fetch. Only this thread touches the PGconn.
+    std::thread fetcher([&] {
+        for (;;) {
+            PGresult* res = connection_.fetch_vector_chunk(cursor_name, chunk_rows);
+            if (!res) {
+                fail(-2);
+                break;
+            }
+            
+            size_t rows = static_cast<size_t>(PQntuples(res));
+            if (rows == 0 || !fetched.push(res)) {
+                PQclear(res);
+                break;
+            }
+            if (rows < chunk_rows) break;
+        }
+        fetched.close();
+    });
+    
+    // Stage 2: binary decode into recycled contiguous chunks
+    std::thread decoder([&] {
+        PGresult* res = nullptr;
+        while (fetched.pop(res)) {
+            Chunk* chunk = nullptr;
+            if (status.load() != 0 || !free_chunks.pop(chunk)) {
+                PQclear(res);
+                continue;
+            }
+            
+            try {
+                chunk->count = pgvector::PGVConnection::decode_vector_rows(
+                    res, dimension, chunk->vectors.data(), chunk->ids.data());
+            } catch (const std::exception& e) {
+                std::cerr << "Error decoding vectors: " << e.what() << std::endl;
+                PQclear(res);
+                fail(-2);
+                continue;
+            }
+            PQclear(res);
+            
+            if (!decoded.push(chunk)) break;
+        }
+        decoded.close();
+    });
+    
+    // Stage 3: index insertion on the calling thread
+    Chunk* chunk = nullptr;
+    while (decoded.pop(chunk)) {
+        if (status.load() == 0 && !(this->*consume)(*chunk)) {
+            fail(-4);
+        }
+        free_chunks.push(chunk);
+    }
+    
+    fetcher.join();
+    decoder.join();
+    fetched.drain([](PGresult* res) { PQclear(res); });
+    
+    connection_.close_vector_cursor(cursor_name, status.load() == 0);
+    return status.load();
+}
+
+bool IndexBuildPipeline::add_chunk(const Chunk& chunk) {
+    if (chunk.count == 0) {
+        return true;
+    }
+    
+    if (index_.add_vectors(chunk.vectors.data(), chunk.ids.data(), chunk.count) != 0) {
+        return false;
+    }
+    
+    stats_.rows_added += chunk.count;
+    return true;
+}
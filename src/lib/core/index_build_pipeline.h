@@ -0,0 +1,59 @@
+#ifndef PGV_INDEX_BUILD_PIPELINE_H
+#define PGV_INDEX_BUILD_PIPELINE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pgvector/pgv_connection.h"
+#include "faiss/faiss_wrapper.h"
+#include "index_trainer.h"
+
+struct IndexBuildOptions {
+    size_t chunk_rows = 10000;          // rows per cursor FETCH
+    size_t queue_depth = 4;             // in-flight chunks per stage; bounds peak memory
+    TrainingOptions training;           // sampling and k-means for indexes that need training
+};
+
+struct IndexBuildStats {
+    size_t rows_added = 0;
+    size_t rows_scanned_for_training = 0;
+    size_t training_rows = 0;
+    double training_seconds = 0.0;
+    double build_seconds = 0.0;
+};
+
+// Builds a FAISS index from a pgvector table with fetch, binary decode and
+// add_with_ids running on separate threads connected by bounded queues.
+// Indexes that need training are first trained by an IndexTrainer on a
+// random sample of the table, so training no longer depends on the physical
+// order of the first batch.
+class IndexBuildPipeline {
+public:
+    IndexBuildPipeline(pgvector::PGVConnection& connection, FAISSWrapper& index,
+                       const IndexBuildOptions& options = IndexBuildOptions());
+
+    // Returns 0 on success, -2 on database errors, -4 on index errors.
+    int run(const std::string& table_name);
+
+    const IndexBuildStats& stats() const { return stats_; }
+
+    struct Chunk {
+        std::vector<float> vectors;
+        std::vector<int64_t> ids;
+        size_t count = 0;
+    };
+
+private:
+    pgvector::PGVConnection& connection_;
+    FAISSWrapper& index_;
+    IndexBuildOptions options_;
+    IndexBuildStats stats_;
+
+    using ChunkConsumer = bool (IndexBuildPipeline::*)(const Chunk& chunk);
+    int stream_table(const std::string& table_name, ChunkConsumer consume);
+
+    bool add_chunk(const Chunk& chunk);
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "index_cache.h"
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const kSuffix = ".faissindex";
+
+// Table names may carry a schema or quoting; keep file names portable
+std::string file_stem(const std::string& table_name) {
+    std::string stem = table_name;
+    for (char& c : stem) {
+        bool keep = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                    c == '_' || c == '-' || c == '.';
+        if (!keep) c = '_';
+    }
+    return stem;
+}
+
+} // namespace
+
+IndexCache::IndexCache(const std::string& directory) : directory_(directory) {
+    std::error_code error;
+    fs::create_directories(directory_, error);
+    if (error) {
+        std::cerr << "Cannot create index cache directory " << directory_ << ": " << error.message() << std::endl;
+    }
+}
+
+std::string IndexCache::path(const std::string& table_name, int64_t version) const {
+    return (fs::path(directory_) / (file_stem(table_name) + "." + std::to_string(version) + kSuffix)).string();
+}
+
+bool IndexCache::contains(const std::string& table_name, int64_t version) const {
+    std::error_code error;
+    return fs::is_regular_file(path(table_name, version), error);
+}
+
+void IndexCache::remove(const std::string& table_name, int64_t version) {
+    std::error_code error;
+    fs::remove(path(table_name, version), error);
+}
+
+std::unique_ptr<IndexCache::Writer> IndexCache::begin(const std::string& table_name) {
+    static std::atomic<uint64_t> sequence(0);
+
+    // Unique per process and writer; dot-prefixed so prune() never matches it
+    std::string temp_path = (fs::path(directory_) /
+        ("." + file_stem(table_name) + "." + std::to_string(getpid()) + "." +
+         std::to_string(sequence.fetch_add(1)) + ".tmp")).string();
+
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Cannot write index cache entry " << temp_path << std::endl;
+        return nullptr;
+    }
+
+    return std::unique_ptr<Writer>(new Writer(*this, table_name, temp_path, file));
+}
+
+void IndexCache::prune(const std::string& table_name, int64_t keep_version) {
+    const std::string prefix = file_stem(table_name) + ".";
+    const std::string keep = fs::path(path(table_name, keep_version)).filename().string();
+
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(directory_, error)) {
+        std::string name = entry.path().filename().string();
+        if (name == keep || name.size() <= prefix.size() + std::strlen(kSuffix)) continue;
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+        if (name.compare(name.size() - std::strlen(kSuffix), std::string::npos, kSuffix) != 0) continue;
+
+        // Only "<stem>.<digits><suffix>" belongs to this table; "<stem>.x.<n>" is another one
+        std::string middle = name.substr(prefix.size(), name.size() - prefix.size() - std::strlen(kSuffix));
+        if (middle.find_first_not_of("0123456789") != std::string::npos) continue;
+
+        std::error_code ignored;
+        fs::remove(entry.path(), ignored);
+    }
+}
+
+IndexCache::Writer::Writer(IndexCache& cache, const std::string& table_name, const std::string& temp_path,
+                           std::FILE* file)
+    : cache_(cache), table_name_(table_name), temp_path_(temp_path), file_(file) {
+}
+
+IndexCache::Writer::~Writer() {
+    if (file_) {
+        std::fclose(file_);
+        std::remove(temp_path_.c_str());
+    }
+}
+
+bool IndexCache::Writer::write(const uint8_t* data, size_t size) {
+    return file_ && std::fwrite(data, 1, size, file_) == size;
+}
+
+bool IndexCache::Writer::commit(int64_t version) {
+    if (!file_) return false;
+
+    bool ok = std::fflush(file_) == 0 && fsync(fileno(file_)) == 0;
+    ok = std::fclose(file_) == 0 && ok;
+    file_ = nullptr;
+
+    std::string final_path = cache_.path(table_name_, version);
+    if (!ok || std::rename(temp_path_.c_str(), final_path.c_str()) != 0) {
+        std::cerr << "Cannot publish index cache entry " << final_path << std::endl;
+        std::remove(temp_path_.c_str());
+        return false;
+    }
+
+    cache_.prune(table_name_, version);
+    return true;
+}
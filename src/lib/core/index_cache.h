@@ -0,0 +1,50 @@
+#ifndef PGV_INDEX_CACHE_H
+#define PGV_INDEX_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+// Local on-disk copy of indexes persisted in PostgreSQL, one file per
+// (table, stored version) holding the plain FAISS serialization. Entries are
+// written under a temporary name and renamed into place once complete, so a
+// crashed writer never leaves a truncated entry that looks valid.
+class IndexCache {
+public:
+    explicit IndexCache(const std::string& directory);
+
+    const std::string& directory() const { return directory_; }
+    std::string path(const std::string& table_name, int64_t version) const;
+    bool contains(const std::string& table_name, int64_t version) const;
+    void remove(const std::string& table_name, int64_t version);
+
+    // Receives the serialized index while it streams to or from the database.
+    class Writer {
+    public:
+        ~Writer();
+
+        bool write(const uint8_t* data, size_t size);
+        // Publishes the entry as `version` and drops older versions of the table
+        bool commit(int64_t version);
+
+    private:
+        friend class IndexCache;
+        Writer(IndexCache& cache, const std::string& table_name, const std::string& temp_path, std::FILE* file);
+
+        IndexCache& cache_;
+        std::string table_name_;
+        std::string temp_path_;
+        std::FILE* file_;
+    };
+
+    // Returns nullptr if the cache directory is not writable.
+    std::unique_ptr<Writer> begin(const std::string& table_name);
+
+private:
+    std::string directory_;
+
+    void prune(const std::string& table_name, int64_t keep_version);
+};
+
+#endif
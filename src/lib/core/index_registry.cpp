@@ -0,0 +1,190 @@
+#include "index_registry.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+// Builds can hold a connection for minutes; opens queue for one rather than fail
+pgvector::PoolOptions pool_options(const RegistryOptions& options) {
+    pgvector::PoolOptions pool;
+    pool.size = std::max<size_t>(options.threads, 1);
+    pool.acquire_timeout = std::chrono::hours(1);
+    return pool;
+}
+
+} // namespace
+
+IndexRegistry::IndexRegistry(const std::string& connection_string, const RegistryOptions& options, Opener open,
+                             Footprint footprint)
+    : options_(options), open_(std::move(open)), footprint_(std::move(footprint)),
+      connections_(std::make_unique<pgvector::PGVConnectionPool>(connection_string, pool_options(options))),
+      pool_(std::max<size_t>(options.threads, 1)) {}
+
+IndexRegistry::IndexRegistry(const RegistryOptions& options, Opener open, Footprint footprint)
+    : options_(options), open_(std::move(open)), footprint_(std::move(footprint)),
+      pool_(std::max<size_t>(options.threads, 1)) {}
+
+bool IndexRegistry::start() {
+    return !connections_ || connections_->start();
+}
+
+int IndexRegistry::open_entry(const std::string& table, Entry& entry, bool rebuild,
+                              std::unique_lock<std::mutex>& lock) {
+    entry.loading = true;
+    // Loads replace the contents of a resident index in place; builds start from an empty one
+    Handle handle = rebuild ? nullptr : entry.handle;
+    lock.unlock();
+
+    int status;
+    try {
+        if (connections_) {
+            pgvector::PGVConnectionPool::Lease connection = connections_->acquire();
+            status = connection ? open_(table, connection.get(), rebuild, handle) : -2;
+            if (status == -2 && connection) connection.invalidate();
+        } else {
+            status = open_(table, nullptr, rebuild, handle);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error opening index of " << table << ": " << e.what() << std::endl;
+        status = -4;
+    }
+    size_t bytes = status == 0 ? footprint_(handle.get()) : 0;
+
+    lock.lock();
+    entry.loading = false;
+    opened_.notify_all();
+    if (status != 0) {
+        return status;
+    }
+
+    if (entry.handle) {
+        recent_.splice(recent_.begin(), recent_, entry.recent);
+    } else {
+        recent_.push_front(table);
+        entry.recent = recent_.begin();
+    }
+    resident_bytes_ = resident_bytes_ - entry.bytes + bytes;
+    entry.bytes = bytes;
+    entry.handle = std::move(handle);
+    ++loads_;
+    return 0;
+}
+
+int IndexRegistry::acquire(const std::string& table, pgv_faiss_index_t** index) {
+    *index = nullptr;
+    std::vector<Handle> dropped;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // References into entries_ survive rehashing
+    Entry& entry = entries_[table];
+    opened_.wait(lock, [&entry] { return !entry.loading; });
+    if (entry.handle) {
+        ++hits_;
+        recent_.splice(recent_.begin(), recent_, entry.recent);
+    } else {
+        int status = open_entry(table, entry, false, lock);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    Lease& lease = leases_[entry.handle.get()];
+    lease.handle = entry.handle;
+    ++lease.count;
+    *index = entry.handle.get();
+    evict_locked(dropped);
+    lock.unlock();
+    return 0;
+}
+
+void IndexRegistry::release(pgv_faiss_index_t* index) {
+    Handle last;
+    std::vector<Handle> dropped;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto lease = leases_.find(index);
+    if (lease == leases_.end()) {
+        return;
+    }
+    if (--lease->second.count == 0) {
+        // Replaced or evicted indexes go away with their last lease
+        last = std::move(lease->second.handle);
+        leases_.erase(lease);
+        evict_locked(dropped);
+    }
+    lock.unlock();
+}
+
+int IndexRegistry::load(const std::vector<std::string>& tables, bool rebuild, std::vector<int>& status) {
+    status.assign(tables.size(), 0);
+    pool_.parallel_for(tables.size(), [&](size_t i) {
+        std::vector<Handle> dropped;
+        std::unique_lock<std::mutex> lock(mutex_);
+        Entry& entry = entries_[tables[i]];
+        opened_.wait(lock, [&entry] { return !entry.loading; });
+        status[i] = open_entry(tables[i], entry, rebuild, lock);
+        evict_locked(dropped);
+        lock.unlock();
+    });
+
+    for (int code : status) {
+        if (code != 0) return code;
+    }
+    return 0;
+}
+
+bool IndexRegistry::evict(const std::string& table) {
+    Handle dropped;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto found = entries_.find(table);
+    if (found == entries_.end()) {
+        return false;
+    }
+    Entry& entry = found->second;
+    if (!entry.handle || entry.loading || leases_.count(entry.handle.get()) > 0) {
+        return false;
+    }
+
+    dropped = std::move(entry.handle);
+    recent_.erase(entry.recent);
+    resident_bytes_ -= entry.bytes;
+    entry.bytes = 0;
+    ++evictions_;
+    return true;
+}
+
+void IndexRegistry::evict_locked(std::vector<Handle>& dropped) {
+    if (options_.memory_budget == 0) {
+        return;
+    }
+
+    // Least recently acquired first, skipping indexes in use or being reopened
+    auto it = recent_.end();
+    while (resident_bytes_ > options_.memory_budget && it != recent_.begin()) {
+        --it;
+        Entry& entry = entries_[*it];
+        if (entry.loading || leases_.count(entry.handle.get()) > 0) continue;
+
+        dropped.push_back(std::move(entry.handle));
+        resident_bytes_ -= entry.bytes;
+        entry.bytes = 0;
+        it = recent_.erase(it);
+        ++evictions_;
+    }
+}
+
+RegistryStats IndexRegistry::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RegistryStats stats;
+    stats.tables = entries_.size();
+    stats.resident = recent_.size();
+    stats.resident_bytes = resident_bytes_;
+    stats.acquired = leases_.size();
+    stats.hits = hits_;
+    stats.loads = loads_;
+    stats.evictions = evictions_;
+    return stats;
+}
@@ -0,0 +1,111 @@
+#ifndef PGV_INDEX_REGISTRY_H
+#define PGV_INDEX_REGISTRY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pgv_faiss.h"
+#include "pgvector/pgv_connection_pool.h"
+#include "thread_pool.h"
+
+struct RegistryOptions {
+    size_t memory_budget = 0;   // bytes of resident indexes across all tables; 0 = unlimited
+    size_t threads = 4;         // parallel loads and builds, one pooled connection each
+};
+
+struct RegistryStats {
+    size_t tables = 0;          // tables acquired or loaded at least once
+    size_t resident = 0;
+    size_t resident_bytes = 0;
+    size_t acquired = 0;        // indexes handed out and not yet released
+    uint64_t hits = 0;          // acquires answered by a resident index
+    uint64_t loads = 0;
+    uint64_t evictions = 0;
+};
+
+// Indexes of many tables in one process. A table's index is opened on its
+// first acquire, or ahead of time by load(), over connections leased from
+// one pool shared by every table. Once the resident indexes outgrow the
+// memory budget the least recently acquired ones are dropped and reopened
+// on their next acquire. Acquired indexes are never dropped: an index
+// replaced or evicted while acquired lives on until its last release.
+class IndexRegistry {
+public:
+    using Handle = std::shared_ptr<pgv_faiss_index_t>;
+    // Opens `table`'s index over `connection` into `handle`, creating the
+    // handle when it is null; with rebuild the index is built from the table
+    // rows instead of loaded. connection is null in a registry without a
+    // database. Returns 0 or a pgv_faiss error code.
+    using Opener = std::function<int(const std::string& table, pgvector::PGVConnection* connection, bool rebuild,
+                                     Handle& handle)>;
+    // Resident bytes of an opened index
+    using Footprint = std::function<size_t(pgv_faiss_index_t* index)>;
+
+    IndexRegistry(const std::string& connection_string, const RegistryOptions& options, Opener open,
+                  Footprint footprint);
+    // Registry whose opener needs no database; it runs with a null connection
+    IndexRegistry(const RegistryOptions& options, Opener open, Footprint footprint);
+
+    IndexRegistry(const IndexRegistry&) = delete;
+    IndexRegistry& operator=(const IndexRegistry&) = delete;
+
+    // Opens the pooled connections; false if none could be established.
+    // Always true without a database.
+    bool start();
+
+    // Returns the table's index, opening it first when it is not resident.
+    // Concurrent acquires of a table that is being opened wait for it.
+    int acquire(const std::string& table, pgv_faiss_index_t** index);
+    void release(pgv_faiss_index_t* index);
+    // Reopens every table in parallel, resident or not: loads pick up the
+    // latest stored version in place, rebuilds replace the index once built.
+    // status receives each table's code; returns the first error.
+    int load(const std::vector<std::string>& tables, bool rebuild, std::vector<int>& status);
+    // Drops a resident index that is not acquired; false otherwise
+    bool evict(const std::string& table);
+
+    RegistryStats stats() const;
+
+private:
+    struct Entry {
+        Handle handle;                              // null while not resident
+        size_t bytes = 0;
+        bool loading = false;
+        std::list<std::string>::iterator recent;    // position in recent_ while resident
+    };
+    struct Lease {
+        Handle handle;
+        size_t count = 0;
+    };
+
+    RegistryOptions options_;
+    Opener open_;
+    Footprint footprint_;
+    std::unique_ptr<pgvector::PGVConnectionPool> connections_;     // null without a database
+    ThreadPool pool_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable opened_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> recent_;                 // resident tables, most recently acquired first
+    std::unordered_map<pgv_faiss_index_t*, Lease> leases_;
+    size_t resident_bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t loads_ = 0;
+    uint64_t evictions_ = 0;
+
+    // Caller holds lock and waited for entry.loading to clear; the lock is
+    // released while the opener runs
+    int open_entry(const std::string& table, Entry& entry, bool rebuild, std::unique_lock<std::mutex>& lock);
+    // Moves indexes over the budget to `dropped`, to be destroyed unlocked
+    void evict_locked(std::vector<Handle>& dropped);
+};
+
+#endif
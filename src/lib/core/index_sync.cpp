@@ -0,0 +1,106 @@
+#include "index_sync.h"
+#include <algorithm>
+#include <iostream>
+
+IndexSync::IndexSync(FAISSWrapper& index, const std::string& connection_string, const std::string& table_name,
+                     const SyncOptions& options)
+    : index_(index), table_name_(table_name), options_(options),
+      listener_(connection_string), reader_(connection_string), watermark_(0), stopping_(false) {
+    options_.batch_rows = std::max<size_t>(options_.batch_rows, 1);
+}
+
+IndexSync::~IndexSync() {
+    stop();
+}
+
+bool IndexSync::start(uint64_t watermark) {
+    stop();
+
+    {
+        std::lock_guard<std::mutex> lock(reader_mutex_);
+        if (!ensure_connected(reader_) || !reader_.install_change_capture(table_name_)) {
+            return false;
+        }
+        if (watermark == 0) {
+            watermark = reader_.change_horizon();
+            if (watermark == 0) {
+                return false;
+            }
+        }
+        watermark_ = watermark;
+    }
+
+    if (!ensure_connected(listener_) || !listener_.listen(pgvector::change_channel(table_name_))) {
+        return false;
+    }
+
+    stopping_ = false;
+    worker_ = std::thread(&IndexSync::run, this);
+    return true;
+}
+
+void IndexSync::stop() {
+    // The worker notices within one poll interval
+    stopping_ = true;
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+int64_t IndexSync::sync_once() {
+    std::lock_guard<std::mutex> lock(reader_mutex_);
+    if (!ensure_connected(reader_)) {
+        return -1;
+    }
+
+    const uint64_t from = watermark_;
+    const uint64_t to = reader_.change_horizon();
+    if (to == 0) {
+        return -1;
+    }
+    if (to <= from) {
+        return 0;
+    }
+
+    // A failure part way leaves the watermark alone; the next pass replays the
+    // range, which is harmless since rows are applied in their current state
+    int64_t applied = reader_.fetch_changes(table_name_, index_.get_dimension(), from, to, options_.batch_rows,
+        [this](const int64_t* upsert_ids, const float* vectors, size_t upserts,
+               const int64_t* deleted_ids, size_t deletes) {
+            if (upserts > 0 && index_.upsert_vectors(vectors, upsert_ids, upserts) != 0) {
+                return false;
+            }
+            return deletes == 0 || index_.remove_vectors(deleted_ids, deletes) == 0;
+        });
+
+    if (applied >= 0) {
+        watermark_ = to;
+    } else {
+        std::cerr << "Change sync of " << table_name_ << " failed; retrying from the same watermark" << std::endl;
+    }
+    return applied;
+}
+
+void IndexSync::run() {
+    const std::string channel = pgvector::change_channel(table_name_);
+    const int timeout_ms = static_cast<int>(options_.poll_interval.count());
+
+    while (!stopping_) {
+        if (!listener_.is_connected()) {
+            // Notifications sent while disconnected are lost; the poll below catches up
+            if (!listener_.reconnect() || !listener_.listen(channel)) {
+                std::this_thread::sleep_for(options_.poll_interval);
+            }
+        } else {
+            listener_.wait_for_notification(timeout_ms);
+        }
+
+        if (!stopping_) {
+            sync_once();
+        }
+    }
+}
+
+bool IndexSync::ensure_connected(pgvector::PGVConnection& connection) {
+    return connection.is_connected() || connection.reconnect();
+}
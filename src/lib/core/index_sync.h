@@ -0,0 +1,66 @@
+#ifndef PGV_INDEX_SYNC_H
+#define PGV_INDEX_SYNC_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "pgvector/pgv_connection.h"
+#include "faiss/faiss_wrapper.h"
+
+struct SyncOptions {
+    size_t batch_rows = 10000;                          // changed ids per FAISS upsert/remove call
+    std::chrono::milliseconds poll_interval{1000};      // re-check even without a NOTIFY
+};
+
+// Keeps a FAISSWrapper in step with its pgvector table through the trigger-
+// maintained change log (PGVConnection::install_change_capture). A background
+// thread LISTENs for change notifications and applies every finished
+// transaction's changes in batches: rows that still exist are upserted,
+// vanished ones removed. The watermark is the xid below which all changes are
+// in the index; saving it with an index version lets a restart resume from
+// there instead of rebuilding.
+//
+// Uses two connections of its own (listener and reader), so it never contends
+// with the caller's connection.
+class IndexSync {
+public:
+    IndexSync(FAISSWrapper& index, const std::string& connection_string, const std::string& table_name,
+              const SyncOptions& options = SyncOptions());
+    ~IndexSync();
+
+    IndexSync(const IndexSync&) = delete;
+    IndexSync& operator=(const IndexSync&) = delete;
+
+    // Installs change capture and starts applying changes from `watermark`;
+    // 0 starts at the current horizon, for an index about to be built from the table
+    bool start(uint64_t watermark);
+    void stop();
+
+    // Applies all finished changes on the calling thread; returns the number of
+    // ids applied, -1 on errors (the watermark then stays where it was)
+    int64_t sync_once();
+    uint64_t watermark() const { return watermark_; }
+    const std::string& table_name() const { return table_name_; }
+
+private:
+    FAISSWrapper& index_;
+    std::string table_name_;
+    SyncOptions options_;
+
+    pgvector::PGVConnection listener_;      // owned by the worker thread
+    pgvector::PGVConnection reader_;
+    std::mutex reader_mutex_;               // sync_once callers and the worker share reader_
+
+    std::atomic<uint64_t> watermark_;
+    std::atomic<bool> stopping_;
+    std::thread worker_;
+
+    void run();
+    bool ensure_connected(pgvector::PGVConnection& connection);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "index_trainer.h"
+#include "sharded_index.h"
+#include "faiss/index_options.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace {
+
+// SYSTEM and BERNOULLI return the requested share only on average, so a
+// little more is asked for and the reservoir trims the rest
+const double kOversample = 1.25;
+
+} // namespace
+
+IndexTrainer::IndexTrainer(pgvector::PGVConnection& connection, const TrainingOptions& options)
+    : connection_(connection), options_(options) {
+    options_.chunk_rows = std::max<size_t>(options_.chunk_rows, 1);
+    options_.samples_per_centroid = std::max<size_t>(options_.samples_per_centroid, 39);
+}
+
+size_t IndexTrainer::sample_size(size_t dataset_rows, size_t partitions) const {
+    partitions = std::max<size_t>(partitions, 1);
+    size_t nlist = derive_nlist(dataset_rows / partitions, 0);
+    size_t rows = std::max(nlist * options_.samples_per_centroid, options_.min_samples) * partitions;
+    if (options_.max_samples > 0) {
+        rows = std::min(rows, options_.max_samples);
+    }
+    return std::min(rows, dataset_rows);
+}
+
+int IndexTrainer::run(const std::string& table_name, FAISSWrapper& index) {
+    if (!index.requires_training()) {
+        return 0;
+    }
+    auto fit = [&](const float* sample, size_t rows, size_t table_rows) {
+        index.set_dataset_size_hint(table_rows);
+        index.train(sample, rows, options_.kmeans);
+        return index.is_trained();
+    };
+    return sample_and_fit(table_name, index.get_dimension(), 1, 1, fit);
+}
+
+int IndexTrainer::run(const std::string& table_name, ShardedIndex& index) {
+    if (!index.shard(0).requires_training()) {
+        return 0;
+    }
+    // Hash-routed shards all train on the same sample
+    size_t partitions = index.routes_by_vector() ? index.shard_count() : 1;
+    auto fit = [&](const float* sample, size_t rows, size_t table_rows) {
+        index.set_dataset_size_hint(table_rows);
+        index.train(sample, rows, options_.kmeans);
+        for (size_t s = 0; s < index.shard_count(); ++s) {
+            if (!index.shard(s).is_trained()) return false;
+        }
+        return true;
+    };
+    return sample_and_fit(table_name, index.get_dimension(), partitions, index.shard_count(), fit);
+}
+
+int IndexTrainer::sample_and_fit(const std::string& table_name, int dimension, size_t partitions, size_t shards,
+                                 const Fit& fit) {
+    stats_ = TrainingStats();
+    if (!connection_.is_connected()) {
+        return -2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int64_t table_rows = connection_.estimate_rows(table_name);
+    if (table_rows < 0) {
+        return -2;
+    }
+    stats_.table_rows = static_cast<size_t>(table_rows);
+    stats_.nlist = derive_nlist(stats_.table_rows / shards, 0);
+
+    int status = draw_sample(table_name, dimension, sample_size(stats_.table_rows, partitions));
+    stats_.sample_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (status != 0 || stats_.sample_rows == 0) {
+        return status;
+    }
+
+    start = std::chrono::steady_clock::now();
+    bool trained = fit(sample_.data(), stats_.sample_rows, std::max(stats_.table_rows, stats_.rows_scanned));
+    stats_.train_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::vector<float>().swap(sample_);
+    return trained ? 0 : -4;
+}
+
+int IndexTrainer::draw_sample(const std::string& table_name, int dimension, size_t rows) {
+    sample_.clear();
+    stats_.rows_scanned = 0;
+    stats_.sample_rows = 0;
+    if (rows == 0 || dimension <= 0) {
+        return 0;
+    }
+
+    // Sampling a table that is not much larger than the sample only loses rows
+    pgvector::TableSample tablesample;
+    tablesample.seed = options_.seed;
+    tablesample.method = options_.method == TrainingSample::Bernoulli ? pgvector::SampleMethod::Bernoulli
+                                                                      : pgvector::SampleMethod::System;
+    tablesample.percent = stats_.table_rows > 0 ? 100.0 * kOversample * rows / stats_.table_rows : 100.0;
+    bool use_tablesample = options_.method != TrainingSample::Reservoir && tablesample.percent < 100.0;
+
+    const std::string cursor_name = "pgv_train_cursor";
+    if (!connection_.open_vector_cursor(table_name, cursor_name, use_tablesample ? &tablesample : nullptr)) {
+        return -2;
+    }
+
+    const size_t dim = static_cast<size_t>(dimension);
+    std::vector<float> chunk_vectors(options_.chunk_rows * dim);
+    std::vector<int64_t> chunk_ids(options_.chunk_rows);
+    std::mt19937_64 rng(options_.seed);
+    size_t seen = 0;
+
+    try {
+        for (;;) {
+            // Cleared on every path, including a decode error
+            std::unique_ptr<PGresult, decltype(&PQclear)> res(
+                connection_.fetch_vector_chunk(cursor_name, options_.chunk_rows), PQclear);
+            if (!res) {
+                connection_.close_vector_cursor(cursor_name, false);
+                return -2;
+            }
+            size_t count = pgvector::PGVConnection::decode_vector_rows(res.get(), dimension, chunk_vectors.data(),
+                                                                       chunk_ids.data());
+            res.reset();
+
+            if (seen < rows) {
+                sample_.resize(std::min(rows, seen + count) * dim);
+            }
+            // Algorithm R: row t replaces a random slot with probability rows / (t + 1)
+            for (size_t i = 0; i < count; ++i, ++seen) {
+                size_t slot = seen;
+                if (slot >= rows) {
+                    slot = std::uniform_int_distribution<size_t>(0, seen)(rng);
+                    if (slot >= rows) continue;
+                }
+                std::copy_n(chunk_vectors.data() + i * dim, dim, sample_.data() + slot * dim);
+            }
+            if (count < options_.chunk_rows) break;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error sampling " << table_name << ": " << e.what() << std::endl;
+        connection_.close_vector_cursor(cursor_name, false);
+        return -2;
+    }
+
+    connection_.close_vector_cursor(cursor_name, false);
+    stats_.rows_scanned = seen;
+    stats_.sample_rows = std::min(seen, rows);
+    return 0;
+}
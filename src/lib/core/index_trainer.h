@@ -0,0 +1,75 @@
+#ifndef PGV_INDEX_TRAINER_H
+#define PGV_INDEX_TRAINER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "pgvector/pgv_connection.h"
+#include "faiss/faiss_wrapper.h"
+
+class ShardedIndex;
+
+enum class TrainingSample {
+    System,         // TABLESAMPLE SYSTEM: reads only the sampled pages
+    Bernoulli,      // TABLESAMPLE BERNOULLI: independent rows, the server reads every page
+    Reservoir,      // every row is streamed and a uniform reservoir kept client-side
+};
+
+struct TrainingOptions {
+    TrainingSample method = TrainingSample::System;
+    size_t samples_per_centroid = 256;  // sample = nlist * this, nlist as derived for the table size
+    size_t min_samples = 10000;         // PQ codebooks want about 39 points per code
+    size_t max_samples = 0;             // 0 = no cap
+    size_t chunk_rows = 10000;          // rows per cursor FETCH
+    uint64_t seed = 42;
+    TrainOptions kmeans;
+};
+
+struct TrainingStats {
+    size_t table_rows = 0;      // planner estimate
+    size_t rows_scanned = 0;    // rows read from the table
+    size_t sample_rows = 0;
+    size_t nlist = 0;           // per shard for sharded indexes
+    double sample_seconds = 0.0;
+    double train_seconds = 0.0;
+};
+
+// Dedicated training stage: draws a uniform random sample sized to the
+// index's nlist from a pgvector table and fits the untrained index on it, so
+// training no longer depends on whatever the first add happens to contain.
+// TABLESAMPLE samples are passed through a reservoir as well, which trims
+// them to the exact size. The caller can then store the trained, still
+// empty index and load it for later rebuilds instead of training again.
+class IndexTrainer {
+public:
+    IndexTrainer(pgvector::PGVConnection& connection, const TrainingOptions& options = TrainingOptions());
+
+    // Both return 0 on success (also when the index needs no training or the
+    // table is empty), -2 on database errors and -4 if training failed.
+    int run(const std::string& table_name, FAISSWrapper& index);
+    // Vector-routed shards each train on their own part of the sample, so it
+    // is drawn large enough for all of them
+    int run(const std::string& table_name, ShardedIndex& index);
+
+    // Rows to sample for `partitions` independently trained parts of dataset_rows
+    size_t sample_size(size_t dataset_rows, size_t partitions = 1) const;
+    // Replaces sample() with up to `rows` rows of table_name; 0 or -2
+    int draw_sample(const std::string& table_name, int dimension, size_t rows);
+
+    const std::vector<float>& sample() const { return sample_; }
+    const TrainingStats& stats() const { return stats_; }
+
+private:
+    pgvector::PGVConnection& connection_;
+    TrainingOptions options_;
+    TrainingStats stats_;
+    std::vector<float> sample_;
+
+    using Fit = std::function<bool(const float* sample, size_t rows, size_t table_rows)>;
+    int sample_and_fit(const std::string& table_name, int dimension, size_t partitions, size_t shards,
+                       const Fit& fit);
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <vector>
+
+namespace metrics {
+
+namespace detail {
+std::atomic<bool> enabled(true);
+std::atomic<bool> tracing(false);
+} // namespace detail
+
+namespace {
+
+const char* const kOpNames[kOpCount] = {
+    "search", "batch_search", "hybrid_search", "add", "remove", "upsert", "compact",
+    "train", "serialize", "deserialize", "db_query", "db_copy",
+    "range_search",
+};
+
+struct Hook {
+    SpanCallback callback;
+    void* user_data;
+    std::shared_ptr<void> owner;
+};
+
+// Read and replaced with std::atomic_load/atomic_store; a span holds its own
+// reference while it calls the hook
+std::shared_ptr<const Hook> hook;
+
+struct OpCounters {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> items;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> buckets[kBuckets];
+};
+
+// Written only by its thread, read by snapshot()
+struct ThreadBlock {
+    OpCounters ops[kOpCount];
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadBlock*> live;
+    Snapshot retired;       // totals of threads that have exited
+};
+
+// Never destroyed: threads may still exit after static destructors ran
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+void add_to(OpSnapshot& to, const OpCounters& from) {
+    to.count += from.count.load(std::memory_order_relaxed);
+    to.errors += from.errors.load(std::memory_order_relaxed);
+    to.items += from.items.load(std::memory_order_relaxed);
+    to.bytes += from.bytes.load(std::memory_order_relaxed);
+    to.total_ns += from.total_ns.load(std::memory_order_relaxed);
+    to.max_ns = std::max(to.max_ns, from.max_ns.load(std::memory_order_relaxed));
+    for (int b = 0; b < kBuckets; ++b) {
+        to.buckets[b] += from.buckets[b].load(std::memory_order_relaxed);
+    }
+}
+
+struct ThreadHandle {
+    ThreadBlock* block;
+
+    ThreadHandle() : block(new ThreadBlock()) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.live.push_back(block);
+    }
+
+    ~ThreadHandle() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (int op = 0; op < kOpCount; ++op) {
+            add_to(r.retired.ops[op], block->ops[op]);
+        }
+        r.live.erase(std::find(r.live.begin(), r.live.end(), block));
+        delete block;
+    }
+};
+
+ThreadBlock& local_block() {
+    thread_local ThreadHandle handle;
+    return *handle.block;
+}
+
+// Single writer, so a plain load and store replaces a locked read-modify-write
+inline void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+int bucket_of(uint64_t ns) {
+    int width = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+    return std::min(width, kBuckets - 1);
+}
+
+thread_local Span* current_span = nullptr;
+
+void random_bytes(uint8_t* out, size_t size) {
+    thread_local uint64_t state = std::random_device()() ^
+                                  (static_cast<uint64_t>(std::random_device()()) << 32);
+    for (size_t i = 0; i < size; i += 8) {
+        // splitmix64
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        std::memcpy(out + i, &z, std::min<size_t>(8, size - i));
+    }
+}
+
+} // namespace
+
+const char* op_name(Op op) {
+    int index = static_cast<int>(op);
+    return index >= 0 && index < kOpCount ? kOpNames[index] : "unknown";
+}
+
+uint64_t OpSnapshot::quantile_ns(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * count)));
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += buckets[b];
+        if (seen >= target) {
+            return std::min(b == 0 ? 0 : (uint64_t(1) << b) - 1, max_ns);
+        }
+    }
+    return max_ns;
+}
+
+Snapshot snapshot() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    Snapshot result = r.retired;
+    for (const ThreadBlock* block : r.live) {
+        for (int op = 0; op < kOpCount; ++op) {
+            add_to(result.ops[op], block->ops[op]);
+        }
+    }
+    return result;
+}
+
+void set_enabled(bool enabled) {
+    detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void set_span_callback(SpanCallback callback, void* user_data, std::shared_ptr<void> owner) {
+    std::shared_ptr<const Hook> next;
+    if (callback) {
+        next = std::make_shared<const Hook>(Hook{callback, user_data, std::move(owner)});
+    }
+    std::atomic_store(&hook, std::move(next));
+    detail::tracing.store(callback != nullptr, std::memory_order_release);
+}
+
+void Span::begin(uint64_t items) {
+    active_ = true;
+    items_ = items;
+    start_ = std::chrono::steady_clock::now();
+
+    if (!detail::tracing.load(std::memory_order_acquire)) {
+        return;
+    }
+    traced_ = true;
+    start_unix_ns_ = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    parent_ = current_span;
+    if (parent_) {
+        std::memcpy(trace_id_, parent_->trace_id_, sizeof(trace_id_));
+        std::memcpy(parent_span_id_, parent_->span_id_, sizeof(parent_span_id_));
+    } else {
+        random_bytes(trace_id_, sizeof(trace_id_));
+        std::memset(parent_span_id_, 0, sizeof(parent_span_id_));
+    }
+    random_bytes(span_id_, sizeof(span_id_));
+    current_span = this;
+}
+
+void Span::end() {
+    const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count());
+
+    if (detail::enabled.load(std::memory_order_relaxed)) {
+        OpCounters& counters = local_block().ops[static_cast<int>(op_)];
+        bump(counters.count, 1);
+        if (status_ != 0) bump(counters.errors, 1);
+        bump(counters.items, items_);
+        bump(counters.bytes, bytes_);
+        bump(counters.total_ns, ns);
+        if (ns > counters.max_ns.load(std::memory_order_relaxed)) {
+            counters.max_ns.store(ns, std::memory_order_relaxed);
+        }
+        bump(counters.buckets[bucket_of(ns)], 1);
+    }
+
+    if (!traced_) {
+        return;
+    }
+    current_span = parent_;
+    std::shared_ptr<const Hook> current = std::atomic_load(&hook);
+    if (!current) {
+        return;
+    }
+
+    SpanRecord record;
+    record.name = op_name(op_);
+    std::memcpy(record.trace_id, trace_id_, sizeof(trace_id_));
+    std::memcpy(record.span_id, span_id_, sizeof(span_id_));
+    std::memcpy(record.parent_span_id, parent_span_id_, sizeof(parent_span_id_));
+    record.start_unix_ns = start_unix_ns_;
+    record.end_unix_ns = start_unix_ns_ + ns;
+    record.status = status_;
+    record.items = items_;
+    record.bytes = bytes_;
+    current->callback(record, current->user_data);
+}
+
+} // namespace metrics
@@ -0,0 +1,132 @@
+#ifndef PGV_METRICS_H
+#define PGV_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Process-wide operation metrics. Every thread counts into its own block of
+// relaxed atomics that only it writes, so recording costs no contended cache
+// lines or locked instructions; snapshot() sums the blocks of live threads
+// and of threads that have exited. When metrics are disabled and no span
+// callback is installed a Span costs one relaxed load and a branch.
+namespace metrics {
+
+// Matches pgv_faiss_op_t
+enum class Op : int {
+    Search,
+    BatchSearch,
+    HybridSearch,
+    Add,
+    Remove,
+    Upsert,
+    Compact,
+    Train,
+    Serialize,
+    Deserialize,
+    DbQuery,
+    DbCopy,
+    RangeSearch,
+    Count,
+};
+
+const int kOpCount = static_cast<int>(Op::Count);
+// Latency buckets by bit width of the duration in ns: bucket b holds
+// [2^(b-1), 2^b) ns, the last one everything from ~9 minutes up
+const int kBuckets = 40;
+
+const char* op_name(Op op);
+
+struct OpSnapshot {
+    uint64_t count = 0;
+    uint64_t errors = 0;
+    uint64_t items = 0;         // queries, vectors or rows
+    uint64_t bytes = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t buckets[kBuckets] = {};
+
+    // Upper bound of the bucket holding quantile q; 0 without samples
+    uint64_t quantile_ns(double q) const;
+};
+
+struct Snapshot {
+    OpSnapshot ops[kOpCount];
+};
+
+Snapshot snapshot();
+
+void set_enabled(bool enabled);
+
+// OpenTelemetry-shaped record of one finished span
+struct SpanRecord {
+    const char* name;
+    uint8_t trace_id[16];
+    uint8_t span_id[8];
+    uint8_t parent_span_id[8];      // all zero for root spans
+    uint64_t start_unix_ns;
+    uint64_t end_unix_ns;
+    int status;                     // 0 ok, otherwise the operation's error code
+    uint64_t items;
+    uint64_t bytes;
+};
+
+using SpanCallback = void (*)(const SpanRecord& span, void* user_data);
+// Called from the thread that ran the operation; nullptr stops tracing.
+// `owner`, if given, keeps user_data alive: it is released once the hook is
+// replaced and no span is still calling it.
+void set_span_callback(SpanCallback callback, void* user_data, std::shared_ptr<void> owner = nullptr);
+
+namespace detail {
+extern std::atomic<bool> enabled;
+extern std::atomic<bool> tracing;       // a span callback is installed
+} // namespace detail
+
+// Times one operation from construction to destruction. Spans opened while
+// another is active on the same thread become its children in traces.
+class Span {
+public:
+    explicit Span(Op op, uint64_t items = 0) : op_(op), active_(false) {
+        if (detail::enabled.load(std::memory_order_relaxed) ||
+            detail::tracing.load(std::memory_order_relaxed)) {
+            begin(items);
+        }
+    }
+    ~Span() {
+        if (active_) end();
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    void set_items(uint64_t items) { items_ = items; }
+    void add_bytes(uint64_t bytes) { bytes_ += bytes; }
+    // Records a non-zero return code as an error and passes it through
+    int status(int rc) {
+        if (rc != 0) status_ = rc;
+        return rc;
+    }
+
+private:
+    Op op_;
+    bool active_;
+    bool traced_ = false;
+    int status_ = 0;
+    uint64_t items_ = 0;
+    uint64_t bytes_ = 0;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t start_unix_ns_ = 0;
+    uint8_t trace_id_[16];
+    uint8_t span_id_[8];
+    uint8_t parent_span_id_[8];
+    Span* parent_ = nullptr;
+
+    void begin(uint64_t items);
+    void end();
+};
+
+} // namespace metrics
+
+#endif
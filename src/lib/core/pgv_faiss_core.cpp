@@ -0,0 +1,1525 @@
+#include "pgv_faiss.h"
+#include "faiss/faiss_wrapper.h"
+#include "pgvector/pgv_connection.h"
+#include "hybrid_search.h"
+#include "index_build_pipeline.h"
+#include "index_cache.h"
+#include "index_registry.h"
+#include "index_sync.h"
+#include "index_trainer.h"
+#include "sharded_index.h"
+#include "search_dispatcher.h"
+#include "metrics.h"
+#include "result_cache.h"
+#include "result_pool.h"
+#include "scratch_arena.h"
+
+#if defined(WITH_GPU) && HAVE_FAISS
+#include "faiss/gpu_backend.h"
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+struct pgv_faiss_index {
+    std::unique_ptr<FAISSWrapper> faiss;        // exactly one of faiss and sharded is set
+    std::unique_ptr<ShardedIndex> sharded;
+    std::unique_ptr<pgvector::PGVConnection> db;
+    std::mutex db_mutex;                        // the connection serves one call at a time
+    std::unique_ptr<HybridSearcher> hybrid;     // created on first hybrid search, guarded by db_mutex
+    std::unique_ptr<SearchDispatcher> dispatcher;
+    std::unique_ptr<IndexCache> cache;
+    bool cache_mmap;
+    std::string connection_string;
+    std::unique_ptr<IndexSync> sync;            // change capture from one table, guarded by db_mutex
+    std::string loaded_table;                   // table and stored version last loaded, for resuming sync
+    int64_t loaded_version;
+    SearchOptions search_defaults;
+    int dimension;
+    std::shared_ptr<ResultCache> results;       // shared with the wrappers and db; null when disabled
+};
+
+struct pgv_faiss_id_filter {
+    IdFilter ids;
+};
+
+struct pgv_faiss_iterator {
+    std::unique_ptr<SearchIterator> results;
+};
+
+struct pgv_faiss_registry {
+    pgv_faiss_config_t config;                  // template of every table's index; strings point below
+    std::string index_type;
+    std::string index_factory;
+    std::string cache_dir;
+    GpuOptions gpu;                             // one backend shared by every table's index
+    bool build_missing;
+    bool persist_builds;
+    std::unique_ptr<IndexRegistry> tables;
+};
+
+namespace {
+
+int validate_config(const pgv_faiss_config_t* config) {
+    if (!config || config->dimension <= 0) {
+        return -1;
+    }
+    if (config->gpu_device_count < 0 || (config->gpu_device_count > 0 && !config->gpu_devices)) {
+        return -1;
+    }
+    if (config->metric < PGV_FAISS_METRIC_L2 || config->metric > PGV_FAISS_METRIC_COSINE) {
+        return -1;
+    }
+    if (config->column_type < PGV_FAISS_COLUMN_VECTOR || config->column_type > PGV_FAISS_COLUMN_SPARSEVEC) {
+        return -1;
+    }
+    return 0;
+}
+
+bool element_type(pgv_faiss_vector_type_t type, simd::ElementType& out) {
+    switch (type) {
+    case PGV_FAISS_FLOAT32: out = simd::ElementType::Float32; return true;
+    case PGV_FAISS_FLOAT16: out = simd::ElementType::Float16; return true;
+    case PGV_FAISS_BFLOAT16: out = simd::ElementType::BFloat16; return true;
+    case PGV_FAISS_INT8: out = simd::ElementType::Int8; return true;
+    default: return false;
+    }
+}
+
+GpuOptions resolve_gpu_options(const pgv_faiss_config_t* config) {
+    GpuOptions gpu;
+    gpu.enabled = config->use_gpu != 0;
+    gpu.devices = {config->gpu_device_id};
+    if (config->gpu_devices && config->gpu_device_count > 0) {
+        gpu.devices.assign(config->gpu_devices, config->gpu_devices + config->gpu_device_count);
+        if (config->gpu_temp_memory_mb) {
+            for (int i = 0; i < config->gpu_device_count; ++i) {
+                gpu.temp_memory.push_back(config->gpu_temp_memory_mb[i] * 1024 * 1024);
+            }
+        }
+    } else if (config->gpu_temp_memory_mb) {
+        gpu.temp_memory.push_back(config->gpu_temp_memory_mb[0] * 1024 * 1024);
+    }
+    gpu.mode = config->gpu_shard ? GpuMode::Shard : GpuMode::Replicate;
+    gpu.pinned_memory = config->gpu_pinned_memory_mb * 1024 * 1024;
+    gpu.allow_float16 = config->gpu_disable_float16 == 0;
+    return gpu;
+}
+
+// Per-call values win; unset ones fall back to the index configuration
+SearchOptions resolve_search_options(const pgv_faiss_index_t* index, const pgv_faiss_search_params_t* params) {
+    SearchOptions options = index->search_defaults;
+    if (params) {
+        if (params->nprobe > 0) options.nprobe = params->nprobe;
+        if (params->ef_search > 0) options.ef_search = params->ef_search;
+        if (params->k_factor > 0.0f) options.k_factor = params->k_factor;
+        if (params->filter) options.filter = &params->filter->ids;
+    }
+    return options;
+}
+
+// Device-wide figures come from any shard, since shards share the devices;
+// footprints add up
+GpuStats collect_gpu_stats(pgv_faiss_index_t* index) {
+    if (!index->sharded) {
+        return index->faiss->get_gpu_stats();
+    }
+
+    GpuStats stats;
+    for (size_t s = 0; s < index->sharded->shard_count(); ++s) {
+        GpuStats shard = index->sharded->shard(s).get_gpu_stats();
+        if (s == 0) {
+            stats = shard;
+            continue;
+        }
+        for (size_t i = 0; i < stats.devices.size() && i < shard.devices.size(); ++i) {
+            stats.devices[i].index_bytes += shard.devices[i].index_bytes;
+            stats.devices[i].sampled_peak_bytes =
+                std::max(stats.devices[i].sampled_peak_bytes, shard.devices[i].sampled_peak_bytes);
+        }
+    }
+    return stats;
+}
+
+// Shards are summed; their lists are pooled, so the imbalance is the
+// vector-weighted mean of the shards' own
+IndexStats collect_index_stats(pgv_faiss_index_t* index, size_t* shards) {
+    if (!index->sharded) {
+        *shards = 1;
+        return index->faiss->get_index_stats();
+    }
+
+    IndexStats stats;
+    double weighted_imbalance = 0.0;
+    *shards = index->sharded->shard_count();
+    for (size_t s = 0; s < *shards; ++s) {
+        IndexStats shard = index->sharded->shard(s).get_index_stats();
+        stats.list_min = s == 0 ? shard.list_min : std::min(stats.list_min, shard.list_min);
+        stats.list_max = std::max(stats.list_max, shard.list_max);
+        stats.ntotal += shard.ntotal;
+        stats.memory_bytes += shard.memory_bytes;
+        stats.tombstones += shard.tombstones;
+        stats.nlist += shard.nlist;
+        weighted_imbalance += shard.list_imbalance * shard.ntotal;
+    }
+    stats.list_imbalance = stats.ntotal > 0 ? weighted_imbalance / stats.ntotal : 0.0;
+    return stats;
+}
+
+// Zero fields keep the TrainingOptions defaults
+TrainingOptions resolve_training_options(const pgv_faiss_train_params_t* params) {
+    TrainingOptions options;
+    if (!params) {
+        return options;
+    }
+    options.method = params->method == PGV_FAISS_SAMPLE_BERNOULLI ? TrainingSample::Bernoulli
+                   : params->method == PGV_FAISS_SAMPLE_RESERVOIR ? TrainingSample::Reservoir
+                                                                  : TrainingSample::System;
+    if (params->samples_per_centroid > 0) options.samples_per_centroid = params->samples_per_centroid;
+    options.max_samples = params->max_samples;
+    options.kmeans.batches = std::max(params->batches, 1);
+    options.kmeans.iterations = std::max(params->iterations, 0);
+    options.kmeans.gpu = params->cpu_kmeans == 0;
+    if (params->seed != 0) {
+        options.seed = params->seed;
+        options.kmeans.seed = params->seed;
+    }
+    return options;
+}
+
+size_t index_ntotal(const pgv_faiss_index_t* index) {
+    return index->sharded ? index->sharded->get_ntotal() : index->faiss->get_ntotal();
+}
+
+std::string trained_storage_name(const std::string& table_name) {
+    return table_name + "_trained";
+}
+
+// ids and distances of a result share one pooled block, ids first
+bool allocate_result(pgv_faiss_result_t* result, size_t count) {
+    void* block = result_pool::allocate(count * (sizeof(int64_t) + sizeof(float)));
+    if (!block) {
+        return false;
+    }
+    result->ids = static_cast<int64_t*>(block);
+    result->distances = reinterpret_cast<float*>(result->ids + count);
+    result->count = count;
+    return true;
+}
+
+// Distance operator and column type the index's table is queried with
+void configure_connection(pgvector::PGVConnection& db, const pgv_faiss_config_t* config) {
+    db.set_distance_operator(config->metric == PGV_FAISS_METRIC_COSINE ? pgvector::DistanceOperator::Cosine
+                             : config->metric == PGV_FAISS_METRIC_INNER_PRODUCT ? pgvector::DistanceOperator::InnerProduct
+                                                                               : pgvector::DistanceOperator::L2);
+    db.set_vector_column(config->column_type == PGV_FAISS_COLUMN_HALFVEC ? pgvector::VectorColumn::Halfvec
+                         : config->column_type == PGV_FAISS_COLUMN_SPARSEVEC ? pgvector::VectorColumn::Sparsevec
+                                                                             : pgvector::VectorColumn::Vector);
+}
+
+// Handle with the configured index and no connection; config is validated
+int create_index(const pgv_faiss_config_t* config, const GpuOptions& gpu, std::unique_ptr<pgv_faiss_index_t>& handle) {
+    handle.reset(new (std::nothrow) pgv_faiss_index_t());
+    if (!handle) {
+        return -3;
+    }
+    handle->dimension = config->dimension;
+    handle->loaded_version = 0;
+    handle->cache_mmap = config->cache_mmap != 0;
+    handle->search_defaults.nprobe = config->nprobe;
+    if (config->cache_dir) {
+        handle->cache = std::make_unique<IndexCache>(config->cache_dir);
+    }
+    if (config->result_cache_mb > 0) {
+        ResultCacheOptions cache;
+        cache.memory_budget = config->result_cache_mb * 1024 * 1024;
+        cache.ttl_ms = static_cast<uint32_t>(std::max(config->result_cache_ttl_ms, 0));
+        cache.epsilon = std::max(config->result_cache_epsilon, 0.0f);
+        handle->results = std::make_shared<ResultCache>(cache);
+    }
+
+    IndexOptions options;
+    if (config->index_type) options.index_type = config->index_type;
+    if (config->index_factory) options.factory = config->index_factory;
+    options.metric = config->metric == PGV_FAISS_METRIC_COSINE ? Metric::Cosine
+                   : config->metric == PGV_FAISS_METRIC_INNER_PRODUCT ? Metric::InnerProduct
+                                                                     : Metric::L2;
+    options.expected_size = config->expected_vectors;
+    options.memory_budget = config->memory_budget_mb * 1024 * 1024;
+    options.pq_m = config->pq_m;
+    if (config->hnsw_m > 0) options.hnsw_m = config->hnsw_m;
+    if (config->hnsw_ef_construction > 0) options.ef_construction = config->hnsw_ef_construction;
+    options.refine = config->refine != 0;
+    options.fast_remove = config->fast_remove != 0;
+
+    try {
+        if (config->shards > 1) {
+            ShardOptions shard_options;
+            shard_options.shards = static_cast<size_t>(config->shards);
+            shard_options.policy = config->shard_by_vector ? ShardPolicy::Vector : ShardPolicy::IdHash;
+            shard_options.probe = static_cast<size_t>(std::max(config->shard_probe, 0));
+            handle->sharded = std::make_unique<ShardedIndex>(config->dimension, options, shard_options, gpu);
+        } else {
+            handle->faiss = std::make_unique<FAISSWrapper>(config->dimension, options, gpu);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating index: " << e.what() << std::endl;
+        return -4;
+    }
+    if (config->compaction_threshold != 0.0) {
+        double threshold = std::max(config->compaction_threshold, 0.0);
+        if (handle->sharded) {
+            for (size_t s = 0; s < handle->sharded->shard_count(); ++s) {
+                handle->sharded->shard(s).set_compaction_threshold(threshold);
+            }
+        } else {
+            handle->faiss->set_compaction_threshold(threshold);
+        }
+    }
+    // Every shard's writes clear the one cache the sharded search answers from
+    if (handle->sharded) {
+        for (size_t s = 0; s < handle->sharded->shard_count(); ++s) {
+            handle->sharded->shard(s).set_result_cache(handle->results);
+        }
+    } else {
+        handle->faiss->set_result_cache(handle->results);
+    }
+    return 0;
+}
+
+// Answers one query into k slots, hits first and the rest -1; count receives the hits
+int search_slots(pgv_faiss_index_t* index, const float* query, size_t k, const SearchOptions& options,
+                 int64_t* ids, float* distances, size_t* count) {
+    size_t hits = 0;
+    ResultCache* cache = options.filter ? nullptr : index->results.get();
+    const uint64_t context = cache ? search_cache_context(index, k, options) : 0;
+    std::vector<SearchResult> cached;
+    if (cache && cache->lookup(query, index->dimension, context, cached)) {
+        for (; hits < cached.size() && hits < k; ++hits) {
+            ids[hits] = cached[hits].id;
+            distances[hits] = cached[hits].distance;
+        }
+        for (size_t i = hits; i < k; ++i) {
+            ids[i] = -1;
+            distances[i] = std::numeric_limits<float>::max();
+        }
+        if (count) *count = hits;
+        return 0;
+    }
+    const uint64_t epoch = cache ? cache->epoch() : 0;
+
+    if (index->dispatcher) {
+        // Coalesced searches come back as a list
+        std::vector<SearchResult> results;
+        try {
+            results = index->dispatcher->submit(query, k, options).get();
+        } catch (const std::exception& e) {
+            std::cerr << "Error searching index: " << e.what() << std::endl;
+            return -4;
+        }
+        for (; hits < results.size() && hits < k; ++hits) {
+            ids[hits] = results[hits].id;
+            distances[hits] = results[hits].distance;
+        }
+        for (size_t i = hits; i < k; ++i) {
+            ids[i] = -1;
+            distances[i] = std::numeric_limits<float>::max();
+        }
+    } else {
+        int status = index->sharded ? index->sharded->search_batch(query, 1, k, distances, ids, options)
+                                    : index->faiss->search_batch(query, 1, k, distances, ids, options);
+        if (status != 0) {
+            return -4;
+        }
+        while (hits < k && ids[hits] >= 0) ++hits;
+    }
+    if (cache) {
+        cached.clear();
+        for (size_t i = 0; i < hits; ++i) cached.push_back({ids[i], distances[i]});
+        cache->insert(query, index->dimension, context, epoch, cached);
+    }
+    if (count) *count = hits;
+    return 0;
+}
+
+} // namespace
+
+int pgv_faiss_init(pgv_faiss_config_t* config, pgv_faiss_index_t** index) {
+    if (!index || validate_config(config) != 0) {
+        return -1;
+    }
+    *index = nullptr;
+
+    std::unique_ptr<pgv_faiss_index_t> handle;
+    int status = create_index(config, resolve_gpu_options(config), handle);
+    if (status != 0) {
+        return status;
+    }
+
+    if (config->connection_string) {
+        handle->connection_string = config->connection_string;
+        handle->db = std::make_unique<pgvector::PGVConnection>(config->connection_string);
+        configure_connection(*handle->db, config);
+        handle->db->set_result_cache(handle->results);
+        if (!handle->db->connect()) {
+            return -2;
+        }
+    }
+
+    *index = handle.release();
+    return 0;
+}
+
+int pgv_faiss_add_vectors(pgv_faiss_index_t* index, const float* vectors, const int64_t* ids, size_t count) {
+    if (!index || !vectors || count == 0) {
+        return -1;
+    }
+
+    metrics::Span span(metrics::Op::Add, count);
+    if (index->sharded) {
+        // The id decides the shard, so generated ids are not an option
+        return span.status(ids ? (index->sharded->add_vectors(vectors, ids, count) == 0 ? 0 : -4) : -1);
+    }
+    return span.status(index->faiss->add_vectors(vectors, ids, count) == 0 ? 0 : -4);
+}
+
+int pgv_faiss_add_vectors_typed(pgv_faiss_index_t* index, const void* vectors, pgv_faiss_vector_type_t type,
+                                float scale, const int64_t* ids, size_t count) {
+    simd::ElementType element;
+    if (!index || !vectors || count == 0 || !element_type(type, element)) {
+        return -1;
+    }
+    // Scale is the INT8 step and ignored for the other types
+    if (element == simd::ElementType::Int8 && !(scale > 0.0f)) {
+        return -1;
+    }
+
+    metrics::Span span(metrics::Op::Add, count);
+    if (index->sharded) {
+        if (!ids) {
+            return span.status(-1);
+        }
+        // Routing needs every vector in float32, so shards get the batch widened whole
+        std::vector<float> widened;
+        try {
+            widened.resize(count * static_cast<size_t>(index->dimension));
+        } catch (const std::bad_alloc&) {
+            return span.status(-3);
+        }
+        simd::to_float(element, vectors, widened.data(), widened.size(), scale);
+        return span.status(index->sharded->add_vectors(widened.data(), ids, count) == 0 ? 0 : -4);
+    }
+    return span.status(index->faiss->add_vectors(vectors, element, ids, count, scale) == 0 ? 0 : -4);
+}
+
+int pgv_faiss_convert_vectors(const void* in, pgv_faiss_vector_type_t in_type, void* out,
+                              pgv_faiss_vector_type_t out_type, size_t count, float scale) {
+    simd::ElementType from, to;
+    if (!in || !out || !element_type(in_type, from) || !element_type(out_type, to)) {
+        return -1;
+    }
+    if ((from == simd::ElementType::Int8 || to == simd::ElementType::Int8) && !(scale > 0.0f)) {
+        return -1;
+    }
+
+    if (from == simd::ElementType::Float32) {
+        simd::from_float(to, static_cast<const float*>(in), out, count, scale);
+    } else if (to == simd::ElementType::Float32) {
+        simd::to_float(from, in, static_cast<float*>(out), count, scale);
+    } else {
+        // Neither side is float32: pass through a block on the stack
+        float block[1024];
+        const char* src = static_cast<const char*>(in);
+        char* dst = static_cast<char*>(out);
+        for (size_t begin = 0; begin < count; begin += 1024) {
+            const size_t n = std::min<size_t>(1024, count - begin);
+            simd::to_float(from, src + begin * simd::element_size(from), block, n, scale);
+            simd::from_float(to, block, dst + begin * simd::element_size(to), n, scale);
+        }
+    }
+    return 0;
+}
+
+int pgv_faiss_remove_vectors(pgv_faiss_index_t* index, const char* table_name, const int64_t* ids, size_t count) {
+    if (!index || !ids || count == 0) {
+        return -1;
+    }
+
+    metrics::Span span(metrics::Op::Remove, count);
+    if (table_name) {
+        std::lock_guard<std::mutex> lock(index->db_mutex);
+        if (!index->db || !index->db->is_connected() || index->db->delete_vectors(table_name, ids, count) < 0) {
+            return span.status(-2);
+        }
+    }
+
+    if (index->sharded) {
+        return span.status(index->sharded->remove_vectors(ids, count) == 0 ? 0 : -4);
+    }
+    return span.status(index->faiss->remove_vectors(ids, count) == 0 ? 0 : -4);
+}
+
+int pgv_faiss_upsert_vectors(pgv_faiss_index_t* index, const char* table_name, const float* vectors,
+                             const int64_t* ids, size_t count) {
+    if (!index || !vectors || !ids || count == 0) {
+        return -1;
+    }
+
+    metrics::Span span(metrics::Op::Upsert, count);
+    if (table_name) {
+        std::lock_guard<std::mutex> lock(index->db_mutex);
+        if (!index->db || !index->db->is_connected() ||
+            !index->db->upsert_vectors(table_name, vectors, ids, count, index->dimension)) {
+            return span.status(-2);
+        }
+    }
+
+    if (index->sharded) {
+        return span.status(index->sharded->upsert_vectors(vectors, ids, count) == 0 ? 0 : -4);
+    }
+    return span.status(index->faiss->upsert_vectors(vectors, ids, count) == 0 ? 0 : -4);
+}
+
+int pgv_faiss_compact(pgv_faiss_index_t* index) {
+    if (!index) {
+        return -1;
+    }
+
+    metrics::Span span(metrics::Op::Compact);
+    if (index->sharded) {
+        return span.status(index->sharded->compact() == 0 ? 0 : -4);
+    }
+    return span.status(index->faiss->compact() == 0 ? 0 : -4);
+}
+
+int pgv_faiss_search(pgv_faiss_index_t* index, const float* query, size_t k, pgv_faiss_result_t* result) {
+    return pgv_faiss_search_with_params(index, query, k, nullptr, result);
+}
+
+int pgv_faiss_search_with_params(pgv_faiss_index_t* index, const float* query, size_t k,
+                                 const pgv_faiss_search_params_t* params, pgv_faiss_result_t* result) {
+    if (!index || !query || k == 0 || !result) {
+        return -1;
+    }
+
+    result->ids = nullptr;
+    result->distances = nullptr;
+    result->count = 0;
+
+    metrics::Span span(metrics::Op::Search, 1);
+    ScratchArena::Scope scratch;
+    int64_t* ids = scratch.allocate<int64_t>(k);
+    float* distances = scratch.allocate<float>(k);
+    size_t hits = 0;
+    int status = search_slots(index, query, k, resolve_search_options(index, params), ids, distances, &hits);
+    if (status != 0 || hits == 0) {
+        return span.status(status);
+    }
+
+    if (!allocate_result(result, hits)) {
+        result->count = 0;
+        return span.status(-3);
+    }
+    std::memcpy(result->ids, ids, hits * sizeof(int64_t));
+    std::memcpy(result->distances, distances, hits * sizeof(float));
+    return 0;
+}
+
+int pgv_faiss_search_into(pgv_faiss_index_t* index, const float* query, size_t k,
+                          const pgv_faiss_search_params_t* params, int64_t* ids, float* distances, size_t* count) {
+    if (!index || !query || k == 0 || !ids || !distances) {
+        return -1;
+    }
+
+    metrics::Span span(metrics::Op::Search, 1);
+    return span.status(search_slots(index, query, k, resolve_search_options(index, params), ids, distances, count));
+}
+
+int pgv_faiss_batch_search(pgv_faiss_index_t* index, const float* queries, size_t nq, size_t k,
+                           pgv_faiss_batch_result_t* result) {
+    return pgv_faiss_batch_search_with_params(index, queries, nq, k, nullptr, result);
+}
+
+int pgv_faiss_batch_search_with_params(pgv_faiss_index_t* index, const float* queries, size_t nq, size_t k,
+                                       const pgv_faiss_search_params_t* params, pgv_faiss_batch_result_t* result) {
+    if (!index || !queries || nq == 0 || k == 0 || !result) {
+        return -1;
+    }
+
+    result->ids = nullptr;
+    result->distances = nullptr;
+    result->nq = 0;
+    result->k = 0;
+
+    metrics::Span span(metrics::Op::BatchSearch, nq);
+    // One pooled allocation holds both arrays; ids come first so distances stay aligned
+    size_t slots = nq * k;
+    void* block = result_pool::allocate(slots * (sizeof(int64_t) + sizeof(float)));
+    if (!block) {
+        return span.status(-3);
+    }
+
+    int64_t* ids = static_cast<int64_t*>(block);
+    float* distances = reinterpret_cast<float*>(ids + slots);
+
+    SearchOptions options = resolve_search_options(index, params);
+    int status = index->sharded ? index->sharded->search_batch(queries, nq, k, distances, ids, options)
+                                : index->faiss->search_batch(queries, nq, k, distances, ids, options);
+    if (status != 0) {
+        result_pool::release(block);
+        return span.status(-4);
+    }
+
+    result->ids = ids;
+    result->distances = distances;
+    result->nq = nq;
+    result->k = k;
+    return 0;
+}
+
+int pgv_faiss_batch_search_into(pgv_faiss_index_t* index, const float* queries, size_t nq, size_t k,
+                                int64_t* ids, float* distances) {
+    if (!index || !queries || nq == 0 || k == 0 || !ids || !distances) {
+        return -1;
+    }
+
+    metrics::Span span(metrics::Op::BatchSearch, nq);
+    SearchOptions options = resolve_search_options(index, nullptr);
+    int status = index->sharded ? index->sharded->search_batch(queries, nq, k, distances, ids, options)
+                                : index->faiss->search_batch(queries, nq, k, distances, ids, options);
+    return span.status(status == 0 ? 0 : -4);
+}
+
+int pgv_faiss_range_search(pgv_faiss_index_t* index, const float* queries, size_t nq, float radius,
+                           const pgv_faiss_search_params_t* params, pgv_faiss_range_result_t* result) {
+    if (!index || !queries || nq == 0 || !result) {
+        return -1;
+    }
+
+    result->nq = 0;
+    result->lims = nullptr;
+    result->ids = nullptr;
+    result->distances = nullptr;
+
+    metrics::Span span(metrics::Op::RangeSearch, nq);
+    RangeResults found;
+    SearchOptions options = resolve_search_options(index, params);
+    int status = index->sharded ? index->sharded->range_search(queries, nq, radius, found, options)
+                                : index->faiss->range_search(queries, nq, radius, found, options);
+    if (status != 0) {
+        return span.status(-4);
+    }
+
+    result->nq = found.nq;
+    result->lims = found.lims.release();
+    result->ids = found.ids.release();
+    result->distances = found.distances.release();
+    return 0;
+}
+
+int pgv_faiss_iterator_create(pgv_faiss_index_t* index, const float* query,
+                              const pgv_faiss_search_params_t* params, pgv_faiss_iterator_t** iterator) {
+    if (!index || !query || !iterator) {
+        return -1;
+    }
+
+    *iterator = nullptr;
+    SearchOptions options = resolve_search_options(index, params);
+    std::unique_ptr<SearchIterator> results = index->sharded ? index->sharded->search_iterator(query, options)
+                                                             : index->faiss->search_iterator(query, options);
+    if (!results) {
+        return -4;
+    }
+
+    *iterator = new (std::nothrow) pgv_faiss_iterator_t;
+    if (!*iterator) {
+        return -3;
+    }
+    (*iterator)->results = std::move(results);
+    return 0;
+}
+
+int pgv_faiss_iterator_next(pgv_faiss_iterator_t* iterator, size_t k, int64_t* ids, float* distances,
+                            size_t* count) {
+    if (count) *count = 0;
+    if (!iterator || k == 0 || !ids || !distances) {
+        return -1;
+    }
+
+    metrics::Span span(metrics::Op::Search, 1);
+    int status = iterator->results->next(k, ids, distances, count);
+    return span.status(status == 0 ? 0 : -4);
+}
+
+void pgv_faiss_iterator_destroy(pgv_faiss_iterator_t* iterator) {
+    delete iterator;
+}
+
+int pgv_faiss_enable_batching(pgv_faiss_index_t* index, size_t max_batch, int max_delay_us) {
+    if (!index || max_delay_us < 0 || index->sharded) {
+        return -1;
+    }
+
+    index->dispatcher.reset();
+    if (max_batch == 0) {
+        return 0;
+    }
+
+    DispatcherOptions options;
+    options.max_batch = max_batch;
+    options.max_delay = std::chrono::microseconds(max_delay_us);
+
+    try {
+        index->dispatcher = std::make_unique<SearchDispatcher>(*index->faiss, options);
+    } catch (const std::exception& e) {
+        std::cerr << "Error starting search dispatcher: " << e.what() << std::endl;
+        return -3;
+    }
+    return 0;
+}
+
+namespace {
+
+// Caller holds whatever serializes use of db
+int save_stored(pgv_faiss_index_t* index, pgvector::PGVConnection& db, const std::string& table_name,
+                metrics::Span& span) {
+    // Shards are stored under names of their own and skip the local cache
+    if (index->sharded) {
+        if (index->sharded->compact() != 0) {
+            return span.status(-4);
+        }
+        int status = index->sharded->save(db, table_name);
+        return span.status(status == -2 ? -2 : (status == 0 ? 0 : -4));
+    }
+
+    // Tombstones live only in memory, so deleted vectors are dropped before saving
+    if (index->faiss->get_tombstone_count() > 0 && index->faiss->compact() != 0) {
+        return span.status(-4);
+    }
+
+    // Serialized bytes stream straight into compressed, checksummed chunks and,
+    // when caching is on, into the local cache entry for the new version
+    // Every change below the watermark is already applied, so it holds for
+    // whatever the serialization below captures
+    bool syncing = index->sync && index->sync->table_name() == table_name;
+    uint64_t watermark = syncing ? index->sync->watermark() : 0;
+
+    std::unique_ptr<IndexCache::Writer> fill = index->cache ? index->cache->begin(table_name) : nullptr;
+    int64_t version = 0;
+    int status = db.save_index_stream(table_name, [index, &fill, &span](const pgvector::IndexSink& sink) {
+        return index->faiss->serialize([&fill, &sink, &span](const uint8_t* data, size_t size) {
+            span.add_bytes(size);
+            if (fill && !fill->write(data, size)) fill.reset();
+            return sink(data, size);
+        });
+    }, pgvector::IndexStorageOptions(), &version);
+
+    if (status == 0 && fill) {
+        fill->commit(version);
+    }
+    if (status == 0 && syncing) {
+        if (!db.save_change_watermark(table_name, version, watermark) || !db.prune_changes(table_name)) {
+            std::cerr << "Warning: sync watermark for " << table_name << " not saved; a restart replays more changes"
+                      << std::endl;
+        }
+    }
+    return span.status(status == -2 ? -2 : (status == 0 ? 0 : -4));
+}
+
+// missing (may be NULL) is set when nothing is stored under table_name
+int load_stored(pgv_faiss_index_t* index, pgvector::PGVConnection& db, const std::string& table_name,
+                metrics::Span& span, bool* missing) {
+    if (missing) *missing = false;
+
+    if (index->sharded) {
+        int status = index->sharded->load(db, table_name);
+        if (missing) *missing = status == -1;
+        return span.status(status == -2 ? -2 : (status == 0 ? 0 : -4));
+    }
+
+    // Warm start: a cached copy of the stored version skips the transfer entirely
+    if (index->cache) {
+        int64_t version = db.latest_index_version(table_name);
+        if (version > 0 && index->cache->contains(table_name, version)) {
+            if (index->faiss->load_file(index->cache->path(table_name, version), index->cache_mmap) == 0) {
+                index->loaded_table = table_name;
+                index->loaded_version = version;
+                return 0;
+            }
+            index->cache->remove(table_name, version);
+        }
+    }
+
+    std::unique_ptr<IndexCache::Writer> fill = index->cache ? index->cache->begin(table_name) : nullptr;
+    int64_t version = 0;
+    FAISSWrapper::ParsedIndex parsed;
+    int status = db.load_index_stream(table_name, [index, &fill, &span, &parsed](const pgvector::IndexSource& source) {
+        // Tee the verified bytes into the cache while FAISS reads them
+        int parse_status = 0;
+        parsed = index->faiss->parse([&fill, &source, &span](uint8_t* data, size_t size) {
+            size_t got = source(data, size);
+            span.add_bytes(got);
+            if (fill && !fill->write(data, got)) fill.reset();
+            return got;
+        }, &parse_status);
+        return parse_status;
+    }, &version);
+
+    // The stream's totals and checksum are only known once it is read to the end
+    if (status == 0) {
+        status = index->faiss->install(std::move(parsed));
+    }
+    if (status == 0 && fill) {
+        fill->commit(version);
+    }
+    if (status == 0) {
+        index->loaded_table = table_name;
+        index->loaded_version = version;
+    }
+    if (status != -1) {
+        return span.status(status == -2 ? -2 : (status == 0 ? 0 : -4));
+    }
+
+    // Nothing in chunked storage: fall back to indexes saved as a single blob
+    std::vector<uint8_t> data = db.load_index(table_name);
+    if (data.empty()) {
+        if (missing) *missing = true;
+        return span.status(-4);
+    }
+
+    span.add_bytes(data.size());
+    if (index->faiss->deserialize(data) != 0) {
+        return span.status(-4);
+    }
+    index->loaded_table = table_name;
+    index->loaded_version = 0;
+    return 0;
+}
+
+// Registry opener: a fresh handle is created from the template, loaded from
+// the stored index and, when nothing is stored or on rebuild, built from the rows
+int open_registry_table(const pgv_faiss_registry_t* registry, const std::string& table_name,
+                        pgvector::PGVConnection& db, bool rebuild, IndexRegistry::Handle& handle) {
+    configure_connection(db, &registry->config);
+    if (!handle) {
+        std::unique_ptr<pgv_faiss_index_t> created;
+        int status = create_index(&registry->config, registry->gpu, created);
+        if (status != 0) {
+            return status;
+        }
+        handle.reset(created.release(), pgv_faiss_destroy);
+    }
+
+    if (!rebuild) {
+        bool missing = false;
+        metrics::Span span(metrics::Op::Deserialize);
+        int status = load_stored(handle.get(), db, table_name, span, &missing);
+        if (status == 0 || !missing || !registry->build_missing || index_ntotal(handle.get()) > 0) {
+            return status;
+        }
+    }
+
+    if (handle->sharded) {
+        std::cerr << "Sharded indexes are not built from tables; store them first" << std::endl;
+        return -1;
+    }
+    IndexBuildPipeline pipeline(db, *handle->faiss);
+    int status = pipeline.run(table_name);
+    if (status != 0) {
+        return status;
+    }
+    handle->loaded_table = table_name;
+    handle->loaded_version = 0;
+
+    if (registry->persist_builds) {
+        metrics::Span span(metrics::Op::Serialize);
+        return save_stored(handle.get(), db, table_name, span);
+    }
+    return 0;
+}
+
+} // namespace
+
+int pgv_faiss_save_to_db(pgv_faiss_index_t* index, const char* table_name) {
+    if (!index || !table_name) {
+        return -1;
+    }
+    metrics::Span span(metrics::Op::Serialize);
+    std::lock_guard<std::mutex> lock(index->db_mutex);
+    if (!index->db || !index->db->is_connected()) {
+        return span.status(-2);
+    }
+
+    return save_stored(index, *index->db, table_name, span);
+}
+
+int pgv_faiss_load_from_db(pgv_faiss_index_t* index, const char* table_name) {
+    if (!index || !table_name) {
+        return -1;
+    }
+    metrics::Span span(metrics::Op::Deserialize);
+    std::lock_guard<std::mutex> lock(index->db_mutex);
+    if (!index->db || !index->db->is_connected()) {
+        return span.status(-2);
+    }
+
+    return load_stored(index, *index->db, table_name, span, nullptr);
+}
+
+int pgv_faiss_registry_create(const pgv_faiss_registry_config_t* config, pgv_faiss_registry_t** registry) {
+    if (!registry || !config || !config->connection_string || config->threads < 0 ||
+        validate_config(&config->index) != 0) {
+        return -1;
+    }
+    *registry = nullptr;
+
+    std::unique_ptr<pgv_faiss_registry_t> handle(new (std::nothrow) pgv_faiss_registry_t());
+    if (!handle) {
+        return -3;
+    }
+
+    // The template outlives the caller's strings and device lists
+    handle->config = config->index;
+    handle->config.connection_string = nullptr;
+    if (config->index.index_type) {
+        handle->index_type = config->index.index_type;
+        handle->config.index_type = &handle->index_type[0];
+    }
+    if (config->index.index_factory) {
+        handle->index_factory = config->index.index_factory;
+        handle->config.index_factory = handle->index_factory.c_str();
+    }
+    if (config->index.cache_dir) {
+        handle->cache_dir = config->index.cache_dir;
+        handle->config.cache_dir = handle->cache_dir.c_str();
+    }
+    handle->gpu = resolve_gpu_options(&config->index);
+    handle->config.gpu_devices = nullptr;
+    handle->config.gpu_device_count = 0;
+    handle->config.gpu_temp_memory_mb = nullptr;
+#if defined(WITH_GPU) && HAVE_FAISS
+    if (handle->gpu.enabled) {
+        try {
+            handle->gpu.backend = std::make_shared<GpuBackend>(handle->gpu);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "; using CPU instead" << std::endl;
+            handle->gpu.enabled = false;
+        }
+    }
+#endif
+    handle->build_missing = config->build_missing != 0;
+    handle->persist_builds = config->persist_builds != 0;
+
+    RegistryOptions options;
+    options.memory_budget = config->memory_budget_mb * 1024 * 1024;
+    if (config->threads > 0) options.threads = static_cast<size_t>(config->threads);
+
+    const pgv_faiss_registry_t* owner = handle.get();
+    try {
+        handle->tables = std::make_unique<IndexRegistry>(config->connection_string, options,
+            [owner](const std::string& table_name, pgvector::PGVConnection* db, bool rebuild,
+                    IndexRegistry::Handle& index) {
+                return db ? open_registry_table(owner, table_name, *db, rebuild, index) : -2;
+            },
+            [](pgv_faiss_index_t* index) {
+                size_t shards = 0;
+                return collect_index_stats(index, &shards).memory_bytes;
+            });
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating index registry: " << e.what() << std::endl;
+        return -3;
+    }
+    if (!handle->tables->start()) {
+        return -2;
+    }
+
+    *registry = handle.release();
+    return 0;
+}
+
+int pgv_faiss_registry_acquire(pgv_faiss_registry_t* registry, const char* table_name, pgv_faiss_index_t** index) {
+    if (!registry || !table_name || !index) {
+        return -1;
+    }
+    return registry->tables->acquire(table_name, index);
+}
+
+void pgv_faiss_registry_release(pgv_faiss_registry_t* registry, pgv_faiss_index_t* index) {
+    if (registry && index) {
+        registry->tables->release(index);
+    }
+}
+
+int pgv_faiss_registry_search(pgv_faiss_registry_t* registry, const char* table_name, const float* query,
+                              size_t k, const pgv_faiss_search_params_t* params, pgv_faiss_result_t* result) {
+    if (!registry || !table_name || !query || k == 0 || !result) {
+        return -1;
+    }
+
+    pgv_faiss_index_t* index = nullptr;
+    int status = registry->tables->acquire(table_name, &index);
+    if (status != 0) {
+        return status;
+    }
+    status = pgv_faiss_search_with_params(index, query, k, params, result);
+    registry->tables->release(index);
+    return status;
+}
+
+int pgv_faiss_registry_load(pgv_faiss_registry_t* registry, const char* const* table_names, size_t count,
+                            int rebuild, int* status) {
+    if (!registry || !table_names || count == 0) {
+        return -1;
+    }
+
+    std::vector<std::string> tables;
+    tables.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (!table_names[i]) {
+            return -1;
+        }
+        tables.push_back(table_names[i]);
+    }
+
+    std::vector<int> codes;
+    int first = registry->tables->load(tables, rebuild != 0, codes);
+    if (status) {
+        std::copy(codes.begin(), codes.end(), status);
+    }
+    return first;
+}
+
+int pgv_faiss_registry_evict(pgv_faiss_registry_t* registry, const char* table_name) {
+    if (!registry || !table_name) {
+        return -1;
+    }
+    return registry->tables->evict(table_name) ? 0 : -1;
+}
+
+int pgv_faiss_registry_get_stats(pgv_faiss_registry_t* registry, pgv_faiss_registry_stats_t* stats) {
+    if (!registry || !stats) {
+        return -1;
+    }
+
+    RegistryStats current = registry->tables->stats();
+    stats->tables = current.tables;
+    stats->resident = current.resident;
+    stats->resident_bytes = current.resident_bytes;
+    stats->acquired = current.acquired;
+    stats->hits = current.hits;
+    stats->loads = current.loads;
+    stats->evictions = current.evictions;
+    return 0;
+}
+
+void pgv_faiss_registry_destroy(pgv_faiss_registry_t* registry) {
+    delete registry;
+}
+
+int pgv_faiss_train(pgv_faiss_index_t* index, const float* vectors, size_t count,
+                    const pgv_faiss_train_params_t* params) {
+    if (!index || !vectors || count == 0 || index_ntotal(index) > 0) {
+        return -1;
+    }
+
+    TrainOptions options = resolve_training_options(params).kmeans;
+    try {
+        if (index->sharded) {
+            index->sharded->train(vectors, count, options);
+            for (size_t s = 0; s < index->sharded->shard_count(); ++s) {
+                if (!index->sharded->shard(s).is_trained()) return -4;
+            }
+            return 0;
+        }
+        index->faiss->train(vectors, count, options);
+    } catch (const std::exception& e) {
+        std::cerr << "Error training index: " << e.what() << std::endl;
+        return -4;
+    }
+    return index->faiss->is_trained() ? 0 : -4;
+}
+
+int pgv_faiss_train_from_db(pgv_faiss_index_t* index, const char* table_name,
+                            const pgv_faiss_train_params_t* params, pgv_faiss_train_stats_t* stats) {
+    if (!index || !table_name || index_ntotal(index) > 0) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(index->db_mutex);
+    if (!index->db || !index->db->is_connected()) {
+        return -2;
+    }
+
+    IndexTrainer trainer(*index->db, resolve_training_options(params));
+    int status = index->sharded ? trainer.run(table_name, *index->sharded) : trainer.run(table_name, *index->faiss);
+    if (stats) {
+        stats->table_rows = trainer.stats().table_rows;
+        stats->sample_rows = trainer.stats().sample_rows;
+        stats->nlist = trainer.stats().nlist;
+        stats->sample_seconds = trainer.stats().sample_seconds;
+        stats->train_seconds = trainer.stats().train_seconds;
+    }
+    if (status != 0 || !params || !params->persist) {
+        return status;
+    }
+
+    // Stored apart from the index itself, so saving the built index later
+    // does not replace it
+    metrics::Span span(metrics::Op::Serialize);
+    if (index->sharded) {
+        status = index->sharded->save(*index->db, trained_storage_name(table_name));
+    } else {
+        status = index->db->save_index_stream(trained_storage_name(table_name),
+            [index, &span](const pgvector::IndexSink& sink) {
+                return index->faiss->serialize([&sink, &span](const uint8_t* data, size_t size) {
+                    span.add_bytes(size);
+                    return sink(data, size);
+                });
+            });
+    }
+    return span.status(status == -2 ? -2 : (status == 0 ? 0 : -4));
+}
+
+int pgv_faiss_load_training(pgv_faiss_index_t* index, const char* table_name) {
+    if (!index || !table_name || index_ntotal(index) > 0) {
+        return -1;
+    }
+    metrics::Span span(metrics::Op::Deserialize);
+    std::lock_guard<std::mutex> lock(index->db_mutex);
+    if (!index->db || !index->db->is_connected()) {
+        return span.status(-2);
+    }
+
+    int status;
+    if (index->sharded) {
+        status = index->sharded->load(*index->db, trained_storage_name(table_name));
+    } else {
+        FAISSWrapper::ParsedIndex parsed;
+        status = index->db->load_index_stream(trained_storage_name(table_name),
+            [index, &span, &parsed](const pgvector::IndexSource& source) {
+                int parse_status = 0;
+                parsed = index->faiss->parse([&source, &span](uint8_t* data, size_t size) {
+                    size_t got = source(data, size);
+                    span.add_bytes(got);
+                    return got;
+                }, &parse_status);
+                return parse_status;
+            });
+        if (status == 0) {
+            status = index->faiss->install(std::move(parsed));
+        }
+    }
+    return span.status(status == -1 || status == -2 ? status : (status == 0 ? 0 : -4));
+}
+
+int pgv_faiss_sync_start(pgv_faiss_index_t* index, const char* table_name, int poll_interval_ms) {
+    if (!index || !table_name || poll_interval_ms < 0 || index->sharded) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(index->db_mutex);
+    if (!index->db || !index->db->is_connected()) {
+        return -2;
+    }
+
+    // Resume from the watermark saved with the loaded version; an index loaded
+    // without one replays the whole change log, a fresh one starts now
+    uint64_t watermark = 0;
+    if (index->loaded_table == table_name) {
+        watermark = index->db->load_change_watermark(table_name, index->loaded_version);
+        if (watermark == 0) watermark = 1;
+    }
+
+    SyncOptions options;
+    if (poll_interval_ms > 0) options.poll_interval = std::chrono::milliseconds(poll_interval_ms);
+
+    index->sync.reset();
+    try {
+        index->sync = std::make_unique<IndexSync>(*index->faiss, index->connection_string, table_name, options);
+    } catch (const std::exception& e) {
+        std::cerr << "Error starting change sync: " << e.what() << std::endl;
+        return -3;
+    }
+    if (!index->sync->start(watermark)) {
+        index->sync.reset();
+        return -2;
+    }
+    return 0;
+}
+
+int pgv_faiss_sync_flush(pgv_faiss_index_t* index, size_t* applied) {
+    if (applied) *applied = 0;
+    if (!index) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(index->db_mutex);
+    if (!index->sync) {
+        return -1;
+    }
+
+    int64_t count = index->sync->sync_once();
+    if (count < 0) {
+        return -2;
+    }
+    if (applied) *applied = static_cast<size_t>(count);
+    return 0;
+}
+
+int pgv_faiss_sync_stop(pgv_faiss_index_t* index) {
+    if (!index) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(index->db_mutex);
+    index->sync.reset();
+    return 0;
+}
+
+int pgv_faiss_id_filter_create(const int64_t* ids, size_t count, pgv_faiss_id_filter_t** filter) {
+    if (!filter || (!ids && count > 0)) {
+        return -1;
+    }
+    *filter = nullptr;
+
+    try {
+        *filter = new pgv_faiss_id_filter_t{IdFilter(ids, count)};
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return -3;
+    }
+}
+
+size_t pgv_faiss_id_filter_size(const pgv_faiss_id_filter_t* filter) {
+    return filter ? filter->ids.size() : 0;
+}
+
+void pgv_faiss_id_filter_destroy(pgv_faiss_id_filter_t* filter) {
+    delete filter;
+}
+
+int pgv_faiss_hybrid_search(pgv_faiss_index_t* index, const char* table_name, const float* query, size_t k,
+                            const pgv_faiss_hybrid_params_t* params, pgv_faiss_result_t* result) {
+    if (!index || !table_name || !query || k == 0 || !result || index->sharded) {
+        return -1;
+    }
+    if (params && params->filter_nargs > 0 && !params->filter_args) {
+        return -1;
+    }
+
+    result->ids = nullptr;
+    result->distances = nullptr;
+    result->count = 0;
+
+    pgvector::SqlFilter filter;
+    HybridSearchOptions options;
+    options.search = resolve_search_options(index, params ? params->search : nullptr);
+    if (params) {
+        if (params->filter) filter.predicate = params->filter;
+        for (int i = 0; i < params->filter_nargs; ++i) {
+            filter.params.emplace_back(params->filter_args[i] ? params->filter_args[i] : "");
+        }
+        if (params->oversample > 0) options.oversample = params->oversample;
+        if (params->fallback_selectivity > 0.0) options.fallback_selectivity = params->fallback_selectivity;
+    }
+
+    metrics::Span span(metrics::Op::HybridSearch, 1);
+    std::vector<SearchResult> hits;
+    {
+        std::lock_guard<std::mutex> lock(index->db_mutex);
+        if (!index->db || !index->db->is_connected()) {
+            return span.status(-2);
+        }
+        if (!index->hybrid) {
+            index->hybrid = std::make_unique<HybridSearcher>(*index->faiss, *index->db);
+        }
+        if (!index->hybrid->search(table_name, query, k, filter, hits, options)) {
+            return span.status(-2);
+        }
+    }
+    if (hits.empty()) {
+        return 0;
+    }
+
+    if (!allocate_result(result, hits.size())) {
+        result->count = 0;
+        return span.status(-3);
+    }
+    for (size_t i = 0; i < hits.size(); ++i) {
+        result->ids[i] = hits[i].id;
+        result->distances[i] = hits[i].distance;
+    }
+    return 0;
+}
+
+int pgv_faiss_get_gpu_stats(pgv_faiss_index_t* index, pgv_faiss_gpu_placement_t* placement,
+                            pgv_faiss_gpu_device_stats_t* devices, size_t capacity, size_t* count) {
+    if (count) *count = 0;
+    if (placement) *placement = PGV_FAISS_PLACEMENT_CPU;
+    if (!index || (!devices && capacity > 0)) {
+        return -1;
+    }
+
+    GpuStats stats = collect_gpu_stats(index);
+    if (placement) *placement = static_cast<pgv_faiss_gpu_placement_t>(stats.placement);
+    for (size_t i = 0; i < stats.devices.size() && i < capacity; ++i) {
+        devices[i].device = stats.devices[i].device;
+        devices[i].total_bytes = stats.devices[i].total_bytes;
+        devices[i].used_bytes = stats.devices[i].used_bytes;
+        devices[i].sampled_peak_bytes = stats.devices[i].sampled_peak_bytes;
+        devices[i].index_bytes = stats.devices[i].index_bytes;
+    }
+    if (count) *count = stats.devices.size();
+    return 0;
+}
+
+int pgv_faiss_get_stats(pgv_faiss_index_t* index, pgv_faiss_stats_t* stats) {
+    if (!stats) {
+        return -1;
+    }
+    std::memset(stats, 0, sizeof(*stats));
+
+    if (index) {
+        IndexStats layout = collect_index_stats(index, &stats->shards);
+        stats->ntotal = layout.ntotal;
+        stats->dimension = index->dimension;
+        stats->memory_bytes = layout.memory_bytes;
+        stats->tombstones = layout.tombstones;
+        stats->nlist = layout.nlist;
+        stats->list_min = layout.list_min;
+        stats->list_max = layout.list_max;
+        stats->list_imbalance = layout.list_imbalance;
+
+        GpuStats gpu = collect_gpu_stats(index);
+        stats->gpu_placement = static_cast<pgv_faiss_gpu_placement_t>(gpu.placement);
+        for (const auto& device : gpu.devices) {
+            stats->gpu_index_bytes += device.index_bytes;
+            stats->gpu_used_bytes += device.used_bytes;
+            stats->gpu_sampled_peak_bytes += device.sampled_peak_bytes;
+        }
+
+        if (index->results) {
+            ResultCacheStats cache = index->results->stats();
+            stats->result_cache_entries = cache.entries;
+            stats->result_cache_bytes = cache.bytes;
+            stats->result_cache_hits = cache.hits + cache.near_hits;
+            stats->result_cache_near_hits = cache.near_hits;
+            stats->result_cache_misses = cache.misses;
+        }
+    }
+
+    metrics::Snapshot snapshot = metrics::snapshot();
+    for (int op = 0; op < PGV_FAISS_OP_COUNT; ++op) {
+        const metrics::OpSnapshot& from = snapshot.ops[op];
+        pgv_faiss_op_stats_t& to = stats->ops[op];
+        to.count = from.count;
+        to.errors = from.errors;
+        to.items = from.items;
+        to.bytes = from.bytes;
+        to.total_ns = from.total_ns;
+        to.max_ns = from.max_ns;
+        to.p50_ns = from.quantile_ns(0.50);
+        to.p95_ns = from.quantile_ns(0.95);
+        to.p99_ns = from.quantile_ns(0.99);
+    }
+    return 0;
+}
+
+const char* pgv_faiss_op_name(pgv_faiss_op_t op) {
+    return metrics::op_name(static_cast<metrics::Op>(op));
+}
+
+int pgv_faiss_export_prometheus(pgv_faiss_index_t* index, char* buffer, size_t capacity, size_t* length) {
+    if (length) *length = 0;
+    if (!buffer && capacity > 0) {
+        return -1;
+    }
+
+    pgv_faiss_stats_t stats;
+    pgv_faiss_get_stats(index, &stats);
+    metrics::Snapshot snapshot = metrics::snapshot();
+
+    std::ostringstream out;
+    auto family = [&out](const char* name, const char* type, const char* help) {
+        out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+    };
+    auto per_op = [&](const char* name, const char* help, uint64_t pgv_faiss_op_stats_t::*field) {
+        family(name, "counter", help);
+        for (int op = 0; op < PGV_FAISS_OP_COUNT; ++op) {
+            out << name << "{op=\"" << metrics::op_name(static_cast<metrics::Op>(op)) << "\"} "
+                << stats.ops[op].*field << "\n";
+        }
+    };
+    per_op("pgv_faiss_operations_total", "Operations completed.", &pgv_faiss_op_stats_t::count);
+    per_op("pgv_faiss_operation_errors_total", "Operations that returned an error.", &pgv_faiss_op_stats_t::errors);
+    per_op("pgv_faiss_operation_items_total", "Queries, vectors or rows handled.", &pgv_faiss_op_stats_t::items);
+    per_op("pgv_faiss_operation_bytes_total", "Bytes streamed or copied.", &pgv_faiss_op_stats_t::bytes);
+
+    // Bucket b counts durations below 2^b ns; 1 us to about a minute is exported
+    const char* histogram = "pgv_faiss_operation_duration_seconds";
+    family(histogram, "histogram", "Operation latency.");
+    for (int op = 0; op < PGV_FAISS_OP_COUNT; ++op) {
+        const metrics::OpSnapshot& ops = snapshot.ops[op];
+        const char* name = metrics::op_name(static_cast<metrics::Op>(op));
+        uint64_t cumulative = 0;
+        for (int b = 0; b < metrics::kBuckets - 1; ++b) {
+            cumulative += ops.buckets[b];
+            if (b < 10 || b > 36) continue;
+            out << histogram << "_bucket{op=\"" << name << "\",le=\"" << static_cast<double>(uint64_t(1) << b) / 1e9
+                << "\"} " << cumulative << "\n";
+        }
+        out << histogram << "_bucket{op=\"" << name << "\",le=\"+Inf\"} " << ops.count << "\n"
+            << histogram << "_sum{op=\"" << name << "\"} " << ops.total_ns / 1e9 << "\n"
+            << histogram << "_count{op=\"" << name << "\"} " << ops.count << "\n";
+    }
+
+    if (index) {
+        auto gauge = [&](const char* name, const char* help, double value) {
+            family(name, "gauge", help);
+            out << name << " " << value << "\n";
+        };
+        gauge("pgv_faiss_index_vectors", "Vectors in the index.", static_cast<double>(stats.ntotal));
+        gauge("pgv_faiss_index_memory_bytes", "Estimated host memory of the index payload.",
+              static_cast<double>(stats.memory_bytes));
+        gauge("pgv_faiss_index_tombstones", "Deleted vectors awaiting compaction.", static_cast<double>(stats.tombstones));
+        gauge("pgv_faiss_index_shards", "Shards of the index.", static_cast<double>(stats.shards));
+        if (index->results) {
+            gauge("pgv_faiss_result_cache_entries", "Queries held by the result cache.",
+                  static_cast<double>(stats.result_cache_entries));
+            gauge("pgv_faiss_result_cache_bytes", "Memory held by the result cache.",
+                  static_cast<double>(stats.result_cache_bytes));
+            family("pgv_faiss_result_cache_lookups_total", "counter", "Result cache lookups by outcome.");
+            out << "pgv_faiss_result_cache_lookups_total{result=\"hit\"} "
+                << stats.result_cache_hits - stats.result_cache_near_hits << "\n"
+                << "pgv_faiss_result_cache_lookups_total{result=\"near_hit\"} " << stats.result_cache_near_hits
+                << "\n"
+                << "pgv_faiss_result_cache_lookups_total{result=\"miss\"} " << stats.result_cache_misses << "\n";
+        }
+        if (stats.nlist > 0) {
+            gauge("pgv_faiss_index_ivf_lists", "IVF inverted lists.", static_cast<double>(stats.nlist));
+            gauge("pgv_faiss_index_ivf_list_max_size", "Vectors in the longest inverted list.",
+                  static_cast<double>(stats.list_max));
+            gauge("pgv_faiss_index_ivf_list_imbalance", "nlist * sum(size^2) / ntotal^2 of the inverted lists.",
+                  stats.list_imbalance);
+        }
+
+        GpuStats gpu = collect_gpu_stats(index);
+        if (!gpu.devices.empty()) {
+            const struct {
+                const char* name;
+                const char* help;
+                size_t GpuDeviceStats::*field;
+            } device_gauges[] = {
+                {"pgv_faiss_gpu_memory_used_bytes", "Device memory in use.", &GpuDeviceStats::used_bytes},
+                {"pgv_faiss_gpu_memory_sampled_peak_bytes", "Highest device memory use seen when sampled.",
+                 &GpuDeviceStats::sampled_peak_bytes},
+                {"pgv_faiss_gpu_index_bytes", "Estimated device footprint of the index.", &GpuDeviceStats::index_bytes},
+            };
+            for (const auto& g : device_gauges) {
+                family(g.name, "gauge", g.help);
+                for (const auto& device : gpu.devices) {
+                    out << g.name << "{device=\"" << device.device << "\"} " << device.*(g.field) << "\n";
+                }
+            }
+        }
+    }
+
+    const std::string text = out.str();
+    if (length) *length = text.size();
+    if (text.size() + 1 > capacity) {
+        return -3;
+    }
+    std::memcpy(buffer, text.c_str(), text.size() + 1);
+    return 0;
+}
+
+void pgv_faiss_set_metrics_enabled(int enabled) {
+    metrics::set_enabled(enabled != 0);
+}
+
+namespace {
+
+struct SpanForwarder {
+    pgv_faiss_span_callback_t callback;
+    void* user_data;
+};
+
+void forward_span(const metrics::SpanRecord& record, void* user_data) {
+    auto forwarder = static_cast<const SpanForwarder*>(user_data);
+    pgv_faiss_span_t span;
+    span.name = record.name;
+    std::memcpy(span.trace_id, record.trace_id, sizeof(span.trace_id));
+    std::memcpy(span.span_id, record.span_id, sizeof(span.span_id));
+    std::memcpy(span.parent_span_id, record.parent_span_id, sizeof(span.parent_span_id));
+    span.start_unix_ns = record.start_unix_ns;
+    span.end_unix_ns = record.end_unix_ns;
+    span.status = record.status;
+    span.items = record.items;
+    span.bytes = record.bytes;
+    forwarder->callback(&span, forwarder->user_data);
+}
+
+} // namespace
+
+void pgv_faiss_set_span_callback(pgv_faiss_span_callback_t callback, void* user_data) {
+    if (!callback) {
+        metrics::set_span_callback(nullptr, nullptr);
+        return;
+    }
+    // The hook owns the forwarder, so replacing the callback frees it
+    auto forwarder = std::make_shared<SpanForwarder>(SpanForwarder{callback, user_data});
+    SpanForwarder* raw = forwarder.get();
+    metrics::set_span_callback(forward_span, raw, std::move(forwarder));
+}
+
+void pgv_faiss_free_result(pgv_faiss_result_t* result) {
+    if (!result) {
+        return;
+    }
+
+    // distances lives in the same block as ids
+    result_pool::release(result->ids);
+    result->ids = nullptr;
+    result->distances = nullptr;
+    result->count = 0;
+}
+
+void pgv_faiss_free_batch_result(pgv_faiss_batch_result_t* result) {
+    if (!result) {
+        return;
+    }
+
+    // distances lives in the same allocation as ids
+    result_pool::release(result->ids);
+    result->ids = nullptr;
+    result->distances = nullptr;
+    result->nq = 0;
+    result->k = 0;
+}
+
+void pgv_faiss_free_range_result(pgv_faiss_range_result_t* result) {
+    if (!result) {
+        return;
+    }
+
+    // The arrays were allocated by the index with new[]
+    delete[] result->lims;
+    delete[] result->ids;
+    delete[] result->distances;
+    result->nq = 0;
+    result->lims = nullptr;
+    result->ids = nullptr;
+    result->distances = nullptr;
+}
+
+void pgv_faiss_destroy(pgv_faiss_index_t* index) {
+    if (index) {
+        // Drain queued searches and stop syncing before the index they target goes away
+        index->dispatcher.reset();
+        index->sync.reset();
+    }
+    delete index;
+}
@@ -0,0 +1,240 @@
+#include "result_cache.h"
+#include "faiss/simd_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+namespace {
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// splitmix64 finalizer
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+ResultCache::ResultCache(const ResultCacheOptions& options) : options_(options) {
+    options_.shards = std::max<size_t>(options_.shards, 1);
+    options_.recent_queries = options_.epsilon > 0.0f ? std::max<size_t>(options_.recent_queries, 1) : 0;
+    if (!(options_.quantization > 0.0f)) {
+        options_.quantization = ResultCacheOptions().quantization;
+    }
+    shards_.reset(new Shard[options_.shards]);
+    shard_budget_ = options_.memory_budget / options_.shards;
+}
+
+uint64_t ResultCache::combine(uint64_t seed, uint64_t value) {
+    return mix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+uint64_t ResultCache::combine(uint64_t seed, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    seed = combine(seed, size);
+    for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + i, std::min(sizeof(uint64_t), size - i));
+        seed = combine(seed, word);
+    }
+    return seed;
+}
+
+void ResultCache::invalidate() {
+    epoch_.fetch_add(1, std::memory_order_acq_rel);
+    invalidations_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ResultCache::quantize(const float* query, size_t dimension, std::vector<int32_t>& codes) const {
+    const float scale = 1.0f / options_.quantization;
+    const float limit = static_cast<float>(std::numeric_limits<int32_t>::max());
+    codes.resize(dimension);
+    for (size_t i = 0; i < dimension; ++i) {
+        const float code = std::nearbyint(query[i] * scale);
+        // NaN and out-of-range components clamp rather than overflow the cast
+        codes[i] = static_cast<int32_t>(code == code ? std::max(-limit, std::min(limit, code)) : 0.0f);
+    }
+}
+
+uint64_t ResultCache::key_of(const std::vector<int32_t>& codes, uint64_t context) const {
+    // 0 marks "no match" in nearest_recent
+    return combine(context, codes.data(), codes.size() * sizeof(int32_t)) | 1;
+}
+
+bool ResultCache::find(uint64_t key, uint64_t context, const std::vector<int32_t>* codes,
+                       std::vector<SearchResult>& results) const {
+    Shard& shard = shard_of(key);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+    auto found = shard.entries.find(key);
+    if (found == shard.entries.end()) {
+        return false;
+    }
+    const Entry& entry = *found->second;
+    if (entry.context != context || entry.epoch != epoch() || (codes && entry.codes != *codes)) {
+        return false;
+    }
+    if (entry.expires != 0 && entry.expires <= now_ms()) {
+        return false;
+    }
+    entry.referenced.store(true, std::memory_order_relaxed);
+    results = entry.results;
+    return true;
+}
+
+bool ResultCache::lookup(const float* query, size_t dimension, uint64_t context,
+                         std::vector<SearchResult>& results) {
+    if (!query || dimension == 0 || options_.memory_budget == 0) {
+        return false;
+    }
+
+    std::vector<int32_t> codes;
+    quantize(query, dimension, codes);
+    const uint64_t key = key_of(codes, context);
+    Shard& shard = shard_of(key);
+    if (find(key, context, &codes, results)) {
+        shard.hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    if (options_.epsilon > 0.0f) {
+        const uint64_t near = nearest_recent(query, dimension, context);
+        if (near != 0 && find(near, context, nullptr, results)) {
+            shard_of(near).near_hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void ResultCache::insert(const float* query, size_t dimension, uint64_t context, uint64_t epoch,
+                         const std::vector<SearchResult>& results) {
+    if (!query || dimension == 0 || options_.memory_budget == 0 || epoch != this->epoch()) {
+        return;
+    }
+
+    Entry entry;
+    quantize(query, dimension, entry.codes);
+    entry.key = key_of(entry.codes, context);
+    entry.context = context;
+    entry.epoch = epoch;
+    entry.expires = options_.ttl_ms > 0 ? now_ms() + options_.ttl_ms : 0;
+    entry.results = results;
+    entry.bytes = sizeof(Entry) + dimension * sizeof(int32_t) + results.size() * sizeof(SearchResult);
+    if (entry.bytes > shard_budget_) {
+        return;
+    }
+    const uint64_t key = entry.key;
+
+    {
+        Shard& shard = shard_of(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto found = shard.entries.find(key);
+        if (found != shard.entries.end()) {
+            shard.bytes -= found->second->bytes;
+            shard.queue.erase(found->second);
+            shard.entries.erase(found);
+        }
+        shard.queue.emplace_back();
+        Entry& slot = shard.queue.back();
+        slot.key = entry.key;
+        slot.context = entry.context;
+        slot.epoch = entry.epoch;
+        slot.expires = entry.expires;
+        slot.codes = std::move(entry.codes);
+        slot.results = std::move(entry.results);
+        slot.bytes = entry.bytes;
+        shard.entries[key] = std::prev(shard.queue.end());
+        shard.bytes += slot.bytes;
+        evict_locked(shard);
+    }
+
+    if (options_.epsilon > 0.0f) {
+        remember(query, dimension, key, context);
+    }
+}
+
+void ResultCache::evict_locked(Shard& shard) {
+    // Entries hit since they last came round get one more pass; stale and
+    // expired ones go first since nothing can hit them
+    const uint64_t current = epoch();
+    const int64_t now = options_.ttl_ms > 0 ? now_ms() : 0;
+    while (shard.bytes > shard_budget_ && !shard.queue.empty()) {
+        Entry& oldest = shard.queue.front();
+        const bool dead = oldest.epoch != current || (oldest.expires != 0 && oldest.expires <= now);
+        if (!dead && oldest.referenced.exchange(false, std::memory_order_relaxed)) {
+            shard.queue.splice(shard.queue.end(), shard.queue, shard.queue.begin());
+            continue;
+        }
+        shard.bytes -= oldest.bytes;
+        shard.entries.erase(oldest.key);
+        shard.queue.pop_front();
+        ++shard.evictions;
+    }
+}
+
+uint64_t ResultCache::nearest_recent(const float* query, size_t dimension, uint64_t context) const {
+    std::shared_lock<std::shared_mutex> lock(recent_.mutex);
+    if (recent_.dimension != dimension) {
+        return 0;
+    }
+
+    const simd::DistanceFn l2_sqr = simd::kernels().l2_sqr;
+    float best = options_.epsilon * options_.epsilon;
+    uint64_t key = 0;
+    for (size_t i = 0; i < recent_.size; ++i) {
+        if (recent_.contexts[i] != context) continue;
+        const float distance = l2_sqr(query, recent_.vectors.data() + i * dimension, dimension);
+        if (distance <= best) {
+            best = distance;
+            key = recent_.keys[i];
+        }
+    }
+    return key;
+}
+
+void ResultCache::remember(const float* query, size_t dimension, uint64_t key, uint64_t context) {
+    std::unique_lock<std::shared_mutex> lock(recent_.mutex);
+    // The ring follows the dimension of the latest insert; indexes share one
+    // cache only when their dimensions agree, so this rarely resets
+    if (recent_.dimension != dimension) {
+        recent_.dimension = dimension;
+        recent_.next = 0;
+        recent_.size = 0;
+        recent_.vectors.assign(options_.recent_queries * dimension, 0.0f);
+        recent_.keys.assign(options_.recent_queries, 0);
+        recent_.contexts.assign(options_.recent_queries, 0);
+    }
+    std::memcpy(recent_.vectors.data() + recent_.next * dimension, query, dimension * sizeof(float));
+    recent_.keys[recent_.next] = key;
+    recent_.contexts[recent_.next] = context;
+    recent_.next = (recent_.next + 1) % options_.recent_queries;
+    recent_.size = std::min(recent_.size + 1, options_.recent_queries);
+}
+
+ResultCacheStats ResultCache::stats() const {
+    ResultCacheStats stats;
+    for (size_t i = 0; i < options_.shards; ++i) {
+        const Shard& shard = shards_[i];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        stats.entries += shard.entries.size();
+        stats.bytes += shard.bytes;
+        stats.hits += shard.hits.load(std::memory_order_relaxed);
+        stats.near_hits += shard.near_hits.load(std::memory_order_relaxed);
+        stats.misses += shard.misses.load(std::memory_order_relaxed);
+        stats.evictions += shard.evictions;
+    }
+    stats.invalidations = invalidations_.load(std::memory_order_relaxed);
+    return stats;
+}
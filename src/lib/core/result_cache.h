@@ -0,0 +1,139 @@
+#ifndef PGV_RESULT_CACHE_H
+#define PGV_RESULT_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "faiss/search_results.h"
+
+struct ResultCacheOptions {
+    size_t memory_budget = 64 << 20;    // bytes of cached queries and results across all shards
+    size_t shards = 16;
+    uint32_t ttl_ms = 0;                // 0 = entries live until evicted or invalidated
+    // Query components are rounded to multiples of this before hashing, so
+    // queries differing only in float noise share an entry
+    float quantization = 1.0f / 4096;
+    // > 0 also answers a query from a recent one within this L2 distance
+    // (same k and parameters); 0 = exact matches only
+    float epsilon = 0.0f;
+    size_t recent_queries = 1024;       // recent queries scanned for approximate matches
+};
+
+struct ResultCacheStats {
+    size_t entries = 0;
+    size_t bytes = 0;
+    uint64_t hits = 0;
+    uint64_t near_hits = 0;             // hits answered by a query within epsilon
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+};
+
+// Top-k results of recent queries, keyed by the quantized query and a
+// context hash of everything else that shapes the answer (k, search
+// parameters, owner). Hits take one shard's lock shared, so readers never
+// wait for each other; inserts and evictions lock their shard exclusively.
+// Each shard evicts second-chance FIFO (CLOCK) within its share of the budget.
+//
+// Writers to the searched data call invalidate() after each write. Entries
+// carry the epoch sampled before their search ran, so any write that
+// completes during or after that search retires them, and an insert racing
+// a write is dropped rather than cached stale.
+class ResultCache {
+public:
+    explicit ResultCache(const ResultCacheOptions& options = ResultCacheOptions());
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Folds `value` into a context hash; start from 0
+    static uint64_t combine(uint64_t seed, uint64_t value);
+    static uint64_t combine(uint64_t seed, const void* data, size_t size);
+
+    // Sample before searching and pass to insert()
+    uint64_t epoch() const { return epoch_.load(std::memory_order_acquire); }
+    // Retires every entry; cheap enough to call after each write
+    void invalidate();
+
+    // Replaces `results` and returns true on a hit
+    bool lookup(const float* query, size_t dimension, uint64_t context, std::vector<SearchResult>& results);
+    void insert(const float* query, size_t dimension, uint64_t context, uint64_t epoch,
+                const std::vector<SearchResult>& results);
+
+    ResultCacheStats stats() const;
+    const ResultCacheOptions& options() const { return options_; }
+
+    // Retires entries of the cache, if any, once the enclosing write scope ends
+    class WriteScope {
+    public:
+        explicit WriteScope(std::shared_ptr<ResultCache> cache) : cache_(std::move(cache)) {}
+        ~WriteScope() {
+            if (cache_) cache_->invalidate();
+        }
+        WriteScope(const WriteScope&) = delete;
+        WriteScope& operator=(const WriteScope&) = delete;
+
+    private:
+        std::shared_ptr<ResultCache> cache_;
+    };
+
+private:
+    struct Entry {
+        uint64_t key = 0;
+        uint64_t context = 0;
+        uint64_t epoch = 0;
+        int64_t expires = 0;                        // steady clock ms; 0 = never
+        std::vector<int32_t> codes;                 // quantized query, compared on exact lookups
+        std::vector<SearchResult> results;
+        size_t bytes = 0;
+        mutable std::atomic<bool> referenced{false};
+    };
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::list<Entry> queue;                     // oldest first
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> entries;
+        size_t bytes = 0;
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> near_hits{0};
+        std::atomic<uint64_t> misses{0};
+        uint64_t evictions = 0;                     // guarded by mutex
+    };
+    // Ring of recently inserted queries of one dimension, scanned with the
+    // SIMD kernels for approximate matches
+    struct Recent {
+        mutable std::shared_mutex mutex;
+        size_t dimension = 0;
+        size_t next = 0;
+        size_t size = 0;
+        std::vector<float> vectors;                 // recent_queries x dimension
+        std::vector<uint64_t> keys;
+        std::vector<uint64_t> contexts;
+    };
+
+    ResultCacheOptions options_;
+    std::unique_ptr<Shard[]> shards_;
+    size_t shard_budget_;
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<uint64_t> invalidations_{0};
+    Recent recent_;
+
+    Shard& shard_of(uint64_t key) const { return shards_[(key >> 48) % options_.shards]; }
+    uint64_t key_of(const std::vector<int32_t>& codes, uint64_t context) const;
+    void quantize(const float* query, size_t dimension, std::vector<int32_t>& codes) const;
+    // Copies a live entry's results; codes null skips the query comparison
+    bool find(uint64_t key, uint64_t context, const std::vector<int32_t>* codes,
+              std::vector<SearchResult>& results) const;
+    // Key of the nearest recent query within epsilon sharing `context`, 0 if none
+    uint64_t nearest_recent(const float* query, size_t dimension, uint64_t context) const;
+    void remember(const float* query, size_t dimension, uint64_t key, uint64_t context);
+    // Caller holds shard.mutex exclusively
+    void evict_locked(Shard& shard);
+};
+
+#endif
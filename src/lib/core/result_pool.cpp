@@ -0,0 +1,83 @@
+#include "result_pool.h"
+
+#include <cstdlib>
+
+namespace result_pool {
+
+namespace {
+
+// The header before each block records its size class and keeps the block aligned
+const size_t kHeader = 64;
+const int kMinShift = 8;            // 256 bytes
+const int kClasses = 11;            // up to 256 KiB
+const int kUncached = -1;
+const size_t kPerClass = 4;         // cached blocks per class and thread
+
+struct Header {
+    int size_class;
+};
+
+int class_of(size_t bytes) {
+    for (int c = 0; c < kClasses; ++c) {
+        if (bytes <= (size_t(1) << (kMinShift + c))) return c;
+    }
+    return kUncached;
+}
+
+struct FreeLists {
+    void* blocks[kClasses][kPerClass];
+    size_t counts[kClasses] = {};
+
+    ~FreeLists() {
+        for (int c = 0; c < kClasses; ++c) {
+            for (size_t i = 0; i < counts[c]; ++i) std::free(blocks[c][i]);
+        }
+    }
+};
+
+FreeLists& local_lists() {
+    thread_local FreeLists lists;
+    return lists;
+}
+
+} // namespace
+
+void* allocate(size_t bytes) {
+    const int size_class = class_of(bytes);
+    void* raw = nullptr;
+    if (size_class != kUncached) {
+        FreeLists& lists = local_lists();
+        if (lists.counts[size_class] > 0) {
+            raw = lists.blocks[size_class][--lists.counts[size_class]];
+        } else {
+            raw = std::aligned_alloc(kHeader, kHeader + (size_t(1) << (kMinShift + size_class)));
+        }
+    } else {
+        raw = std::aligned_alloc(kHeader, kHeader + (bytes + kHeader - 1) / kHeader * kHeader);
+    }
+    if (!raw) {
+        return nullptr;
+    }
+
+    static_cast<Header*>(raw)->size_class = size_class;
+    return static_cast<char*>(raw) + kHeader;
+}
+
+void release(void* block) {
+    if (!block) {
+        return;
+    }
+
+    void* raw = static_cast<char*>(block) - kHeader;
+    const int size_class = static_cast<Header*>(raw)->size_class;
+    if (size_class != kUncached) {
+        FreeLists& lists = local_lists();
+        if (lists.counts[size_class] < kPerClass) {
+            lists.blocks[size_class][lists.counts[size_class]++] = raw;
+            return;
+        }
+    }
+    std::free(raw);
+}
+
+} // namespace result_pool
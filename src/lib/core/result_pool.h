@@ -0,0 +1,20 @@
+#ifndef PGV_RESULT_POOL_H
+#define PGV_RESULT_POOL_H
+
+#include <cstddef>
+
+// Recycles the buffers handed out in pgv_faiss_result_t and
+// pgv_faiss_batch_result_t. Released blocks are kept on per-thread free lists
+// by power-of-two size class, so a search that follows a free of a similar
+// result reuses that result's memory instead of calling malloc. Blocks above
+// the largest class go straight back to the system.
+namespace result_pool {
+
+// 64-byte aligned block of at least `bytes`; nullptr when out of memory
+void* allocate(size_t bytes);
+// Takes a block from allocate(), from any thread; nullptr is ignored
+void release(void* block);
+
+} // namespace result_pool
+
+#endif
@@ -0,0 +1,92 @@
+#include "scratch_arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+const size_t kAlignment = 64;
+const size_t kMinBlock = 64 * 1024;
+// Larger demands are served per call rather than pinned to the thread
+const size_t kMaxRetained = 64 * 1024 * 1024;
+
+size_t align_up(size_t bytes) {
+    return (bytes + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+void* aligned(size_t bytes) {
+    void* data = std::aligned_alloc(kAlignment, align_up(std::max<size_t>(bytes, 1)));
+    if (!data) throw std::bad_alloc();
+    return data;
+}
+
+} // namespace
+
+ScratchArena& ScratchArena::local() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+size_t ScratchArena::local_capacity() {
+    return local().capacity_;
+}
+
+size_t ScratchArena::local_overflow() {
+    return local().overflow_.size();
+}
+
+ScratchArena::~ScratchArena() {
+    for (void* data : overflow_) std::free(data);
+    std::free(block_);
+}
+
+ScratchArena::Scope::Scope()
+    : arena_(ScratchArena::local()), mark_{arena_.used_, arena_.overflow_.size(), arena_.demand_} {
+    ++arena_.depth_;
+}
+
+ScratchArena::Scope::~Scope() {
+    arena_.release(mark_);
+}
+
+void* ScratchArena::allocate_bytes(size_t bytes) {
+    bytes = align_up(std::max<size_t>(bytes, 1));
+    demand_ += bytes;
+    peak_ = std::max(peak_, demand_);
+    if (used_ + bytes <= capacity_) {
+        void* data = block_ + used_;
+        used_ += bytes;
+        return data;
+    }
+
+    overflow_.reserve(overflow_.size() + 1);
+    void* data = aligned(bytes);
+    overflow_.push_back(data);
+    return data;
+}
+
+void ScratchArena::release(const Mark& mark) {
+    // Inner scopes opened in a loop must not pile up overflow allocations
+    for (size_t i = mark.overflow; i < overflow_.size(); ++i) std::free(overflow_[i]);
+    overflow_.resize(mark.overflow);
+    used_ = mark.used;
+    demand_ = mark.demand;
+    if (--depth_ > 0) {
+        return;
+    }
+
+    if (peak_ <= capacity_ || peak_ > kMaxRetained) {
+        peak_ = 0;
+        return;
+    }
+
+    // Nothing is live at the outermost scope, so the block can be replaced
+    size_t capacity = std::max({peak_, capacity_ * 2, kMinBlock});
+    std::free(block_);
+    block_ = nullptr;
+    capacity_ = 0;
+    peak_ = 0;
+    block_ = static_cast<char*>(std::aligned_alloc(kAlignment, align_up(capacity)));
+    if (block_) capacity_ = align_up(capacity);
+}
@@ -0,0 +1,68 @@
+#ifndef PGV_SCRATCH_ARENA_H
+#define PGV_SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Per-thread bump allocator for search temporaries (distance blocks, top-k
+// heaps, merge buffers). Memory comes from one block per thread that grows to
+// the largest demand seen and is then reused, so a steady stream of similar
+// searches allocates nothing. Requests that do not fit the block are served
+// by separate allocations, freed when the scope that made them ends; once the
+// outermost Scope ends the block is regrown to cover the largest demand.
+class ScratchArena {
+    // Arena state when a scope opened, restored when it ends
+    struct Mark {
+        size_t used;
+        size_t overflow;
+        size_t demand;
+    };
+
+public:
+    // Everything allocated through a scope is released when it ends. Scopes
+    // nest, and belong to the thread that opened them.
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        // Uninitialized, 64-byte aligned; throws std::bad_alloc
+        template <typename T>
+        T* allocate(size_t count) {
+            static_assert(std::is_trivially_destructible<T>::value, "scratch memory is never destroyed");
+            return static_cast<T*>(arena_.allocate_bytes(count * sizeof(T)));
+        }
+
+    private:
+        ScratchArena& arena_;
+        Mark mark_;
+    };
+
+    ~ScratchArena();
+
+    // Bytes held by the calling thread's arena, for tests and diagnostics
+    static size_t local_capacity();
+    // Allocations the calling thread holds outside its block
+    static size_t local_overflow();
+
+private:
+    char* block_ = nullptr;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    size_t depth_ = 0;
+    std::vector<void*> overflow_;       // allocations that did not fit the block
+    size_t demand_ = 0;                 // used_ plus overflow bytes of the open scopes
+    size_t peak_ = 0;
+
+    ScratchArena() = default;
+    static ScratchArena& local();
+
+    void* allocate_bytes(size_t bytes);
+    void release(const Mark& mark);
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "search_dispatcher.h"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+SearchDispatcher::SearchDispatcher(FAISSWrapper& index, const DispatcherOptions& options)
+    : index_(index), options_(options), stopping_(false) {
+    options_.max_batch = std::max<size_t>(options_.max_batch, 1);
+    worker_ = std::thread(&SearchDispatcher::run, this);
+}
+
+SearchDispatcher::~SearchDispatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    worker_.join();
+}
+
+std::future<std::vector<SearchResult>> SearchDispatcher::submit(const float* query, size_t k,
+                                                                const SearchOptions& options) {
+    Request request;
+    request.query.assign(query, query + index_.get_dimension());
+    request.k = k;
+    request.options = options;
+    auto future = request.promise.get_future();
+    enqueue(std::move(request));
+    return future;
+}
+
+void SearchDispatcher::submit(const float* query, size_t k, Callback done, const SearchOptions& options) {
+    Request request;
+    request.query.assign(query, query + index_.get_dimension());
+    request.k = k;
+    request.options = options;
+    request.callback = std::move(done);
+    enqueue(std::move(request));
+}
+
+void SearchDispatcher::enqueue(Request request) {
+    request.enqueued = std::chrono::steady_clock::now();
+    
+    bool notify;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Wake the worker for the first query (starts the deadline) and for a full batch
+        pending_.push_back(std::move(request));
+        notify = pending_.size() == 1 || pending_.size() >= options_.max_batch;
+    }
+    if (notify) {
+        wake_.notify_one();
+    }
+}
+
+void SearchDispatcher::run() {
+    std::vector<Request> batch;
+    batch.reserve(options_.max_batch);
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            return;   // stopping with nothing left to answer
+        }
+        
+        auto deadline = pending_.front().enqueued + options_.max_delay;
+        wake_.wait_until(lock, deadline, [this] {
+            return stopping_ || pending_.size() >= options_.max_batch;
+        });
+        
+        size_t take = std::min(pending_.size(), options_.max_batch);
+        for (size_t i = 0; i < take; ++i) {
+            batch.push_back(std::move(pending_.front()));
+            pending_.pop_front();
+        }
+        
+        lock.unlock();
+        execute(batch);
+        batch.clear();
+        lock.lock();
+    }
+}
+
+void SearchDispatcher::execute(std::vector<Request>& batch) {
+    // Requests with the same options run as one index call; batches are
+    // usually uniform, so this is a single pass in the common case
+    std::vector<bool> done(batch.size(), false);
+    std::vector<Request*> group;
+    group.reserve(batch.size());
+    
+    for (size_t first = 0; first < batch.size(); ++first) {
+        if (done[first]) continue;
+        
+        group.clear();
+        for (size_t i = first; i < batch.size(); ++i) {
+            if (!done[i] && batch[i].options == batch[first].options) {
+                group.push_back(&batch[i]);
+                done[i] = true;
+            }
+        }
+        execute_group(group);
+    }
+}
+
+void SearchDispatcher::execute_group(const std::vector<Request*>& group) {
+    const size_t dimension = static_cast<size_t>(index_.get_dimension());
+    const size_t nq = group.size();
+    size_t k = 0;
+    for (const Request* request : group) {
+        k = std::max(k, request->k);
+    }
+    
+    // An exception here would end the worker and strand every later request,
+    // so it is handed to this group's futures instead
+    bool ok = false;
+    std::exception_ptr error;
+    try {
+        queries_.resize(nq * dimension);
+        distances_.resize(nq * k);
+        labels_.resize(nq * k);
+        for (size_t q = 0; q < nq; ++q) {
+            std::copy(group[q]->query.begin(), group[q]->query.end(), queries_.begin() + q * dimension);
+        }
+        ok = k > 0 && index_.search_batch(queries_.data(), nq, k, distances_.data(), labels_.data(),
+                                          group.front()->options) == 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error in dispatched search: " << e.what() << std::endl;
+        error = std::current_exception();
+    } catch (...) {
+        std::cerr << "Error in dispatched search" << std::endl;
+        error = std::current_exception();
+    }
+    
+    for (size_t q = 0; q < nq; ++q) {
+        Request& request = *group[q];
+        try {
+            std::vector<SearchResult> results;
+            if (ok) {
+                results.reserve(request.k);
+                for (size_t i = 0; i < request.k; ++i) {
+                    int64_t label = labels_[q * k + i];
+                    if (label >= 0) {
+                        results.push_back({label, distances_[q * k + i]});
+                    }
+                }
+            }
+            
+            if (request.callback) {
+                // Callbacks cannot take an exception; they see a failed search as no results
+                request.callback(std::move(results));
+            } else if (error) {
+                request.promise.set_exception(error);
+            } else {
+                request.promise.set_value(std::move(results));
+            }
+        } catch (const std::exception& e) {
+            // A throwing callback, or results that did not fit in memory
+            std::cerr << "Error completing dispatched search: " << e.what() << std::endl;
+            if (!request.callback) {
+                request.promise.set_exception(std::current_exception());
+            }
+        } catch (...) {
+            std::cerr << "Error completing dispatched search" << std::endl;
+            if (!request.callback) {
+                request.promise.set_exception(std::current_exception());
+            }
+        }
+    }
+}
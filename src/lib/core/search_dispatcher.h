@@ -0,0 +1,71 @@
+#ifndef PGV_SEARCH_DISPATCHER_H
+#define PGV_SEARCH_DISPATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "faiss/faiss_wrapper.h"
+
+struct DispatcherOptions {
+    size_t max_batch = 64;                              // flush as soon as this many queries wait
+    std::chrono::microseconds max_delay{200};           // or once the oldest query waited this long
+};
+
+// Coalesces single-query searches from many threads into one
+// FAISSWrapper::search_batch call per batch. Batches are answered with the
+// largest k requested and trimmed per caller; queries with different
+// SearchOptions share a batch window but run as separate index calls.
+// Failed searches complete with no results; one that throws hands the
+// exception to its batch's futures, and its callbacks see no results.
+class SearchDispatcher {
+public:
+    using Callback = std::function<void(std::vector<SearchResult>)>;
+
+    SearchDispatcher(FAISSWrapper& index, const DispatcherOptions& options = DispatcherOptions());
+    ~SearchDispatcher();
+
+    SearchDispatcher(const SearchDispatcher&) = delete;
+    SearchDispatcher& operator=(const SearchDispatcher&) = delete;
+
+    std::future<std::vector<SearchResult>> submit(const float* query, size_t k,
+                                                  const SearchOptions& options = SearchOptions());
+    void submit(const float* query, size_t k, Callback done,
+                const SearchOptions& options = SearchOptions());
+
+private:
+    struct Request {
+        std::vector<float> query;
+        size_t k;
+        SearchOptions options;
+        std::chrono::steady_clock::time_point enqueued;
+        std::promise<std::vector<SearchResult>> promise;
+        Callback callback;
+    };
+
+    FAISSWrapper& index_;
+    DispatcherOptions options_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Request> pending_;
+    bool stopping_;
+    std::thread worker_;
+
+    void enqueue(Request request);
+    void run();
+    void execute(std::vector<Request>& batch);
+    void execute_group(const std::vector<Request*>& group);
+
+    // Reused across batches so steady-state dispatch does not reallocate
+    std::vector<float> queries_;
+    std::vector<float> distances_;
+    std::vector<int64_t> labels_;
+};
+
+#endif
@@ -0,0 +1,643 @@
+#include "sharded_index.h"
+#include "faiss/simd_kernels.h"
+#include "pgvector/pgv_binary.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <functional>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+// Layout stream: magic | int32 shards | int32 policy | int32 dimension | float4 centroids[]
+const char kLayoutMagic[8] = {'P', 'G', 'V', 'S', 'H', 'R', 'D', '1'};
+const size_t kLayoutHeader = sizeof(kLayoutMagic) + 3 * sizeof(int32_t);
+
+// Lloyd iterations and sample size per centroid for the Vector policy
+const int kKMeansIterations = 10;
+const size_t kKMeansSamplesPerShard = 256;
+
+uint64_t mix64(uint64_t x) {
+    // splitmix64 finalizer: consecutive ids spread evenly across shards
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+void gather(const float* vectors, const int64_t* ids, const std::vector<size_t>& rows, int dimension,
+            std::vector<float>& out_vectors, std::vector<int64_t>& out_ids) {
+    out_vectors.resize(rows.size() * dimension);
+    out_ids.resize(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        std::memcpy(out_vectors.data() + i * dimension, vectors + rows[i] * dimension, dimension * sizeof(float));
+        if (ids) out_ids[i] = ids[rows[i]];
+    }
+}
+
+int first_error(const std::vector<int>& status) {
+    for (int code : status) {
+        if (code != 0) return code;
+    }
+    return 0;
+}
+
+} // namespace
+
+ShardedIndex::ShardedIndex(int dimension, const IndexOptions& index_options, const ShardOptions& options,
+                           const GpuOptions& gpu)
+    : dimension_(dimension), metric_(index_options.metric), options_(options),
+      pool_(options.threads > 0 ? options.threads : std::max<size_t>(options.shards, 1)) {
+    if (options_.shards == 0) {
+        throw std::invalid_argument("ShardedIndex needs at least one shard");
+    }
+
+    // Each shard holds its share of the dataset and of the memory budget
+    IndexOptions per_shard = index_options;
+    per_shard.expected_size = index_options.expected_size / options_.shards;
+    per_shard.memory_budget = index_options.memory_budget / options_.shards;
+
+    shards_.reserve(options_.shards);
+    for (size_t s = 0; s < options_.shards; ++s) {
+        shards_.push_back(std::make_unique<FAISSWrapper>(dimension, per_shard, gpu));
+    }
+}
+
+std::string ShardedIndex::shard_storage_name(const std::string& table_name, size_t shard) {
+    return table_name + "_shard" + std::to_string(shard);
+}
+
+std::string ShardedIndex::layout_storage_name(const std::string& table_name) {
+    return table_name + "_shards";
+}
+
+size_t ShardedIndex::shard_of_id(int64_t id) const {
+    return static_cast<size_t>(mix64(static_cast<uint64_t>(id)) % shards_.size());
+}
+
+float ShardedIndex::route_distance(const float* vector, const float* centroid) const {
+    // Inner-product centroids are kept at unit length, where the largest
+    // inner product also picks the most similar direction for cosine
+    if (metric_ == Metric::L2) {
+        return simd::l2_sqr(vector, centroid, dimension_);
+    }
+    return -simd::inner_product(vector, centroid, dimension_);
+}
+
+size_t ShardedIndex::nearest_shard(const float* vector) const {
+    size_t best = 0;
+    float best_distance = std::numeric_limits<float>::max();
+    for (size_t s = 0; s < shards_.size(); ++s) {
+        float distance = route_distance(vector, centroids_.data() + s * dimension_);
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = s;
+        }
+    }
+    return best;
+}
+
+void ShardedIndex::nearest_shards(const float* query, size_t count, size_t* out) const {
+    ScratchArena::Scope scratch;
+    auto ranked = scratch.allocate<std::pair<float, size_t>>(shards_.size());
+    for (size_t s = 0; s < shards_.size(); ++s) {
+        ranked[s] = {route_distance(query, centroids_.data() + s * dimension_), s};
+    }
+    std::partial_sort(ranked, ranked + count, ranked + shards_.size());
+
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = ranked[i].second;
+    }
+}
+
+void ShardedIndex::fit_centroids(const float* data, size_t count, bool replace) {
+    const size_t shards = shards_.size();
+    std::mt19937_64 rng(42);
+
+    // Plain k-means on a sample; the partition only needs to be balanced and
+    // local, not as accurate as the shards' own quantizers
+    std::vector<size_t> sample(count);
+    for (size_t i = 0; i < count; ++i) sample[i] = i;
+    if (count > shards * kKMeansSamplesPerShard) {
+        std::shuffle(sample.begin(), sample.end(), rng);
+        sample.resize(shards * kKMeansSamplesPerShard);
+    }
+
+    // Cosine shards hold unit vectors, so the partition is fitted on them:
+    // raw means would let long vectors pull the centroids their way
+    std::vector<float> unit;
+    if (metric_ == Metric::Cosine) {
+        unit.resize(sample.size() * dimension_);
+        for (size_t i = 0; i < sample.size(); ++i) {
+            simd::normalize(data + sample[i] * dimension_, unit.data() + i * dimension_, 1, dimension_);
+            sample[i] = i;
+        }
+        data = unit.data();
+    }
+
+    std::vector<float> centroids(shards * dimension_);
+    for (size_t s = 0; s < shards; ++s) {
+        const float* seed = data + sample[(s * sample.size()) / shards] * dimension_;
+        std::copy(seed, seed + dimension_, centroids.begin() + s * dimension_);
+    }
+    if (metric_ != Metric::L2) {
+        simd::normalize(centroids.data(), centroids.data(), shards, dimension_);
+    }
+
+    std::vector<float> sums(shards * dimension_);
+    std::vector<size_t> sizes(shards);
+    std::uniform_int_distribution<size_t> pick(0, sample.size() - 1);
+    for (int iteration = 0; iteration < kKMeansIterations; ++iteration) {
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        std::fill(sizes.begin(), sizes.end(), 0);
+        for (size_t row : sample) {
+            const float* vector = data + row * dimension_;
+            size_t best = 0;
+            float best_distance = std::numeric_limits<float>::max();
+            for (size_t s = 0; s < shards; ++s) {
+                float distance = route_distance(vector, centroids.data() + s * dimension_);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = s;
+                }
+            }
+            for (int d = 0; d < dimension_; ++d) sums[best * dimension_ + d] += vector[d];
+            ++sizes[best];
+        }
+        for (size_t s = 0; s < shards; ++s) {
+            float* centroid = centroids.data() + s * dimension_;
+            if (sizes[s] == 0) {
+                // Reseed empty shards so none stays unused
+                const float* seed = data + sample[pick(rng)] * dimension_;
+                std::copy(seed, seed + dimension_, centroid);
+                continue;
+            }
+            for (int d = 0; d < dimension_; ++d) centroid[d] = sums[s * dimension_ + d] / sizes[s];
+        }
+        if (metric_ != Metric::L2) {
+            simd::normalize(centroids.data(), centroids.data(), shards, dimension_);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(centroids_mutex_);
+    if (replace || centroids_.empty()) {
+        centroids_ = std::move(centroids);
+    }
+}
+
+void ShardedIndex::partition(const float* vectors, const int64_t* ids, size_t count,
+                             std::vector<std::vector<size_t>>& parts) {
+    parts.assign(shards_.size(), std::vector<size_t>());
+
+    if (options_.policy == ShardPolicy::IdHash) {
+        for (size_t i = 0; i < count; ++i) {
+            parts[shard_of_id(ids[i])].push_back(i);
+        }
+        return;
+    }
+
+    // The first batch fits the centroids when train() was not called
+    bool fitted;
+    {
+        std::shared_lock<std::shared_mutex> lock(centroids_mutex_);
+        fitted = !centroids_.empty();
+    }
+    if (!fitted) {
+        fit_centroids(vectors, count, false);
+    }
+
+    std::shared_lock<std::shared_mutex> lock(centroids_mutex_);
+    for (size_t i = 0; i < count; ++i) {
+        parts[nearest_shard(vectors + i * dimension_)].push_back(i);
+    }
+}
+
+int ShardedIndex::add_vectors(const float* vectors, const int64_t* ids, size_t count) {
+    if (!vectors || !ids || count == 0) {
+        return -1;
+    }
+
+    std::vector<std::vector<size_t>> parts;
+    partition(vectors, ids, count, parts);
+
+    std::vector<int> status(shards_.size(), 0);
+    pool_.parallel_for(shards_.size(), [&](size_t s) {
+        if (parts[s].empty()) return;
+        std::vector<float> shard_vectors;
+        std::vector<int64_t> shard_ids;
+        gather(vectors, ids, parts[s], dimension_, shard_vectors, shard_ids);
+        status[s] = shards_[s]->add_vectors(shard_vectors.data(), shard_ids.data(), shard_ids.size());
+    });
+    return first_error(status);
+}
+
+int ShardedIndex::remove_vectors(const int64_t* ids, size_t count, size_t* removed) {
+    if (removed) *removed = 0;
+    if (!ids || count == 0) {
+        return -1;
+    }
+
+    // Under the Vector policy an id's shard depends on its old vector, so every shard is asked
+    std::vector<std::vector<int64_t>> parts(shards_.size());
+    if (options_.policy == ShardPolicy::IdHash) {
+        for (size_t i = 0; i < count; ++i) {
+            parts[shard_of_id(ids[i])].push_back(ids[i]);
+        }
+    }
+
+    std::vector<int> status(shards_.size(), 0);
+    std::vector<size_t> counts(shards_.size(), 0);
+    pool_.parallel_for(shards_.size(), [&](size_t s) {
+        if (options_.policy == ShardPolicy::IdHash) {
+            if (!parts[s].empty()) {
+                status[s] = shards_[s]->remove_vectors(parts[s].data(), parts[s].size(), &counts[s]);
+            }
+        } else {
+            status[s] = shards_[s]->remove_vectors(ids, count, &counts[s]);
+        }
+    });
+
+    if (removed) {
+        for (size_t n : counts) *removed += n;
+    }
+    return first_error(status);
+}
+
+int ShardedIndex::upsert_vectors(const float* vectors, const int64_t* ids, size_t count) {
+    if (!vectors || !ids || count == 0) {
+        return -1;
+    }
+
+    if (options_.policy == ShardPolicy::Vector) {
+        // A changed vector may move to another shard
+        int status = remove_vectors(ids, count);
+        return status == 0 ? add_vectors(vectors, ids, count) : status;
+    }
+
+    std::vector<std::vector<size_t>> parts;
+    partition(vectors, ids, count, parts);
+
+    std::vector<int> status(shards_.size(), 0);
+    pool_.parallel_for(shards_.size(), [&](size_t s) {
+        if (parts[s].empty()) return;
+        std::vector<float> shard_vectors;
+        std::vector<int64_t> shard_ids;
+        gather(vectors, ids, parts[s], dimension_, shard_vectors, shard_ids);
+        status[s] = shards_[s]->upsert_vectors(shard_vectors.data(), shard_ids.data(), shard_ids.size());
+    });
+    return first_error(status);
+}
+
+int ShardedIndex::compact() {
+    std::vector<int> status(shards_.size(), 0);
+    pool_.parallel_for(shards_.size(), [&](size_t s) {
+        status[s] = shards_[s]->compact();
+    });
+    return first_error(status);
+}
+
+void ShardedIndex::train(const float* training_data, size_t count, const TrainOptions& train_options) {
+    if (!training_data || count == 0) {
+        return;
+    }
+
+    if (options_.policy == ShardPolicy::IdHash) {
+        pool_.parallel_for(shards_.size(), [&](size_t s) {
+            shards_[s]->train(training_data, count, train_options);
+        });
+        return;
+    }
+
+    // Retraining an empty index refits the routing; once vectors are stored
+    // it stays as is, so every vector remains in the shard it routes to
+    fit_centroids(training_data, count, get_ntotal() == 0);
+    std::vector<std::vector<size_t>> parts;
+    partition(training_data, nullptr, count, parts);
+
+    pool_.parallel_for(shards_.size(), [&](size_t s) {
+        // A shard that drew no sample trains on everything rather than not at all
+        if (parts[s].empty()) {
+            shards_[s]->train(training_data, count, train_options);
+            return;
+        }
+        std::vector<float> sample;
+        std::vector<int64_t> unused;
+        gather(training_data, nullptr, parts[s], dimension_, sample, unused);
+        shards_[s]->train(sample.data(), parts[s].size(), train_options);
+    });
+}
+
+void ShardedIndex::set_dataset_size_hint(size_t rows) {
+    for (auto& shard : shards_) {
+        shard->set_dataset_size_hint(rows / shards_.size());
+    }
+}
+
+std::vector<SearchResult> ShardedIndex::search(const float* query, size_t k, const SearchOptions& options) {
+    std::vector<SearchResult> results;
+    if (!query || k == 0) {
+        return results;
+    }
+
+    ScratchArena::Scope scratch;
+    float* distances = scratch.allocate<float>(k);
+    int64_t* labels = scratch.allocate<int64_t>(k);
+    if (search_batch(query, 1, k, distances, labels, options) != 0) {
+        return results;
+    }
+
+    for (size_t i = 0; i < k && labels[i] >= 0; ++i) {
+        results.push_back({labels[i], distances[i]});
+    }
+    return results;
+}
+
+int ShardedIndex::search_batch(const float* queries, size_t nq, size_t k, float* distances, int64_t* labels,
+                               const SearchOptions& options) {
+    if (!queries || nq == 0 || k == 0 || !distances || !labels) {
+        return -1;
+    }
+
+    const size_t shards = shards_.size();
+    ScratchArena::Scope scratch;
+
+    // Query q visits `visits` shards: route[q * visits + i] is the i-th and
+    // slot[q * visits + i] the row of q among that shard's queries
+    size_t visits = shards;
+    size_t* route;
+    size_t* slot;
+    size_t* counts = scratch.allocate<size_t>(shards);
+    std::fill(counts, counts + shards, 0);
+    {
+        std::shared_lock<std::shared_mutex> lock(centroids_mutex_);
+        bool probe = options_.policy == ShardPolicy::Vector && options_.probe > 0 &&
+                     options_.probe < shards && !centroids_.empty();
+        if (probe) visits = options_.probe;
+        route = scratch.allocate<size_t>(nq * visits);
+        slot = scratch.allocate<size_t>(nq * visits);
+        for (size_t q = 0; q < nq; ++q) {
+            size_t* visit = route + q * visits;
+            if (probe) {
+                nearest_shards(queries + q * dimension_, visits, visit);
+            } else {
+                for (size_t s = 0; s < shards; ++s) visit[s] = s;
+            }
+            for (size_t i = 0; i < visits; ++i) {
+                slot[q * visits + i] = counts[visit[i]]++;
+            }
+        }
+    }
+
+    // Shard s answers its queries into rows first[s] .. first[s + 1] of one
+    // block; members lists those queries when it is not all of them
+    size_t* first = scratch.allocate<size_t>(shards + 1);
+    first[0] = 0;
+    for (size_t s = 0; s < shards; ++s) first[s + 1] = first[s] + counts[s];
+    size_t* members = scratch.allocate<size_t>(nq * visits);
+    for (size_t i = 0; i < nq * visits; ++i) {
+        members[first[route[i]] + slot[i]] = i / visits;
+    }
+    float* shard_distances = scratch.allocate<float>(nq * visits * k);
+    int64_t* shard_labels = scratch.allocate<int64_t>(nq * visits * k);
+    int* status = scratch.allocate<int>(shards);
+    std::fill(status, status + shards, 0);
+
+    pool_.parallel_for(shards, [&](size_t s) {
+        const size_t count = counts[s];
+        if (count == 0) return;
+
+        // Runs on a pool thread, so the gathered queries use that thread's arena
+        ScratchArena::Scope local;
+        const float* shard_queries = queries;
+        if (count != nq) {
+            float* gathered = local.allocate<float>(count * dimension_);
+            for (size_t i = 0; i < count; ++i) {
+                std::memcpy(gathered + i * dimension_, queries + members[first[s] + i] * dimension_,
+                            dimension_ * sizeof(float));
+            }
+            shard_queries = gathered;
+        }
+        status[s] = shards_[s]->search_batch(shard_queries, count, k, shard_distances + first[s] * k,
+                                             shard_labels + first[s] * k, options);
+    });
+    for (size_t s = 0; s < shards; ++s) {
+        if (status[s] != 0) return status[s];
+    }
+
+    // k-way merge of the per-shard lists, each already sorted by distance
+    struct Head {
+        float distance;
+        size_t source;
+        size_t rank;
+        bool operator>(const Head& other) const { return distance > other.distance; }
+    };
+    const std::greater<Head> later;
+    Head* heap = scratch.allocate<Head>(visits);
+    for (size_t q = 0; q < nq; ++q) {
+        size_t size = 0;
+        for (size_t i = 0; i < visits; ++i) {
+            size_t base = (first[route[q * visits + i]] + slot[q * visits + i]) * k;
+            if (shard_labels[base] >= 0) {
+                heap[size++] = {shard_distances[base], i, 0};
+                std::push_heap(heap, heap + size, later);
+            }
+        }
+
+        size_t filled = 0;
+        while (filled < k && size > 0) {
+            std::pop_heap(heap, heap + size, later);
+            Head head = heap[--size];
+            size_t base = (first[route[q * visits + head.source]] + slot[q * visits + head.source]) * k;
+            labels[q * k + filled] = shard_labels[base + head.rank];
+            distances[q * k + filled] = head.distance;
+            ++filled;
+
+            size_t next = head.rank + 1;
+            if (next < k && shard_labels[base + next] >= 0) {
+                heap[size++] = {shard_distances[base + next], head.source, next};
+                std::push_heap(heap, heap + size, later);
+            }
+        }
+        for (; filled < k; ++filled) {
+            labels[q * k + filled] = -1;
+            distances[q * k + filled] = std::numeric_limits<float>::max();
+        }
+    }
+    return 0;
+}
+
+int ShardedIndex::range_search(const float* queries, size_t nq, float radius, RangeResults& results,
+                               const SearchOptions& options) {
+    if (!queries || nq == 0) {
+        return -1;
+    }
+
+    const size_t shards = shards_.size();
+    std::vector<RangeResults> parts(shards);
+    std::vector<int> status(shards, 0);
+    pool_.parallel_for(shards, [&](size_t s) {
+        status[s] = shards_[s]->range_search(queries, nq, radius, parts[s], options);
+    });
+    int error = first_error(status);
+    if (error != 0) {
+        return error;
+    }
+
+    size_t total = 0;
+    for (const RangeResults& part : parts) total += part.size();
+    results.allocate(nq, total);
+
+    // Query q's hits from every shard, then one sort per query
+    size_t at = 0;
+    for (size_t q = 0; q < nq; ++q) {
+        for (const RangeResults& part : parts) {
+            const size_t begin = part.lims[q];
+            const size_t n = part.lims[q + 1] - begin;
+            std::copy(part.ids.get() + begin, part.ids.get() + begin + n, results.ids.get() + at);
+            std::copy(part.distances.get() + begin, part.distances.get() + begin + n,
+                      results.distances.get() + at);
+            at += n;
+        }
+        results.lims[q + 1] = at;
+    }
+    results.sort_by_distance();
+    return 0;
+}
+
+std::unique_ptr<SearchIterator> ShardedIndex::search_iterator(const float* query, const SearchOptions& options) {
+    if (!query) {
+        return nullptr;
+    }
+
+    std::vector<float> copy(query, query + dimension_);
+    return std::make_unique<SearchIterator>(SearchIterator::growing_top_k(
+        [this, copy, options](size_t k, float* distances, int64_t* labels) {
+            return search_batch(copy.data(), 1, k, distances, labels, options);
+        }));
+}
+
+size_t ShardedIndex::get_ntotal() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->get_ntotal();
+    }
+    return total;
+}
+
+int ShardedIndex::save(pgvector::PGVConnection& connection, const std::string& table_name, int shard) {
+    if (shard >= static_cast<int>(shards_.size())) {
+        return -1;
+    }
+
+    // One connection, so the shards stream out one after another
+    for (size_t s = 0; s < shards_.size(); ++s) {
+        if (shard >= 0 && s != static_cast<size_t>(shard)) continue;
+        FAISSWrapper& target = *shards_[s];
+        int status = connection.save_index_stream(shard_storage_name(table_name, s),
+            [&target](const pgvector::IndexSink& sink) { return target.serialize(sink); });
+        if (status != 0) {
+            std::cerr << "Saving shard " << s << " of " << table_name << " failed" << std::endl;
+            return status;
+        }
+    }
+
+    // Written last, the layout marks a completed save; a save that fails on
+    // a shard leaves the previous layout in place
+    if (shard < 0) {
+        std::vector<char> layout;
+        {
+            std::shared_lock<std::shared_mutex> lock(centroids_mutex_);
+            layout.resize(kLayoutHeader + centroids_.size() * sizeof(float));
+            char* out = layout.data();
+            std::memcpy(out, kLayoutMagic, sizeof(kLayoutMagic));
+            out = pgvector::binary::put_int32(out + sizeof(kLayoutMagic), static_cast<int32_t>(shards_.size()));
+            out = pgvector::binary::put_int32(out, static_cast<int32_t>(options_.policy));
+            out = pgvector::binary::put_int32(out, dimension_);
+            for (float value : centroids_) out = pgvector::binary::put_float4(out, value);
+        }
+        int status = connection.save_index_stream(layout_storage_name(table_name),
+            [&layout](const pgvector::IndexSink& sink) {
+                return sink(reinterpret_cast<const uint8_t*>(layout.data()), layout.size()) ? 0 : -3;
+            });
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    return 0;
+}
+
+int ShardedIndex::load(pgvector::PGVConnection& connection, const std::string& table_name, int shard) {
+    if (shard >= static_cast<int>(shards_.size())) {
+        return -1;
+    }
+
+    std::vector<float> centroids;
+    if (shard < 0) {
+        std::vector<char> layout;
+        int status = connection.load_index_stream(layout_storage_name(table_name),
+            [&layout](const pgvector::IndexSource& source) {
+                uint8_t buffer[4096];
+                for (size_t got; (got = source(buffer, sizeof(buffer))) > 0;) {
+                    layout.insert(layout.end(), buffer, buffer + got);
+                }
+                return 0;
+            });
+        if (status != 0) {
+            return status;
+        }
+
+        const char* in = layout.data();
+        if (layout.size() < kLayoutHeader || std::memcmp(in, kLayoutMagic, sizeof(kLayoutMagic)) != 0) {
+            return -4;
+        }
+        in += sizeof(kLayoutMagic);
+        int32_t shards = pgvector::binary::get_int32(in);
+        int32_t policy = pgvector::binary::get_int32(in + 4);
+        int32_t dimension = pgvector::binary::get_int32(in + 8);
+        size_t floats = (layout.size() - kLayoutHeader) / sizeof(float);
+        if (shards != static_cast<int32_t>(shards_.size()) || policy != static_cast<int32_t>(options_.policy) ||
+            dimension != dimension_ || (floats != 0 && floats != shards_.size() * dimension_)) {
+            std::cerr << "Stored shard layout of " << table_name << " does not match this index" << std::endl;
+            return -4;
+        }
+
+        centroids.resize(floats);
+        for (size_t i = 0; i < floats; ++i) {
+            centroids[i] = pgvector::binary::get_float4(in + 12 + i * sizeof(float));
+        }
+    }
+
+    // Every stream is read and verified before any shard or the layout
+    // changes, so a bad one leaves the loaded index as it was
+    std::vector<FAISSWrapper::ParsedIndex> parsed(shards_.size());
+    for (size_t s = 0; s < shards_.size(); ++s) {
+        if (shard >= 0 && s != static_cast<size_t>(shard)) continue;
+        FAISSWrapper& target = *shards_[s];
+        int status = connection.load_index_stream(shard_storage_name(table_name, s),
+            [&target, &parsed, s](const pgvector::IndexSource& source) {
+                int parse_status = 0;
+                parsed[s] = target.parse(source, &parse_status);
+                return parse_status;
+            });
+        if (status != 0) {
+            std::cerr << "Loading shard " << s << " of " << table_name << " failed" << std::endl;
+            return status;
+        }
+    }
+
+    for (size_t s = 0; s < shards_.size(); ++s) {
+        if (parsed[s] && shards_[s]->install(std::move(parsed[s])) != 0) {
+            return -4;
+        }
+    }
+    if (shard < 0) {
+        std::unique_lock<std::shared_mutex> lock(centroids_mutex_);
+        centroids_ = std::move(centroids);
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#ifndef PGV_SHARDED_INDEX_H
+#define PGV_SHARDED_INDEX_H
+
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "pgvector/pgv_connection.h"
+#include "faiss/faiss_wrapper.h"
+#include "thread_pool.h"
+
+enum class ShardPolicy {
+    IdHash,     // shard = hash(id) % shards; every search visits every shard
+    Vector,     // shard = nearest of `shards` k-means centroids under the index metric;
+                // searches may visit the nearest few
+};
+
+struct ShardOptions {
+    size_t shards = 4;
+    ShardPolicy policy = ShardPolicy::IdHash;
+    size_t probe = 0;       // Vector policy: shards searched per query, nearest first (0 = all)
+    size_t threads = 0;     // fan-out pool size (0 = one per shard)
+};
+
+// Partitions vectors across independent FAISSWrapper shards, each with its
+// own lock and its own persisted index. Training builds the shards in
+// parallel; searches fan out over a thread pool and the per-shard top-k lists
+// are combined with a heap-based k-way merge. Safe for concurrent use to the
+// same extent as FAISSWrapper.
+class ShardedIndex {
+public:
+    // Throws std::invalid_argument like FAISSWrapper
+    ShardedIndex(int dimension, const IndexOptions& index_options, const ShardOptions& options,
+                 const GpuOptions& gpu = GpuOptions());
+
+    ShardedIndex(const ShardedIndex&) = delete;
+    ShardedIndex& operator=(const ShardedIndex&) = delete;
+
+    // ids are required, since they decide the shard and must stay unique across shards
+    int add_vectors(const float* vectors, const int64_t* ids, size_t count);
+    int remove_vectors(const int64_t* ids, size_t count, size_t* removed = nullptr);
+    int upsert_vectors(const float* vectors, const int64_t* ids, size_t count);
+    int compact();
+
+    // Vector policy: fits the shard centroids, then trains every shard on its
+    // part of the sample; IdHash trains every shard on the whole sample.
+    // Centroids are refitted only while no shard holds vectors, since stored
+    // vectors would otherwise sit in shards the new routing never probes
+    void train(const float* training_data, size_t count, const TrainOptions& train_options = TrainOptions());
+    // Each shard is sized for its share of `rows`
+    void set_dataset_size_hint(size_t rows);
+
+    std::vector<SearchResult> search(const float* query, size_t k,
+                                     const SearchOptions& options = SearchOptions());
+    int search_batch(const float* queries, size_t nq, size_t k, float* distances, int64_t* labels,
+                     const SearchOptions& options = SearchOptions());
+    // Every shard is searched, whatever the policy: the radius, not the
+    // routing, decides which vectors qualify
+    int range_search(const float* queries, size_t nq, float radius, RangeResults& results,
+                     const SearchOptions& options = SearchOptions());
+    // Grows k over search_batch, so routed queries see the same shards
+    std::unique_ptr<SearchIterator> search_iterator(const float* query,
+                                                    const SearchOptions& options = SearchOptions());
+
+    // Shard i is stored under shard_storage_name(table, i) and the partitioning
+    // (policy, centroids) under layout_storage_name(table). shard = -1 saves or
+    // loads all of them, the layout after the shards so it marks a completed
+    // save; a single shard can be rebuilt and reloaded alone.
+    // Return codes follow PGVConnection::save_index_stream / load_index_stream.
+    int save(pgvector::PGVConnection& connection, const std::string& table_name, int shard = -1);
+    int load(pgvector::PGVConnection& connection, const std::string& table_name, int shard = -1);
+    static std::string shard_storage_name(const std::string& table_name, size_t shard);
+    static std::string layout_storage_name(const std::string& table_name);
+
+    size_t shard_count() const { return shards_.size(); }
+    bool routes_by_vector() const { return options_.policy == ShardPolicy::Vector; }
+    FAISSWrapper& shard(size_t i) { return *shards_[i]; }
+    size_t get_ntotal() const;
+    int get_dimension() const { return dimension_; }
+
+private:
+    int dimension_;
+    Metric metric_;
+    ShardOptions options_;
+    std::vector<std::unique_ptr<FAISSWrapper>> shards_;
+    ThreadPool pool_;
+
+    std::vector<float> centroids_;              // Vector policy: shards x dimension, empty until trained
+    mutable std::shared_mutex centroids_mutex_;
+
+    size_t shard_of_id(int64_t id) const;
+    // Smaller is nearer: squared L2, or the negated inner product with a unit centroid
+    float route_distance(const float* vector, const float* centroid) const;
+    // Vector policy; caller holds centroids_mutex_ and centroids_ is set
+    size_t nearest_shard(const float* vector) const;
+    // Writes the count nearest shards to out, nearest first; count < shard_count()
+    void nearest_shards(const float* query, size_t count, size_t* out) const;
+    // replace = false keeps centroids another thread fitted first
+    void fit_centroids(const float* data, size_t count, bool replace);
+    // Splits rows by shard; rows of shard s are listed in parts[s]
+    void partition(const float* vectors, const int64_t* ids, size_t count,
+                   std::vector<std::vector<size_t>>& parts);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef PGV_THREAD_POOL_H
+#define PGV_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for fan-out work. Tasks run in submission
+// order; exceptions surface through the returned future.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads) : stopping_(false) {
+        if (threads == 0) threads = 1;
+        workers_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::future<void> submit(std::function<void()> task) {
+        auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+        std::future<void> done = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back([packaged] { (*packaged)(); });
+        }
+        wake_.notify_one();
+        return done;
+    }
+
+    // Runs task(0) .. task(count - 1), the first on the calling thread, and
+    // returns once all have finished; rethrows the first exception
+    void parallel_for(size_t count, const std::function<void(size_t)>& task) {
+        std::vector<std::future<void>> pending;
+        pending.reserve(count > 0 ? count - 1 : 0);
+        for (size_t i = 1; i < count; ++i) {
+            pending.push_back(submit([&task, i] { task(i); }));
+        }
+
+        std::exception_ptr error;
+        try {
+            if (count > 0) task(0);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (auto& done : pending) {
+            try {
+                done.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+    size_t size() const { return workers_.size(); }
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+
+    void run() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+#endif
@@ -1,136 +1,312 @@
 #ifdef WITH_GPU
 
-#include "faiss_wrapper.h"
+#include "gpu_backend.h"
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexIVFFlat.h>
+#include <faiss/IndexPreTransform.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/IndexReplicas.h>
+#include <faiss/IndexShards.h>
+#include <faiss/clone_index.h>
+#include <faiss/index_io.h>
+#include <faiss/impl/io.h>
+#include <faiss/gpu/GpuCloner.h>
+#include <faiss/gpu/GpuClonerOptions.h>
+#include <faiss/gpu/GpuIndex.h>
 #include <faiss/gpu/GpuIndexFlat.h>
-#include <faiss/gpu/GpuIndexIVFFlat.h>
 #include <faiss/gpu/StandardGpuResources.h>
 #include <faiss/gpu/utils/DeviceUtils.h>
 #include <cuda_runtime.h>
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
-class FAISSWrapper::GPUImpl {
-public:
-    std::unique_ptr<faiss::gpu::StandardGpuResources> gpu_resources;
-    int gpu_device;
-    
-    GPUImpl(int device) : gpu_device(device) {
-        setup_gpu_resources();
-    }
-    
-    void setup_gpu_resources() {
-        // TODO: Add GPU capability checking (compute capability, memory size)
-        // TODO: Implement GPU memory optimization strategies
-        // TODO: Add support for multiple GPU devices and load balancing
-        // TODO: Implement GPU memory monitoring and adaptive allocation
-        
-        if (faiss::gpu::getNumDevices() <= gpu_device) {
-            std::cerr << "GPU device " << gpu_device << " not available" << std::endl;
-            return;
+namespace {
+
+// Counts what faiss::write_index would produce, which tracks the device
+// footprint of flat, IVF and PQ payloads closely
+struct CountingWriter : faiss::IOWriter {
+    size_t bytes = 0;
+    size_t operator()(const void*, size_t size, size_t nitems) override {
+        bytes += size * nitems;
+        return nitems;
+    }
+};
+
+// Inverted lists are padded on the device and GpuIndex keeps some bookkeeping
+const double kDeviceOverhead = 1.15;
+
+// Index beneath IDMap / refine / pre-transform wrappers
+faiss::Index* unwrap(faiss::Index* index) {
+    if (auto id_map = dynamic_cast<faiss::IndexIDMap*>(index)) {
+        return unwrap(id_map->index);
+    }
+    if (auto refine = dynamic_cast<faiss::IndexRefine*>(index)) {
+        return unwrap(refine->base_index);
+    }
+    if (auto transform = dynamic_cast<faiss::IndexPreTransform*>(index)) {
+        return unwrap(transform->index);
+    }
+    return index;
+}
+
+const faiss::Index* unwrap(const faiss::Index* index) {
+    return unwrap(const_cast<faiss::Index*>(index));
+}
+
+} // namespace
+
+GpuBackend::GpuBackend(const GpuOptions& options) : options_(options) {
+    // TODO: Add GPU capability checking (compute capability, memory size)
+
+    if (options_.devices.empty()) {
+        throw std::runtime_error("No GPU devices given");
+    }
+
+    const int available = faiss::gpu::getNumDevices();
+    for (size_t i = 0; i < options_.devices.size(); ++i) {
+        const int device = options_.devices[i];
+        if (device < 0 || device >= available) {
+            throw std::runtime_error("GPU device " + std::to_string(device) + " not available");
         }
-        
-        cudaError_t err = cudaSetDevice(gpu_device);
+
+        cudaError_t err = cudaSetDevice(device);
         if (err != cudaSuccess) {
-            std::cerr << "Failed to set CUDA device " << gpu_device 
-                      << ": " << cudaGetErrorString(err) << std::endl;
-            return;
+            throw std::runtime_error("Failed to set CUDA device " + std::to_string(device) + ": " +
+                                     cudaGetErrorString(err));
         }
-        
-        try {
-            gpu_resources = std::make_unique<faiss::gpu::StandardGpuResources>();
-            
-            size_t free_mem, total_mem;
-            cudaMemGetInfo(&free_mem, &total_mem);
-            
-            // TODO: Make memory allocation strategy configurable
-            // TODO: Add memory pool management for better performance
-            size_t temp_mem = std::min(free_mem / 4, size_t(1536 * 1024 * 1024));
-            gpu_resources->setTempMemory(temp_mem);
-            
-            std::cout << "GPU " << gpu_device << " initialized with " 
-                      << temp_mem / (1024*1024) << " MB temp memory" << std::endl;
-                      
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to initialize GPU resources: " << e.what() << std::endl;
-            gpu_resources.reset();
+
+        auto resources = std::make_unique<faiss::gpu::StandardGpuResources>();
+
+        size_t free_mem, total_mem;
+        cudaMemGetInfo(&free_mem, &total_mem);
+        size_t temp_mem = i < options_.temp_memory.size() ? options_.temp_memory[i] : 0;
+        if (temp_mem == 0) {
+            temp_mem = std::min(free_mem / 4, size_t(1536) * 1024 * 1024);
+        }
+        resources->setTempMemory(temp_mem);
+
+        // Queries are staged into and results copied out of page-locked host
+        // memory, so transfers run as async DMA instead of through a bounce buffer
+        if (options_.pinned_memory > 0) {
+            resources->setPinnedMemory(options_.pinned_memory);
+        }
+
+        std::cout << "GPU " << device << " initialized with "
+                  << temp_mem / (1024 * 1024) << " MB temp memory" << std::endl;
+        resources_.push_back(std::move(resources));
+        temp_memory_.push_back(temp_mem);
+
+        GpuDeviceStats device_stats;
+        device_stats.device = device;
+        device_stats.total_bytes = total_mem;
+        stats_.push_back(device_stats);
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    sample_locked();
+}
+
+GpuBackend::~GpuBackend() = default;
+
+faiss::Index* GpuBackend::clone(const faiss::Index* index, bool float16) {
+    if (resources_.size() == 1) {
+        faiss::gpu::GpuClonerOptions cloner;
+        cloner.useFloat16 = float16;
+        cloner.useFloat16CoarseQuantizer = float16;
+        return faiss::gpu::index_cpu_to_gpu(resources_[0].get(), options_.devices[0], index, &cloner);
+    }
+
+    std::vector<faiss::gpu::GpuResourcesProvider*> providers;
+    for (auto& resources : resources_) {
+        providers.push_back(resources.get());
+    }
+    std::vector<int> devices = options_.devices;
+
+    faiss::gpu::GpuMultipleClonerOptions cloner;
+    cloner.shard = options_.mode == GpuMode::Shard;
+    cloner.useFloat16 = float16;
+    cloner.useFloat16CoarseQuantizer = float16;
+    return faiss::gpu::index_cpu_to_gpu_multiple(providers, devices, index, &cloner);
+}
+
+bool GpuBackend::fits(size_t bytes, bool first_device_only) {
+    const size_t devices = first_device_only ? 1 : resources_.size();
+    const bool split = !first_device_only && options_.mode == GpuMode::Shard;
+    const size_t needed = static_cast<size_t>((split ? bytes / devices : bytes) * kDeviceOverhead);
+
+    for (size_t i = 0; i < devices; ++i) {
+        size_t free_mem, total_mem;
+        cudaSetDevice(options_.devices[i]);
+        if (cudaMemGetInfo(&free_mem, &total_mem) != cudaSuccess) {
+            return false;
+        }
+        // Scratch memory is only reserved by the first search, so leave room for it
+        size_t usable = free_mem > temp_memory_[i] ? free_mem - temp_memory_[i] : 0;
+        if (needed > usable) {
+            return false;
         }
     }
-    
-    faiss::Index* create_gpu_index(const std::string& index_type, int dimension) {
-        if (!gpu_resources) {
-            return nullptr;
+    return true;
+}
+
+faiss::Index* GpuBackend::to_gpu(const faiss::Index* index, GpuStats& placed) {
+    CountingWriter counter;
+    faiss::write_index(index, &counter);
+    const size_t full = counter.bytes;
+
+    // Float16 halves the vectors of flat payloads; IVF ids stay 64-bit. For
+    // PQ codes it only shrinks the lookup tables, which live in scratch memory.
+    const faiss::Index* base = unwrap(index);
+    const auto ivf = dynamic_cast<const faiss::IndexIVF*>(base);
+    const bool flat_payload = dynamic_cast<const faiss::IndexFlat*>(base) ||
+                              dynamic_cast<const faiss::IndexIVFFlat*>(base);
+    const size_t ids = ivf ? static_cast<size_t>(index->ntotal) * sizeof(int64_t) : 0;
+    const size_t half = flat_payload ? (full - std::min(full, ids)) / 2 + ids : full;
+
+    struct Step {
+        GpuPlacement placement;
+        size_t bytes;
+    };
+    const Step steps[] = {{GpuPlacement::Gpu, full}, {GpuPlacement::GpuFloat16, half}};
+    for (const Step& step : steps) {
+        const bool float16 = step.placement == GpuPlacement::GpuFloat16;
+        if ((float16 && !options_.allow_float16) || !fits(step.bytes, false)) {
+            continue;
         }
-        
-        // TODO: Add automatic GPU index selection based on data size and GPU memory
-        // TODO: Implement fallback to CPU when GPU memory is insufficient
-        // TODO: Add support for more GPU index types (GpuIndexIVFPQ, etc.)
-        // TODO: Implement index parameter optimization based on GPU architecture
-        
+        // The estimate can be off; an allocation failure just moves on to the next step
         try {
-            if (index_type == "Flat") {
-                return new faiss::gpu::GpuIndexFlat(
-                    gpu_resources.get(), dimension, faiss::METRIC_L2);
-            }
-            else if (index_type == "IVFFlat") {
-                // TODO: Make ncentroids adaptive based on dataset size and GPU memory
-                int ncentroids = std::min(4 * (int)sqrt(100000), 65536);
-                return new faiss::gpu::GpuIndexIVFFlat(
-                    gpu_resources.get(), dimension, ncentroids, faiss::METRIC_L2);
-            }
+            faiss::Index* copy = clone(index, float16);
+            placed = record(step.placement, step.bytes, false);
+            return copy;
         } catch (const std::exception& e) {
-            std::cerr << "Failed to create GPU index: " << e.what() << std::endl;
+            std::cerr << "GPU placement failed: " << e.what() << std::endl;
         }
-        
-        return nullptr;
-    }
-    
-    void print_gpu_info() {
-        int device_count;
-        cudaGetDeviceCount(&device_count);
-        
-        std::cout << "Found " << device_count << " CUDA devices:" << std::endl;
-        
-        for (int i = 0; i < device_count; ++i) {
-            cudaDeviceProp prop;
-            cudaGetDeviceProperties(&prop, i);
-            
-            std::cout << "  Device " << i << ": " << prop.name 
-                      << " (" << prop.major << "." << prop.minor << ")" << std::endl;
-            std::cout << "    Memory: " << prop.totalGlobalMem / (1024*1024) << " MB" << std::endl;
-            std::cout << "    Multiprocessors: " << prop.multiProcessorCount << std::endl;
+    }
+
+    // Coarse assignment on the GPU, list scans on the CPU
+    if (ivf) {
+        const size_t quantizer_bytes = static_cast<size_t>(ivf->quantizer->ntotal) * ivf->d * sizeof(float);
+        if (fits(quantizer_bytes, true)) {
+            try {
+                std::unique_ptr<faiss::Index> hybrid(faiss::clone_index(index));
+                auto target = dynamic_cast<faiss::IndexIVF*>(unwrap(hybrid.get()));
+                faiss::Index* quantizer = faiss::gpu::index_cpu_to_gpu(resources_[0].get(), options_.devices[0],
+                                                                       target->quantizer);
+                if (target->own_fields) {
+                    delete target->quantizer;
+                }
+                target->quantizer = quantizer;
+                target->own_fields = true;
+                placed = record(GpuPlacement::GpuQuantizer, quantizer_bytes, true);
+                return hybrid.release();
+            } catch (const std::exception& e) {
+                std::cerr << "GPU quantizer placement failed: " << e.what() << std::endl;
+            }
         }
     }
-};
 
-void FAISSWrapper::setup_gpu_resources() {
-    if (use_gpu_) {
-        gpu_impl_ = std::make_unique<GPUImpl>(gpu_device_);
+    std::cerr << "Index of " << full / (1024 * 1024) << " MB does not fit in GPU memory; using CPU instead"
+              << std::endl;
+    placed = record(GpuPlacement::Cpu, 0, false);
+    return nullptr;
+}
+
+faiss::Index* GpuBackend::to_cpu(const faiss::Index* index) {
+    return faiss::gpu::index_gpu_to_cpu(index);
+}
+
+bool GpuBackend::uses_gpu(const faiss::Index* index) {
+    const faiss::Index* base = unwrap(index);
+    if (dynamic_cast<const faiss::gpu::GpuIndex*>(base) ||
+        dynamic_cast<const faiss::IndexReplicas*>(base) ||
+        dynamic_cast<const faiss::IndexShards*>(base)) {
+        return true;
     }
+    auto ivf = dynamic_cast<const faiss::IndexIVF*>(base);
+    return ivf && dynamic_cast<const faiss::gpu::GpuIndex*>(ivf->quantizer);
 }
 
-faiss::Index* FAISSWrapper::create_gpu_index(const std::string& index_type, int dimension) {
-    if (use_gpu_ && gpu_impl_) {
-        return gpu_impl_->create_gpu_index(index_type, dimension);
+faiss::Index* GpuBackend::clustering_index(int dimension, Metric metric) {
+    faiss::gpu::GpuIndexFlatConfig config;
+    config.device = options_.devices[0];
+    if (metric != Metric::L2) {
+        return new faiss::gpu::GpuIndexFlatIP(resources_[0].get(), dimension, config);
     }
-    return nullptr;
+    return new faiss::gpu::GpuIndexFlatL2(resources_[0].get(), dimension, config);
 }
 
-void FAISSWrapper::print_gpu_info() {
-    if (gpu_impl_) {
-        gpu_impl_->print_gpu_info();
+GpuStats GpuBackend::record(GpuPlacement placement, size_t bytes, bool first_device_only) {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    sample_locked();
+
+    GpuStats placed;
+    placed.placement = placement;
+    placed.devices = stats_;
+    const bool split = !first_device_only && options_.mode == GpuMode::Shard;
+    for (size_t i = 0; i < placed.devices.size(); ++i) {
+        if (placement == GpuPlacement::Cpu || (first_device_only && i > 0)) {
+            placed.devices[i].index_bytes = 0;
+        } else {
+            placed.devices[i].index_bytes = split ? bytes / placed.devices.size() : bytes;
+        }
+    }
+    return placed;
+}
+
+void GpuBackend::sample_locked() {
+    for (auto& device : stats_) {
+        size_t free_mem, total_mem;
+        cudaSetDevice(device.device);
+        if (cudaMemGetInfo(&free_mem, &total_mem) != cudaSuccess) {
+            continue;
+        }
+        device.total_bytes = total_mem;
+        device.used_bytes = total_mem - free_mem;
+        device.sampled_peak_bytes = std::max(device.sampled_peak_bytes, device.used_bytes);
+    }
+}
+
+GpuStats GpuBackend::stats() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    sample_locked();
+
+    GpuStats stats;
+    stats.devices = stats_;
+    return stats;
+}
+
+void GpuBackend::print_devices() {
+    int device_count;
+    cudaGetDeviceCount(&device_count);
+
+    std::cout << "Found " << device_count << " CUDA devices:" << std::endl;
+
+    for (int i = 0; i < device_count; ++i) {
+        cudaDeviceProp prop;
+        cudaGetDeviceProperties(&prop, i);
+
+        std::cout << "  Device " << i << ": " << prop.name
+                  << " (" << prop.major << "." << prop.minor << ")" << std::endl;
+        std::cout << "    Memory: " << prop.totalGlobalMem / (1024*1024) << " MB" << std::endl;
+        std::cout << "    Multiprocessors: " << prop.multiProcessorCount << std::endl;
     }
 }
 
-__global__ void warm_up_gpu() {
+__global__ void warm_up_kernel() {
     int idx = blockIdx.x * blockDim.x + threadIdx.x;
     volatile float dummy = sinf(float(idx));
 }
 
-void FAISSWrapper::warm_up_gpu() {
-    if (use_gpu_) {
-        cudaSetDevice(gpu_device_);
-        warm_up_gpu<<<256, 256>>>();
+void GpuBackend::warm_up() const {
+    for (int device : options_.devices) {
+        cudaSetDevice(device);
+        warm_up_kernel<<<256, 256>>>();
         cudaDeviceSynchronize();
     }
 }
 
-#endif
\ No newline at end of file
+#endif
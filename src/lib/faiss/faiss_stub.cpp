@@ -1,9 +1,14 @@
 #include "faiss_wrapper.h"
+#include "simd_kernels.h"
+#include "core/scratch_arena.h"
 #include <iostream>
 #include <vector>
-#include <random>
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <limits>
+#include <new>
 
 // Forward declare FAISS types as stubs
 namespace faiss {
@@ -13,84 +18,629 @@ namespace faiss {
     };
 }
 
-// Stub implementation for FAISS functionality when FAISS is not available
-struct FakeIndex : public faiss::Index {
+// Without FAISS every index type is answered by an exact scan over contiguous
+// storage with the SIMD kernels, so results match IndexFlatL2 / IndexFlatIP.
+namespace {
+
+// Version 1 streams predate metrics and are L2
+const char kFlatMagic[8] = {'P', 'G', 'V', 'F', 'L', 'A', 'T', '2'};
+const char kFlatMagicV1[8] = {'P', 'G', 'V', 'F', 'L', 'A', 'T', '1'};
+const size_t kAlignment = 64;
+const size_t kFloatsPerLine = kAlignment / sizeof(float);
+const size_t kQueryTile = 16;       // queries sharing one pass over the stored vectors
+const size_t kBlockRows = 4096;     // stored vectors per distance block
+const size_t kWidenBlockBytes = 1 << 20;   // float32 bytes widened per add_locked call
+
+// Vectors as rows of one buffer, each row starting on a cache line. Padding
+// floats are zero and never read by the kernels.
+class AlignedRows {
+public:
+    explicit AlignedRows(int dimension)
+        : dimension_(dimension), stride_((dimension + kFloatsPerLine - 1) / kFloatsPerLine * kFloatsPerLine),
+          data_(nullptr), rows_(0), capacity_(0) {}
+    ~AlignedRows() { std::free(data_); }
+
+    AlignedRows(const AlignedRows&) = delete;
+    AlignedRows& operator=(const AlignedRows&) = delete;
+
+    size_t size() const { return rows_; }
+    size_t stride() const { return stride_; }
+    const float* row(size_t i) const { return data_ + i * stride_; }
+
+    // Throws std::bad_alloc. With normalize, rows are scaled to unit length
+    // straight into their slots.
+    void append(const float* vectors, size_t count, bool normalize = false) {
+        reserve(rows_ + count);
+        const simd::NormalizeFn scale = simd::kernels().normalize;
+        for (size_t i = 0; i < count; ++i) {
+            if (normalize) {
+                scale(vectors + i * dimension_, data_ + (rows_ + i) * stride_, dimension_);
+            } else {
+                std::memcpy(data_ + (rows_ + i) * stride_, vectors + i * dimension_, dimension_ * sizeof(float));
+            }
+        }
+        rows_ += count;
+    }
+
+    void move_row(size_t from, size_t to) {
+        std::memcpy(data_ + to * stride_, data_ + from * stride_, dimension_ * sizeof(float));
+    }
+
+    void truncate(size_t rows) { rows_ = std::min(rows, rows_); }
+
+private:
+    size_t dimension_;
+    size_t stride_;
+    float* data_;
+    size_t rows_;
+    size_t capacity_;
+
+    void reserve(size_t rows) {
+        if (rows <= capacity_) return;
+        size_t capacity = std::max({rows, capacity_ * 2, size_t(1024)});
+        // stride_ is a whole number of cache lines, so the size is a multiple of the alignment
+        float* data = static_cast<float*>(std::aligned_alloc(kAlignment, capacity * stride_ * sizeof(float)));
+        if (!data) throw std::bad_alloc();
+        if (rows_ > 0) std::memcpy(data, data_, rows_ * stride_ * sizeof(float));
+        std::memset(data + rows_ * stride_, 0, (capacity - rows_) * stride_ * sizeof(float));
+        std::free(data_);
+        data_ = data;
+        capacity_ = capacity;
+    }
+};
+
+struct FlatIndex : public faiss::Index {
     int dimension;
-    std::vector<std::vector<float>> vectors;
+    Metric metric;
+    AlignedRows vectors;            // unit length for Cosine
     std::vector<int64_t> ids;
-    
-    FakeIndex(int dim) : dimension(dim) {}
+
+    FlatIndex(int dim, Metric metric) : dimension(dim), metric(metric), vectors(dim) {}
 };
 
+using Candidate = std::pair<float, int64_t>;    // max-heap on distance holds the current top-k
+
+void search_flat(const FlatIndex& index, const float* queries, size_t nq, size_t k,
+                 float* distances, int64_t* labels, const IdFilter* filter) {
+    const size_t n = index.ids.size();
+    const size_t dimension = index.dimension;
+    // Inner products become -a.b or 1 - cos(a, b), so smaller is better for every metric
+    const bool l2 = index.metric == Metric::L2;
+    const simd::DistanceFn fn = l2 ? simd::kernels().l2_sqr : simd::kernels().inner_product;
+    const float sign = l2 ? 1.0f : -1.0f;
+    const float offset = index.metric == Metric::Cosine ? 1.0f : 0.0f;
+
+    // Distance block and one k-slot heap per query of the tile
+    ScratchArena::Scope scratch;
+    if (index.metric == Metric::Cosine) {
+        float* unit = scratch.allocate<float>(nq * dimension);
+        simd::normalize(queries, unit, nq, dimension);
+        queries = unit;
+    }
+    float* block = scratch.allocate<float>(kQueryTile * std::max<size_t>(1, std::min(n, kBlockRows)));
+    Candidate* heaps = scratch.allocate<Candidate>(kQueryTile * k);
+    size_t sizes[kQueryTile];
+
+    for (size_t q0 = 0; q0 < nq; q0 += kQueryTile) {
+        const size_t tile = std::min(kQueryTile, nq - q0);
+        std::fill(sizes, sizes + tile, 0);
+
+        for (size_t j0 = 0; j0 < n; j0 += kBlockRows) {
+            const size_t rows = std::min(kBlockRows, n - j0);
+            simd::pairwise(fn, queries + q0 * dimension, tile, index.vectors.row(j0), rows,
+                           dimension, index.vectors.stride(), block);
+            if (!l2) {
+                for (size_t i = 0; i < tile * rows; ++i) block[i] = offset + sign * block[i];
+            }
+
+            for (size_t t = 0; t < tile; ++t) {
+                Candidate* heap = heaps + t * k;
+                size_t& size = sizes[t];
+                const float* row = block + t * rows;
+                for (size_t j = 0; j < rows; ++j) {
+                    if (size == k && row[j] >= heap[0].first) continue;
+                    const int64_t id = index.ids[j0 + j];
+                    if (filter && !filter->contains(id)) continue;
+                    if (size == k) {
+                        std::pop_heap(heap, heap + size);
+                        heap[size - 1] = {row[j], id};
+                    } else {
+                        heap[size++] = {row[j], id};
+                    }
+                    std::push_heap(heap, heap + size);
+                }
+            }
+        }
+
+        for (size_t t = 0; t < tile; ++t) {
+            Candidate* heap = heaps + t * k;
+            std::sort_heap(heap, heap + sizes[t]);
+            float* out_distances = distances + (q0 + t) * k;
+            int64_t* out_labels = labels + (q0 + t) * k;
+            for (size_t i = 0; i < k; ++i) {
+                out_labels[i] = i < sizes[t] ? heap[i].second : -1;
+                out_distances[i] = i < sizes[t] ? heap[i].first : std::numeric_limits<float>::max();
+            }
+        }
+    }
+}
+
+// Hits strictly within radius, one query at a time over the same distance blocks
+void range_flat(const FlatIndex& index, const float* queries, size_t nq, float radius,
+                RangeResults& results, const IdFilter* filter) {
+    const size_t n = index.ids.size();
+    const size_t dimension = index.dimension;
+    const bool l2 = index.metric == Metric::L2;
+    const simd::DistanceFn fn = l2 ? simd::kernels().l2_sqr : simd::kernels().inner_product;
+    const float sign = l2 ? 1.0f : -1.0f;
+    const float offset = index.metric == Metric::Cosine ? 1.0f : 0.0f;
+
+    ScratchArena::Scope scratch;
+    if (index.metric == Metric::Cosine) {
+        float* unit = scratch.allocate<float>(nq * dimension);
+        simd::normalize(queries, unit, nq, dimension);
+        queries = unit;
+    }
+    float* block = scratch.allocate<float>(std::max<size_t>(1, std::min(n, kBlockRows)));
+
+    std::vector<std::vector<Candidate>> hits(nq);
+    size_t total = 0;
+    for (size_t q = 0; q < nq; ++q) {
+        for (size_t j0 = 0; j0 < n; j0 += kBlockRows) {
+            const size_t rows = std::min(kBlockRows, n - j0);
+            simd::pairwise(fn, queries + q * dimension, 1, index.vectors.row(j0), rows,
+                           dimension, index.vectors.stride(), block);
+            for (size_t j = 0; j < rows; ++j) {
+                const float distance = l2 ? block[j] : offset + sign * block[j];
+                if (distance >= radius) continue;
+                const int64_t id = index.ids[j0 + j];
+                if (filter && !filter->contains(id)) continue;
+                hits[q].push_back({distance, id});
+            }
+        }
+        total += hits[q].size();
+    }
+
+    results.allocate(nq, total);
+    for (size_t q = 0; q < nq; ++q) {
+        size_t at = results.lims[q];
+        for (const Candidate& hit : hits[q]) {
+            results.ids[at] = hit.second;
+            results.distances[at++] = hit.first;
+        }
+        results.lims[q + 1] = at;
+    }
+    results.sort_by_distance();
+}
+
+// Sources may return short reads; false at end of stream
+bool read_exact(const FAISSWrapper::ByteSource& source, void* data, size_t size) {
+    uint8_t* out = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        size_t got = source(out, size);
+        if (got == 0) return false;
+        out += got;
+        size -= got;
+    }
+    return true;
+}
+
+} // namespace
+
 FAISSWrapper::FAISSWrapper(int dimension, const std::string& index_type, 
                            bool use_gpu, int gpu_device)
-    : dimension_(dimension), use_gpu_(false), gpu_device_(0), 
-      index_type_(index_type), trained_(true) {
+    : FAISSWrapper(dimension, [&index_type] {
+          IndexOptions options;
+          options.index_type = index_type;
+          return options;
+      }(), use_gpu, gpu_device) {
+}
+
+FAISSWrapper::FAISSWrapper(int dimension, const IndexOptions& options, bool, int)
+    : FAISSWrapper(dimension, options, GpuOptions()) {
+}
+
+FAISSWrapper::FAISSWrapper(int dimension, const IndexOptions& options, const GpuOptions&)
+    : next_version_(0), dimension_(dimension), use_gpu_(false), gpu_device_(0), 
+      index_type_(options.index_type), options_(options), dataset_size_hint_(0), trained_(true),
+      compaction_threshold_(0.2), compaction_pending_(false), stopping_(false) {
+    
+    // Validate the configuration the same way the FAISS build would
+    build_index_factory(options_, dimension_, options_.expected_size, 0);
     
-    std::cout << "Warning: Using stub FAISS implementation (FAISS not installed)" << std::endl;
-    index_ = std::make_unique<FakeIndex>(dimension);
+    std::cout << "Warning: FAISS not installed; using built-in exact search (" << simd::kernels().isa << ")"
+              << std::endl;
+    publish(create_index(options_.expected_size, 0));
 }
 
 FAISSWrapper::~FAISSWrapper() = default;
 
-int FAISSWrapper::add_vectors(const float* vectors, const int64_t* ids, size_t count) {
-    FakeIndex* fake_idx = static_cast<FakeIndex*>(index_.get());
+void FAISSWrapper::publish(faiss::Index* index) {
+    publish(std::shared_ptr<faiss::Index>(index));
+}
+
+void FAISSWrapper::publish(std::shared_ptr<faiss::Index> index) {
+    auto next = std::make_shared<IndexVersion>();
+    next->index = std::move(index);
+    next->version = ++next_version_;
+    std::atomic_store(&index_, next);
+    if (auto cache = get_result_cache()) {
+        cache->invalidate();
+    }
+}
+
+uint64_t FAISSWrapper::get_index_version() const {
+    auto current = acquire();
+    return current ? current->version : 0;
+}
+
+void FAISSWrapper::set_result_cache(std::shared_ptr<ResultCache> cache) {
+    std::atomic_store(&results_, std::move(cache));
+}
+
+GpuStats FAISSWrapper::get_gpu_stats() const {
+    return GpuStats();
+}
+
+IndexStats FAISSWrapper::get_index_stats() const {
+    IndexStats stats;
+    auto current = acquire();
+    if (!current) {
+        return stats;
+    }
     
-    for (size_t i = 0; i < count; ++i) {
-        std::vector<float> vec(vectors + i * dimension_, vectors + (i + 1) * dimension_);
-        fake_idx->vectors.push_back(vec);
-        fake_idx->ids.push_back(ids[i]);
+    std::shared_lock<std::shared_mutex> lock(current->mutex);
+    const FlatIndex* flat = static_cast<const FlatIndex*>(current->index.get());
+    stats.ntotal = flat->ids.size();
+    stats.memory_bytes = flat->vectors.size() * flat->vectors.stride() * sizeof(float) +
+                         flat->ids.size() * sizeof(int64_t);
+    return stats;
+}
+
+int FAISSWrapper::add_vectors(const float* vectors, const int64_t* ids, size_t count) {
+    if (!vectors || count == 0) {
+        return -1;
     }
     
-    return 0; // Success
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    return add_locked(vectors, ids, count);
 }
 
-std::vector<SearchResult> FAISSWrapper::search(const float* query, size_t k) {
-    FakeIndex* fake_idx = static_cast<FakeIndex*>(index_.get());
-    std::vector<SearchResult> results;
+int FAISSWrapper::add_vectors(const void* vectors, simd::ElementType type, const int64_t* ids, size_t count,
+                              float scale) {
+    if (type == simd::ElementType::Float32) {
+        return add_vectors(static_cast<const float*>(vectors), ids, count);
+    }
+    if (!vectors || count == 0 || !(scale > 0.0f)) {
+        return -1;
+    }
     
-    // TODO: Implement actual L2 distance calculation instead of random values
-    // TODO: Add support for different distance metrics (cosine, dot product)
-    // TODO: Implement proper brute-force search with actual vector comparisons
-    // TODO: Consider using BLAS or other optimized libraries for distance calculations
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    const size_t dimension = static_cast<size_t>(dimension_);
+    const size_t row_bytes = simd::element_size(type) * dimension;
+    const size_t block = requires_training() ? count
+                                             : std::max<size_t>(1, kWidenBlockBytes / (dimension * sizeof(float)));
+    const char* rows = static_cast<const char*>(vectors);
     
-    // Simple brute force search with random distances (stub implementation)
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(0.1f, 10.0f);
+    for (size_t begin = 0; begin < count; begin += block) {
+        const size_t n = std::min(block, count - begin);
+        int status;
+        try {
+            ScratchArena::Scope scratch;
+            float* widened = scratch.allocate<float>(n * dimension);
+            simd::to_float(type, rows + begin * row_bytes, widened, n * dimension, scale);
+            status = add_locked(widened, ids ? ids + begin : nullptr, n);
+        } catch (const std::bad_alloc&) {
+            std::cerr << "Error adding vectors: out of memory" << std::endl;
+            return -2;
+        }
+        if (status != 0) {
+            return status;
+        }
+    }
+    return 0;
+}
+
+int FAISSWrapper::add_locked(const float* vectors, const int64_t* ids, size_t count) {
+    // Declared first, so cached results are retired after the version lock is released
+    const ResultCache::WriteScope write(get_result_cache());
+    auto current = acquire();
+    std::unique_lock<std::shared_mutex> lock(current->mutex);
+    FlatIndex* flat = static_cast<FlatIndex*>(current->index.get());
     
-    size_t count = std::min(k, fake_idx->ids.size());
+    try {
+        flat->vectors.append(vectors, count, flat->metric == Metric::Cosine);
+        // Without ids, vectors are numbered sequentially like a FAISS index
+        const int64_t first = static_cast<int64_t>(flat->ids.size());
+        for (size_t i = 0; i < count; ++i) {
+            flat->ids.push_back(ids ? ids[i] : first + static_cast<int64_t>(i));
+        }
+    } catch (const std::bad_alloc&) {
+        flat->vectors.truncate(flat->ids.size());
+        std::cerr << "Error adding vectors: out of memory" << std::endl;
+        return -2;
+    }
+    return 0;
+}
+
+int FAISSWrapper::remove_vectors(const int64_t* ids, size_t count, size_t* removed) {
+    if (removed) *removed = 0;
+    if (!ids || count == 0) {
+        return -1;
+    }
     
-    for (size_t i = 0; i < count; ++i) {
-        if (i < fake_idx->ids.size()) {
-            SearchResult result;
-            result.id = fake_idx->ids[i];
-            result.distance = dis(gen);
-            results.push_back(result);
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    return remove_locked(ids, count, removed);
+}
+
+int FAISSWrapper::remove_locked(const int64_t* ids, size_t count, size_t* removed) {
+    const ResultCache::WriteScope write(get_result_cache());
+    auto current = acquire();
+    std::unique_lock<std::shared_mutex> lock(current->mutex);
+    FlatIndex* flat = static_cast<FlatIndex*>(current->index.get());
+    
+    // Rows are removed in place, so the flat index never holds tombstones
+    std::vector<int64_t> doomed(ids, ids + count);
+    std::sort(doomed.begin(), doomed.end());
+    size_t kept = 0;
+    for (size_t i = 0; i < flat->ids.size(); ++i) {
+        if (std::binary_search(doomed.begin(), doomed.end(), flat->ids[i])) continue;
+        if (kept != i) {
+            flat->ids[kept] = flat->ids[i];
+            flat->vectors.move_row(i, kept);
         }
+        ++kept;
+    }
+    if (removed) *removed = flat->ids.size() - kept;
+    flat->ids.resize(kept);
+    flat->vectors.truncate(kept);
+    return 0;
+}
+
+int FAISSWrapper::upsert_vectors(const float* vectors, const int64_t* ids, size_t count) {
+    if (!vectors || !ids || count == 0) {
+        return -1;
+    }
+    
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    remove_locked(ids, count, nullptr);
+    return add_locked(vectors, ids, count);
+}
+
+int FAISSWrapper::compact() {
+    return 0;
+}
+
+void FAISSWrapper::set_compaction_threshold(double ratio) {
+    compaction_threshold_ = ratio;
+}
+
+size_t FAISSWrapper::get_tombstone_count() const {
+    return 0;
+}
+
+std::vector<SearchResult> FAISSWrapper::search(const float* query, size_t k, const SearchOptions& options) {
+    std::vector<SearchResult> results;
+    if (!query || k == 0) {
+        return results;
     }
     
-    // Sort by distance (ascending)
-    std::sort(results.begin(), results.end(), 
-              [](const SearchResult& a, const SearchResult& b) { 
-                  return a.distance < b.distance; 
-              });
+    const std::shared_ptr<ResultCache> cache = options.filter ? nullptr : get_result_cache();
+    const uint64_t context = cache ? search_cache_context(this, k, options) : 0;
+    if (cache && cache->lookup(query, dimension_, context, results)) {
+        return results;
+    }
+    const uint64_t epoch = cache ? cache->epoch() : 0;
+    
+    ScratchArena::Scope scratch;
+    float* distances = scratch.allocate<float>(k);
+    int64_t* labels = scratch.allocate<int64_t>(k);
+    if (search_batch(query, 1, k, distances, labels, options) != 0) {
+        return results;
+    }
     
+    for (size_t i = 0; i < k && labels[i] >= 0; ++i) {
+        results.push_back({labels[i], distances[i]});
+    }
+    if (cache) {
+        cache->insert(query, dimension_, context, epoch, results);
+    }
     return results;
 }
 
+int FAISSWrapper::search_batch(const float* queries, size_t nq, size_t k, 
+                               float* distances, int64_t* labels, const SearchOptions& options) {
+    if (!queries || nq == 0 || k == 0 || !distances || !labels) {
+        return -1;
+    }
+    
+    // nprobe / ef_search have no meaning for an exact scan
+    auto current = acquire();
+    try {
+        std::shared_lock<std::shared_mutex> lock(current->mutex);
+        search_flat(*static_cast<const FlatIndex*>(current->index.get()), queries, nq, k, distances, labels,
+                    options.filter);
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Error during batch search: out of memory" << std::endl;
+        return -2;
+    }
+    return 0;
+}
+
+int FAISSWrapper::range_search(const float* queries, size_t nq, float radius, RangeResults& results,
+                               const SearchOptions& options) {
+    if (!queries || nq == 0) {
+        return -1;
+    }
+    
+    auto current = acquire();
+    try {
+        std::shared_lock<std::shared_mutex> lock(current->mutex);
+        range_flat(*static_cast<const FlatIndex*>(current->index.get()), queries, nq, radius, results,
+                   options.filter);
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Error during range search: out of memory" << std::endl;
+        return -2;
+    }
+    return 0;
+}
+
+std::unique_ptr<SearchIterator> FAISSWrapper::search_iterator(const float* query, const SearchOptions& options) {
+    if (!query) {
+        return nullptr;
+    }
+    
+    // An exact scan has nothing to resume, so k is grown
+    std::vector<float> copy(query, query + dimension_);
+    return std::make_unique<SearchIterator>(SearchIterator::growing_top_k(
+        [this, copy, options](size_t k, float* distances, int64_t* labels) {
+            return search_batch(copy.data(), 1, k, distances, labels, options);
+        }));
+}
+
 std::vector<uint8_t> FAISSWrapper::serialize() const {
-    // Return a dummy serialization
-    std::string dummy = "stub_faiss_index_v1.0";
-    return std::vector<uint8_t>(dummy.begin(), dummy.end());
+    std::vector<uint8_t> data;
+    serialize([&data](const uint8_t* bytes, size_t size) {
+        data.insert(data.end(), bytes, bytes + size);
+        return true;
+    });
+    return data;
 }
 
 int FAISSWrapper::deserialize(const std::vector<uint8_t>& data) {
-    // Accept any data for stub implementation
-    return 0; // Success
+    if (data.empty()) {
+        return -1;
+    }
+    
+    size_t offset = 0;
+    return deserialize([&data, &offset](uint8_t* bytes, size_t size) {
+        size_t take = std::min(size, data.size() - offset);
+        std::memcpy(bytes, data.data() + offset, take);
+        offset += take;
+        return take;
+    });
+}
+
+// Layout: magic | int32 dimension | int32 metric | uint64 count | int64 ids[count] |
+// float vectors[count][dimension], in host byte order like FAISS's own format
+int FAISSWrapper::serialize(const ByteSink& sink) const {
+    auto current = acquire();
+    if (!current) {
+        return -1;
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(current->mutex);
+    const FlatIndex* flat = static_cast<const FlatIndex*>(current->index.get());
+    const int32_t dimension = flat->dimension;
+    const int32_t metric = static_cast<int32_t>(flat->metric);
+    const uint64_t count = flat->ids.size();
+    
+    std::vector<uint8_t> header(sizeof(kFlatMagic) + sizeof(dimension) + sizeof(metric) + sizeof(count));
+    uint8_t* out = header.data();
+    std::memcpy(out, kFlatMagic, sizeof(kFlatMagic));
+    std::memcpy(out += sizeof(kFlatMagic), &dimension, sizeof(dimension));
+    std::memcpy(out += sizeof(dimension), &metric, sizeof(metric));
+    std::memcpy(out += sizeof(metric), &count, sizeof(count));
+    if (!sink(header.data(), header.size()) ||
+        (count > 0 && !sink(reinterpret_cast<const uint8_t*>(flat->ids.data()), count * sizeof(int64_t)))) {
+        return -3;
+    }
+    
+    // Rows are padded in memory, so they are packed into chunks on the way out
+    const size_t row_bytes = dimension * sizeof(float);
+    const size_t rows_per_chunk = std::max<size_t>(1, (1 << 20) / row_bytes);
+    std::vector<uint8_t> chunk;
+    chunk.reserve(rows_per_chunk * row_bytes);
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* row = reinterpret_cast<const uint8_t*>(flat->vectors.row(i));
+        chunk.insert(chunk.end(), row, row + row_bytes);
+        if (chunk.size() >= rows_per_chunk * row_bytes || i + 1 == count) {
+            if (!sink(chunk.data(), chunk.size())) {
+                return -3;
+            }
+            chunk.clear();
+        }
+    }
+    return 0;
+}
+
+int FAISSWrapper::deserialize(const ByteSource& source) {
+    int status = 0;
+    ParsedIndex parsed = parse(source, &status);
+    return parsed ? install(std::move(parsed)) : status;
+}
+
+FAISSWrapper::ParsedIndex FAISSWrapper::parse(const ByteSource& source, int* status) {
+    if (status) *status = -2;
+    char magic[sizeof(kFlatMagic)];
+    int32_t dimension = 0;
+    int32_t metric = static_cast<int32_t>(Metric::L2);
+    uint64_t count = 0;
+    bool read = read_exact(source, magic, sizeof(magic));
+    bool v1 = read && std::memcmp(magic, kFlatMagicV1, sizeof(magic)) == 0;
+    if (!read || (!v1 && std::memcmp(magic, kFlatMagic, sizeof(magic)) != 0) ||
+        !read_exact(source, &dimension, sizeof(dimension)) ||
+        (!v1 && !read_exact(source, &metric, sizeof(metric))) || !read_exact(source, &count, sizeof(count))) {
+        std::cerr << "Error deserializing index: not a serialized flat index" << std::endl;
+        return nullptr;
+    }
+    if (dimension != dimension_) {
+        std::cerr << "Error deserializing index: dimension " << dimension << " does not match "
+                  << dimension_ << std::endl;
+        return nullptr;
+    }
+    
+    // Built off to the side; searches keep using the current version until it is installed
+    try {
+        std::shared_ptr<FlatIndex> loaded = std::make_shared<FlatIndex>(dimension_, static_cast<Metric>(metric));
+        if (!matches_metric(loaded.get())) {
+            return nullptr;
+        }
+        loaded->ids.resize(count);
+        if (count > 0 && !read_exact(source, loaded->ids.data(), count * sizeof(int64_t))) {
+            return nullptr;
+        }
+        std::vector<float> row(dimension_);
+        for (uint64_t i = 0; i < count; ++i) {
+            if (!read_exact(source, row.data(), row.size() * sizeof(float))) {
+                return nullptr;
+            }
+            loaded->vectors.append(row.data(), 1);
+        }
+        if (status) *status = 0;
+        return loaded;
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Error deserializing index: out of memory" << std::endl;
+        if (status) *status = -3;
+        return nullptr;
+    }
 }
 
-void FAISSWrapper::train(const float* training_data, size_t count) {
+int FAISSWrapper::install(ParsedIndex index) {
+    if (!index) {
+        return -1;
+    }
+    
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    publish(std::move(index));
+    return 0;
+}
+
+int FAISSWrapper::load_file(const std::string& path, bool) {
+    // Always read into memory; the flat layout is scanned in full anyway
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return -2;
+    }
+    
+    int status = deserialize([file](uint8_t* data, size_t size) {
+        return std::fread(data, 1, size, file);
+    });
+    std::fclose(file);
+    return status;
+}
+
+void FAISSWrapper::train(const float*, size_t, const TrainOptions&) {
     // Stub training always succeeds
     trained_ = true;
 }
@@ -99,17 +649,44 @@ bool FAISSWrapper::is_trained() const {
     return trained_;
 }
 
+bool FAISSWrapper::requires_training() const {
+    return false;
+}
+
 size_t FAISSWrapper::get_ntotal() const {
-    FakeIndex* fake_idx = static_cast<FakeIndex*>(index_.get());
-    return fake_idx ? fake_idx->ids.size() : 0;
+    auto current = acquire();
+    std::shared_lock<std::shared_mutex> lock(current->mutex);
+    const FlatIndex* flat = static_cast<const FlatIndex*>(current->index.get());
+    return flat ? flat->ids.size() : 0;
 }
 
 int FAISSWrapper::get_dimension() const {
     return dimension_;
 }
 
-faiss::Index* FAISSWrapper::create_index(const std::string& index_type, int dimension) {
-    return new FakeIndex(dimension);
+faiss::Index* FAISSWrapper::create_index(size_t, size_t) {
+    return new FlatIndex(dimension_, options_.metric);
+}
+
+bool FAISSWrapper::matches_metric(const faiss::Index* index) const {
+    if (static_cast<const FlatIndex*>(index)->metric == options_.metric) {
+        return true;
+    }
+    std::cerr << "Error loading index: stored index uses a different distance metric" << std::endl;
+    return false;
+}
+
+void FAISSWrapper::train_locked(const float*, size_t, const TrainOptions&) {
+    // Nothing to train in the stub
+}
+
+bool FAISSWrapper::fit_coarse_quantizer(faiss::Index*, const float*, size_t, const TrainOptions&) {
+    return false;
+}
+
+void FAISSWrapper::set_dataset_size_hint(size_t rows) {
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    dataset_size_hint_ = rows;
 }
 
 void FAISSWrapper::setup_gpu_resources() {
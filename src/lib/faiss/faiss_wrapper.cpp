@@ -1,23 +1,60 @@
 #include "faiss_wrapper.h"
 #include <faiss/IndexFlat.h>
+#include <faiss/IndexFlatCodes.h>
 #include <faiss/IndexIVFFlat.h>
 #include <faiss/IndexHNSW.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexPreTransform.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/index_factory.h>
 #include <faiss/index_io.h>
+#include <faiss/impl/io.h>
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/invlists/DirectMap.h>
 #include <faiss/AutoTune.h>
+#include <faiss/Clustering.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+#include "core/metrics.h"
+#include "core/scratch_arena.h"
+#include "simd_kernels.h"
 
 #ifdef WITH_GPU
-#include <faiss/gpu/GpuIndexFlat.h>
-#include <faiss/gpu/GpuIndexIVFFlat.h>
-#include <faiss/gpu/StandardGpuResources.h>
-#include <faiss/gpu/utils/DeviceUtils.h>
+#include "gpu_backend.h"
 #endif
 
 FAISSWrapper::FAISSWrapper(int dimension, const std::string& index_type, 
                            bool use_gpu, int gpu_device)
-    : dimension_(dimension), use_gpu_(use_gpu), gpu_device_(gpu_device), 
-      index_type_(index_type), trained_(false) {
+    : FAISSWrapper(dimension, [&index_type] {
+          IndexOptions options;
+          options.index_type = index_type;
+          return options;
+      }(), use_gpu, gpu_device) {
+}
+
+FAISSWrapper::FAISSWrapper(int dimension, const IndexOptions& options,
+                           bool use_gpu, int gpu_device)
+    : FAISSWrapper(dimension, options, [use_gpu, gpu_device] {
+          GpuOptions gpu;
+          gpu.enabled = use_gpu;
+          gpu.devices = {gpu_device};
+          return gpu;
+      }()) {
+}
+
+FAISSWrapper::FAISSWrapper(int dimension, const IndexOptions& options, const GpuOptions& gpu)
+    : next_version_(0), dimension_(dimension), use_gpu_(gpu.enabled && !gpu.devices.empty()),
+      gpu_device_(gpu.devices.empty() ? 0 : gpu.devices[0]), gpu_options_(gpu),
+      index_type_(options.index_type), options_(options), dataset_size_hint_(0), trained_(false),
+      compaction_threshold_(0.2), compaction_pending_(false), stopping_(false) {
     
 #ifdef WITH_GPU
     if (use_gpu_) {
@@ -30,85 +67,352 @@ FAISSWrapper::FAISSWrapper(int dimension, const std::string& index_type,
     }
 #endif
     
-    index_.reset(create_index(index_type_, dimension_));
+    publish(create_index(options_.expected_size, 0));
 }
 
-FAISSWrapper::~FAISSWrapper() = default;
+FAISSWrapper::~FAISSWrapper() {
+    {
+        std::lock_guard<std::mutex> lock(compactor_mutex_);
+        stopping_ = true;
+    }
+    compactor_wake_.notify_all();
+    if (compactor_.joinable()) {
+        compactor_.join();
+    }
+}
 
-faiss::Index* FAISSWrapper::create_index(const std::string& index_type, int dimension) {
-    if (index_type == "Flat") {
+void FAISSWrapper::publish(faiss::Index* index) {
+    publish(std::shared_ptr<faiss::Index>(index));
+}
+
+void FAISSWrapper::publish(std::shared_ptr<faiss::Index> index) {
+    auto next = std::make_shared<IndexVersion>();
 #ifdef WITH_GPU
-        if (use_gpu_) {
-            return new faiss::gpu::GpuIndexFlat(&gpu_resources_, dimension, faiss::METRIC_L2);
-        }
+    next->on_gpu = use_gpu_ && GpuBackend::uses_gpu(index.get());
 #endif
-        return new faiss::IndexFlatL2(dimension);
+    next->index = std::move(index);
+    next->version = ++next_version_;
+    std::atomic_store(&index_, next);
+    if (auto cache = get_result_cache()) {
+        cache->invalidate();
     }
-    else if (index_type == "IVFFlat") {
-        // TODO: Make ncentroids adaptive based on dataset size
-        // TODO: Add support for different distance metrics (cosine, inner product)
-        int ncentroids = std::min(4 * (int)sqrt(100000), 65536);
-        auto quantizer = new faiss::IndexFlatL2(dimension);
-        
-#ifdef WITH_GPU
-        if (use_gpu_) {
-            faiss::gpu::GpuIndexIVFFlat* gpu_index = 
-                new faiss::gpu::GpuIndexIVFFlat(&gpu_resources_, dimension, ncentroids, faiss::METRIC_L2);
-            return gpu_index;
-        }
-#endif
-        return new faiss::IndexIVFFlat(quantizer, dimension, ncentroids);
+}
+
+uint64_t FAISSWrapper::get_index_version() const {
+    auto current = acquire();
+    return current ? current->version : 0;
+}
+
+void FAISSWrapper::set_result_cache(std::shared_ptr<ResultCache> cache) {
+    std::atomic_store(&results_, std::move(cache));
+}
+
+namespace {
+
+// Finds the HNSW graph beneath IDMap / refine / pre-transform wrappers
+faiss::IndexHNSW* find_hnsw(faiss::Index* index) {
+    if (auto hnsw = dynamic_cast<faiss::IndexHNSW*>(index)) {
+        return hnsw;
+    }
+    if (auto id_map = dynamic_cast<faiss::IndexIDMap*>(index)) {
+        return find_hnsw(id_map->index);
+    }
+    if (auto refine = dynamic_cast<faiss::IndexRefine*>(index)) {
+        return find_hnsw(refine->base_index);
+    }
+    if (auto transform = dynamic_cast<faiss::IndexPreTransform*>(index)) {
+        return find_hnsw(transform->index);
+    }
+    return nullptr;
+}
+
+// Finds the IVF index beneath the same wrappers
+const faiss::IndexIVF* find_ivf(const faiss::Index* index) {
+    if (auto ivf = dynamic_cast<const faiss::IndexIVF*>(index)) {
+        return ivf;
+    }
+    if (auto id_map = dynamic_cast<const faiss::IndexIDMap*>(index)) {
+        return find_ivf(id_map->index);
+    }
+    if (auto refine = dynamic_cast<const faiss::IndexRefine*>(index)) {
+        return find_ivf(refine->base_index);
+    }
+    if (auto transform = dynamic_cast<const faiss::IndexPreTransform*>(index)) {
+        return find_ivf(transform->index);
+    }
+    return nullptr;
+}
+
+faiss::IndexIVF* find_ivf(faiss::Index* index) {
+    return const_cast<faiss::IndexIVF*>(find_ivf(static_cast<const faiss::Index*>(index)));
+}
+
+faiss::MetricType faiss_metric(Metric metric) {
+    return metric == Metric::L2 ? faiss::METRIC_L2 : faiss::METRIC_INNER_PRODUCT;
+}
+
+// Cosine indexes hold unit vectors, so vectors and queries are normalized on
+// the way in, in one pass into scratch; other metrics use them as they are
+const float* unit_rows(Metric metric, const float* vectors, size_t count, int dimension,
+                       ScratchArena::Scope& scratch) {
+    if (metric != Metric::Cosine) {
+        return vectors;
+    }
+    float* unit = scratch.allocate<float>(count * dimension);
+    simd::normalize(vectors, unit, count, dimension);
+    return unit;
+}
+
+// FAISS returns similarities for inner-product indexes; they become the
+// distances pgvector's <#> and <=> report, so every metric ranks ascending
+void to_distances(Metric metric, float* distances, const int64_t* labels, size_t count) {
+    if (metric == Metric::L2) {
+        return;
+    }
+    const float offset = metric == Metric::Cosine ? 1.0f : 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        distances[i] = labels[i] >= 0 ? offset - distances[i] : std::numeric_limits<float>::max();
+    }
+}
+
+} // namespace
+
+faiss::Index* FAISSWrapper::create_index(size_t dataset_size, size_t training_size) {
+    std::string factory = build_index_factory(options_, dimension_, dataset_size, training_size);
+    
+    std::unique_ptr<faiss::Index> index;
+    try {
+        index.reset(faiss::index_factory(dimension_, factory.c_str(), faiss_metric(options_.metric)));
+    } catch (const std::exception& e) {
+        throw std::invalid_argument("Invalid index factory string '" + factory + "': " + e.what());
     }
-    else if (index_type == "HNSW") {
-        // TODO: Make M and efConstruction configurable parameters
-        // TODO: Add support for different distance metrics
-        int M = 16;
-        auto index = new faiss::IndexHNSWFlat(dimension, M);
-        index->hnsw.efConstruction = 40;
-        return index;
+    
+    if (auto hnsw = find_hnsw(index.get())) {
+        hnsw->hnsw.efConstruction = options_.ef_construction;
+    }
+    if (options_.fast_remove && !use_gpu_) {
+        if (auto ivf = find_ivf(index.get())) {
+            ivf->set_direct_map_type(faiss::DirectMap::Hashtable);
+        }
     }
-    // TODO: Add support for more index types:
-    // - IndexIVFPQ for memory-efficient vector quantization
-    // - IndexLSH for locality-sensitive hashing
-    // - IndexPQ for product quantization
-    // - IndexScalarQuantizer for scalar quantization
     
-    return new faiss::IndexFlatL2(dimension);
+    return to_device(index.release());
 }
 
 #ifdef WITH_GPU
 void FAISSWrapper::setup_gpu_resources() {
-    if (faiss::gpu::getNumDevices() <= gpu_device_) {
-        std::cerr << "GPU device " << gpu_device_ << " not available" << std::endl;
+    // TODO: Implement GPU memory profiling and optimization
+    try {
+        gpu_ = gpu_options_.backend ? gpu_options_.backend : std::make_shared<GpuBackend>(gpu_options_);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "; using CPU instead" << std::endl;
         use_gpu_ = false;
-        return;
     }
-    
-    // TODO: Add configurable GPU memory limits and temp memory settings
-    // TODO: Add support for multi-GPU resource management
-    // TODO: Implement GPU memory profiling and optimization
-    gpu_resources_ = std::make_unique<faiss::gpu::StandardGpuResources>();
+}
+
+faiss::Index* FAISSWrapper::to_device(faiss::Index* index) {
+    std::unique_ptr<faiss::Index> cpu(index);
+    if (!use_gpu_) {
+        return cpu.release();
+    }
+    faiss::Index* placed;
+    GpuStats footprint;
+    {
+        std::lock_guard<std::mutex> device(gpu_->device_mutex());
+        placed = gpu_->to_gpu(cpu.get(), footprint);
+    }
+    {
+        std::lock_guard<std::mutex> lock(placement_mutex_);
+        placement_ = std::move(footprint);
+    }
+    return placed ? placed : cpu.release();
+}
+
+std::unique_lock<std::mutex> FAISSWrapper::device_lock(const IndexVersion& version) const {
+    return version.on_gpu ? std::unique_lock<std::mutex>(gpu_->device_mutex()) : std::unique_lock<std::mutex>();
+}
+
+// The backend may be shared with other wrappers, so it reports only the
+// device-wide figures; placement and footprint are this wrapper's own
+GpuStats FAISSWrapper::get_gpu_stats() const {
+    if (!gpu_) {
+        return GpuStats();
+    }
+    GpuStats stats = gpu_->stats();
+    std::lock_guard<std::mutex> lock(placement_mutex_);
+    stats.placement = placement_.placement;
+    for (size_t i = 0; i < stats.devices.size() && i < placement_.devices.size(); ++i) {
+        stats.devices[i].index_bytes = placement_.devices[i].index_bytes;
+    }
+    return stats;
 }
 #else
 void FAISSWrapper::setup_gpu_resources() {
     // No-op for CPU-only builds
 }
+
+faiss::Index* FAISSWrapper::to_device(faiss::Index* index) {
+    return index;
+}
+
+std::unique_lock<std::mutex> FAISSWrapper::device_lock(const IndexVersion&) const {
+    return std::unique_lock<std::mutex>();
+}
+
+GpuStats FAISSWrapper::get_gpu_stats() const {
+    return GpuStats();
+}
 #endif
 
+namespace {
+
+// Host bytes of the payload under `index`: codes, stored ids, coarse
+// quantizers and HNSW links. Allocator slack is not counted.
+size_t estimate_bytes(const faiss::Index* index) {
+    if (auto id_map = dynamic_cast<const faiss::IndexIDMap*>(index)) {
+        return id_map->id_map.size() * sizeof(faiss::idx_t) + estimate_bytes(id_map->index);
+    }
+    if (auto refine = dynamic_cast<const faiss::IndexRefine*>(index)) {
+        return estimate_bytes(refine->base_index) + estimate_bytes(refine->refine_index);
+    }
+    if (auto transform = dynamic_cast<const faiss::IndexPreTransform*>(index)) {
+        return estimate_bytes(transform->index);
+    }
+    if (auto ivf = dynamic_cast<const faiss::IndexIVF*>(index)) {
+        return static_cast<size_t>(ivf->ntotal) * (ivf->code_size + sizeof(faiss::idx_t)) +
+               estimate_bytes(ivf->quantizer);
+    }
+    if (auto hnsw = dynamic_cast<const faiss::IndexHNSW*>(index)) {
+        return hnsw->hnsw.neighbors.size() * sizeof(faiss::HNSW::storage_idx_t) +
+               hnsw->hnsw.offsets.size() * sizeof(size_t) + estimate_bytes(hnsw->storage);
+    }
+    if (auto flat = dynamic_cast<const faiss::IndexFlatCodes*>(index)) {
+        return flat->codes.size();
+    }
+    return static_cast<size_t>(index->ntotal) * index->d * sizeof(float);
+}
+
+// float32 bytes widened per add_locked call when adding reduced-precision rows
+const size_t kWidenBlockBytes = 1 << 20;
+
+} // namespace
+
+IndexStats FAISSWrapper::get_index_stats() const {
+    IndexStats stats;
+    auto current = acquire();
+    if (!current) {
+        return stats;
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(current->mutex);
+    const faiss::Index* index = current->index.get();
+    stats.ntotal = index->ntotal;
+    stats.tombstones = current->tombstone_count;
+    // Device copies keep their payload on the GPU; get_gpu_stats covers them
+    if (current->on_gpu) {
+        return stats;
+    }
+    stats.memory_bytes = estimate_bytes(index);
+    
+    const faiss::IndexIVF* ivf = find_ivf(index);
+    if (ivf && ivf->invlists) {
+        stats.nlist = ivf->nlist;
+        stats.list_min = std::numeric_limits<size_t>::max();
+        double squares = 0.0;
+        size_t total = 0;
+        for (size_t list = 0; list < ivf->nlist; ++list) {
+            size_t size = ivf->invlists->list_size(list);
+            stats.list_min = std::min(stats.list_min, size);
+            stats.list_max = std::max(stats.list_max, size);
+            squares += static_cast<double>(size) * size;
+            total += size;
+        }
+        if (ivf->nlist == 0) stats.list_min = 0;
+        stats.list_imbalance = total > 0 ? ivf->nlist * squares / (static_cast<double>(total) * total) : 0.0;
+    }
+    return stats;
+}
+
 int FAISSWrapper::add_vectors(const float* vectors, const int64_t* ids, size_t count) {
-    if (!index_ || !vectors || count == 0) {
+    if (!vectors || count == 0) {
+        return -1;
+    }
+    
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    return add_locked(vectors, ids, count);
+}
+
+int FAISSWrapper::add_vectors(const void* vectors, simd::ElementType type, const int64_t* ids, size_t count,
+                              float scale) {
+    if (type == simd::ElementType::Float32) {
+        return add_vectors(static_cast<const float*>(vectors), ids, count);
+    }
+    if (!vectors || count == 0 || !(scale > 0.0f)) {
+        return -1;
+    }
+    
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    const size_t dimension = static_cast<size_t>(dimension_);
+    const size_t row_bytes = simd::element_size(type) * dimension;
+    const size_t block = requires_training() ? count
+                                             : std::max<size_t>(1, kWidenBlockBytes / (dimension * sizeof(float)));
+    const char* rows = static_cast<const char*>(vectors);
+    
+    for (size_t begin = 0; begin < count; begin += block) {
+        const size_t n = std::min(block, count - begin);
+        int status;
+        try {
+            ScratchArena::Scope scratch;
+            float* widened = scratch.allocate<float>(n * dimension);
+            simd::to_float(type, rows + begin * row_bytes, widened, n * dimension, scale);
+            status = add_locked(widened, ids ? ids + begin : nullptr, n);
+        } catch (const std::bad_alloc&) {
+            std::cerr << "Error adding vectors: out of memory" << std::endl;
+            return -2;
+        }
+        if (status != 0) {
+            return status;
+        }
+    }
+    return 0;
+}
+
+int FAISSWrapper::add_locked(const float* vectors, const int64_t* ids, size_t count) {
+    // Declared first, so cached results are retired after the version lock is released
+    const ResultCache::WriteScope write(get_result_cache());
+    if (!acquire()) {
         return -1;
     }
     
     try {
-        if (!is_trained() && index_type_ == "IVFFlat") {
-            train(vectors, count);
+        ScratchArena::Scope scratch;
+        vectors = unit_rows(options_.metric, vectors, count, dimension_, scratch);
+        
+        // Untrained indexes are trained on the first batch they are given
+        if (!acquire()->index->is_trained) {
+            train_locked(vectors, count);
         }
         
+        auto current = acquire();
+        auto device = device_lock(*current);
+        std::unique_lock<std::shared_mutex> lock(current->mutex);
+        faiss::Index* index = current->index.get();
+        
+        const faiss::idx_t first = index->ntotal;
         if (ids) {
-            index_->add_with_ids(count, vectors, ids);
+            index->add_with_ids(count, vectors, ids);
         } else {
-            index_->add(count, vectors);
+            index->add(count, vectors);
+        }
+        
+        // Once tombstones are in use, new positions must be findable for later
+        // deletes and covered by the bitmap that searches and compaction read
+        if (!current->positions.empty() || current->tombstone_count > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                int64_t id = ids ? ids[i] : first + static_cast<int64_t>(i);
+                current->positions[id] = first + static_cast<int64_t>(i);
+            }
+            current->tombstones.resize((static_cast<uint64_t>(index->ntotal) + 63) / 64, 0);
         }
         
         return 0;
@@ -118,85 +422,817 @@ int FAISSWrapper::add_vectors(const float* vectors, const int64_t* ids, size_t c
     }
 }
 
-std::vector<SearchResult> FAISSWrapper::search(const float* query, size_t k) {
-    std::vector<SearchResult> results;
+int FAISSWrapper::remove_vectors(const int64_t* ids, size_t count, size_t* removed) {
+    if (removed) *removed = 0;
+    if (!ids || count == 0) {
+        return -1;
+    }
     
-    if (!index_ || !query || k == 0) {
-        return results;
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    return remove_locked(ids, count, removed);
+}
+
+int FAISSWrapper::upsert_vectors(const float* vectors, const int64_t* ids, size_t count) {
+    if (!vectors || !ids || count == 0) {
+        return -1;
+    }
+    
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    int status = remove_locked(ids, count, nullptr);
+    return status == 0 ? add_locked(vectors, ids, count) : status;
+}
+
+int FAISSWrapper::remove_locked(const int64_t* ids, size_t count, size_t* removed) {
+    const ResultCache::WriteScope write(get_result_cache());
+    auto current = acquire();
+    if (!current) {
+        return -1;
     }
     
+    size_t deleted = 0;
     try {
-        std::vector<float> distances(k);
-        std::vector<faiss::idx_t> labels(k);
-        
-        // TODO: Add batch search support for multiple queries
-        // TODO: Implement search parameter tuning (nprobe for IVF indices)
-        // TODO: Add support for range search and filtered search
-        // TODO: Implement search result filtering and post-processing
-        index_->search(1, query, k, distances.data(), labels.data());
-        
-        results.reserve(k);
-        for (size_t i = 0; i < k; ++i) {
-            if (labels[i] >= 0) {
-                results.push_back({labels[i], distances[i]});
+        auto device = device_lock(*current);
+        std::unique_lock<std::shared_mutex> lock(current->mutex);
+        auto id_map = dynamic_cast<faiss::IndexIDMap*>(current->index.get());
+        auto ivf = find_ivf(current->index.get());
+        if (!id_map && !ivf) {
+            // Without stored ids remove_ids takes row positions and renumbers
+            // the rows after them
+            std::cerr << "Error removing vectors: index does not store ids" << std::endl;
+            return -2;
+        }
+        
+        bool tombstone = current->tombstone_count > 0 || !current->positions.empty();
+        if (!tombstone) {
+            try {
+                // IVF with a hash-table direct map only accepts an id array, and
+                // then removes in O(batch); otherwise FAISS scans the lists
+                if (ivf && ivf->direct_map.type == faiss::DirectMap::Hashtable) {
+                    deleted = current->index->remove_ids(faiss::IDSelectorArray(count, ids));
+                } else {
+                    deleted = current->index->remove_ids(faiss::IDSelectorBatch(count, ids));
+                }
+            } catch (const std::exception&) {
+                // HNSW graphs cannot drop nodes; IDMap indexes fall back to tombstones
+                if (!id_map) {
+                    throw;
+                }
+                tombstone = true;
             }
         }
         
+        if (tombstone) {
+            uint64_t ntotal = static_cast<uint64_t>(id_map->ntotal);
+            if (current->positions.empty() && current->tombstone_count == 0) {
+                current->positions.reserve(id_map->id_map.size());
+                for (size_t pos = 0; pos < id_map->id_map.size(); ++pos) {
+                    current->positions[id_map->id_map[pos]] = static_cast<int64_t>(pos);
+                }
+            }
+            current->tombstones.resize((ntotal + 63) / 64, 0);
+            
+            for (size_t i = 0; i < count; ++i) {
+                auto it = current->positions.find(ids[i]);
+                if (it == current->positions.end()) continue;
+                uint64_t pos = static_cast<uint64_t>(it->second);
+                current->tombstones[pos >> 6] |= uint64_t(1) << (pos & 63);
+                current->positions.erase(it);
+                ++deleted;
+            }
+            current->tombstone_count += deleted;
+        }
     } catch (const std::exception& e) {
-        std::cerr << "Error during search: " << e.what() << std::endl;
+        std::cerr << "Error removing vectors: " << e.what() << std::endl;
+        return -2;
+    }
+    
+    if (removed) *removed = deleted;
+    schedule_compaction();
+    return 0;
+}
+
+size_t FAISSWrapper::get_tombstone_count() const {
+    auto current = acquire();
+    if (!current) {
+        return 0;
+    }
+    std::shared_lock<std::shared_mutex> lock(current->mutex);
+    return current->tombstone_count;
+}
+
+void FAISSWrapper::set_compaction_threshold(double ratio) {
+    compaction_threshold_ = ratio;
+}
+
+void FAISSWrapper::schedule_compaction() {
+    double threshold = compaction_threshold_;
+    auto current = acquire();
+    if (threshold <= 0.0 || !current) {
+        return;
+    }
+    
+    {
+        std::shared_lock<std::shared_mutex> lock(current->mutex);
+        if (current->tombstone_count == 0 ||
+            current->tombstone_count < threshold * static_cast<double>(current->index->ntotal)) {
+            return;
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(compactor_mutex_);
+    if (!compactor_.joinable()) {
+        compactor_ = std::thread(&FAISSWrapper::run_compactor, this);
+    }
+    compaction_pending_ = true;
+    compactor_wake_.notify_one();
+}
+
+void FAISSWrapper::run_compactor() {
+    std::unique_lock<std::mutex> lock(compactor_mutex_);
+    for (;;) {
+        compactor_wake_.wait(lock, [this] { return stopping_ || compaction_pending_; });
+        if (stopping_) {
+            return;
+        }
+        compaction_pending_ = false;
+        
+        lock.unlock();
+        compact();
+        lock.lock();
+    }
+}
+
+int FAISSWrapper::compact() {
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    return compact_locked();
+}
+
+int FAISSWrapper::compact_locked() {
+    // Vectors are rebuilt in chunks so no full copy of the dataset is held
+    const size_t kChunk = 65536;
+    // Training sample per coarse centroid and overall, as in the training stage
+    const size_t kSamplesPerCentroid = 256;
+    const size_t kMinTrainingSamples = 10000;
+    
+    auto current = acquire();
+    if (!current) {
+        return -1;
+    }
+    
+    try {
+        // Writers are excluded by write_mutex_, so the counts cannot change
+        // under us and the new index is created before any lock is taken:
+        // placing it on a GPU takes the device mutex, which searches acquire
+        // ahead of the version mutex
+        if (current->tombstone_count == 0) {
+            return 0;
+        }
+        auto id_map = static_cast<faiss::IndexIDMap*>(current->index.get());   // tombstones exist only on IDMap indexes
+        const size_t ntotal = static_cast<size_t>(id_map->ntotal);
+        const size_t live = ntotal - current->tombstone_count;
+        std::unique_ptr<faiss::Index> rebuilt(create_index(live, live));
+        
+        // Only searches share the old version; reconstruct needs the device too
+        auto device = device_lock(*current);
+        std::shared_lock<std::shared_mutex> lock(current->mutex);
+        
+        // Positions past the bitmap were added after the last delete and are live
+        auto deleted = [&current](size_t pos) {
+            return (pos >> 6) < current->tombstones.size() && ((current->tombstones[pos >> 6] >> (pos & 63)) & 1);
+        };
+        std::vector<float> vectors;
+        std::vector<faiss::idx_t> ids;
+        
+        if (!rebuilt->is_trained && live > 0) {
+            // Uniform reservoir of live positions, sized to the new nlist the
+            // way the training stage sizes its table samples
+            auto ivf = find_ivf(rebuilt.get());
+            size_t rows = std::max<size_t>((ivf ? ivf->nlist : 1) * kSamplesPerCentroid, kMinTrainingSamples);
+            rows = std::min(rows, live);
+            std::vector<size_t> sample;
+            sample.reserve(rows);
+            std::mt19937_64 random(42);
+            size_t seen = 0;
+            for (size_t pos = 0; pos < ntotal; ++pos) {
+                if (deleted(pos)) continue;
+                if (sample.size() < rows) {
+                    sample.push_back(pos);
+                } else {
+                    size_t slot = std::uniform_int_distribution<size_t>(0, seen)(random);
+                    if (slot < rows) sample[slot] = pos;
+                }
+                ++seen;
+            }
+            std::sort(sample.begin(), sample.end());
+            vectors.resize(sample.size() * dimension_);
+            for (size_t i = 0; i < sample.size(); ++i) {
+                id_map->index->reconstruct(static_cast<faiss::idx_t>(sample[i]), vectors.data() + i * dimension_);
+            }
+            rebuilt->train(sample.size(), vectors.data());
+            vectors.clear();
+            vectors.shrink_to_fit();
+        }
+        vectors.reserve(std::min(live, kChunk) * dimension_);
+        ids.reserve(std::min(live, kChunk));
+        
+        auto flush = [&] {
+            if (ids.empty()) return;
+            rebuilt->add_with_ids(ids.size(), vectors.data(), ids.data());
+            vectors.clear();
+            ids.clear();
+        };
+        
+        for (size_t pos = 0; pos < ntotal; ++pos) {
+            if (deleted(pos)) continue;
+            vectors.resize(vectors.size() + dimension_);
+            id_map->index->reconstruct(static_cast<faiss::idx_t>(pos), vectors.data() + vectors.size() - dimension_);
+            ids.push_back(id_map->id_map[pos]);
+            if (ids.size() == kChunk) flush();
+        }
+        flush();
+        
+        lock.unlock();
+        if (device) device.unlock();
+        publish(rebuilt.release());
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error compacting index: " << e.what() << std::endl;
+        return -2;
+    }
+}
+
+namespace {
+
+// Lets FAISS consult an IdFilter while scanning, so filtered-out vectors are
+// skipped before they compete for the top k
+class IdFilterSelector : public faiss::IDSelector {
+public:
+    explicit IdFilterSelector(const IdFilter& filter) : filter_(filter) {}
+    bool is_member(faiss::idx_t id) const override { return filter_.contains(id); }
+
+private:
+    const IdFilter& filter_;
+};
+
+// Search-time view of an IDMap index with tombstones, applied to the index
+// it wraps: marked positions are skipped and the caller's filter is checked
+// against the external id stored for each position
+class LiveSelector : public faiss::IDSelector {
+public:
+    LiveSelector(const IndexVersion& version, const std::vector<faiss::idx_t>& id_map, const IdFilter* filter)
+        : tombstones_(version.tombstones), id_map_(id_map), filter_(filter) {}
+    
+    bool is_member(faiss::idx_t id) const override {
+        uint64_t pos = static_cast<uint64_t>(id);
+        if ((pos >> 6) < tombstones_.size() && ((tombstones_[pos >> 6] >> (pos & 63)) & 1)) {
+            return false;
+        }
+        return !filter_ || filter_->contains(id_map_[pos]);
+    }
+
+private:
+    const std::vector<uint64_t>& tombstones_;
+    const std::vector<faiss::idx_t>& id_map_;
+    const IdFilter* filter_;
+};
+
+// Owns the faiss::SearchParameters for one call, nested to mirror the
+// index's wrappers (refine -> pre-transform -> IDMap -> IVF -> quantizer).
+class SearchParameterChain {
+public:
+    // sel, if given, replaces the selector built from options.filter
+    faiss::SearchParameters* build(const faiss::Index* index, const SearchOptions& options,
+                                   faiss::IDSelector* sel = nullptr) {
+        if (!sel && options.filter) {
+            sel = own_selector(new IdFilterSelector(*options.filter));
+        }
+        faiss::SearchParameters* params = build_level(index, options, sel);
+        if (!params && sel) {
+            // Flat indexes have no parameter type of their own
+            params = own(new faiss::SearchParameters());
+            params->sel = sel;
+        }
+        return params;
+    }
+
+private:
+    std::vector<std::unique_ptr<faiss::SearchParameters>> owned_;
+    std::vector<std::unique_ptr<faiss::IDSelector>> selectors_;
+
+    // sel applies to the vectors searched, never to the coarse quantizer's centroids
+    faiss::SearchParameters* build_level(const faiss::Index* index, const SearchOptions& options,
+                                         faiss::IDSelector* sel) {
+        if (auto refine = dynamic_cast<const faiss::IndexRefine*>(index)) {
+            auto params = own(new faiss::IndexRefineSearchParameters());
+            params->k_factor = options.k_factor > 0.0f ? options.k_factor : refine->k_factor;
+            params->sel = sel;
+            params->base_index_params = build_level(refine->base_index, options, sel);
+            return params;
+        }
+        if (auto transform = dynamic_cast<const faiss::IndexPreTransform*>(index)) {
+            auto params = own(new faiss::SearchParametersPreTransform());
+            params->sel = sel;
+            params->index_params = build_level(transform->index, options, sel);
+            return params;
+        }
+        if (auto id_map = dynamic_cast<const faiss::IndexIDMap*>(index)) {
+            // IDMap forwards the parameters to the index it wraps and
+            // translates the outermost sel from its external ids to inner
+            // positions; nested levels get a pre-translated selector
+            faiss::IDSelector* inner = nullptr;
+            if (sel) {
+                inner = own_selector(new faiss::IDSelectorTranslated(id_map->id_map, sel));
+            }
+            faiss::SearchParameters* params = build_level(id_map->index, options, inner);
+            if (!params && sel) {
+                params = own(new faiss::SearchParameters());
+            }
+            if (params) {
+                params->sel = sel;
+            }
+            return params;
+        }
+        if (auto ivf = dynamic_cast<const faiss::IndexIVF*>(index)) {
+            auto params = own(new faiss::SearchParametersIVF());
+            params->nprobe = options.nprobe > 0 ? options.nprobe : ivf->nprobe;
+            params->sel = sel;
+            params->quantizer_params = build_level(ivf->quantizer, options, nullptr);
+            return params;
+        }
+        if (auto hnsw = dynamic_cast<const faiss::IndexHNSW*>(index)) {
+            auto params = own(new faiss::SearchParametersHNSW());
+            params->efSearch = options.ef_search > 0 ? options.ef_search : hnsw->hnsw.efSearch;
+            params->sel = sel;
+            return params;
+        }
+        return nullptr;
+    }
+
+    template <typename T>
+    T* own(T* params) {
+        owned_.emplace_back(params);
+        return params;
+    }
+
+    faiss::IDSelector* own_selector(faiss::IDSelector* sel) {
+        selectors_.emplace_back(sel);
+        return sel;
+    }
+};
+
+// Caller holds version.mutex
+void search_version(const IndexVersion& version, const float* queries, size_t nq, size_t k,
+                    float* distances, int64_t* labels, const SearchOptions& options) {
+    SearchParameterChain chain;
+    if (version.tombstone_count == 0) {
+        faiss::SearchParameters* params = options.is_default() ? nullptr : chain.build(version.index.get(), options);
+        version.index->search(nq, queries, k, distances, labels, params);
+        return;
+    }
+    
+    // Tombstones are positions, so the IDMap is bypassed and labels translated here
+    auto id_map = static_cast<const faiss::IndexIDMap*>(version.index.get());
+    LiveSelector live(version, id_map->id_map, options.filter);
+    faiss::SearchParameters* params = chain.build(id_map->index, options, &live);
+    id_map->index->search(nq, queries, k, distances, labels, params);
+    for (size_t i = 0; i < nq * k; ++i) {
+        if (labels[i] >= 0) {
+            labels[i] = id_map->id_map[labels[i]];
+        }
+    }
+}
+
+// FAISS keeps inner-product hits whose similarity exceeds the radius
+float faiss_radius(Metric metric, float radius) {
+    switch (metric) {
+    case Metric::InnerProduct: return -radius;
+    case Metric::Cosine: return 1.0f - radius;
+    default: return radius;
+    }
+}
+
+// Caller holds version.mutex
+void range_search_version(const IndexVersion& version, const float* queries, size_t nq, float radius,
+                          faiss::RangeSearchResult& result, const SearchOptions& options) {
+    SearchParameterChain chain;
+    if (version.tombstone_count == 0) {
+        faiss::SearchParameters* params = options.is_default() ? nullptr : chain.build(version.index.get(), options);
+        version.index->range_search(nq, queries, radius, &result, params);
+        return;
+    }
+    
+    auto id_map = static_cast<const faiss::IndexIDMap*>(version.index.get());
+    LiveSelector live(version, id_map->id_map, options.filter);
+    faiss::SearchParameters* params = chain.build(id_map->index, options, &live);
+    id_map->index->range_search(nq, queries, radius, &result, params);
+    for (size_t i = 0; i < result.lims[nq]; ++i) {
+        result.labels[i] = id_map->id_map[result.labels[i]];
+    }
+}
+
+// Opens the inverted lists of a plain IVF index nearest centroid first, `step`
+// lists per call. The version stays pinned, so a reload cannot move the lists
+// between pages; vectors live in one list each, so none comes back twice.
+SearchIterator::Source ivf_list_source(std::shared_ptr<IndexVersion> version, const faiss::IndexIVF* ivf,
+                                       std::vector<float> query, const SearchOptions& options, Metric metric) {
+    struct State {
+        std::shared_ptr<IndexVersion> version;
+        const faiss::IndexIVF* ivf = nullptr;
+        std::vector<float> query;
+        std::vector<faiss::idx_t> lists;
+        std::vector<float> centroid_distances;
+        size_t opened = 0;
+        size_t step = 1;
+        std::unique_ptr<IdFilterSelector> selector;
+        Metric metric = Metric::L2;
+    };
+    auto state = std::make_shared<State>();
+    state->version = std::move(version);
+    state->ivf = ivf;
+    state->query = std::move(query);
+    state->step = static_cast<size_t>(std::max<int>(options.nprobe > 0 ? options.nprobe : ivf->nprobe, 1));
+    state->metric = metric;
+    if (options.filter) {
+        state->selector.reset(new IdFilterSelector(*options.filter));
+    }
+    {
+        std::shared_lock<std::shared_mutex> lock(state->version->mutex);
+        state->lists.resize(ivf->nlist);
+        state->centroid_distances.resize(ivf->nlist);
+        ivf->quantizer->search(1, state->query.data(), ivf->nlist, state->centroid_distances.data(),
+                               state->lists.data());
+    }
+    
+    return [state](size_t, std::vector<SearchResult>& out) {
+        const faiss::IndexIVF* ivf = state->ivf;
+        std::shared_lock<std::shared_mutex> lock(state->version->mutex);
+        const size_t n = std::min(state->step, state->lists.size() - state->opened);
+        const faiss::idx_t* keys = state->lists.data() + state->opened;
+        size_t codes = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (keys[i] >= 0) codes += ivf->invlists->list_size(keys[i]);
+        }
+        
+        // Every code of the opened lists is a candidate
+        if (codes > 0) {
+            try {
+                std::vector<float> distances(codes);
+                std::vector<faiss::idx_t> labels(codes);
+                faiss::SearchParametersIVF params;
+                params.nprobe = n;
+                params.sel = state->selector.get();
+                ivf->search_preassigned(1, state->query.data(), codes, keys,
+                                        state->centroid_distances.data() + state->opened,
+                                        distances.data(), labels.data(), false, &params);
+                to_distances(state->metric, distances.data(), labels.data(), codes);
+                for (size_t i = 0; i < codes && labels[i] >= 0; ++i) {
+                    out.push_back({labels[i], distances[i]});
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error during search: " << e.what() << std::endl;
+                return -2;
+            }
+        }
+        state->opened += n;
+        return state->opened < state->lists.size() ? 1 : 0;
+    };
+}
+
+} // namespace
+
+std::vector<SearchResult> FAISSWrapper::search(const float* query, size_t k, const SearchOptions& options) {
+    std::vector<SearchResult> results;
+    
+    if (!query || k == 0) {
+        return results;
+    }
+    
+    const std::shared_ptr<ResultCache> cache = options.filter ? nullptr : get_result_cache();
+    const uint64_t context = cache ? search_cache_context(this, k, options) : 0;
+    if (cache && cache->lookup(query, dimension_, context, results)) {
+        return results;
+    }
+    // Sampled before searching, so a write landing mid-search keeps the result out
+    const uint64_t epoch = cache ? cache->epoch() : 0;
+    
+    ScratchArena::Scope scratch;
+    float* distances = scratch.allocate<float>(k);
+    faiss::idx_t* labels = scratch.allocate<faiss::idx_t>(k);
+    
+    // TODO: Implement search result filtering and post-processing
+    if (search_batch(query, 1, k, distances, labels, options) != 0) {
+        return results;
+    }
+    
+    results.reserve(k);
+    for (size_t i = 0; i < k; ++i) {
+        if (labels[i] >= 0) {
+            results.push_back({labels[i], distances[i]});
+        }
+    }
+    if (cache) {
+        cache->insert(query, dimension_, context, epoch, results);
     }
     
     return results;
 }
 
-void FAISSWrapper::train(const float* training_data, size_t count) {
-    if (!index_ || !training_data || count == 0) {
+int FAISSWrapper::search_batch(const float* queries, size_t nq, size_t k, 
+                               float* distances, int64_t* labels, const SearchOptions& options) {
+    if (!queries || nq == 0 || k == 0 || !distances || !labels) {
+        return -1;
+    }
+    
+    auto current = acquire();
+    if (!current) {
+        return -1;
+    }
+    
+    try {
+        ScratchArena::Scope scratch;
+        queries = unit_rows(options_.metric, queries, nq, dimension_, scratch);
+        
+        // A single call lets FAISS use its BLAS path and OpenMP over queries
+        if (current->on_gpu) {
+            auto device = device_lock(*current);
+            std::unique_lock<std::shared_mutex> lock(current->mutex);
+            search_version(*current, queries, nq, k, distances, labels, options);
+        } else {
+            std::shared_lock<std::shared_mutex> lock(current->mutex);
+            search_version(*current, queries, nq, k, distances, labels, options);
+        }
+        to_distances(options_.metric, distances, labels, nq * k);
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error during search: " << e.what() << std::endl;
+        return -2;
+    }
+}
+
+int FAISSWrapper::range_search(const float* queries, size_t nq, float radius, RangeResults& results,
+                               const SearchOptions& options) {
+    if (!queries || nq == 0) {
+        return -1;
+    }
+    
+    auto current = acquire();
+    if (!current) {
+        return -1;
+    }
+    
+    try {
+        ScratchArena::Scope scratch;
+        queries = unit_rows(options_.metric, queries, nq, dimension_, scratch);
+        
+        faiss::RangeSearchResult found(nq);
+        if (current->on_gpu) {
+            auto device = device_lock(*current);
+            std::unique_lock<std::shared_mutex> lock(current->mutex);
+            range_search_version(*current, queries, nq, faiss_radius(options_.metric, radius), found, options);
+        } else {
+            std::shared_lock<std::shared_mutex> lock(current->mutex);
+            range_search_version(*current, queries, nq, faiss_radius(options_.metric, radius), found, options);
+        }
+        
+        // FAISS's buffers are taken over as they are
+        results.nq = nq;
+        results.lims.reset(found.lims);
+        results.ids.reset(found.labels);
+        results.distances.reset(found.distances);
+        found.lims = nullptr;
+        found.labels = nullptr;
+        found.distances = nullptr;
+        
+        to_distances(options_.metric, results.distances.get(), results.ids.get(), results.size());
+        results.sort_by_distance();
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error during range search: " << e.what() << std::endl;
+        return -2;
+    }
+}
+
+std::unique_ptr<SearchIterator> FAISSWrapper::search_iterator(const float* query, const SearchOptions& options) {
+    auto current = acquire();
+    if (!query || !current) {
+        return nullptr;
+    }
+    
+    std::vector<float> copy(query, query + dimension_);
+    auto ivf = dynamic_cast<const faiss::IndexIVF*>(current->index.get());
+    if (ivf && !current->on_gpu && current->tombstone_count == 0) {
+        if (options_.metric == Metric::Cosine) {
+            simd::normalize(copy.data(), copy.data(), 1, dimension_);
+        }
+        try {
+            return std::make_unique<SearchIterator>(
+                ivf_list_source(current, ivf, std::move(copy), options, options_.metric));
+        } catch (const std::exception& e) {
+            std::cerr << "Error during search: " << e.what() << std::endl;
+            return nullptr;
+        }
+    }
+    
+    // search_batch normalizes cosine queries itself
+    return std::make_unique<SearchIterator>(SearchIterator::growing_top_k(
+        [this, copy, options](size_t k, float* distances, int64_t* labels) {
+            return search_batch(copy.data(), 1, k, distances, labels, options);
+        }));
+}
+
+void FAISSWrapper::train(const float* training_data, size_t count, const TrainOptions& options) {
+    if (!training_data || count == 0) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    if (!acquire()) {
+        return;
+    }
+    
+    ScratchArena::Scope scratch;
+    train_locked(unit_rows(options_.metric, training_data, count, dimension_, scratch), count, options);
+}
+
+bool FAISSWrapper::fit_coarse_quantizer(faiss::Index* index, const float* training_data, size_t count,
+                                        const TrainOptions& options) {
+    // Under a pre-transform (OPQ) the quantizer lives in the rotated space,
+    // and GPU IVF indexes run their own k-means on the device
+    faiss::Index* level = index;
+    if (auto id_map = dynamic_cast<faiss::IndexIDMap*>(level)) level = id_map->index;
+    if (auto refine = dynamic_cast<faiss::IndexRefine*>(level)) level = refine->base_index;
+    auto ivf = dynamic_cast<faiss::IndexIVF*>(level);
+    if (!ivf || count < ivf->nlist) {
+        return false;
+    }
+    
+    const size_t batches = std::min<size_t>(std::max(options.batches, 1), count / ivf->nlist);
+    // The index's own parameters make inner-product quantizers spherical
+    faiss::ClusteringParameters params = ivf->cp;
+    params.niter = options.iterations > 0 ? options.iterations : (batches > 1 ? 10 : 25);
+    params.seed = static_cast<int>(options.seed);
+    // The caller sized the sample; FAISS would otherwise cut each slice to 256 points per centroid
+    params.max_points_per_centroid = static_cast<int>(std::max<size_t>(256, count / batches / ivf->nlist + 1));
+    faiss::Clustering clustering(dimension_, ivf->nlist, params);
+    
+    std::unique_ptr<faiss::Index> assign;
+    std::unique_lock<std::mutex> device;
+#ifdef WITH_GPU
+    if (options.gpu && gpu_) {
+        device = std::unique_lock<std::mutex>(gpu_->device_mutex());
+        assign.reset(gpu_->clustering_index(dimension_, options_.metric));
+    }
+#endif
+    if (!assign) {
+        assign.reset(new faiss::IndexFlat(dimension_, ivf->metric_type));
+    }
+    
+    // Later slices start from the centroids the earlier ones left behind
+    for (size_t b = 0; b < batches; ++b) {
+        size_t begin = count * b / batches;
+        size_t end = count * (b + 1) / batches;
+        clustering.train(end - begin, training_data + begin * dimension_, *assign);
+    }
+    
+    ivf->quantizer->reset();
+    ivf->quantizer->add(ivf->nlist, clustering.centroids.data());
+    ivf->quantizer->is_trained = true;
+    return true;
+}
+
+void FAISSWrapper::train_locked(const float* training_data, size_t count, const TrainOptions& options) {
+    auto current = acquire();
+    if (current->index->is_trained) {
+        trained_ = true;
         return;
     }
     
+    metrics::Span span(metrics::Op::Train, count);
     try {
-        if (!index_->is_trained) {
-            // TODO: Make training size adaptive based on index type and dataset characteristics
-            // TODO: Implement progressive training for very large datasets
-            // TODO: Add training quality validation and convergence metrics
-            size_t training_size = std::min(count, size_t(100000));
-            index_->train(training_size, training_data);
+        // TODO: Add training quality validation and convergence metrics
+        // FAISS subsamples k-means input itself (256 points per centroid), so
+        // the whole training set is passed through. A quantizer fitted here is
+        // kept by IndexIVF::train, which then only trains the encoder.
+        if (current->index->ntotal == 0) {
+            // nlist and the PQ code size depend on the data, so an empty index
+            // is rebuilt to its final shape off to the side, then published
+            size_t dataset_size = options_.expected_size > 0 ? options_.expected_size : dataset_size_hint_;
+            std::unique_ptr<faiss::Index> index(create_index(dataset_size, count));
+            if (!options.is_default() || use_gpu_) {
+                fit_coarse_quantizer(index.get(), training_data, count, options);
+            }
+            index->train(count, training_data);
+            trained_ = true;
+            publish(index.release());
+            return;
         }
+        
+        auto device = device_lock(*current);
+        std::unique_lock<std::shared_mutex> lock(current->mutex);
+        current->index->train(count, training_data);
         trained_ = true;
     } catch (const std::exception& e) {
         std::cerr << "Error training index: " << e.what() << std::endl;
+        span.status(-2);
     }
 }
 
+void FAISSWrapper::set_dataset_size_hint(size_t rows) {
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    dataset_size_hint_ = rows;
+}
+
 bool FAISSWrapper::is_trained() const {
-    return index_ && (index_->is_trained || trained_);
+    auto current = acquire();
+    if (!current) {
+        return false;
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(current->mutex);
+    return current->index->is_trained || trained_;
+}
+
+bool FAISSWrapper::requires_training() const {
+    auto current = acquire();
+    if (!current) {
+        return false;
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(current->mutex);
+    return !current->index->is_trained;
 }
 
+namespace {
+
+// Adapters between FAISS's I/O interfaces and the streaming callbacks; FAISS
+// throws when a write or read comes up short.
+struct SinkWriter : faiss::IOWriter {
+    explicit SinkWriter(const FAISSWrapper::ByteSink& sink) : sink(sink) {}
+    
+    size_t operator()(const void* ptr, size_t size, size_t nitems) override {
+        size_t bytes = size * nitems;
+        if (bytes == 0) return nitems;
+        return sink(static_cast<const uint8_t*>(ptr), bytes) ? nitems : 0;
+    }
+    
+    const FAISSWrapper::ByteSink& sink;
+};
+
+struct SourceReader : faiss::IOReader {
+    explicit SourceReader(const FAISSWrapper::ByteSource& source) : source(source) {}
+    
+    size_t operator()(void* ptr, size_t size, size_t nitems) override {
+        if (size == 0 || nitems == 0) return nitems;
+        return source(static_cast<uint8_t*>(ptr), size * nitems) / size;
+    }
+    
+    const FAISSWrapper::ByteSource& source;
+};
+
+} // namespace
+
 std::vector<uint8_t> FAISSWrapper::serialize() const {
     std::vector<uint8_t> data;
     
-    if (!index_) {
-        return data;
+    int status = serialize([&data](const uint8_t* bytes, size_t size) {
+        data.insert(data.end(), bytes, bytes + size);
+        return true;
+    });
+    if (status != 0) {
+        data.clear();
+    }
+    
+    return data;
+}
+
+int FAISSWrapper::serialize(const ByteSink& sink) const {
+    auto current = acquire();
+    if (!current) {
+        return -1;
     }
     
     // TODO: Add index metadata serialization (index type, parameters, creation time)
-    // TODO: Implement compression for large index serialization
-    // TODO: Add checksum validation for serialized data integrity
     // TODO: Support different serialization formats (binary, JSON metadata)
     
     try {
-        std::stringstream ss;
-        faiss::write_index(index_.get(), &ss);
-        
-        std::string str = ss.str();
-        data.assign(str.begin(), str.end());
-        
+        // Copying a GPU index back to the host uses the shared device resources
+        auto device = device_lock(*current);
+        std::shared_lock<std::shared_mutex> lock(current->mutex);
+        SinkWriter writer(sink);
+#ifdef WITH_GPU
+        // GPU indexes are stored as their CPU equivalent, shards merged
+        if (current->on_gpu) {
+            std::unique_ptr<faiss::Index> cpu(GpuBackend::to_cpu(current->index.get()));
+            faiss::write_index(cpu.get(), &writer);
+            return 0;
+        }
+#endif
+        faiss::write_index(current->index.get(), &writer);
+        return 0;
     } catch (const std::exception& e) {
         std::cerr << "Error serializing index: " << e.what() << std::endl;
-        data.clear();
+        return -3;
     }
-    
-    return data;
 }
 
 int FAISSWrapper::deserialize(const std::vector<uint8_t>& data) {
@@ -204,32 +1240,99 @@ int FAISSWrapper::deserialize(const std::vector<uint8_t>& data) {
         return -1;
     }
     
+    size_t offset = 0;
+    return deserialize([&data, &offset](uint8_t* bytes, size_t size) {
+        size_t take = std::min(size, data.size() - offset);
+        std::memcpy(bytes, data.data() + offset, take);
+        offset += take;
+        return take;
+    });
+}
+
+bool FAISSWrapper::matches_metric(const faiss::Index* index) const {
+    if (index->metric_type == faiss_metric(options_.metric)) {
+        return true;
+    }
+    std::cerr << "Error loading index: stored index uses a different distance metric" << std::endl;
+    return false;
+}
+
+int FAISSWrapper::deserialize(const ByteSource& source) {
+    int status = 0;
+    ParsedIndex parsed = parse(source, &status);
+    return parsed ? install(std::move(parsed)) : status;
+}
+
+FAISSWrapper::ParsedIndex FAISSWrapper::parse(const ByteSource& source, int* status) {
     // TODO: Add version compatibility checking for different FAISS versions
-    // TODO: Implement data validation and corruption detection
-    // TODO: Add support for progressive loading of large indices
     // TODO: Implement fallback mechanisms for incompatible index formats
     
+    // Loading happens off to the side; searches keep using the current
+    // version until the new one is installed.
+    if (status) *status = -2;
     try {
-        std::string str(data.begin(), data.end());
-        std::stringstream ss(str);
-        
-        auto loaded_index = faiss::read_index(&ss);
+        SourceReader reader(source);
+        auto loaded_index = faiss::read_index(&reader);
+        if (!loaded_index) {
+            return nullptr;
+        }
+        if (!matches_metric(loaded_index)) {
+            delete loaded_index;
+            return nullptr;
+        }
+        ParsedIndex parsed(to_device(loaded_index));
+        if (status) *status = 0;
+        return parsed;
+    } catch (const std::exception& e) {
+        std::cerr << "Error deserializing index: " << e.what() << std::endl;
+        if (status) *status = -3;
+        return nullptr;
+    }
+}
+
+int FAISSWrapper::install(ParsedIndex index) {
+    if (!index) {
+        return -1;
+    }
+    
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    trained_ = index->is_trained;
+    publish(std::move(index));
+    return 0;
+}
+
+int FAISSWrapper::load_file(const std::string& path, bool mmap) {
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    
+    try {
+        auto loaded_index = faiss::read_index(path.c_str(), mmap ? faiss::IO_FLAG_MMAP : 0);
         if (!loaded_index) {
             return -2;
         }
+        if (!matches_metric(loaded_index)) {
+            delete loaded_index;
+            return -2;
+        }
+        loaded_index = to_device(loaded_index);
         
-        index_.reset(loaded_index);
-        trained_ = index_->is_trained;
+        trained_ = loaded_index->is_trained;
+        publish(loaded_index);
         
         return 0;
     } catch (const std::exception& e) {
-        std::cerr << "Error deserializing index: " << e.what() << std::endl;
+        std::cerr << "Error loading index from " << path << ": " << e.what() << std::endl;
         return -3;
     }
 }
 
 size_t FAISSWrapper::get_ntotal() const {
-    return index_ ? index_->ntotal : 0;
+    auto current = acquire();
+    if (!current) {
+        return 0;
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(current->mutex);
+    return current->index->ntotal;
 }
 
 int FAISSWrapper::get_dimension() const {
@@ -1,48 +1,254 @@
 #ifndef FAISS_WRAPPER_H
 #define FAISS_WRAPPER_H
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "core/result_cache.h"
+#include "id_filter.h"
+#include "index_options.h"
+#include "search_results.h"
+#include "simd_kernels.h"
 
 namespace faiss {
     class Index;
     class IndexIVFFlat;
 }
 
-struct SearchResult {
-    int64_t id;
-    float distance;
+class GpuBackend;
+
+// Size and shape of the published index version
+struct IndexStats {
+    size_t ntotal = 0;
+    size_t memory_bytes = 0;        // host memory for codes, ids, quantizers and graph links (0 on GPUs)
+    size_t tombstones = 0;
+    // IVF only: inverted list sizes. Imbalance is nlist * sum(size^2) / ntotal^2,
+    // 1 for even lists; searches scan about that factor more codes than even lists would.
+    size_t nlist = 0;
+    size_t list_min = 0;
+    size_t list_max = 0;
+    double list_imbalance = 0.0;
+};
+
+// Per-call search knobs; 0 keeps the index's own setting. Applied through
+// faiss::SearchParameters, so concurrent calls never touch shared index state.
+struct SearchOptions {
+    int nprobe = 0;         // IVF lists to probe
+    int ef_search = 0;      // HNSW beam width
+    float k_factor = 0.0f;  // refine: candidates per result before exact re-ranking
+    // Only ids in this set are returned; not owned, must outlive the search
+    const IdFilter* filter = nullptr;
+
+    bool is_default() const { return nprobe <= 0 && ef_search <= 0 && k_factor <= 0.0f && !filter; }
+    bool operator==(const SearchOptions& other) const {
+        return nprobe == other.nprobe && ef_search == other.ef_search && k_factor == other.k_factor &&
+               filter == other.filter;
+    }
+};
+
+// Result cache context of a top-k search by `owner`: k and the knobs above.
+// Filtered searches are not cached, so the filter takes no part.
+inline uint64_t search_cache_context(const void* owner, size_t k, const SearchOptions& options) {
+    uint64_t context = ResultCache::combine(reinterpret_cast<uintptr_t>(owner), k);
+    context = ResultCache::combine(context, static_cast<uint64_t>(static_cast<uint32_t>(options.nprobe)) << 32 |
+                                                static_cast<uint32_t>(options.ef_search));
+    return ResultCache::combine(context, &options.k_factor, sizeof(float));
+}
+
+// How the IVF coarse quantizer is fitted. With batches > 1 the training set
+// is split into that many slices and k-means runs over them in turn, each
+// slice starting from the previous slice's centroids (mini-batch refinement),
+// so a large sample is seen in full without one long pass over all of it.
+struct TrainOptions {
+    int batches = 1;
+    int iterations = 0;     // k-means iterations per slice; 0 = 25 for one slice, 10 per slice otherwise
+    bool gpu = true;        // assign points on the first GPU when the wrapper has GPU resources
+    uint64_t seed = 1234;
+    
+    bool is_default() const { return batches <= 1 && iterations <= 0 && gpu; }
 };
 
+// One published generation of the index. Readers pin it with a shared_ptr, so
+// a reload can publish a replacement while in-flight searches finish here.
+struct IndexVersion {
+    std::shared_ptr<faiss::Index> index;
+    uint64_t version = 0;
+    bool on_gpu = false;    // searches touch a device, so they must not overlap
+    // FAISS does not allow mutation concurrently with search: searches hold
+    // this shared, in-place adds and training hold it exclusively.
+    mutable std::shared_mutex mutex;
+    
+    // Deletes from indexes without remove_ids (HNSW) mark IDMap positions
+    // here; searches skip marked positions until compaction. Guarded by mutex.
+    std::vector<uint64_t> tombstones;                 // bitmap over positions
+    size_t tombstone_count = 0;
+    std::unordered_map<int64_t, int64_t> positions;   // live id -> position, built on the first tombstone
+};
+
+// Thread safety: all methods may be called concurrently. Searches run in
+// parallel with each other and never wait for deserialize(), which builds the
+// new index off to the side and publishes it atomically. Writers (add, remove,
+// train, deserialize, compact) are serialized among themselves; an add or
+// remove briefly excludes searches on the version it mutates. Compaction
+// rebuilds off to the side as well, so only writers wait for it. GPU indexes serialize searches as well,
+// since GPU resources are not safe for concurrent use.
 class FAISSWrapper {
 public:
     FAISSWrapper(int dimension, const std::string& index_type = "IVFFlat", 
                  bool use_gpu = false, int gpu_device = 0);
+    // Throws std::invalid_argument for unknown index types or factory strings
+    FAISSWrapper(int dimension, const IndexOptions& options,
+                 bool use_gpu = false, int gpu_device = 0);
+    // Places the index on one or more GPUs; falls back to the CPU when a
+    // listed device is unavailable or GPU support is not compiled in
+    FAISSWrapper(int dimension, const IndexOptions& options, const GpuOptions& gpu);
     ~FAISSWrapper();
 
     int add_vectors(const float* vectors, const int64_t* ids, size_t count);
-    std::vector<SearchResult> search(const float* query, size_t k);
+    // Adds rows stored as float16, bfloat16 or int8 (value = code * scale,
+    // scale > 0). They are widened into scratch memory a block at a time, so
+    // the batch is never held in float32 whole, except by an untrained index,
+    // which trains on all of it. A failure leaves earlier blocks added.
+    int add_vectors(const void* vectors, simd::ElementType type, const int64_t* ids, size_t count,
+                    float scale = 1.0f);
+    // Deletes ids, through remove_ids where the index supports it and as
+    // tombstones otherwise; unknown ids are ignored. `removed` receives how
+    // many vectors were deleted. Returns 0, -1 for bad arguments, -2 on FAISS
+    // errors or when the index stores no ids (no IDMap or IVF).
+    int remove_vectors(const int64_t* ids, size_t count, size_t* removed = nullptr);
+    // Replaces the vectors stored under ids, adding ids that are not present.
+    // The old vectors are removed first and not kept, so when the add fails
+    // (-2) the ids are left deleted; retrying the upsert restores them.
+    int upsert_vectors(const float* vectors, const int64_t* ids, size_t count);
+    
+    // Rebuilds the index without tombstoned vectors. Runs in the background once
+    // tombstones exceed `ratio` of the index (0 disables); call directly to force it.
+    int compact();
+    void set_compaction_threshold(double ratio);
+    size_t get_tombstone_count() const;
+    // Unfiltered searches are answered from the result cache when one is set
+    std::vector<SearchResult> search(const float* query, size_t k,
+                                     const SearchOptions& options = SearchOptions());
+    // Answers nq queries with one index call; distances/labels are nq x k, missing slots get label -1
+    int search_batch(const float* queries, size_t nq, size_t k, float* distances, int64_t* labels,
+                     const SearchOptions& options = SearchOptions());
+    // Every vector strictly within `radius` of each query, in the distances
+    // search reports (squared L2, -a.b, 1 - cos); one index call answers all
+    // nq queries. Returns 0, -1 for bad arguments, -2 on FAISS errors,
+    // including index types without range search (GPU, refine).
+    int range_search(const float* queries, size_t nq, float radius, RangeResults& results,
+                     const SearchOptions& options = SearchOptions());
+    // Resumable search for one query. Plain IVF indexes open options.nprobe
+    // more inverted lists of the version current at creation whenever their
+    // candidates run out, so no list is scanned twice; other indexes search
+    // again with a doubled k. The wrapper and options.filter must outlive the
+    // iterator. nullptr for bad arguments.
+    std::unique_ptr<SearchIterator> search_iterator(const float* query,
+                                                    const SearchOptions& options = SearchOptions());
+    
+    using ByteSink = std::function<bool(const uint8_t* data, size_t size)>;
+    using ByteSource = std::function<size_t(uint8_t* data, size_t size)>;
     
     std::vector<uint8_t> serialize() const;
     int deserialize(const std::vector<uint8_t>& data);
+    // Streaming variants: bytes are handed over as FAISS produces or consumes
+    // them, so no full copy of the index is built in memory
+    int serialize(const ByteSink& sink) const;
+    int deserialize(const ByteSource& source);
+    // deserialize() in two steps, for sources verified only once read to the
+    // end (chunked storage): parse() builds the index without publishing it,
+    // or returns nullptr with deserialize()'s code in status; install()
+    // publishes it, -1 for nullptr. Dropping a parsed index discards it.
+    using ParsedIndex = std::shared_ptr<faiss::Index>;
+    ParsedIndex parse(const ByteSource& source, int* status = nullptr);
+    int install(ParsedIndex index);
+    // Loads a serialized index from a local file. With mmap the file is mapped
+    // read-only and pages fault in on first use (IVF inverted lists), so the
+    // loaded index cannot take further adds until it is reloaded.
+    int load_file(const std::string& path, bool mmap = false);
     
-    void train(const float* training_data, size_t count);
+    // Trains an untrained index; a no-op once trained. Decoupled from adds:
+    // training an empty index ahead of time means the first add only encodes.
+    void train(const float* training_data, size_t count, const TrainOptions& options = TrainOptions());
     bool is_trained() const;
+    bool requires_training() const;
+    // Dataset size used to size nlist and PQ codes when IndexOptions::expected_size
+    // is unset; takes effect at the next training of an empty index
+    void set_dataset_size_hint(size_t rows);
     
     size_t get_ntotal() const;
     int get_dimension() const;
+    Metric get_metric() const { return options_.metric; }
+    // Bumped every time a new index is published (construction, deserialize)
+    uint64_t get_index_version() const;
+    // Caches search() results in `cache`, which may be shared with other
+    // wrappers and connections; every add, remove and publish invalidates it.
+    // nullptr detaches the cache.
+    void set_result_cache(std::shared_ptr<ResultCache> cache);
+    std::shared_ptr<ResultCache> get_result_cache() const { return std::atomic_load(&results_); }
+    // Placement of the newest GPU copy and device memory; empty for CPU indexes
+    GpuStats get_gpu_stats() const;
+    // Walks the inverted lists of IVF indexes, so O(nlist)
+    IndexStats get_index_stats() const;
 
 private:
-    std::unique_ptr<faiss::Index> index_;
+    std::shared_ptr<IndexVersion> index_;   // read and replaced with std::atomic_load/atomic_store
+    std::mutex write_mutex_;
+    uint64_t next_version_;
     int dimension_;
     bool use_gpu_;
     int gpu_device_;
+    GpuOptions gpu_options_;
+    std::shared_ptr<GpuBackend> gpu_;       // set while use_gpu_, WITH_GPU builds only
+    mutable std::mutex placement_mutex_;
+    GpuStats placement_;                    // placement and footprint of the newest GPU copy
     std::string index_type_;
-    bool trained_;
+    IndexOptions options_;
+    size_t dataset_size_hint_;
+    std::atomic<bool> trained_;
+    std::shared_ptr<ResultCache> results_;  // read and replaced with std::atomic_load/atomic_store
+    
+    std::atomic<double> compaction_threshold_;
+    std::thread compactor_;                 // started with the first tombstone
+    std::mutex compactor_mutex_;
+    std::condition_variable compactor_wake_;
+    bool compaction_pending_;
+    bool stopping_;
+    
+    std::shared_ptr<IndexVersion> acquire() const { return std::atomic_load(&index_); }
+    void publish(faiss::Index* index);
+    void publish(std::shared_ptr<faiss::Index> index);
+    // Caller holds write_mutex_; may publish a rebuilt index
+    void train_locked(const float* training_data, size_t count, const TrainOptions& options = TrainOptions());
+    // k-means for the coarse quantizer of `index` per options; false if the
+    // index has no IVF layer in input space, so FAISS trains it as usual
+    bool fit_coarse_quantizer(faiss::Index* index, const float* training_data, size_t count,
+                              const TrainOptions& options);
+    // Caller holds write_mutex_
+    int add_locked(const float* vectors, const int64_t* ids, size_t count);
+    int remove_locked(const int64_t* ids, size_t count, size_t* removed);
+    int compact_locked();
+    void schedule_compaction();
+    void run_compactor();
     
-    faiss::Index* create_index(const std::string& index_type, int dimension);
+    faiss::Index* create_index(size_t dataset_size, size_t training_size);
+    // Whether a loaded index ranks by this wrapper's metric; reports the mismatch
+    bool matches_metric(const faiss::Index* index) const;
     void setup_gpu_resources();
+    // Held around device calls of a version on the GPU; empty otherwise
+    std::unique_lock<std::mutex> device_lock(const IndexVersion& version) const;
+    // Takes ownership of a CPU index and returns it on the configured GPUs, or
+    // as is for CPU indexes and indexes that fit on no device
+    faiss::Index* to_device(faiss::Index* index);
 };
 
 #endif
\ No newline at end of file
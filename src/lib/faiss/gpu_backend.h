@@ -0,0 +1,73 @@
+#ifndef PGV_GPU_BACKEND_H
+#define PGV_GPU_BACKEND_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "index_options.h"
+
+namespace faiss {
+    class Index;
+    namespace gpu {
+        class StandardGpuResources;
+    }
+}
+
+// FAISS GPU resources for a set of devices, one StandardGpuResources each with
+// its own scratch and pinned host memory. Moves CPU indexes onto the devices
+// as a single copy, one replica per device, or shards. Implemented in
+// faiss_gpu_wrapper.cu and only built with WITH_GPU.
+class GpuBackend {
+public:
+    // Throws std::runtime_error if a listed device does not exist
+    explicit GpuBackend(const GpuOptions& options);
+    ~GpuBackend();
+
+    GpuBackend(const GpuBackend&) = delete;
+    GpuBackend& operator=(const GpuBackend&) = delete;
+
+    // Estimates the index footprint and returns a copy placed as well as the
+    // free device memory allows, trying each GpuPlacement in turn; returns
+    // nullptr when none fits, in which case the caller keeps the CPU index.
+    // The CPU index is left untouched. `placed` receives the placement and the
+    // copy's footprint per device; the backend is shared, so it keeps neither.
+    faiss::Index* to_gpu(const faiss::Index* index, GpuStats& placed);
+    // CPU copy of an index returned by to_gpu, merging shards, for serialization
+    static faiss::Index* to_cpu(const faiss::Index* index);
+    // Whether searching `index` touches a device, so searches must not overlap
+    static bool uses_gpu(const faiss::Index* index);
+    // Exact index on the first device for k-means assignment during training;
+    // inner product for InnerProduct and Cosine, L2 otherwise
+    faiss::Index* clustering_index(int dimension, Metric metric);
+
+    // Samples device memory now; sampled peaks cover every sample taken so far.
+    // Device-wide figures only: placement is Cpu and index_bytes 0.
+    GpuStats stats();
+
+    // Indexes sharing one backend share its streams and scratch memory, so
+    // their device calls take this mutex and run one at a time
+    std::mutex& device_mutex() { return device_mutex_; }
+
+    const std::vector<int>& devices() const { return options_.devices; }
+    void warm_up() const;
+    static void print_devices();
+
+private:
+    GpuOptions options_;
+    std::vector<std::unique_ptr<faiss::gpu::StandardGpuResources>> resources_;
+    std::vector<size_t> temp_memory_;       // scratch reserved per device by its first search
+
+    std::mutex device_mutex_;
+    std::mutex stats_mutex_;
+    std::vector<GpuDeviceStats> stats_;
+
+    faiss::Index* clone(const faiss::Index* index, bool float16);
+    // Whether every device has room for `bytes` of the index (split across them when sharding)
+    bool fits(size_t bytes, bool first_device_only);
+    // Footprint of a placement per device; samples memory after it
+    GpuStats record(GpuPlacement placement, size_t bytes, bool first_device_only);
+    void sample_locked();
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "id_filter.h"
+#include <algorithm>
+
+IdFilter::IdFilter(const int64_t* ids, size_t count) {
+    if (!ids || count == 0) {
+        return;
+    }
+
+    std::vector<uint64_t> sorted(count);
+    for (size_t i = 0; i < count; ++i) {
+        sorted[i] = static_cast<uint64_t>(ids[i]);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    size_ = sorted.size();
+
+    size_t begin = 0;
+    while (begin < sorted.size()) {
+        uint64_t key = sorted[begin] >> 16;
+        size_t end = begin;
+        while (end < sorted.size() && (sorted[end] >> 16) == key) ++end;
+
+        Container container;
+        container.key = key;
+        if (end - begin > kArrayLimit) {
+            container.bits.assign(65536 / 64, 0);
+            for (size_t i = begin; i < end; ++i) {
+                uint16_t low = static_cast<uint16_t>(sorted[i]);
+                container.bits[low >> 6] |= uint64_t(1) << (low & 63);
+            }
+        } else {
+            container.values.reserve(end - begin);
+            for (size_t i = begin; i < end; ++i) {
+                container.values.push_back(static_cast<uint16_t>(sorted[i]));
+            }
+        }
+        containers_.push_back(std::move(container));
+        begin = end;
+    }
+}
+
+bool IdFilter::contains(int64_t id) const {
+    uint64_t value = static_cast<uint64_t>(id);
+    uint64_t key = value >> 16;
+
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const Container& container, uint64_t k) { return container.key < k; });
+    if (it == containers_.end() || it->key != key) {
+        return false;
+    }
+
+    uint16_t low = static_cast<uint16_t>(value);
+    if (!it->bits.empty()) {
+        return (it->bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(it->values.begin(), it->values.end(), low);
+}
+
+size_t IdFilter::memory_usage() const {
+    size_t bytes = containers_.capacity() * sizeof(Container);
+    for (const auto& container : containers_) {
+        bytes += container.values.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,36 @@
+#ifndef PGV_ID_FILTER_H
+#define PGV_ID_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Immutable set of allowed ids for filtered search, stored roaring-style:
+// ids are grouped by their high 48 bits and each group keeps its low 16 bits
+// either as a sorted array (sparse) or as an 8 KB bitmap (dense). A few
+// million ids cost a few bytes each and membership is a binary search plus
+// an array or bit probe. Safe to share between concurrent searches.
+class IdFilter {
+public:
+    IdFilter() = default;
+    // ids may be unsorted and contain duplicates
+    IdFilter(const int64_t* ids, size_t count);
+
+    bool contains(int64_t id) const;
+    size_t size() const { return size_; }
+    size_t memory_usage() const;
+
+private:
+    struct Container {
+        uint64_t key = 0;               // id >> 16
+        std::vector<uint16_t> values;   // sorted low bits while sparse
+        std::vector<uint64_t> bits;     // 65536-bit bitmap once dense
+    };
+
+    static const size_t kArrayLimit = 4096;   // past this a bitmap is smaller than the array
+
+    std::vector<Container> containers_;       // sorted by key
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "index_options.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+// Sizing assumption until the real dataset size is known, as in earlier releases
+const size_t kDefaultDatasetSize = 100000;
+const size_t kMaxNlist = 65536;
+// FAISS warns below 39 training points per centroid
+const size_t kMinPointsPerCentroid = 39;
+// Code sizes (bytes per vector at 8 bits per sub-quantizer) in preferred order
+const int kPqCodeSizes[] = {128, 96, 64, 56, 48, 40, 32, 28, 24, 20, 16, 12, 8, 4, 2, 1};
+
+void replace_all(std::string& text, const std::string& token, const std::string& value) {
+    for (size_t pos = text.find(token); pos != std::string::npos; pos = text.find(token, pos + value.size())) {
+        text.replace(pos, token.size(), value);
+    }
+}
+
+} // namespace
+
+size_t derive_nlist(size_t dataset_size, size_t training_size) {
+    size_t size = dataset_size > 0 ? dataset_size : (training_size > 0 ? training_size : kDefaultDatasetSize);
+    size_t nlist = static_cast<size_t>(4.0 * std::sqrt(static_cast<double>(size)));
+    nlist = std::min(nlist, kMaxNlist);
+    if (training_size > 0) {
+        nlist = std::min(nlist, training_size / kMinPointsPerCentroid);
+    }
+    return std::max<size_t>(nlist, 1);
+}
+
+int derive_pq_m(const IndexOptions& options, int dimension, size_t dataset_size) {
+    if (options.pq_m > 0) {
+        return options.pq_m;
+    }
+
+    // Without a budget aim for a quarter of the dimension (16x compression at fp32)
+    size_t limit = std::max(dimension / 4, 1);
+    if (options.memory_budget > 0) {
+        size_t size = dataset_size > 0 ? dataset_size : kDefaultDatasetSize;
+        size_t per_vector = options.memory_budget / size;
+        size_t overhead = sizeof(int64_t) + (options.refine ? sizeof(float) * dimension : 0);
+        if (per_vector <= overhead) {
+            std::cerr << "Memory budget leaves no room for PQ codes; using the smallest code size" << std::endl;
+            limit = 1;
+        } else {
+            limit = per_vector - overhead;
+        }
+    }
+
+    for (int m : kPqCodeSizes) {
+        if (static_cast<size_t>(m) <= limit && dimension % m == 0) {
+            return m;
+        }
+    }
+    return 1;
+}
+
+std::string build_index_factory(const IndexOptions& options, int dimension,
+                                size_t dataset_size, size_t training_size) {
+    const std::string& type = options.index_type;
+    std::string factory = options.factory;
+    bool uses_refine = options.refine;
+
+    if (factory.empty()) {
+        if (type == "Flat") {
+            // IndexFlat alone cannot take external ids
+            factory = "IDMap2,Flat";
+            uses_refine = false;
+        } else if (type == "SQfp16" || type == "SQ8") {
+            factory = "IDMap," + type;
+        } else if (type == "IVFFlat") {
+            factory = "IVF{nlist},Flat";
+        } else if (type == "IVFPQ") {
+            factory = "IVF{nlist},PQ{m}";
+        } else if (type == "OPQ") {
+            factory = "OPQ{m},IVF{nlist},PQ{m}";
+        } else if (type == "IVFSQ8") {
+            factory = "IVF{nlist},SQ8";
+        } else if (type == "IVFSQfp16") {
+            factory = "IVF{nlist},SQfp16";
+        } else if (type == "IVFHNSW") {
+            factory = "IVF{nlist}_HNSW" + std::to_string(options.hnsw_m) + ",Flat";
+        } else if (type == "HNSW") {
+            // HNSW cannot take external ids itself
+            factory = "IDMap,HNSW" + std::to_string(options.hnsw_m);
+        } else if (type == "HNSWSQ") {
+            factory = "IDMap,HNSW" + std::to_string(options.hnsw_m) + ",SQ8";
+        } else {
+            throw std::invalid_argument("Unknown index type: " + type);
+        }
+    }
+
+    replace_all(factory, "{nlist}", std::to_string(derive_nlist(dataset_size, training_size)));
+    replace_all(factory, "{m}", std::to_string(derive_pq_m(options, dimension, dataset_size)));
+
+    if (uses_refine && factory.find("RFlat") == std::string::npos && factory.find("Refine(") == std::string::npos) {
+        factory += ",RFlat";
+    }
+    return factory;
+}
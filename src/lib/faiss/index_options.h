@@ -0,0 +1,104 @@
+#ifndef PGV_INDEX_OPTIONS_H
+#define PGV_INDEX_OPTIONS_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class GpuBackend;
+
+// Distance an index ranks by. Results always report smaller-is-better
+// distances equal to pgvector's operators: squared L2 for L2 (pgvector's
+// <-> is its square root), -a.b for InnerProduct (<#>) and 1 - cos for
+// Cosine (<=>). Cosine indexes store unit vectors and search with unit
+// queries on FAISS's inner-product metric.
+enum class Metric {
+    L2,
+    InnerProduct,
+    Cosine,
+};
+
+// Structured description of the index family. Named types map onto FAISS
+// index_factory strings; a custom factory string may be given instead.
+//
+//   Flat       IDMap2,Flat    (exact search)
+//   SQfp16     IDMap,SQfp16   (exact scan over float16 codes, half the memory)
+//   SQ8        IDMap,SQ8      (exact scan over 8-bit codes, trained ranges)
+//   IVFFlat    IVF{nlist},Flat
+//   IVFPQ      IVF{nlist},PQ{m}
+//   OPQ        OPQ{m},IVF{nlist},PQ{m}
+//   IVFSQ8     IVF{nlist},SQ8
+//   IVFSQfp16  IVF{nlist},SQfp16
+//   IVFHNSW    IVF{nlist}_HNSW{M},Flat   (HNSW coarse quantizer for large nlist)
+//   HNSW       IDMap,HNSW{M}
+//   HNSWSQ     IDMap,HNSW{M},SQ8
+struct IndexOptions {
+    std::string index_type = "IVFFlat";
+    std::string factory;            // overrides index_type; "{nlist}" and "{m}" are substituted
+    Metric metric = Metric::L2;
+    size_t expected_size = 0;       // vectors the index will hold; 0 = size of the training set
+    size_t memory_budget = 0;       // bytes for codes and ids across expected_size; picks m, 0 = default
+    int pq_m = 0;                   // PQ sub-quantizers; 0 = derived from dimension or memory_budget
+    int hnsw_m = 32;
+    int ef_construction = 40;
+    bool refine = false;            // re-rank candidates with exact distances (RFlat)
+    bool fast_remove = false;       // IVF: keep an id -> list hash table so removes cost O(batch)
+};
+
+// Where the index lives. With several devices the index is either copied to
+// each of them (queries of a batch are split across the copies) or split
+// across them (each holds a share of the vectors; every query visits all).
+enum class GpuMode {
+    Replicate,
+    Shard,
+};
+
+struct GpuOptions {
+    bool enabled = false;
+    std::vector<int> devices = {0};
+    GpuMode mode = GpuMode::Replicate;      // only matters with more than one device
+    std::vector<size_t> temp_memory;        // scratch bytes per device, parallel to devices; 0 = min(free / 4, 1.5 GB)
+    size_t pinned_memory = 0;               // pinned host bytes per device for query/result copies; 0 = FAISS default
+    bool allow_float16 = true;              // store vectors as float16 when full precision does not fit
+    // Resources of these devices already created for other indexes, which
+    // then share them instead of each reserving its own; null = create them
+    std::shared_ptr<GpuBackend> backend;
+};
+
+// Where placement put the index, best first. Each step is tried when the
+// estimated footprint does not fit the free device memory of the one before.
+enum class GpuPlacement {
+    Cpu,            // nothing fitted (or no GPU): the index stays in host memory
+    Gpu,            // full precision on the devices
+    GpuFloat16,     // float16 vectors / lookup tables
+    GpuQuantizer,   // IVF coarse quantizer on the first device, inverted lists on the CPU
+};
+
+struct GpuDeviceStats {
+    int device = 0;
+    size_t total_bytes = 0;
+    size_t used_bytes = 0;      // device-wide, as of the last sample
+    // Highest used_bytes among the samples taken at placements and stats
+    // calls; a peak reached between two samples is not seen
+    size_t sampled_peak_bytes = 0;
+    size_t index_bytes = 0;     // estimated footprint of this index on the device
+};
+
+struct GpuStats {
+    GpuPlacement placement = GpuPlacement::Cpu;
+    std::vector<GpuDeviceStats> devices;
+};
+
+// nlist ~ 4 * sqrt(N), capped at 65536 and at one centroid per 39 training points
+size_t derive_nlist(size_t dataset_size, size_t training_size);
+
+// Largest supported PQ code size that divides `dimension` and fits the budget
+int derive_pq_m(const IndexOptions& options, int dimension, size_t dataset_size);
+
+// Resolves options into an index_factory string; throws std::invalid_argument
+// for unknown index types. dataset_size/training_size may be 0 when unknown.
+std::string build_index_factory(const IndexOptions& options, int dimension,
+                                size_t dataset_size, size_t training_size);
+
+#endif
@@ -0,0 +1,104 @@
+#include "search_results.h"
+#include "core/scratch_arena.h"
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+
+bool nearer(const SearchResult& a, const SearchResult& b) {
+    return a.distance < b.distance;
+}
+
+bool farther(const SearchResult& a, const SearchResult& b) {
+    return a.distance > b.distance;
+}
+
+} // namespace
+
+void RangeResults::allocate(size_t queries, size_t total) {
+    nq = queries;
+    lims.reset(new size_t[queries + 1]());
+    ids.reset(new int64_t[total]);
+    distances.reset(new float[total]);
+}
+
+void RangeResults::sort_by_distance() {
+    for (size_t q = 0; q < nq; ++q) {
+        const size_t begin = lims[q];
+        const size_t n = lims[q + 1] - begin;
+        if (n < 2) continue;
+
+        ScratchArena::Scope scratch;
+        SearchResult* hits = scratch.allocate<SearchResult>(n);
+        for (size_t i = 0; i < n; ++i) {
+            hits[i] = {ids[begin + i], distances[begin + i]};
+        }
+        std::sort(hits, hits + n, nearer);
+        for (size_t i = 0; i < n; ++i) {
+            ids[begin + i] = hits[i].id;
+            distances[begin + i] = hits[i].distance;
+        }
+    }
+}
+
+SearchIterator::SearchIterator(Source source) : source_(std::move(source)) {}
+
+SearchIterator::Source SearchIterator::growing_top_k(TopK search, size_t initial_k) {
+    struct State {
+        size_t k = 0;
+        std::unordered_set<int64_t> seen;
+        std::vector<float> distances;
+        std::vector<int64_t> labels;
+    };
+    auto state = std::make_shared<State>();
+    state->k = std::max<size_t>(initial_k, 1) / 2;
+
+    return [state, search](size_t wanted, std::vector<SearchResult>& out) {
+        state->k = std::max(state->k * 2, state->seen.size() + wanted);
+        state->distances.resize(state->k);
+        state->labels.resize(state->k);
+        int status = search(state->k, state->distances.data(), state->labels.data());
+        if (status != 0) {
+            return status;
+        }
+
+        // Approximate indexes may reorder the head as k grows, so ids are
+        // matched rather than the first k skipped
+        size_t hits = 0;
+        for (; hits < state->k && state->labels[hits] >= 0; ++hits) {
+            if (state->seen.insert(state->labels[hits]).second) {
+                out.push_back({state->labels[hits], state->distances[hits]});
+            }
+        }
+        return hits == state->k ? 1 : 0;
+    };
+}
+
+int SearchIterator::next(size_t count, int64_t* ids, float* distances, size_t* produced) {
+    if (produced) *produced = 0;
+
+    // The whole page is drawn from one heap, so it comes out in order
+    while (pending_.size() < count && !exhausted_) {
+        std::vector<SearchResult> found;
+        int status = source_(count - pending_.size(), found);
+        if (status < 0) {
+            return status;
+        }
+        exhausted_ = status == 0;
+        for (const SearchResult& hit : found) {
+            pending_.push_back(hit);
+            std::push_heap(pending_.begin(), pending_.end(), farther);
+        }
+    }
+
+    const size_t n = std::min(count, pending_.size());
+    for (size_t i = 0; i < n; ++i) {
+        std::pop_heap(pending_.begin(), pending_.end(), farther);
+        ids[i] = pending_.back().id;
+        distances[i] = pending_.back().distance;
+        pending_.pop_back();
+    }
+    returned_ += n;
+    if (produced) *produced = n;
+    return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef PGV_SEARCH_RESULTS_H
+#define PGV_SEARCH_RESULTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct SearchResult {
+    int64_t id;
+    float distance;
+};
+
+// Hits of a range search over nq queries in one flat layout: query i owns
+// entries lims[i] .. lims[i + 1] of ids and distances, nearest first. The
+// arrays are FAISS's own RangeSearchResult buffers, taken over without a copy.
+struct RangeResults {
+    size_t nq = 0;
+    std::unique_ptr<size_t[]> lims;
+    std::unique_ptr<int64_t[]> ids;
+    std::unique_ptr<float[]> distances;
+
+    size_t size() const { return lims ? lims[nq] : 0; }
+    // Sizes ids and distances for `total` hits; lims is nq + 1 zeros
+    void allocate(size_t queries, size_t total);
+    // Orders each query's hits by ascending distance
+    void sort_by_distance();
+};
+
+// Pages through the neighbours of one query, nearest first within a page.
+// Candidates come from a Source, asked for more only when the pending ones
+// run out, so a page never costs more than the candidates it needs. A later
+// page can still hold a vector nearer than the last one returned when an
+// approximate index finds it late (e.g. in an inverted list opened later).
+class SearchIterator {
+public:
+    // Appends further candidates to `out`, none returned before. Returns 1
+    // if more may follow, 0 once nothing is left, negative codes on errors.
+    using Source = std::function<int(size_t wanted, std::vector<SearchResult>& out)>;
+    // Top-k search of the iterator's query into k slots, missing ones id -1
+    using TopK = std::function<int(size_t k, float* distances, int64_t* labels)>;
+
+    explicit SearchIterator(Source source);
+
+    // Source repeating `search` with k doubled each time and keeping the
+    // results not seen before; for indexes that cannot resume a scan
+    static Source growing_top_k(TopK search, size_t initial_k = 16);
+
+    // Writes up to `count` results and stores how many in `produced` (fewer
+    // than count only once the index is exhausted). 0 or the source's error.
+    int next(size_t count, int64_t* ids, float* distances, size_t* produced);
+    bool exhausted() const { return exhausted_ && pending_.empty(); }
+    size_t returned() const { return returned_; }
+
+private:
+    Source source_;
+    std::vector<SearchResult> pending_;     // min-heap on distance
+    bool exhausted_ = false;
+    size_t returned_ = 0;
+};
+
+#endif
@@ -0,0 +1,590 @@
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PGV_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define PGV_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace simd {
+
+namespace {
+
+// y rows per tile: about 64 KB, so a tile stays in L2 while every x row passes over it
+const size_t kTileBytes = 64 * 1024;
+
+float l2_sqr_scalar(const float* a, const float* b, size_t dimension) {
+    // Four independent sums keep the loop from serializing on one accumulator
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= dimension; i += 4) {
+        float d0 = a[i] - b[i], d1 = a[i + 1] - b[i + 1];
+        float d2 = a[i + 2] - b[i + 2], d3 = a[i + 3] - b[i + 3];
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+        s2 += d2 * d2;
+        s3 += d3 * d3;
+    }
+    for (; i < dimension; ++i) {
+        float d = a[i] - b[i];
+        s0 += d * d;
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+float inner_product_scalar(const float* a, const float* b, size_t dimension) {
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= dimension; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < dimension; ++i) {
+        s0 += a[i] * b[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+// 1 / |x|, or 1 for zero vectors so they pass through unchanged
+inline float inverse_norm(float squared) {
+    return squared > 0.0f ? 1.0f / std::sqrt(squared) : 1.0f;
+}
+
+void normalize_scalar(const float* in, float* out, size_t dimension) {
+    const float scale = inverse_norm(inner_product_scalar(in, in, dimension));
+    for (size_t i = 0; i < dimension; ++i) {
+        out[i] = in[i] * scale;
+    }
+}
+
+float half_to_float(uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1fu;
+    const uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0) {
+        // Zero or subnormal: mantissa * 2^-24
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    } else if (exponent == 0x1f) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    const uint32_t magnitude = bits & 0x7fffffffu;
+    if (magnitude >= 0x7f800000u) {
+        return sign | (magnitude > 0x7f800000u ? 0x7e00u : 0x7c00u);
+    }
+    if (magnitude >= 0x477ff000u) {
+        return sign | 0x7c00u;      // 65520 and up round to infinity
+    }
+    if (magnitude < 0x38800000u) {
+        // Below 2^-14 the result is subnormal; the FPU rounds to even here
+        float absolute;
+        std::memcpy(&absolute, &magnitude, sizeof(absolute));
+        return sign | static_cast<uint16_t>(std::nearbyint(absolute * 16777216.0f));
+    }
+    const uint32_t rounded = magnitude + 0xfffu + ((magnitude >> 13) & 1u);
+    return sign | static_cast<uint16_t>((rounded - 0x38000000u) >> 13);
+}
+
+inline float bfloat_to_float(uint16_t bfloat) {
+    const uint32_t bits = static_cast<uint32_t>(bfloat) << 16;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint16_t float_to_bfloat(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) {
+        return static_cast<uint16_t>((bits >> 16) | 0x40u);   // keep NaNs quiet
+    }
+    return static_cast<uint16_t>((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16);
+}
+
+// NaN has no code; every path maps it to 0
+inline int8_t float_to_code(float value, float inverse_scale) {
+    const float scaled = value * inverse_scale;
+    if (std::isnan(scaled)) return 0;
+    float code = std::min(std::max(scaled, -127.0f), 127.0f);
+    return static_cast<int8_t>(std::nearbyint(code));
+}
+
+void fp16_to_float_scalar(const uint16_t* in, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = half_to_float(in[i]);
+}
+
+void float_to_fp16_scalar(const float* in, uint16_t* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = float_to_half(in[i]);
+}
+
+void bf16_to_float_scalar(const uint16_t* in, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = bfloat_to_float(in[i]);
+}
+
+void float_to_bf16_scalar(const float* in, uint16_t* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = float_to_bfloat(in[i]);
+}
+
+void int8_to_float_scalar(const int8_t* in, float* out, size_t count, float scale) {
+    for (size_t i = 0; i < count; ++i) out[i] = in[i] * scale;
+}
+
+void float_to_int8_scalar(const float* in, int8_t* out, size_t count, float scale) {
+    const float inverse_scale = 1.0f / scale;
+    for (size_t i = 0; i < count; ++i) out[i] = float_to_code(in[i], inverse_scale);
+}
+
+#ifdef PGV_SIMD_X86
+
+__attribute__((target("avx2,fma")))
+inline float horizontal_sum(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    __m128 shuffled = _mm_movehdup_ps(sum);
+    sum = _mm_add_ps(sum, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sum);
+    return _mm_cvtss_f32(_mm_add_ss(sum, shuffled));
+}
+
+__attribute__((target("avx2,fma")))
+float l2_sqr_avx2(const float* a, const float* b, size_t dimension) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dimension; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    if (i + 8 <= dimension) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        i += 8;
+    }
+    float sum = horizontal_sum(_mm256_add_ps(acc0, acc1));
+    for (; i < dimension; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+float inner_product_avx2(const float* a, const float* b, size_t dimension) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dimension; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    if (i + 8 <= dimension) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        i += 8;
+    }
+    float sum = horizontal_sum(_mm256_add_ps(acc0, acc1));
+    for (; i < dimension; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+void normalize_avx2(const float* in, float* out, size_t dimension) {
+    const float scale = inverse_norm(inner_product_avx2(in, in, dimension));
+    const __m256 factor = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= dimension; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i), factor));
+    }
+    for (; i < dimension; ++i) {
+        out[i] = in[i] * scale;
+    }
+}
+
+// Every AVX2 CPU also has F16C, so the AVX2 table uses it without a CPUID check
+__attribute__((target("avx2,fma,f16c")))
+void fp16_to_float_avx2(const uint16_t* in, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(half));
+    }
+    fp16_to_float_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2,fma,f16c")))
+void float_to_fp16_avx2(const float* in, uint16_t* out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), half);
+    }
+    float_to_fp16_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2,fma")))
+void bf16_to_float_avx2(const uint16_t* in, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16)));
+    }
+    bf16_to_float_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2,fma")))
+void float_to_bf16_avx2(const float* in, uint16_t* out, size_t count) {
+    const __m256i bias = _mm256_set1_epi32(0x7fff);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i magnitude = _mm256_set1_epi32(0x7fffffff);
+    const __m256i infinity = _mm256_set1_epi32(0x7f800000);
+    const __m256i quiet = _mm256_set1_epi32(0x00400000);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i bits = _mm256_castps_si256(_mm256_loadu_ps(in + i));
+        __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+        __m256i rounded = _mm256_add_epi32(bits, _mm256_add_epi32(bias, lsb));
+        __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(bits, magnitude), infinity);
+        rounded = _mm256_blendv_epi8(rounded, _mm256_or_si256(bits, quiet), nan);
+        // packus works within 128-bit lanes; the permute restores the order
+        __m256i packed = _mm256_packus_epi32(_mm256_srli_epi32(rounded, 16), _mm256_setzero_si256());
+        packed = _mm256_permute4x64_epi64(packed, 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(packed));
+    }
+    float_to_bf16_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2,fma")))
+void int8_to_float_avx2(const int8_t* in, float* out, size_t count, float scale) {
+    const __m256 factor = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i wide = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(wide), factor));
+    }
+    int8_to_float_scalar(in + i, out + i, count - i, scale);
+}
+
+__attribute__((target("avx2,fma")))
+void float_to_int8_avx2(const float* in, int8_t* out, size_t count, float scale) {
+    const __m256 factor = _mm256_set1_ps(1.0f / scale);
+    const __m256 low = _mm256_set1_ps(-127.0f);
+    const __m256 high = _mm256_set1_ps(127.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 scaled = _mm256_mul_ps(_mm256_loadu_ps(in + i), factor);
+        scaled = _mm256_and_ps(scaled, _mm256_cmp_ps(scaled, scaled, _CMP_ORD_Q));   // NaN -> 0
+        __m256 code = _mm256_min_ps(_mm256_max_ps(scaled, low), high);
+        __m256i wide = _mm256_cvtps_epi32(code);
+        __m128i narrow = _mm_packs_epi32(_mm256_castsi256_si128(wide), _mm256_extracti128_si256(wide, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi16(narrow, narrow));
+    }
+    float_to_int8_scalar(in + i, out + i, count - i, scale);
+}
+
+__attribute__((target("avx512f")))
+float l2_sqr_avx512(const float* a, const float* b, size_t dimension) {
+    __m512 acc = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dimension; i += 16) {
+        __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        acc = _mm512_fmadd_ps(d, d, acc);
+    }
+    if (i < dimension) {
+        // Masked loads cover the tail without reading past either vector
+        __mmask16 mask = static_cast<__mmask16>((1u << (dimension - i)) - 1);
+        __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+        acc = _mm512_fmadd_ps(d, d, acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+__attribute__((target("avx512f")))
+float inner_product_avx512(const float* a, const float* b, size_t dimension) {
+    __m512 acc = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dimension; i += 16) {
+        acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);
+    }
+    if (i < dimension) {
+        __mmask16 mask = static_cast<__mmask16>((1u << (dimension - i)) - 1);
+        acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+__attribute__((target("avx512f")))
+void normalize_avx512(const float* in, float* out, size_t dimension) {
+    const __m512 factor = _mm512_set1_ps(inverse_norm(inner_product_avx512(in, in, dimension)));
+    size_t i = 0;
+    for (; i + 16 <= dimension; i += 16) {
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_loadu_ps(in + i), factor));
+    }
+    if (i < dimension) {
+        __mmask16 mask = static_cast<__mmask16>((1u << (dimension - i)) - 1);
+        _mm512_mask_storeu_ps(out + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, in + i), factor));
+    }
+}
+
+__attribute__((target("avx512f")))
+void fp16_to_float_avx512(const uint16_t* in, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i half = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        _mm512_storeu_ps(out + i, _mm512_cvtph_ps(half));
+    }
+    fp16_to_float_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+void float_to_fp16_avx512(const float* in, uint16_t* out, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i half = _mm512_cvtps_ph(_mm512_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), half);
+    }
+    float_to_fp16_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+void bf16_to_float_avx512(const uint16_t* in, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i wide = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+        _mm512_storeu_ps(out + i, _mm512_castsi512_ps(_mm512_slli_epi32(wide, 16)));
+    }
+    bf16_to_float_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+void float_to_bf16_avx512(const float* in, uint16_t* out, size_t count) {
+    const __m512i bias = _mm512_set1_epi32(0x7fff);
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i magnitude = _mm512_set1_epi32(0x7fffffff);
+    const __m512i infinity = _mm512_set1_epi32(0x7f800000);
+    const __m512i quiet = _mm512_set1_epi32(0x00400000);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i bits = _mm512_castps_si512(_mm512_loadu_ps(in + i));
+        __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(bits, 16), one);
+        __m512i rounded = _mm512_add_epi32(bits, _mm512_add_epi32(bias, lsb));
+        __mmask16 nan = _mm512_cmpgt_epi32_mask(_mm512_and_si512(bits, magnitude), infinity);
+        rounded = _mm512_mask_mov_epi32(rounded, nan, _mm512_or_si512(bits, quiet));
+        __m256i packed = _mm512_cvtepi32_epi16(_mm512_srli_epi32(rounded, 16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+    float_to_bf16_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+void int8_to_float_avx512(const int8_t* in, float* out, size_t count, float scale) {
+    const __m512 factor = _mm512_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i wide = _mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_cvtepi32_ps(wide), factor));
+    }
+    int8_to_float_scalar(in + i, out + i, count - i, scale);
+}
+
+__attribute__((target("avx512f")))
+void float_to_int8_avx512(const float* in, int8_t* out, size_t count, float scale) {
+    const __m512 factor = _mm512_set1_ps(1.0f / scale);
+    const __m512 low = _mm512_set1_ps(-127.0f);
+    const __m512 high = _mm512_set1_ps(127.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 scaled = _mm512_mul_ps(_mm512_loadu_ps(in + i), factor);
+        scaled = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(scaled, scaled, _CMP_ORD_Q), scaled);   // NaN -> 0
+        __m512 code = _mm512_min_ps(_mm512_max_ps(scaled, low), high);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm512_cvtsepi32_epi8(_mm512_cvtps_epi32(code)));
+    }
+    float_to_int8_scalar(in + i, out + i, count - i, scale);
+}
+
+#endif // PGV_SIMD_X86
+
+#ifdef PGV_SIMD_NEON
+
+float l2_sqr_neon(const float* a, const float* b, size_t dimension) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 8 <= dimension; i += 8) {
+        float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        acc0 = vfmaq_f32(acc0, d0, d0);
+        acc1 = vfmaq_f32(acc1, d1, d1);
+    }
+    float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+    for (; i < dimension; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+float inner_product_neon(const float* a, const float* b, size_t dimension) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 8 <= dimension; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+    for (; i < dimension; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void normalize_neon(const float* in, float* out, size_t dimension) {
+    const float scale = inverse_norm(inner_product_neon(in, in, dimension));
+    size_t i = 0;
+    for (; i + 4 <= dimension; i += 4) {
+        vst1q_f32(out + i, vmulq_n_f32(vld1q_f32(in + i), scale));
+    }
+    for (; i < dimension; ++i) {
+        out[i] = in[i] * scale;
+    }
+}
+
+void fp16_to_float_neon(const uint16_t* in, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+    }
+    fp16_to_float_scalar(in + i, out + i, count - i);
+}
+
+void float_to_fp16_neon(const float* in, uint16_t* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+    }
+    float_to_fp16_scalar(in + i, out + i, count - i);
+}
+
+void bf16_to_float_neon(const uint16_t* in, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(out + i, vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(in + i), 16)));
+    }
+    bf16_to_float_scalar(in + i, out + i, count - i);
+}
+
+#endif // PGV_SIMD_NEON
+
+Kernels select_kernels() {
+#ifdef PGV_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return {l2_sqr_avx512, inner_product_avx512, normalize_avx512,
+                fp16_to_float_avx512, float_to_fp16_avx512, bf16_to_float_avx512, float_to_bf16_avx512,
+                int8_to_float_avx512, float_to_int8_avx512, "avx512"};
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return {l2_sqr_avx2, inner_product_avx2, normalize_avx2,
+                fp16_to_float_avx2, float_to_fp16_avx2, bf16_to_float_avx2, float_to_bf16_avx2,
+                int8_to_float_avx2, float_to_int8_avx2, "avx2"};
+    }
+#elif defined(PGV_SIMD_NEON)
+    // bfloat16 narrowing and int8 stay scalar: they are off the ingest path
+    return {l2_sqr_neon, inner_product_neon, normalize_neon,
+            fp16_to_float_neon, float_to_fp16_neon, bf16_to_float_neon, float_to_bf16_scalar,
+            int8_to_float_scalar, float_to_int8_scalar, "neon"};
+#endif
+    return {l2_sqr_scalar, inner_product_scalar, normalize_scalar,
+            fp16_to_float_scalar, float_to_fp16_scalar, bf16_to_float_scalar, float_to_bf16_scalar,
+            int8_to_float_scalar, float_to_int8_scalar, "scalar"};
+}
+
+} // namespace
+
+const Kernels& kernels() {
+    static const Kernels selected = select_kernels();
+    return selected;
+}
+
+float cosine_distance(const float* a, const float* b, size_t dimension) {
+    const Kernels& k = kernels();
+    float norms = k.inner_product(a, a, dimension) * k.inner_product(b, b, dimension);
+    if (norms <= 0.0f) {
+        return 1.0f;
+    }
+    return 1.0f - k.inner_product(a, b, dimension) / std::sqrt(norms);
+}
+
+void normalize(const float* in, float* out, size_t count, size_t dimension) {
+    const NormalizeFn fn = kernels().normalize;
+    for (size_t i = 0; i < count; ++i) {
+        fn(in + i * dimension, out + i * dimension, dimension);
+    }
+}
+
+size_t element_size(ElementType type) {
+    switch (type) {
+    case ElementType::Float16:
+    case ElementType::BFloat16: return sizeof(uint16_t);
+    case ElementType::Int8: return sizeof(int8_t);
+    default: return sizeof(float);
+    }
+}
+
+void to_float(ElementType type, const void* in, float* out, size_t count, float scale) {
+    const Kernels& k = kernels();
+    switch (type) {
+    case ElementType::Float16: k.fp16_to_float(static_cast<const uint16_t*>(in), out, count); break;
+    case ElementType::BFloat16: k.bf16_to_float(static_cast<const uint16_t*>(in), out, count); break;
+    case ElementType::Int8: k.int8_to_float(static_cast<const int8_t*>(in), out, count, scale); break;
+    default: std::memcpy(out, in, count * sizeof(float)); break;
+    }
+}
+
+void from_float(ElementType type, const float* in, void* out, size_t count, float scale) {
+    const Kernels& k = kernels();
+    switch (type) {
+    case ElementType::Float16: k.float_to_fp16(in, static_cast<uint16_t*>(out), count); break;
+    case ElementType::BFloat16: k.float_to_bf16(in, static_cast<uint16_t*>(out), count); break;
+    case ElementType::Int8: k.float_to_int8(in, static_cast<int8_t*>(out), count, scale); break;
+    default: std::memcpy(out, in, count * sizeof(float)); break;
+    }
+}
+
+void pairwise(DistanceFn fn, const float* x, size_t nx, const float* y, size_t ny,
+              size_t dimension, size_t y_stride, float* out) {
+    const size_t tile = std::max<size_t>(16, kTileBytes / (y_stride * sizeof(float)));
+    for (size_t j0 = 0; j0 < ny; j0 += tile) {
+        const size_t j1 = std::min(ny, j0 + tile);
+        for (size_t i = 0; i < nx; ++i) {
+            const float* xi = x + i * dimension;
+            float* row = out + i * ny;
+            for (size_t j = j0; j < j1; ++j) {
+                row[j] = fn(xi, y + j * y_stride, dimension);
+            }
+        }
+    }
+}
+
+} // namespace simd
@@ -0,0 +1,71 @@
+#ifndef PGV_SIMD_KERNELS_H
+#define PGV_SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Vector distance and element conversion kernels with runtime dispatch:
+// AVX-512 or AVX2+FMA on x86-64 (picked by CPUID at first use), NEON on
+// AArch64, portable C++ elsewhere. Inputs need no particular alignment.
+namespace simd {
+
+using DistanceFn = float (*)(const float* a, const float* b, size_t dimension);
+using NormalizeFn = void (*)(const float* in, float* out, size_t dimension);
+
+struct Kernels {
+    DistanceFn l2_sqr;
+    DistanceFn inner_product;
+    NormalizeFn normalize;
+    void (*fp16_to_float)(const uint16_t* in, float* out, size_t count);
+    void (*float_to_fp16)(const float* in, uint16_t* out, size_t count);
+    void (*bf16_to_float)(const uint16_t* in, float* out, size_t count);
+    void (*float_to_bf16)(const float* in, uint16_t* out, size_t count);
+    void (*int8_to_float)(const int8_t* in, float* out, size_t count, float scale);
+    void (*float_to_int8)(const float* in, int8_t* out, size_t count, float scale);
+    const char* isa;        // "avx512", "avx2", "neon" or "scalar"
+};
+
+// Best implementation for this CPU, resolved once
+const Kernels& kernels();
+
+inline float l2_sqr(const float* a, const float* b, size_t dimension) {
+    return kernels().l2_sqr(a, b, dimension);
+}
+
+inline float inner_product(const float* a, const float* b, size_t dimension) {
+    return kernels().inner_product(a, b, dimension);
+}
+
+// 1 - cos(a, b); 1 when either vector is zero
+float cosine_distance(const float* a, const float* b, size_t dimension);
+
+// Scales each of `count` rows of `in` to unit L2 norm into `out`, which may
+// be `in` itself for an in-place pass. Zero rows are copied unchanged.
+void normalize(const float* in, float* out, size_t count, size_t dimension);
+
+// Storage formats for vector elements. Float16 is IEEE binary16 (pgvector's
+// halfvec), BFloat16 the upper half of a float32, and Int8 a symmetric code
+// where value = code * scale. 16-bit values are in host byte order.
+enum class ElementType {
+    Float32,
+    Float16,
+    BFloat16,
+    Int8,
+};
+
+size_t element_size(ElementType type);
+
+// Widens `count` elements of `type` to float32. `scale` applies to Int8 only.
+void to_float(ElementType type, const void* in, float* out, size_t count, float scale = 1.0f);
+// Narrows float32 to `type`, rounding to nearest even. Out-of-range values
+// become infinity in Float16 and saturate to [-127, 127] in Int8.
+void from_float(ElementType type, const float* in, void* out, size_t count, float scale = 1.0f);
+
+// Distance block out[i * ny + j] = fn(x_i, y_j). Rows of y are y_stride floats
+// apart; y is walked in cache-sized tiles so each tile is reused by all of x.
+void pairwise(DistanceFn fn, const float* x, size_t nx, const float* y, size_t ny,
+              size_t dimension, size_t y_stride, float* out);
+
+} // namespace simd
+
+#endif
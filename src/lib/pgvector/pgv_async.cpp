@@ -0,0 +1,417 @@
+#include "pgv_async.h"
+#include "pgv_binary.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace pgvector {
+
+PGVAsyncConnection::PGVAsyncConnection(const std::string& connection_string, size_t max_in_flight)
+    : conn_string_(connection_string), max_in_flight_(max_in_flight > 0 ? max_in_flight : 1),
+      conn_(nullptr), pipelining_(false), epoll_fd_(-1), wake_fd_(-1), socket_fd_(-1), running_(false),
+      broken_(false), want_write_(false) {
+}
+
+PGVAsyncConnection::~PGVAsyncConnection() {
+    stop();
+}
+
+bool PGVAsyncConnection::start() {
+    if (running_) return true;
+
+    conn_ = PQconnectdb(conn_string_.c_str());
+    if (PQstatus(conn_) != CONNECTION_OK) {
+        std::cerr << "Connection failed: " << PQerrorMessage(conn_) << std::endl;
+        PQfinish(conn_);
+        conn_ = nullptr;
+        return false;
+    }
+
+    if (PQsetnonblocking(conn_, 1) != 0) {
+        std::cerr << "Failed to switch connection to non-blocking mode" << std::endl;
+        PQfinish(conn_);
+        conn_ = nullptr;
+        return false;
+    }
+
+#ifdef LIBPQ_HAS_PIPELINING
+    pipelining_ = PQenterPipelineMode(conn_) == 1;
+#else
+    pipelining_ = false;
+#endif
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        std::cerr << "Failed to set up epoll: " << std::strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+
+    epoll_event wake_event = {};
+    wake_event.events = EPOLLIN;
+    wake_event.data.fd = wake_fd_;
+
+    socket_fd_ = PQsocket(conn_);
+    epoll_event socket_event = {};
+    socket_event.events = EPOLLIN;
+    socket_event.data.fd = socket_fd_;
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &wake_event) != 0 ||
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket_fd_, &socket_event) != 0) {
+        std::cerr << "Failed to register with epoll: " << std::strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+
+    broken_ = false;
+    want_write_ = false;
+    running_ = true;
+    io_thread_ = std::thread(&PGVAsyncConnection::run, this);
+    return true;
+}
+
+void PGVAsyncConnection::stop() {
+    bool was_running;
+    {
+        // Under the queue lock so no enqueue can slip in after the final fail_all
+        std::lock_guard<std::mutex> lock(mutex_);
+        was_running = running_.exchange(false);
+    }
+    if (was_running) {
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd_, &one, sizeof(one));
+        (void)written;
+        io_thread_.join();
+    }
+
+    // Anything the I/O thread did not complete is failed here
+    fail_all("connection stopped");
+
+    if (conn_) {
+        PQfinish(conn_);
+        conn_ = nullptr;
+    }
+    socket_fd_ = -1;
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+}
+
+std::future<AsyncResult> PGVAsyncConnection::submit(std::vector<AsyncQuery> queries) {
+    auto job = std::make_unique<Job>();
+    job->queries = std::move(queries);
+    auto future = job->promise.get_future();
+    enqueue(std::move(job));
+    return future;
+}
+
+void PGVAsyncConnection::submit(std::vector<AsyncQuery> queries, Callback done) {
+    auto job = std::make_unique<Job>();
+    job->queries = std::move(queries);
+    job->callback = std::move(done);
+    enqueue(std::move(job));
+}
+
+std::future<AsyncResult> PGVAsyncConnection::insert_vectors(const std::string& table_name, const float* vectors,
+                                                            const int64_t* ids, size_t count, int dimension,
+                                                            size_t rows_per_statement) {
+    // PostgreSQL caps a statement at 65535 parameters, two per row here
+    rows_per_statement = std::max<size_t>(1, std::min<size_t>(rows_per_statement, 32767));
+
+    std::vector<AsyncQuery> queries;
+    for (size_t begin = 0; begin < count; begin += rows_per_statement) {
+        size_t end = std::min(count, begin + rows_per_statement);
+
+        AsyncQuery query;
+        query.sql = "INSERT INTO " + table_name + " (id, embedding) VALUES ";
+        query.params.reserve(2 * (end - begin));
+
+        for (size_t i = begin; i < end; ++i) {
+            size_t param = 2 * (i - begin) + 1;
+            if (i > begin) query.sql += ", ";
+            query.sql += "($" + std::to_string(param) + "::bigint, $" + std::to_string(param + 1) + "::vector)";
+
+            std::string id(sizeof(int64_t), '\0');
+            binary::put_int64(&id[0], ids[i]);
+            query.params.push_back(std::move(id));
+
+            std::string vector(binary::vector_size(dimension), '\0');
+            binary::put_vector(&vector[0], vectors + i * static_cast<size_t>(dimension), dimension);
+            query.params.push_back(std::move(vector));
+        }
+
+        queries.push_back(std::move(query));
+    }
+
+    return submit(std::move(queries));
+}
+
+std::future<std::vector<std::pair<int64_t, float>>> PGVAsyncConnection::similarity_search(
+    const std::string& table_name, const float* query, int dimension, size_t k, DistanceOperator op) {
+
+    AsyncQuery statement;
+    const std::string distance = std::string("embedding ") + distance_operator_sql(op) + " $1::vector";
+    statement.sql = "SELECT id, " + distance + " AS distance FROM " + table_name +
+                    " ORDER BY " + distance + " LIMIT $2::bigint";
+
+    std::string vector(binary::vector_size(dimension), '\0');
+    binary::put_vector(&vector[0], query, dimension);
+    std::string limit(sizeof(int64_t), '\0');
+    binary::put_int64(&limit[0], static_cast<int64_t>(k));
+    statement.params = {std::move(vector), std::move(limit)};
+
+    auto promise = std::make_shared<std::promise<std::vector<std::pair<int64_t, float>>>>();
+    auto future = promise->get_future();
+
+    std::vector<AsyncQuery> queries;
+    queries.push_back(std::move(statement));
+    submit(std::move(queries), [promise, op](AsyncResult result) {
+        std::vector<std::pair<int64_t, float>> hits;
+        if (!result.ok()) {
+            std::cerr << "Query failed: " << result.error << std::endl;
+        } else if (!result.results.empty()) {
+            PGresult* res = result.results.front().get();
+            int rows = PQntuples(res);
+            hits.reserve(rows);
+            for (int i = 0; i < rows; ++i) {
+                int64_t id = 0;
+                binary::get_id(PQgetvalue(res, i, 0), PQgetlength(res, i, 0), id);
+                double distance = binary::get_float8(PQgetvalue(res, i, 1));
+                if (op == DistanceOperator::L2) distance *= distance;
+                hits.emplace_back(id, static_cast<float>(distance));
+            }
+        }
+        promise->set_value(std::move(hits));
+    });
+
+    return future;
+}
+
+void PGVAsyncConnection::enqueue(std::unique_ptr<Job> job) {
+    // Jobs without statements have nothing to wait for and complete at once
+    if (!job->queries.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) {
+            queued_.push_back(std::move(job));
+            // Still under the lock, so stop() cannot have closed wake_fd_ yet
+            uint64_t one = 1;
+            ssize_t written = write(wake_fd_, &one, sizeof(one));
+            (void)written;
+            return;
+        }
+        job->result.error = "connection not started";
+    }
+    complete(*job);
+}
+
+void PGVAsyncConnection::run() {
+    epoll_event events[2];
+
+    while (running_) {
+        int ready = epoll_wait(epoll_fd_, events, 2, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            fail_all(std::string("epoll_wait failed: ") + std::strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.fd == wake_fd_) {
+                uint64_t counter;
+                ssize_t drained = read(wake_fd_, &counter, sizeof(counter));
+                (void)drained;
+            }
+        }
+
+        if (!running_) break;
+        if (broken_) {
+            // Only the wake fd is polled now; queued jobs fail as they arrive
+            fail_all("connection lost");
+            continue;
+        }
+
+        read_results();
+        send_jobs();
+        update_poll_events();
+    }
+}
+
+void PGVAsyncConnection::send_jobs() {
+    for (;;) {
+        // Without pipeline mode only one job (and one statement) is on the wire
+        size_t limit = pipelining_ ? max_in_flight_ : 1;
+        if (in_flight_.size() >= limit) return;
+
+        std::unique_ptr<Job> job;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queued_.empty()) return;
+            job = std::move(queued_.front());
+            queued_.pop_front();
+        }
+
+        bool ok = true;
+        if (pipelining_) {
+            for (const auto& query : job->queries) {
+                ok = ok && send_query(query);
+            }
+#ifdef LIBPQ_HAS_PIPELINING
+            ok = ok && PQpipelineSync(conn_) == 1;
+#endif
+            job->sent = job->queries.size();
+        } else {
+            ok = send_query(job->queries.front());
+            job->sent = 1;
+        }
+
+        in_flight_.push_back(std::move(job));
+        if (!ok) {
+            fail_connection(false);
+            return;
+        }
+    }
+}
+
+bool PGVAsyncConnection::send_query(const AsyncQuery& query) {
+    std::vector<const char*> values;
+    std::vector<int> lengths;
+    std::vector<int> formats;
+    values.reserve(query.params.size());
+    lengths.reserve(query.params.size());
+    formats.reserve(query.params.size());
+
+    for (size_t i = 0; i < query.params.size(); ++i) {
+        values.push_back(query.params[i].data());
+        lengths.push_back(static_cast<int>(query.params[i].size()));
+        formats.push_back(i < query.formats.size() ? query.formats[i] : 1);
+    }
+
+    return PQsendQueryParams(conn_, query.sql.c_str(), static_cast<int>(values.size()), nullptr,
+                             values.data(), lengths.data(), formats.data(), query.result_format) == 1;
+}
+
+void PGVAsyncConnection::read_results() {
+    if (!PQconsumeInput(conn_)) {
+        fail_connection(true);
+        return;
+    }
+
+    while (!in_flight_.empty() && !PQisBusy(conn_)) {
+        Job& job = *in_flight_.front();
+        PGresult* res = PQgetResult(conn_);
+
+        if (!res) {
+            // End of one statement's results
+            ++job.completed;
+            if (pipelining_) continue;   // the job completes at its sync point
+
+            if (job.completed < job.queries.size() && job.result.ok()) {
+                if (!send_query(job.queries[job.completed])) {
+                    fail_connection(false);
+                    return;
+                }
+                ++job.sent;
+                continue;
+            }
+            finish_front();
+            continue;
+        }
+
+        ExecStatusType status = PQresultStatus(res);
+#ifdef LIBPQ_HAS_PIPELINING
+        if (status == PGRES_PIPELINE_SYNC) {
+            PQclear(res);
+            finish_front();
+            continue;
+        }
+        if (status == PGRES_PIPELINE_ABORTED) {
+            // Skipped because an earlier statement in the job failed
+            PQclear(res);
+            continue;
+        }
+#endif
+        if (status == PGRES_FATAL_ERROR || status == PGRES_BAD_RESPONSE || status == PGRES_NONFATAL_ERROR) {
+            if (job.result.error.empty()) {
+                job.result.error = PQresultErrorMessage(res);
+            }
+            PQclear(res);
+            continue;
+        }
+
+        job.result.results.emplace_back(res, PQclear);
+    }
+}
+
+void PGVAsyncConnection::finish_front(const std::string& error) {
+    std::unique_ptr<Job> job = std::move(in_flight_.front());
+    in_flight_.pop_front();
+
+    if (!error.empty() && job->result.error.empty()) {
+        job->result.error = error;
+    }
+    complete(*job);
+}
+
+void PGVAsyncConnection::complete(Job& job) {
+    if (job.callback) {
+        job.callback(std::move(job.result));
+    } else {
+        job.promise.set_value(std::move(job.result));
+    }
+}
+
+void PGVAsyncConnection::fail_all(const std::string& error) {
+    while (!in_flight_.empty()) {
+        finish_front(error);
+    }
+
+    std::deque<std::unique_ptr<Job>> queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued.swap(queued_);
+    }
+    for (auto& job : queued) {
+        in_flight_.push_back(std::move(job));
+        finish_front(error);
+    }
+}
+
+void PGVAsyncConnection::fail_connection(bool fatal) {
+    const std::string error = PQerrorMessage(conn_);
+    if ((fatal || PQstatus(conn_) == CONNECTION_BAD) && !broken_) {
+        std::cerr << "Async connection lost: " << error << std::endl;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket_fd_, nullptr);
+        broken_ = true;
+    }
+    fail_all(error);
+}
+
+void PGVAsyncConnection::update_poll_events() {
+    if (!conn_ || broken_) return;
+
+    // PQflush returns 1 while output is still queued; wait for writability then
+    bool want_write = PQflush(conn_) == 1;
+    if (want_write == want_write_) return;
+    want_write_ = want_write;
+
+    epoll_event socket_event = {};
+    socket_event.events = EPOLLIN | (want_write_ ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    socket_event.data.fd = socket_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket_fd_, &socket_event) != 0) {
+        // The socket is no longer polled as needed, so nothing in flight would finish
+        std::cerr << "Failed to update epoll events: " << std::strerror(errno) << std::endl;
+        fail_connection(true);
+    }
+}
+
+} // namespace pgvector
@@ -0,0 +1,119 @@
+#ifndef PGV_ASYNC_H
+#define PGV_ASYNC_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <libpq-fe.h>
+
+#include "pgv_connection.h"
+
+namespace pgvector {
+
+struct AsyncResult {
+    std::vector<std::shared_ptr<PGresult>> results;   // one per statement in the job
+    std::string error;
+
+    bool ok() const { return error.empty(); }
+};
+
+// One statement with binary-or-text parameters owned by the job.
+struct AsyncQuery {
+    std::string sql;
+    std::vector<std::string> params;
+    std::vector<int> formats;        // 1 = binary, 0 = text; defaults to binary
+    int result_format = 1;
+};
+
+// Non-blocking PostgreSQL connection driven by a dedicated I/O thread.
+// Jobs are queued from any thread, sent with PQsendQueryParams and, where
+// libpq supports it (PG14+ client), pipelined with one sync per job so many
+// jobs are in flight on a single connection. The I/O thread waits on the
+// socket with epoll and completes futures or callbacks as results arrive;
+// callbacks run on the I/O thread and must not block. Jobs without
+// statements, and jobs submitted while the connection is not running,
+// complete on the submitting thread.
+class PGVAsyncConnection {
+public:
+    using Callback = std::function<void(AsyncResult)>;
+
+    explicit PGVAsyncConnection(const std::string& connection_string, size_t max_in_flight = 64);
+    ~PGVAsyncConnection();
+
+    PGVAsyncConnection(const PGVAsyncConnection&) = delete;
+    PGVAsyncConnection& operator=(const PGVAsyncConnection&) = delete;
+
+    bool start();
+    void stop();
+    bool is_running() const { return running_.load(); }
+    // The server connection failed: pending jobs were failed, later ones
+    // fail at once until the connection is stopped and started again
+    bool is_broken() const { return broken_.load(); }
+    bool pipelining() const { return pipelining_; }
+
+    std::future<AsyncResult> submit(std::vector<AsyncQuery> queries);
+    void submit(std::vector<AsyncQuery> queries, Callback done);
+
+    // Multi-row INSERT statements with binary parameters, split so each
+    // statement carries at most rows_per_statement rows.
+    std::future<AsyncResult> insert_vectors(const std::string& table_name, const float* vectors,
+                                            const int64_t* ids, size_t count, int dimension,
+                                            size_t rows_per_statement = 1000);
+
+    // L2 distances are squared, as in PGVConnection::similarity_search
+    std::future<std::vector<std::pair<int64_t, float>>> similarity_search(
+        const std::string& table_name, const float* query, int dimension, size_t k,
+        DistanceOperator op = DistanceOperator::L2);
+
+private:
+    struct Job {
+        std::vector<AsyncQuery> queries;
+        size_t sent = 0;
+        size_t completed = 0;
+        AsyncResult result;
+        Callback callback;
+        std::promise<AsyncResult> promise;
+    };
+
+    std::string conn_string_;
+    size_t max_in_flight_;
+    PGconn* conn_;
+    bool pipelining_;
+
+    int epoll_fd_;
+    int wake_fd_;
+    int socket_fd_;                                 // as registered with epoll; libpq may drop it on failure
+    std::thread io_thread_;
+    std::atomic<bool> running_;
+    std::atomic<bool> broken_;
+
+    std::mutex mutex_;
+    std::deque<std::unique_ptr<Job>> queued_;       // guarded by mutex_
+    std::deque<std::unique_ptr<Job>> in_flight_;    // I/O thread only
+    bool want_write_;
+
+    void enqueue(std::unique_ptr<Job> job);
+    void run();
+    void send_jobs();
+    bool send_query(const AsyncQuery& query);
+    void read_results();
+    void finish_front(const std::string& error = std::string());
+    static void complete(Job& job);
+    void fail_all(const std::string& error);
+    // Fails every job with libpq's error; when the connection itself is gone
+    // (always with `fatal`) the socket also leaves epoll, which would
+    // otherwise report it ready forever
+    void fail_connection(bool fatal);
+    void update_poll_events();
+};
+
+} // namespace pgvector
+
+#endif
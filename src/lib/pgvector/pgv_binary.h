@@ -0,0 +1,239 @@
+#ifndef PGV_BINARY_H
+#define PGV_BINARY_H
+
+// Helpers for PostgreSQL's binary wire format (network byte order) and
+// pgvector's binary type representations:
+//   vector     int16 dim | int16 unused (0) | float4[dim]
+//   halfvec    int16 dim | int16 unused (0) | binary16[dim]
+//   sparsevec  int32 dim | int32 nnz | int32 unused (0) | int32 index[nnz] | float4 value[nnz]
+// Sparse indexes are zero-based and ascending on the wire.
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+namespace pgvector {
+namespace binary {
+
+// "PGCOPY\n\377\r\n\0" followed by int32 flags and int32 header extension length
+constexpr char kCopySignature[11] = {'P', 'G', 'C', 'O', 'P', 'Y', '\n', '\377', '\r', '\n', '\0'};
+constexpr size_t kCopyHeaderSize = sizeof(kCopySignature) + 4 + 4;
+constexpr size_t kVectorHeaderSize = 4;
+constexpr size_t kSparseHeaderSize = 12;
+
+inline char* put_uint16(char* out, uint16_t value) {
+    out[0] = static_cast<char>(value >> 8);
+    out[1] = static_cast<char>(value);
+    return out + 2;
+}
+
+inline char* put_uint32(char* out, uint32_t value) {
+    out[0] = static_cast<char>(value >> 24);
+    out[1] = static_cast<char>(value >> 16);
+    out[2] = static_cast<char>(value >> 8);
+    out[3] = static_cast<char>(value);
+    return out + 4;
+}
+
+inline char* put_uint64(char* out, uint64_t value) {
+    out = put_uint32(out, static_cast<uint32_t>(value >> 32));
+    return put_uint32(out, static_cast<uint32_t>(value));
+}
+
+inline char* put_int16(char* out, int16_t value) { return put_uint16(out, static_cast<uint16_t>(value)); }
+inline char* put_int32(char* out, int32_t value) { return put_uint32(out, static_cast<uint32_t>(value)); }
+inline char* put_int64(char* out, int64_t value) { return put_uint64(out, static_cast<uint64_t>(value)); }
+
+inline char* put_float4(char* out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return put_uint32(out, bits);
+}
+
+inline size_t vector_size(int dimension) {
+    return kVectorHeaderSize + sizeof(float) * static_cast<size_t>(dimension);
+}
+
+// Encodes one pgvector value; `out` must hold vector_size(dimension) bytes.
+inline char* put_vector(char* out, const float* values, int dimension) {
+    out = put_int16(out, static_cast<int16_t>(dimension));
+    out = put_int16(out, 0);
+    for (int i = 0; i < dimension; ++i) {
+        out = put_float4(out, values[i]);
+    }
+    return out;
+}
+
+inline size_t halfvec_size(int dimension) {
+    return kVectorHeaderSize + sizeof(uint16_t) * static_cast<size_t>(dimension);
+}
+
+// Encodes one halfvec from binary16 values in host order; `out` must hold
+// halfvec_size(dimension) bytes.
+inline char* put_halfvec(char* out, const uint16_t* halves, int dimension) {
+    out = put_int16(out, static_cast<int16_t>(dimension));
+    out = put_int16(out, 0);
+    for (int i = 0; i < dimension; ++i) {
+        out = put_uint16(out, halves[i]);
+    }
+    return out;
+}
+
+inline size_t sparsevec_size(size_t nonzeros) {
+    return kSparseHeaderSize + (sizeof(int32_t) + sizeof(float)) * nonzeros;
+}
+
+// Encodes the nonzero elements of a dense vector as a sparsevec; `out` must
+// hold sparsevec_size(nonzeros) bytes.
+inline char* put_sparsevec(char* out, const float* values, int dimension, size_t nonzeros) {
+    out = put_int32(out, dimension);
+    out = put_int32(out, static_cast<int32_t>(nonzeros));
+    out = put_int32(out, 0);
+    char* value_out = out + sizeof(int32_t) * nonzeros;
+    for (int i = 0; i < dimension; ++i) {
+        if (values[i] != 0.0f) {
+            out = put_int32(out, i);
+            value_out = put_float4(value_out, values[i]);
+        }
+    }
+    return value_out;
+}
+
+inline char* put_copy_header(char* out) {
+    std::memcpy(out, kCopySignature, sizeof(kCopySignature));
+    out += sizeof(kCopySignature);
+    out = put_int32(out, 0);
+    return put_int32(out, 0);
+}
+
+// Field count, the id field and the embedding's length word of a COPY row
+constexpr size_t kCopyRowOverhead = 2 + (4 + sizeof(int64_t)) + 4;
+
+// Size of one (id bigint, embedding vector) tuple in COPY BINARY format.
+inline size_t copy_row_size(int dimension) {
+    return kCopyRowOverhead + vector_size(dimension);
+}
+
+// Writes a row up to its embedding, which the caller encodes in `value_size`
+// bytes at the returned position.
+inline char* put_copy_row_header(char* out, int64_t id, size_t value_size) {
+    out = put_int16(out, 2);
+    out = put_int32(out, static_cast<int32_t>(sizeof(int64_t)));
+    out = put_int64(out, id);
+    return put_int32(out, static_cast<int32_t>(value_size));
+}
+
+inline char* put_copy_row(char* out, int64_t id, const float* values, int dimension) {
+    out = put_copy_row_header(out, id, vector_size(dimension));
+    return put_vector(out, values, dimension);
+}
+
+inline char* put_copy_trailer(char* out) {
+    return put_int16(out, -1);
+}
+
+constexpr uint32_t kInt8Oid = 20;
+
+// Size of a one-dimensional bigint[] in array_send format.
+inline size_t int8_array_size(size_t count) {
+    return 5 * 4 + count * (4 + sizeof(int64_t));
+}
+
+// Encodes `count` ids as a bigint[] parameter; `out` must hold int8_array_size(count) bytes.
+inline char* put_int8_array(char* out, const int64_t* values, size_t count) {
+    out = put_int32(out, 1);                               // ndim
+    out = put_int32(out, 0);                               // no NULLs
+    out = put_uint32(out, kInt8Oid);                       // element type
+    out = put_int32(out, static_cast<int32_t>(count));     // dimension length
+    out = put_int32(out, 1);                               // lower bound
+    for (size_t i = 0; i < count; ++i) {
+        out = put_int32(out, static_cast<int32_t>(sizeof(int64_t)));
+        out = put_int64(out, values[i]);
+    }
+    return out;
+}
+
+inline uint16_t get_uint16(const char* in) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t get_uint32(const char* in) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline uint64_t get_uint64(const char* in) {
+    return (uint64_t(get_uint32(in)) << 32) | get_uint32(in + 4);
+}
+
+inline int16_t get_int16(const char* in) { return static_cast<int16_t>(get_uint16(in)); }
+inline int32_t get_int32(const char* in) { return static_cast<int32_t>(get_uint32(in)); }
+inline int64_t get_int64(const char* in) { return static_cast<int64_t>(get_uint64(in)); }
+
+inline float get_float4(const char* in) {
+    uint32_t bits = get_uint32(in);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline double get_float8(const char* in) {
+    uint64_t bits = get_uint64(in);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Decodes a binary bigint or integer column value.
+inline bool get_id(const char* in, int length, int64_t& id) {
+    if (length == 8) {
+        id = get_int64(in);
+        return true;
+    }
+    if (length == 4) {
+        id = get_int32(in);
+        return true;
+    }
+    return false;
+}
+
+// Decodes one pgvector value into `out`; fails if the stored dimension differs.
+inline bool get_vector(const char* in, int length, float* out, int dimension) {
+    if (length < static_cast<int>(kVectorHeaderSize) || get_int16(in) != dimension ||
+        static_cast<size_t>(length) != vector_size(dimension)) {
+        return false;
+    }
+    in += kVectorHeaderSize;
+    for (int i = 0; i < dimension; ++i, in += 4) {
+        out[i] = get_float4(in);
+    }
+    return true;
+}
+
+// Decodes one sparsevec into a dense vector, zero-filling the gaps.
+inline bool get_sparsevec(const char* in, int length, float* out, int dimension) {
+    if (length < static_cast<int>(kSparseHeaderSize) || get_int32(in) != dimension) {
+        return false;
+    }
+    const int32_t nonzeros = get_int32(in + 4);
+    if (nonzeros < 0 || static_cast<size_t>(length) != sparsevec_size(static_cast<size_t>(nonzeros))) {
+        return false;
+    }
+    std::memset(out, 0, sizeof(float) * static_cast<size_t>(dimension));
+    const char* indexes = in + kSparseHeaderSize;
+    const char* values = indexes + sizeof(int32_t) * static_cast<size_t>(nonzeros);
+    for (int32_t i = 0; i < nonzeros; ++i) {
+        int32_t index = get_int32(indexes + 4 * i);
+        if (index < 0 || index >= dimension) {
+            return false;
+        }
+        out[index] = get_float4(values + 4 * i);
+    }
+    return true;
+}
+
+} // namespace binary
+} // namespace pgvector
+
+#endif
@@ -0,0 +1,247 @@
+#include "pgv_connection.h"
+#include "pgv_binary.h"
+#include <cerrno>
+#include <iostream>
+#include <poll.h>
+
+namespace pgvector {
+
+namespace {
+
+const char* const kChangeCursor = "pgv_changes";
+
+std::string changes_table(const std::string& table_name) {
+    return table_name + "_faiss_changes";
+}
+
+std::string sync_state_table(const std::string& table_name) {
+    return table_name + "_faiss_sync_state";
+}
+
+std::string versions_table(const std::string& table_name) {
+    return table_name + "_faiss_index_versions";
+}
+
+std::string xid8_literal(uint64_t xid) {
+    return "'" + std::to_string(xid) + "'::xid8";
+}
+
+} // namespace
+
+std::string change_channel(const std::string& table_name) {
+    return changes_table(table_name);
+}
+
+bool PGVConnection::install_change_capture(const std::string& table_name) {
+    const std::string changes = changes_table(table_name);
+    const std::string function = table_name + "_faiss_capture";
+
+    // The key dedupes ids touched repeatedly within one transaction and
+    // serves the consumer's xid range scans
+    const std::string create_sql =
+        "CREATE TABLE IF NOT EXISTS " + changes + " ("
+        "xid xid8 NOT NULL DEFAULT pg_current_xact_id(), "
+        "id bigint NOT NULL, "
+        "PRIMARY KEY (xid, id))";
+
+    // Rows are re-read by id when the change is applied, so only ids are logged.
+    // Notifications are folded per transaction by the server.
+    const std::string function_sql =
+        "CREATE OR REPLACE FUNCTION " + function + "() RETURNS trigger LANGUAGE plpgsql AS $pgv$\n"
+        "BEGIN\n"
+        "    IF TG_OP <> 'INSERT' THEN\n"
+        "        INSERT INTO " + changes + " (id) VALUES (OLD.id) ON CONFLICT DO NOTHING;\n"
+        "    END IF;\n"
+        "    IF TG_OP <> 'DELETE' THEN\n"
+        "        INSERT INTO " + changes + " (id) VALUES (NEW.id) ON CONFLICT DO NOTHING;\n"
+        "    END IF;\n"
+        "    PERFORM pg_notify('" + change_channel(table_name) + "', '');\n"
+        "    RETURN NULL;\n"
+        "END\n"
+        "$pgv$";
+
+    const std::string trigger_sql =
+        "CREATE TRIGGER faiss_capture AFTER INSERT OR UPDATE OF id, embedding OR DELETE ON " +
+        table_name + " FOR EACH ROW EXECUTE FUNCTION " + function + "()";
+
+    if (!execute_query("BEGIN")) return false;
+    if (!execute_query(create_sql) || !execute_query(function_sql) ||
+        !execute_query("DROP TRIGGER IF EXISTS faiss_capture ON " + table_name) ||
+        !execute_query(trigger_sql) || !execute_query("COMMIT")) {
+        execute_query("ROLLBACK");
+        return false;
+    }
+    return true;
+}
+
+uint64_t PGVConnection::change_horizon() {
+    PGresult* result = execute_params("", "SELECT pg_snapshot_xmin(pg_current_snapshot())::text::bigint",
+                                      0, nullptr, nullptr, nullptr, PGRES_TUPLES_OK);
+    if (!result) return 0;
+
+    uint64_t horizon = PQntuples(result) == 1 ? static_cast<uint64_t>(binary::get_int64(PQgetvalue(result, 0, 0))) : 0;
+    PQclear(result);
+    return horizon;
+}
+
+int64_t PGVConnection::fetch_changes(const std::string& table_name, int dimension, uint64_t from, uint64_t to,
+                                     size_t chunk_rows, const ChangeCallback& on_changes) {
+    if (!is_connected() || dimension <= 0 || chunk_rows == 0 || !on_changes) return -1;
+    if (from >= to) return 0;
+
+    const std::string declare_sql =
+        std::string("DECLARE ") + kChangeCursor + " NO SCROLL CURSOR FOR "
+        "SELECT c.id, t.embedding FROM (SELECT DISTINCT id FROM " + changes_table(table_name) +
+        " WHERE xid >= " + xid8_literal(from) + " AND xid < " + xid8_literal(to) + ") c "
+        "LEFT JOIN " + table_name + " t ON t.id = c.id";
+
+    if (!execute_query("BEGIN")) return -1;
+    if (!execute_query(declare_sql)) {
+        execute_query("ROLLBACK");
+        return -1;
+    }
+
+    std::vector<int64_t> upsert_ids;
+    std::vector<float> vectors;
+    std::vector<int64_t> deleted_ids;
+    upsert_ids.reserve(chunk_rows);
+    vectors.reserve(chunk_rows * static_cast<size_t>(dimension));
+
+    int64_t total = 0;
+    bool ok = true;
+    while (ok) {
+        PGresult* result = fetch_vector_chunk(kChangeCursor, chunk_rows);
+        if (!result) {
+            ok = false;
+            break;
+        }
+
+        int rows = PQntuples(result);
+        upsert_ids.clear();
+        deleted_ids.clear();
+        vectors.resize(static_cast<size_t>(rows) * dimension);
+        for (int i = 0; i < rows && ok; ++i) {
+            int64_t id = 0;
+            if (!binary::get_id(PQgetvalue(result, i, 0), PQgetlength(result, i, 0), id)) {
+                ok = false;
+            } else if (PQgetisnull(result, i, 1)) {
+                deleted_ids.push_back(id);   // the row is gone (or never committed)
+            } else if (PGVConnection::decode_embedding(PQgetvalue(result, i, 1), PQgetlength(result, i, 1),
+                                                       vectors.data() + upsert_ids.size() * dimension, dimension)) {
+                upsert_ids.push_back(id);
+            } else {
+                std::cerr << "Change capture: embedding of id " << id << " does not match dimension "
+                          << dimension << std::endl;
+                ok = false;
+            }
+        }
+        PQclear(result);
+
+        if (ok && rows > 0) {
+            ok = on_changes(upsert_ids.data(), vectors.data(), upsert_ids.size(),
+                            deleted_ids.data(), deleted_ids.size());
+            total += rows;
+        }
+        if (static_cast<size_t>(rows) < chunk_rows) break;
+    }
+
+    return close_vector_cursor(kChangeCursor, ok) && ok ? total : -1;
+}
+
+bool PGVConnection::save_change_watermark(const std::string& table_name, int64_t index_version,
+                                          uint64_t watermark) {
+    const std::string state = sync_state_table(table_name);
+
+    // Older watermarks go away with the index versions they describe
+    if (!execute_query("CREATE TABLE IF NOT EXISTS " + state + " ("
+                       "index_version bigint PRIMARY KEY REFERENCES " + versions_table(table_name) +
+                       " (version) ON DELETE CASCADE, "
+                       "watermark bigint NOT NULL)")) {
+        return false;
+    }
+
+    char version_param[sizeof(int64_t)];
+    char watermark_param[sizeof(int64_t)];
+    binary::put_int64(version_param, index_version);
+    binary::put_int64(watermark_param, static_cast<int64_t>(watermark));
+
+    const char* values[2] = {version_param, watermark_param};
+    const int lengths[2] = {static_cast<int>(sizeof(version_param)), static_cast<int>(sizeof(watermark_param))};
+    const int formats[2] = {1, 1};
+
+    PGresult* result = execute_params("", "INSERT INTO " + state + " (index_version, watermark) VALUES ($1, $2) "
+                                      "ON CONFLICT (index_version) DO UPDATE SET watermark = EXCLUDED.watermark",
+                                      2, values, lengths, formats, PGRES_COMMAND_OK);
+    if (!result) return false;
+    PQclear(result);
+    return true;
+}
+
+uint64_t PGVConnection::load_change_watermark(const std::string& table_name, int64_t index_version) {
+    const std::string state = sync_state_table(table_name);
+
+    PGresult* result = execute_query_result("SELECT to_regclass('" + state + "') IS NOT NULL");
+    if (!result) return 0;
+    bool exists = PQntuples(result) == 1 && PQgetvalue(result, 0, 0)[0] == 't';
+    PQclear(result);
+    if (!exists) return 0;
+
+    char version_param[sizeof(int64_t)];
+    binary::put_int64(version_param, index_version);
+    const char* values[1] = {version_param};
+    const int lengths[1] = {static_cast<int>(sizeof(version_param))};
+    const int formats[1] = {1};
+
+    // An older version's watermark is also safe: replaying changes is idempotent
+    result = execute_params("", "SELECT coalesce(max(watermark), 0) FROM " + state + " WHERE index_version <= $1",
+                            1, values, lengths, formats, PGRES_TUPLES_OK);
+    if (!result) return 0;
+
+    uint64_t watermark = PQntuples(result) == 1 ? static_cast<uint64_t>(binary::get_int64(PQgetvalue(result, 0, 0))) : 0;
+    PQclear(result);
+    return watermark;
+}
+
+bool PGVConnection::prune_changes(const std::string& table_name) {
+    // No recorded watermark means min() is NULL and nothing is deleted
+    return execute_query("DELETE FROM " + changes_table(table_name) + " WHERE xid < "
+                         "(SELECT min(watermark) FROM " + sync_state_table(table_name) + ")::text::xid8");
+}
+
+bool PGVConnection::listen(const std::string& channel) {
+    if (!is_connected()) return false;
+
+    char* quoted = PQescapeIdentifier(conn_, channel.c_str(), channel.size());
+    if (!quoted) return false;
+    bool ok = execute_query(std::string("LISTEN ") + quoted);
+    PQfreemem(quoted);
+    return ok;
+}
+
+bool PGVConnection::wait_for_notification(int timeout_ms) {
+    if (!is_connected()) return false;
+
+    auto drain = [this] {
+        bool any = false;
+        while (PGnotify* notify = PQnotifies(conn_)) {
+            any = true;
+            PQfreemem(notify);
+        }
+        return any;
+    };
+
+    if (drain()) return true;
+
+    pollfd fd = {PQsocket(conn_), POLLIN, 0};
+    int ready = ::poll(&fd, 1, timeout_ms);
+    if (ready < 0 && errno != EINTR) return false;
+    if (ready <= 0) return false;
+
+    if (!PQconsumeInput(conn_)) {
+        std::cerr << "LISTEN connection failed: " << PQerrorMessage(conn_) << std::endl;
+        return false;
+    }
+    return drain();
+}
+
+} // namespace pgvector
@@ -1,10 +1,161 @@
 #include "pgv_connection.h"
+#include "pgv_binary.h"
+#include "core/metrics.h"
+#include "core/result_cache.h"
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <sstream>
-#include <iomanip>
 
 namespace pgvector {
 
+namespace {
+
+// PostgreSQL truncates identifiers to 63 bytes, which would let long table
+// names sharing a prefix collide, so tables are named by a 64-bit FNV-1a hash
+std::string statement_name(const char* kind, const std::string& table_name) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : table_name) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    static const char digits[] = "0123456789abcdef";
+    std::string name(kind);
+    name += '_';
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        name += digits[(hash >> shift) & 0xf];
+    }
+    return name;
+}
+
+// Each operator has a search statement of its own
+const char* search_statement(DistanceOperator op) {
+    switch (op) {
+    case DistanceOperator::InnerProduct: return "pgv_search_ip";
+    case DistanceOperator::Cosine: return "pgv_search_cosine";
+    default: return "pgv_search";
+    }
+}
+
+std::string search_sql(const std::string& table_name, DistanceOperator op) {
+    const std::string distance = std::string("embedding ") + distance_operator_sql(op) + " $1::vector";
+    return "SELECT id, " + distance + " AS distance FROM " + table_name +
+           " ORDER BY " + distance + " LIMIT $2::bigint";
+}
+
+std::string insert_sql(const std::string& table_name) {
+    return "INSERT INTO " + table_name + " (id, embedding) VALUES ($1::bigint, $2::vector)";
+}
+
+std::string fetch_by_id_sql(const std::string& table_name) {
+    return "SELECT id, embedding FROM " + table_name + " WHERE id = ANY($1::bigint[])";
+}
+
+std::string load_index_sql(const std::string& table_name) {
+    return "SELECT index_data FROM " + table_name + "_faiss_index ORDER BY id DESC LIMIT 1";
+}
+
+// Shifts $n placeholders in a caller predicate by `offset` so they follow the
+// query's own parameters. String literals, quoted identifiers, dollar-quoted
+// strings and comments are copied untouched.
+std::string renumber_parameters(const std::string& sql, int offset) {
+    std::string out;
+    out.reserve(sql.size() + 8);
+    
+    size_t i = 0;
+    while (i < sql.size()) {
+        char c = sql[i];
+        
+        if (c == '\'' || c == '"') {
+            size_t end = i + 1;
+            while (end < sql.size()) {
+                if (sql[end] == c) {
+                    // Doubled quote is an escaped quote, keep scanning
+                    if (end + 1 < sql.size() && sql[end + 1] == c) {
+                        end += 2;
+                        continue;
+                    }
+                    break;
+                }
+                ++end;
+            }
+            end = std::min(end + 1, sql.size());
+            out.append(sql, i, end - i);
+            i = end;
+        } else if (c == '-' && i + 1 < sql.size() && sql[i + 1] == '-') {
+            size_t end = sql.find('\n', i);
+            end = end == std::string::npos ? sql.size() : end;
+            out.append(sql, i, end - i);
+            i = end;
+        } else if (c == '/' && i + 1 < sql.size() && sql[i + 1] == '*') {
+            size_t end = sql.find("*/", i + 2);
+            end = end == std::string::npos ? sql.size() : end + 2;
+            out.append(sql, i, end - i);
+            i = end;
+        } else if (c == '$' && i + 1 < sql.size() && std::isdigit(static_cast<unsigned char>(sql[i + 1]))) {
+            size_t end = i + 1;
+            while (end < sql.size() && std::isdigit(static_cast<unsigned char>(sql[end]))) ++end;
+            out += '$';
+            out += std::to_string(std::stoi(sql.substr(i + 1, end - i - 1)) + offset);
+            i = end;
+        } else if (c == '$') {
+            // $tag$ ... $tag$ (including $$ ... $$)
+            size_t tag_end = i + 1;
+            while (tag_end < sql.size() &&
+                   (std::isalnum(static_cast<unsigned char>(sql[tag_end])) || sql[tag_end] == '_')) {
+                ++tag_end;
+            }
+            if (tag_end < sql.size() && sql[tag_end] == '$') {
+                std::string tag = sql.substr(i, tag_end - i + 1);
+                size_t close = sql.find(tag, tag_end + 1);
+                size_t end = close == std::string::npos ? sql.size() : close + tag.size();
+                out.append(sql, i, end - i);
+                i = end;
+            } else {
+                out += c;
+                ++i;
+            }
+        } else {
+            out += c;
+            ++i;
+        }
+    }
+    
+    return out;
+}
+
+// <-> is the plain L2 distance; it is squared to match what FAISS reports
+std::vector<std::pair<int64_t, float>> decode_search_rows(const PGresult* result, DistanceOperator op) {
+    std::vector<std::pair<int64_t, float>> rows;
+    int count = PQntuples(result);
+    rows.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        int64_t id = 0;
+        binary::get_id(PQgetvalue(result, i, 0), PQgetlength(result, i, 0), id);
+        double distance = binary::get_float8(PQgetvalue(result, i, 1));
+        if (op == DistanceOperator::L2) distance *= distance;
+        rows.emplace_back(id, static_cast<float>(distance));
+    }
+    return rows;
+}
+
+} // namespace
+
+const char* vector_column_sql(VectorColumn column) {
+    switch (column) {
+    case VectorColumn::Halfvec: return "halfvec";
+    case VectorColumn::Sparsevec: return "sparsevec";
+    default: return "vector";
+    }
+}
+
+const char* distance_operator_sql(DistanceOperator op) {
+    switch (op) {
+    case DistanceOperator::InnerProduct: return "<#>";
+    case DistanceOperator::Cosine: return "<=>";
+    default: return "<->";
+    }
+}
+
 PGVConnection::PGVConnection(const std::string& connection_string) 
     : conn_string_(connection_string), conn_(nullptr) {
 }
@@ -32,12 +183,66 @@ void PGVConnection::disconnect() {
         PQfinish(conn_);
         conn_ = nullptr;
     }
+    prepared_.clear();
 }
 
 bool PGVConnection::is_connected() const {
     return conn_ && PQstatus(conn_) == CONNECTION_OK;
 }
 
+bool PGVConnection::reconnect() {
+    disconnect();
+    return connect();
+}
+
+bool PGVConnection::ping() {
+    if (!is_connected()) return false;
+    
+    PGresult* result = PQexec(conn_, "SELECT 1");
+    bool alive = PQresultStatus(result) == PGRES_TUPLES_OK;
+    PQclear(result);
+    return alive && is_connected();
+}
+
+bool PGVConnection::prepare_statements(const std::string& table_name) {
+    if (!is_connected()) return false;
+    
+    struct Statement {
+        const char* kind;
+        std::string sql;
+        bool required;
+    };
+    
+    // The index table only exists once an index was saved, so its statement is optional
+    const Statement statements[] = {
+        {search_statement(distance_), search_sql(table_name, distance_), true},
+        {"pgv_insert", insert_sql(table_name), true},
+        {"pgv_fetch", fetch_by_id_sql(table_name), true},
+        {"pgv_load_index", load_index_sql(table_name), false},
+    };
+    
+    bool ok = true;
+    for (const auto& statement : statements) {
+        std::string name = statement_name(statement.kind, table_name);
+        if (prepared_.count(name)) continue;
+        
+        PGresult* result = PQprepare(conn_, name.c_str(), statement.sql.c_str(), 0, nullptr);
+        if (PQresultStatus(result) == PGRES_COMMAND_OK) {
+            prepared_.insert(name);
+        } else if (statement.required) {
+            std::cerr << "Prepare failed: " << PQerrorMessage(conn_) << std::endl;
+            ok = false;
+        }
+        PQclear(result);
+    }
+    
+    return ok;
+}
+
+bool PGVConnection::has_prepared_statements(const std::string& table_name) const {
+    return prepared_.count(statement_name(search_statement(distance_), table_name)) > 0;
+}
+
 bool PGVConnection::create_extension() {
     return execute_query("CREATE EXTENSION IF NOT EXISTS vector");
 }
@@ -45,21 +250,27 @@ bool PGVConnection::create_extension() {
 bool PGVConnection::create_table(const std::string& table_name, int dimension) {
     std::ostringstream query;
     query << "CREATE TABLE IF NOT EXISTS " << table_name 
-          << " (id bigserial PRIMARY KEY, embedding vector(" << dimension << "))";
+          << " (id bigserial PRIMARY KEY, embedding " << vector_column_sql(column_) << "(" << dimension << "))";
     return execute_query(query.str());
 }
 
 bool PGVConnection::insert_vector(const std::string& table_name, int64_t id, const std::vector<float>& vector) {
-    std::ostringstream query;
-    query << "INSERT INTO " << table_name << " (id, embedding) VALUES (" << id << ", '[";
+    const ResultCache::WriteScope write(results_);
+    std::vector<char> id_param(sizeof(int64_t));
+    binary::put_int64(id_param.data(), id);
     
-    for (size_t i = 0; i < vector.size(); ++i) {
-        if (i > 0) query << ",";
-        query << std::fixed << std::setprecision(6) << vector[i];
-    }
-    query << "]')";
+    std::vector<char> vector_param(binary::vector_size(static_cast<int>(vector.size())));
+    binary::put_vector(vector_param.data(), vector.data(), static_cast<int>(vector.size()));
     
-    return execute_query(query.str());
+    const char* values[2] = {id_param.data(), vector_param.data()};
+    const int lengths[2] = {static_cast<int>(id_param.size()), static_cast<int>(vector_param.size())};
+    const int formats[2] = {1, 1};
+    
+    PGresult* result = execute_params(statement_name("pgv_insert", table_name), insert_sql(table_name),
+                                      2, values, lengths, formats, PGRES_COMMAND_OK);
+    const bool ok = result != nullptr;
+    PQclear(result);
+    return ok;
 }
 
 bool PGVConnection::batch_insert_vectors(const std::string& table_name, 
@@ -67,67 +278,199 @@ bool PGVConnection::batch_insert_vectors(const std::string& table_name,
                                        const std::vector<std::vector<float>>& vectors) {
     if (ids.size() != vectors.size()) return false;
     
-    std::ostringstream query;
-    query << "INSERT INTO " << table_name << " (id, embedding) VALUES ";
-    
-    for (size_t i = 0; i < ids.size(); ++i) {
-        if (i > 0) query << ", ";
-        query << "(" << ids[i] << ", '[";
-        
-        for (size_t j = 0; j < vectors[i].size(); ++j) {
-            if (j > 0) query << ",";
-            query << std::fixed << std::setprecision(6) << vectors[i][j];
-        }
-        query << "]')";
-    }
+    CopyOptions options;
+    options.rows_per_transaction = 0;
     
-    return execute_query(query.str());
+    return copy_rows(table_name, ids.data(), ids.size(),
+                     [&vectors](size_t row, int& dimension) {
+                         dimension = static_cast<int>(vectors[row].size());
+                         return vectors[row].data();
+                     }, options);
 }
 
 std::vector<std::pair<int64_t, float>> PGVConnection::similarity_search(
     const std::string& table_name, const std::vector<float>& query, size_t k) {
     
-    // TODO: Use parameterized queries to prevent SQL injection
-    // TODO: Add support for different distance operators (<->, <#>, <=>)  
-    // TODO: Implement connection pooling for high-throughput scenarios
-    // TODO: Add query caching and prepared statement optimization
-    std::ostringstream sql;
-    sql << "SELECT id, embedding <-> '[";
-    for (size_t i = 0; i < query.size(); ++i) {
-        if (i > 0) sql << ",";
-        sql << std::fixed << std::setprecision(6) << query[i];
-    }
-    sql << "]' AS distance FROM " << table_name 
-        << " ORDER BY embedding <-> '[";
-    for (size_t i = 0; i < query.size(); ++i) {
-        if (i > 0) sql << ",";
-        sql << std::fixed << std::setprecision(6) << query[i];
-    }
-    sql << "]' LIMIT " << k;
-    
-    auto result = execute_query_result(sql.str());
     std::vector<std::pair<int64_t, float>> results;
+    const uint64_t context = cache_context(table_name, k, nullptr);
+    const uint64_t epoch = results_ ? results_->epoch() : 0;
+    if (cached_results(query.data(), query.size(), context, results)) {
+        return results;
+    }
+    
+    std::vector<char> vector_param(binary::vector_size(static_cast<int>(query.size())));
+    binary::put_vector(vector_param.data(), query.data(), static_cast<int>(query.size()));
+    
+    char limit_param[sizeof(int64_t)];
+    binary::put_int64(limit_param, static_cast<int64_t>(k));
+    
+    const char* values[2] = {vector_param.data(), limit_param};
+    const int lengths[2] = {static_cast<int>(vector_param.size()), static_cast<int>(sizeof(limit_param))};
+    const int formats[2] = {1, 1};
+    
+    auto result = execute_params(statement_name(search_statement(distance_), table_name),
+                                 search_sql(table_name, distance_),
+                                 2, values, lengths, formats, PGRES_TUPLES_OK);
     
     if (result) {
-        int rows = PQntuples(result);
-        for (int i = 0; i < rows; ++i) {
-            int64_t id = std::stoll(PQgetvalue(result, i, 0));
-            float distance = std::stof(PQgetvalue(result, i, 1));
-            results.emplace_back(id, distance);
-        }
+        results = decode_search_rows(result, distance_);
         PQclear(result);
+        cache_results(query.data(), query.size(), context, epoch, results);
     }
     
     return results;
 }
 
+bool PGVConnection::similarity_search(const std::string& table_name, const float* query, int dimension,
+                                      size_t k, const SqlFilter& filter,
+                                      std::vector<std::pair<int64_t, float>>& results) {
+    results.clear();
+    if (!query || dimension <= 0 || k == 0) return true;
+    const uint64_t context = cache_context(table_name, k, &filter);
+    const uint64_t epoch = results_ ? results_->epoch() : 0;
+    if (cached_results(query, dimension, context, results)) {
+        return true;
+    }
+    
+    const std::string distance = std::string("embedding ") + distance_operator_sql(distance_) + " $1::vector";
+    std::string sql = "SELECT id, " + distance + " AS distance FROM " + table_name;
+    if (!filter.predicate.empty()) {
+        sql += " WHERE (" + renumber_parameters(filter.predicate, 2) + ")";
+    }
+    sql += " ORDER BY " + distance + " LIMIT $2::bigint";
+    
+    std::vector<char> vector_param(binary::vector_size(dimension));
+    binary::put_vector(vector_param.data(), query, dimension);
+    char limit_param[sizeof(int64_t)];
+    binary::put_int64(limit_param, static_cast<int64_t>(k));
+    
+    std::vector<const char*> values = {vector_param.data(), limit_param};
+    std::vector<int> lengths = {static_cast<int>(vector_param.size()), static_cast<int>(sizeof(limit_param))};
+    std::vector<int> formats = {1, 1};
+    for (const auto& param : filter.params) {
+        values.push_back(param.c_str());
+        lengths.push_back(0);
+        formats.push_back(0);
+    }
+    
+    auto result = execute_params("", sql, static_cast<int>(values.size()), values.data(), lengths.data(),
+                                 formats.data(), PGRES_TUPLES_OK);
+    if (!result) return false;
+    results = decode_search_rows(result, distance_);
+    PQclear(result);
+    cache_results(query, dimension, context, epoch, results);
+    return true;
+}
+
+uint64_t PGVConnection::cache_context(const std::string& table_name, size_t k, const SqlFilter* filter) const {
+    if (!results_) return 0;
+    uint64_t context = ResultCache::combine(0, conn_string_.data(), conn_string_.size());
+    context = ResultCache::combine(context, table_name.data(), table_name.size());
+    context = ResultCache::combine(ResultCache::combine(context, k), static_cast<uint64_t>(distance_));
+    if (filter) {
+        context = ResultCache::combine(context, filter->predicate.data(), filter->predicate.size());
+        for (const auto& param : filter->params) {
+            context = ResultCache::combine(context, param.data(), param.size());
+        }
+    }
+    return context;
+}
+
+bool PGVConnection::cached_results(const float* query, size_t dimension, uint64_t context,
+                                   std::vector<std::pair<int64_t, float>>& results) {
+    std::vector<SearchResult> hits;
+    if (!results_ || !results_->lookup(query, dimension, context, hits)) {
+        return false;
+    }
+    results.reserve(hits.size());
+    for (const SearchResult& hit : hits) results.emplace_back(hit.id, hit.distance);
+    return true;
+}
+
+void PGVConnection::cache_results(const float* query, size_t dimension, uint64_t context, uint64_t epoch,
+                                  const std::vector<std::pair<int64_t, float>>& results) {
+    if (!results_) return;
+    std::vector<SearchResult> hits;
+    hits.reserve(results.size());
+    for (const auto& row : results) hits.push_back({row.first, row.second});
+    results_->insert(query, dimension, context, epoch, hits);
+}
+
+bool PGVConnection::rerank_candidates(const std::string& table_name, const float* query, int dimension,
+                                      const int64_t* candidate_ids, size_t count, size_t k,
+                                      const SqlFilter& filter, std::vector<std::pair<int64_t, float>>& results,
+                                      size_t* matched) {
+    results.clear();
+    if (matched) *matched = 0;
+    if (!query || dimension <= 0 || !candidate_ids || count == 0 || k == 0) return true;
+    
+    // count(*) OVER () is evaluated before the LIMIT, so it reports how many
+    // candidates survived the filter
+    std::string sql = std::string("SELECT id, embedding ") + distance_operator_sql(distance_) +
+                      " $1::vector AS distance, count(*) OVER () FROM " + table_name + " WHERE id = ANY($2::bigint[])";
+    if (!filter.predicate.empty()) {
+        sql += " AND (" + renumber_parameters(filter.predicate, 3) + ")";
+    }
+    sql += " ORDER BY distance LIMIT $3::bigint";
+    
+    std::vector<char> vector_param(binary::vector_size(dimension));
+    binary::put_vector(vector_param.data(), query, dimension);
+    std::vector<char> ids_param(binary::int8_array_size(count));
+    binary::put_int8_array(ids_param.data(), candidate_ids, count);
+    char limit_param[sizeof(int64_t)];
+    binary::put_int64(limit_param, static_cast<int64_t>(k));
+    
+    std::vector<const char*> values = {vector_param.data(), ids_param.data(), limit_param};
+    std::vector<int> lengths = {static_cast<int>(vector_param.size()), static_cast<int>(ids_param.size()),
+                                static_cast<int>(sizeof(limit_param))};
+    std::vector<int> formats = {1, 1, 1};
+    for (const auto& param : filter.params) {
+        values.push_back(param.c_str());
+        lengths.push_back(0);
+        formats.push_back(0);
+    }
+    
+    auto result = execute_params("", sql, static_cast<int>(values.size()), values.data(), lengths.data(),
+                                 formats.data(), PGRES_TUPLES_OK);
+    if (!result) return false;
+    results = decode_search_rows(result, distance_);
+    if (matched && PQntuples(result) > 0) {
+        *matched = static_cast<size_t>(binary::get_int64(PQgetvalue(result, 0, 2)));
+    }
+    PQclear(result);
+    return true;
+}
+
+size_t PGVConnection::fetch_vectors_by_id(const std::string& table_name, const int64_t* ids, size_t count,
+                                          int dimension, float* vectors, int64_t* found_ids) {
+    if (!ids || count == 0 || dimension <= 0 || !vectors || !found_ids) return 0;
+    
+    std::vector<char> ids_param(binary::int8_array_size(count));
+    binary::put_int8_array(ids_param.data(), ids, count);
+    
+    const char* values[1] = {ids_param.data()};
+    const int lengths[1] = {static_cast<int>(ids_param.size())};
+    const int formats[1] = {1};
+    
+    PGresult* result = execute_params(statement_name("pgv_fetch", table_name), fetch_by_id_sql(table_name),
+                                      1, values, lengths, formats, PGRES_TUPLES_OK);
+    if (!result) return 0;
+    
+    size_t found = 0;
+    try {
+        found = decode_vector_rows(result, dimension, vectors, found_ids);
+    } catch (const std::exception& e) {
+        std::cerr << "Error decoding vectors: " << e.what() << std::endl;
+    }
+    PQclear(result);
+    return found;
+}
+
 int PGVConnection::save_index(const std::string& table_name, const std::vector<uint8_t>& index_data) {
     std::string index_table = table_name + "_faiss_index";
     
-    // TODO: Add versioning support for index storage
-    // TODO: Implement compression for large index data
-    // TODO: Add metadata storage (index type, parameters, creation time)
-    // TODO: Implement transactional safety for index updates
+    // Legacy single-blob format; versioned, compressed, checksummed and
+    // transactional storage is save_index_stream (pgv_index_storage.cpp)
     execute_query("CREATE TABLE IF NOT EXISTS " + index_table + " (id SERIAL PRIMARY KEY, index_data BYTEA)");
     execute_query("DELETE FROM " + index_table);
     
@@ -145,20 +488,15 @@ int PGVConnection::save_index(const std::string& table_name, const std::vector<u
 }
 
 std::vector<uint8_t> PGVConnection::load_index(const std::string& table_name) {
-    std::string index_table = table_name + "_faiss_index";
-    std::string query = "SELECT index_data FROM " + index_table + " ORDER BY id DESC LIMIT 1";
-    
-    auto result = execute_query_result(query);
+    // Binary results hand back the raw bytea, so no PQunescapeBytea pass is needed
+    auto result = execute_params(statement_name("pgv_load_index", table_name), load_index_sql(table_name),
+                                 0, nullptr, nullptr, nullptr, PGRES_TUPLES_OK);
     std::vector<uint8_t> data;
     
-    if (result && PQntuples(result) > 0) {
-        size_t length;
-        unsigned char* raw_data = PQunescapeBytea(
-            reinterpret_cast<unsigned char*>(PQgetvalue(result, 0, 0)), &length);
-        
-        if (raw_data) {
-            data.assign(raw_data, raw_data + length);
-            PQfreemem(raw_data);
+    if (result) {
+        if (PQntuples(result) > 0) {
+            const char* raw_data = PQgetvalue(result, 0, 0);
+            data.assign(raw_data, raw_data + PQgetlength(result, 0, 0));
         }
         PQclear(result);
     }
@@ -169,10 +507,12 @@ std::vector<uint8_t> PGVConnection::load_index(const std::string& table_name) {
 bool PGVConnection::execute_query(const std::string& query) {
     if (!is_connected()) return false;
     
+    metrics::Span span(metrics::Op::DbQuery);
     PGresult* result = PQexec(conn_, query.c_str());
     bool success = PQresultStatus(result) == PGRES_COMMAND_OK;
     
     if (!success) {
+        span.status(-2);
         std::cerr << "Query failed: " << PQerrorMessage(conn_) << std::endl;
         std::cerr << "Query: " << query << std::endl;
     }
@@ -184,8 +524,30 @@ bool PGVConnection::execute_query(const std::string& query) {
 PGresult* PGVConnection::execute_query_result(const std::string& query) {
     if (!is_connected()) return nullptr;
     
+    metrics::Span span(metrics::Op::DbQuery);
     PGresult* result = PQexec(conn_, query.c_str());
     if (PQresultStatus(result) != PGRES_TUPLES_OK) {
+        span.status(-2);
+        std::cerr << "Query failed: " << PQerrorMessage(conn_) << std::endl;
+        PQclear(result);
+        return nullptr;
+    }
+    
+    return result;
+}
+
+PGresult* PGVConnection::execute_params(const std::string& statement, const std::string& sql,
+                                        int nparams, const char* const* values, const int* lengths,
+                                        const int* formats, ExecStatusType expected) {
+    if (!is_connected()) return nullptr;
+    
+    metrics::Span span(metrics::Op::DbQuery);
+    PGresult* result = prepared_.count(statement)
+        ? PQexecPrepared(conn_, statement.c_str(), nparams, values, lengths, formats, 1)
+        : PQexecParams(conn_, sql.c_str(), nparams, nullptr, values, lengths, formats, 1);
+    
+    if (PQresultStatus(result) != expected) {
+        span.status(-2);
         std::cerr << "Query failed: " << PQerrorMessage(conn_) << std::endl;
         PQclear(result);
         return nullptr;
@@ -1,17 +1,102 @@
 #ifndef PGV_CONNECTION_H
 #define PGV_CONNECTION_H
 
-// TODO: Add connection pooling support for high-throughput applications
-// TODO: Add async operation support with callbacks or futures
+// Connection pooling lives in pgv_connection_pool.h.
 // TODO: Add transaction management and rollback capabilities
-// TODO: Add connection retry logic with exponential backoff
 
+#include <cstdint>
 #include <string>
 #include <vector>
+#include <functional>
+#include <memory>
+#include <unordered_set>
 #include <libpq-fe.h>
 
+class ResultCache;
+
 namespace pgvector {
 
+// Tuning knobs for the binary COPY ingestion path.
+struct CopyOptions {
+    size_t flush_bytes = 4 * 1024 * 1024;   // hand buffered rows to libpq once this many bytes are queued
+    size_t rows_per_transaction = 100000;   // each COPY statement commits at most this many rows (0 = single COPY)
+};
+
+// Per-chunk compression for persisted indexes. Codecs that were not found at
+// build time are unavailable; chunks that do not shrink are stored raw.
+enum class IndexCodec : int16_t {
+    None = 0,
+    Zstd = 1,
+    Lz4 = 2,
+};
+
+bool index_codec_available(IndexCodec codec);
+// Best codec compiled into this build (zstd, then lz4, then none)
+IndexCodec default_index_codec();
+
+struct IndexStorageOptions {
+    size_t chunk_bytes = 8 * 1024 * 1024;   // uncompressed bytes per stored chunk
+    IndexCodec codec = default_index_codec();
+    int compression_level = 3;
+    size_t keep_versions = 1;               // older versions are deleted once a save commits
+};
+
+// Streaming index persistence: the producer writes serialized bytes to the
+// sink as they are generated, the consumer pulls them back from the source.
+// A sink returns false to abort; a source returns fewer bytes than asked only
+// at the end of the stream or on a verification error.
+using IndexSink = std::function<bool(const uint8_t* data, size_t size)>;
+using IndexSource = std::function<size_t(uint8_t* data, size_t size)>;
+using IndexProducer = std::function<int(const IndexSink& sink)>;
+using IndexConsumer = std::function<int(const IndexSource& source)>;
+
+// Row sampling for training sets. SYSTEM reads only the sampled pages, so
+// rows stored together are drawn together; BERNOULLI draws rows independently
+// but the server still reads every page.
+enum class SampleMethod {
+    System,
+    Bernoulli,
+};
+
+struct TableSample {
+    SampleMethod method = SampleMethod::System;
+    double percent = 100.0;
+    uint64_t seed = 42;     // REPEATABLE seed, so the same table state gives the same sample
+};
+
+// Caller-supplied SQL predicate over the table's columns, e.g.
+// "tenant_id = $1 AND created_at > $2". The predicate numbers its own
+// parameters from $1; they are bound as text after the query's own
+// parameters. The predicate is embedded verbatim, so it must come from
+// trusted code; user input belongs in params.
+struct SqlFilter {
+    std::string predicate;              // empty = no filter
+    std::vector<std::string> params;    // text values for $1..$n in predicate
+};
+
+// pgvector operator the similarity queries order by
+enum class DistanceOperator {
+    L2,             // <->  Euclidean distance
+    InnerProduct,   // <#>  negative inner product
+    Cosine,         // <=>  cosine distance
+};
+
+const char* distance_operator_sql(DistanceOperator op);
+
+// pgvector type of the embedding column. Reads accept all three and convert
+// to float32; writes encode rows in the configured type, since binary COPY
+// does not cast. halfvec halves the wire and heap size of dense vectors.
+enum class VectorColumn {
+    Vector,         // float32
+    Halfvec,        // IEEE binary16
+    Sparsevec,      // nonzero elements only
+};
+
+const char* vector_column_sql(VectorColumn column);
+
+// NOTIFY channel used by change capture on `table_name`
+std::string change_channel(const std::string& table_name);
+
 class PGVConnection {
 public:
     explicit PGVConnection(const std::string& connection_string);
@@ -20,6 +105,33 @@ public:
     bool connect();
     void disconnect();
     bool is_connected() const;
+    bool reconnect();
+    // Round-trips a trivial query; detects connections the server dropped
+    bool ping();
+    
+    // Server-side prepared statements for search, insert, fetch-by-id and
+    // load_index on `table_name`. Vectors are bound as binary parameters and
+    // results come back in binary. Statements live on this connection only and
+    // are forgotten on disconnect; unprepared tables fall back to PQexecParams.
+    bool prepare_statements(const std::string& table_name);
+    bool has_prepared_statements(const std::string& table_name) const;
+    
+    // Operator for similarity_search and rerank_candidates (default L2).
+    // Statements prepared under another operator are left unused. Their L2
+    // distances are squared, like FAISS's.
+    void set_distance_operator(DistanceOperator op) { distance_ = op; }
+    DistanceOperator distance_operator() const { return distance_; }
+    
+    // Column type for create_table, copy_vectors, upsert_vectors and
+    // batch_insert_vectors (default vector)
+    void set_vector_column(VectorColumn column) { column_ = column; }
+    VectorColumn vector_column() const { return column_; }
+    
+    // Answers repeated similarity_search calls (same table, k, operator and
+    // filter) from `cache`, which may be shared; writes through this
+    // connection invalidate it. Writes by other clients are only caught by
+    // the cache's TTL. nullptr detaches.
+    void set_result_cache(std::shared_ptr<ResultCache> cache) { results_ = std::move(cache); }
 
     bool create_extension();
     bool create_table(const std::string& table_name, int dimension);
@@ -27,30 +139,150 @@ public:
     bool batch_insert_vectors(const std::string& table_name, const std::vector<int64_t>& ids, const std::vector<std::vector<float>>& vectors);
     
     std::vector<std::pair<int64_t, float>> similarity_search(const std::string& table_name, const std::vector<float>& query, size_t k);
+    // Exact pgvector scan restricted to rows matching `filter`; false on
+    // database errors, which leave `results` empty
+    bool similarity_search(const std::string& table_name, const float* query, int dimension, size_t k,
+                           const SqlFilter& filter, std::vector<std::pair<int64_t, float>>& results);
+    // Exact distances for the candidates that pass `filter`, best k first, in one
+    // round trip. `matched` receives how many candidates passed before the LIMIT.
+    // False on database errors.
+    bool rerank_candidates(const std::string& table_name, const float* query, int dimension,
+                           const int64_t* candidate_ids, size_t count, size_t k, const SqlFilter& filter,
+                           std::vector<std::pair<int64_t, float>>& results, size_t* matched = nullptr);
     
+    // Looks up embeddings by id; found rows are written to vectors/found_ids, returns how many
+    size_t fetch_vectors_by_id(const std::string& table_name, const int64_t* ids, size_t count, int dimension,
+                               float* vectors, int64_t* found_ids);
+    
+    // Legacy single-row BYTEA storage in <table>_faiss_index, limited to 1 GB.
     int save_index(const std::string& table_name, const std::vector<uint8_t>& index_data);
     std::vector<uint8_t> load_index(const std::string& table_name);
     
+    // Chunked storage in <table>_faiss_index_versions / <table>_faiss_index_chunks.
+    // Each save gets a new version written in one transaction; every chunk
+    // carries a CRC32 of its uncompressed bytes and the version records the
+    // CRC32 and size of the whole stream. Only one chunk is held in memory.
+    // save returns 0 on success, -1 for invalid options, -2 on database errors,
+    // -4 if the producer fails; a failed save leaves the previous version intact.
+    // `version`, if given, receives the version that was written or read.
+    int save_index_stream(const std::string& table_name, const IndexProducer& produce,
+                          const IndexStorageOptions& options = IndexStorageOptions(),
+                          int64_t* version = nullptr);
+    // Loads the newest version. Returns 0 on success, -1 if no chunked index is
+    // stored, -2 on database errors, -4 on corruption or consumer failure.
+    // Chunks are checked as they arrive, but the chunk count, size and
+    // whole-stream CRC only once the consumer has returned: consumers keep
+    // what they read to the side and apply it only after a 0 return.
+    int load_index_stream(const std::string& table_name, const IndexConsumer& consume,
+                          int64_t* version = nullptr);
+    // Newest complete version in chunked storage: 0 if none, -1 on errors
+    int64_t latest_index_version(const std::string& table_name);
+    
+    // Change capture for keeping an index in step with `table_name`. A row
+    // trigger logs every changed id with its transaction's xid8 in
+    // <table>_faiss_changes and notifies change_channel(table_name).
+    // Consumers read by xid range: all transactions below change_horizon()
+    // have finished, so a range below it never gains entries. Changed rows are
+    // read in their current state, which makes replaying a range harmless.
+    // Needs PostgreSQL 13 or later.
+    bool install_change_capture(const std::string& table_name);
+    // xid below which every transaction has finished; 0 on errors
+    uint64_t change_horizon();
+    using ChangeCallback = std::function<bool(const int64_t* upsert_ids, const float* vectors, size_t upserts,
+                                              const int64_t* deleted_ids, size_t deletes)>;
+    // Streams the ids changed by transactions in [from, to), chunk_rows at a time:
+    // rows that still exist come with their embedding, the rest as deletes.
+    // Returns the number of ids, -1 on errors or when the callback returns false.
+    int64_t fetch_changes(const std::string& table_name, int dimension, uint64_t from, uint64_t to,
+                          size_t chunk_rows, const ChangeCallback& on_changes);
+    // Records that index_version contains every change below `watermark`
+    bool save_change_watermark(const std::string& table_name, int64_t index_version, uint64_t watermark);
+    // Newest watermark recorded for index_version or an earlier version; 0 if none
+    uint64_t load_change_watermark(const std::string& table_name, int64_t index_version);
+    // Drops logged changes below the oldest recorded watermark
+    bool prune_changes(const std::string& table_name);
+    
+    // LISTEN on `channel`; wait_for_notification returns true once a
+    // notification has arrived, false on timeout or errors
+    bool listen(const std::string& channel);
+    bool wait_for_notification(int timeout_ms);
+    
     // Additional methods for vector operations
     std::vector<std::vector<float>> fetch_vectors(const std::string& table_name, int limit = 0);
     bool store_vectors(const std::string& table_name, const std::vector<std::vector<float>>& vectors, const std::vector<int64_t>& ids);
     
+    // Binary, cursor-streamed fetch of (id, embedding). Each chunk is pulled with
+    // FETCH FORWARD in binary result format and decoded straight into the
+    // caller's contiguous buffers (rows × dimension floats, rows ids).
+    size_t fetch_vectors(const std::string& table_name, int dimension, float* vectors, int64_t* ids,
+                         size_t max_rows, size_t fetch_rows = 10000);
+    
+    using VectorChunkCallback = std::function<bool(const float* vectors, const int64_t* ids, size_t count)>;
+    size_t stream_vectors(const std::string& table_name, int dimension, size_t chunk_rows,
+                          const VectorChunkCallback& on_chunk);
+    
+    // Low-level cursor primitives; fetch_vector_chunk results must be PQclear'ed.
+    bool open_vector_cursor(const std::string& table_name, const std::string& cursor_name,
+                            const TableSample* sample = nullptr);
+    // Planner estimate of the table's rows (pg_class.reltuples), counted
+    // exactly when the table was never analyzed; -1 on errors
+    int64_t estimate_rows(const std::string& table_name);
+    PGresult* fetch_vector_chunk(const std::string& cursor_name, size_t rows);
+    bool close_vector_cursor(const std::string& cursor_name, bool commit = true);
+    static size_t decode_vector_rows(const PGresult* result, int dimension, float* vectors, int64_t* ids);
+    // Decodes a binary vector, halfvec or sparsevec value, told apart by its
+    // layout; false if it is none of them or has another dimension
+    static bool decode_embedding(const char* value, int length, float* out, int dimension);
+    
+    // Streams `count` row-major vectors straight from the caller's buffer using
+    // COPY ... FROM STDIN (FORMAT BINARY). Rows are committed in batches of
+    // options.rows_per_transaction, so a failure leaves earlier batches in place.
+    bool copy_vectors(const std::string& table_name, const float* vectors, const int64_t* ids,
+                      size_t count, int dimension, const CopyOptions& options = CopyOptions());
+    
+    // Deletes the rows with these ids in one statement; returns the number of
+    // rows deleted, -1 on errors
+    int64_t delete_vectors(const std::string& table_name, const int64_t* ids, size_t count);
+    // Inserts or replaces rows: each batch of options.rows_per_transaction rows is
+    // COPYed into a session-local staging table and merged with INSERT ... ON
+    // CONFLICT (id) DO UPDATE in one transaction. The last row wins for ids
+    // repeated within a batch.
+    bool upsert_vectors(const std::string& table_name, const float* vectors, const int64_t* ids,
+                        size_t count, int dimension, const CopyOptions& options = CopyOptions());
+    
     // TODO: Add missing methods:
-    // - delete_vector(table_name, id) for vector removal
-    // - update_vector(table_name, id, vector) for vector modification
     // - get_table_stats(table_name) for table statistics
     // - vacuum_table(table_name) for maintenance operations
     // - create_index(table_name, index_type) for pgvector indices
-    // - batch_delete_vectors(table_name, ids) for bulk deletion
     // - get_vector_by_id(table_name, id) for single vector retrieval
 
 private:
     std::string conn_string_;
     PGconn* conn_;
+    DistanceOperator distance_ = DistanceOperator::L2;
+    VectorColumn column_ = VectorColumn::Vector;
+    std::shared_ptr<ResultCache> results_;
+    
+    std::unordered_set<std::string> prepared_;   // prepared statement names on conn_
     
     bool execute_query(const std::string& query);
     PGresult* execute_query_result(const std::string& query);
+    // Runs `statement` if it is prepared on this connection, else `sql` via PQexecParams.
+    // Results are requested in binary.
+    PGresult* execute_params(const std::string& statement, const std::string& sql,
+                             int nparams, const char* const* values, const int* lengths, const int* formats,
+                             ExecStatusType expected);
     std::vector<float> parse_vector_string(const std::string& vector_str);
+    // Result cache plumbing for similarity_search; no-ops without a cache
+    uint64_t cache_context(const std::string& table_name, size_t k, const SqlFilter* filter) const;
+    bool cached_results(const float* query, size_t dimension, uint64_t context,
+                        std::vector<std::pair<int64_t, float>>& results);
+    void cache_results(const float* query, size_t dimension, uint64_t context, uint64_t epoch,
+                       const std::vector<std::pair<int64_t, float>>& results);
+    
+    using RowAccessor = std::function<const float*(size_t row, int& dimension)>;
+    bool copy_rows(const std::string& table_name, const int64_t* ids, size_t count,
+                   const RowAccessor& row, const CopyOptions& options);
 };
 
 } // namespace pgvector
@@ -0,0 +1,216 @@
+#include "pgv_connection_pool.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+namespace pgvector {
+
+PGVConnectionPool::Lease::Lease(Lease&& other) noexcept 
+    : pool_(other.pool_), slot_(other.slot_) {
+    other.pool_ = nullptr;
+    other.slot_ = nullptr;
+}
+
+PGVConnectionPool::Lease& PGVConnectionPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        slot_ = other.slot_;
+        other.pool_ = nullptr;
+        other.slot_ = nullptr;
+    }
+    return *this;
+}
+
+PGVConnectionPool::Lease::~Lease() {
+    release();
+}
+
+PGVConnection* PGVConnectionPool::Lease::get() const {
+    return slot_ ? slot_->connection.get() : nullptr;
+}
+
+void PGVConnectionPool::Lease::invalidate() {
+    if (slot_) {
+        slot_->broken = true;
+    }
+}
+
+void PGVConnectionPool::Lease::release() {
+    if (pool_ && slot_) {
+        pool_->give_back(slot_);
+    }
+    pool_ = nullptr;
+    slot_ = nullptr;
+}
+
+PGVConnectionPool::PGVConnectionPool(const std::string& connection_string, const PoolOptions& options)
+    : conn_string_(connection_string), options_(options) {
+    options_.size = std::max<size_t>(options_.size, 1);
+    for (size_t i = 0; i < options_.size; ++i) {
+        auto slot = std::make_unique<Slot>();
+        slot->connection = std::make_unique<PGVConnection>(conn_string_);
+        slot->broken = true;
+        slots_.push_back(std::move(slot));
+    }
+}
+
+PGVConnectionPool::~PGVConnectionPool() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [this] {
+        return std::none_of(slots_.begin(), slots_.end(), [](const std::unique_ptr<Slot>& slot) {
+            return slot->in_use;
+        });
+    });
+}
+
+bool PGVConnectionPool::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    size_t connected = 0;
+    for (auto& slot : slots_) {
+        if (slot->in_use) continue;
+        if (slot->connection->connect()) {
+            slot->broken = false;
+            slot->last_used = std::chrono::steady_clock::now();
+            ++connected;
+        }
+    }
+    
+    return connected > 0;
+}
+
+PGVConnectionPool::Lease PGVConnectionPool::acquire() {
+    auto deadline = std::chrono::steady_clock::now() + options_.acquire_timeout;
+    std::unique_lock<std::mutex> lock(mutex_);
+    
+    // Slots that failed to (re)connect during this call are not retried
+    std::vector<Slot*> failed;
+    
+    for (;;) {
+        // Prefer a healthy idle connection, fall back to one that needs reconnecting
+        Slot* candidate = nullptr;
+        for (auto& slot : slots_) {
+            if (slot->in_use) continue;
+            if (std::find(failed.begin(), failed.end(), slot.get()) != failed.end()) continue;
+            if (!slot->broken) {
+                candidate = slot.get();
+                break;
+            }
+            if (!candidate) candidate = slot.get();
+        }
+        
+        if (candidate) {
+            candidate->in_use = true;
+            std::vector<std::string> tables = tables_;
+            lock.unlock();
+            
+            // Health checks and reconnects run without holding the pool lock
+            bool healthy = ensure_healthy(*candidate, deadline);
+            if (healthy) {
+                for (const auto& table : tables) {
+                    if (!candidate->connection->has_prepared_statements(table)) {
+                        candidate->connection->prepare_statements(table);
+                    }
+                }
+                return Lease(this, candidate);
+            }
+            
+            failed.push_back(candidate);
+            give_back(candidate);
+            lock.lock();
+            if (std::chrono::steady_clock::now() >= deadline) {
+                std::cerr << "Connection pool: timed out waiting for a healthy connection" << std::endl;
+                return Lease();
+            }
+            continue;
+        }
+        
+        if (failed.size() == slots_.size()) {
+            std::cerr << "Connection pool: no connection could be established" << std::endl;
+            return Lease();
+        }
+        
+        if (released_.wait_until(lock, deadline) == std::cv_status::timeout) {
+            std::cerr << "Connection pool: timed out waiting for a free connection" << std::endl;
+            return Lease();
+        }
+    }
+}
+
+bool PGVConnectionPool::prepare_table(const std::string& table_name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    if (std::find(tables_.begin(), tables_.end(), table_name) == tables_.end()) {
+        tables_.push_back(table_name);
+    }
+    
+    // Idle connections are prepared now, leased ones on their next acquire()
+    bool ok = true;
+    for (auto& slot : slots_) {
+        if (!slot->in_use && !slot->broken) {
+            ok = slot->connection->prepare_statements(table_name) && ok;
+        }
+    }
+    return ok;
+}
+
+size_t PGVConnectionPool::available() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::count_if(slots_.begin(), slots_.end(), [](const std::unique_ptr<Slot>& slot) {
+        return !slot->in_use;
+    });
+}
+
+bool PGVConnectionPool::ensure_healthy(Slot& slot, Deadline deadline) {
+    if (!slot.broken) {
+        auto idle = std::chrono::steady_clock::now() - slot.last_used;
+        bool needs_ping = idle >= options_.health_check_interval;
+        
+        if (slot.connection->is_connected() && (!needs_ping || slot.connection->ping())) {
+            return true;
+        }
+    }
+    
+    return connect_with_backoff(slot, deadline);
+}
+
+bool PGVConnectionPool::connect_with_backoff(Slot& slot, Deadline deadline) {
+    auto backoff = options_.initial_backoff;
+    
+    int attempt = 0;
+    for (; attempt < std::max(options_.max_reconnect_attempts, 1); ++attempt) {
+        if (attempt > 0) {
+            // Never sleep past the caller's acquire timeout
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) break;
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(backoff, deadline - now));
+            if (std::chrono::steady_clock::now() >= deadline) break;
+            backoff = std::min(backoff * 2, options_.max_backoff);
+        }
+        
+        if (slot.connection->reconnect()) {
+            slot.broken = false;
+            return true;
+        }
+    }
+    
+    std::cerr << "Connection pool: giving up after " << attempt
+              << " reconnect attempts" << std::endl;
+    slot.broken = true;
+    return false;
+}
+
+void PGVConnectionPool::give_back(Slot* slot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!slot->connection->is_connected()) {
+            slot->broken = true;
+        }
+        slot->last_used = std::chrono::steady_clock::now();
+        slot->in_use = false;
+    }
+    released_.notify_all();
+}
+
+} // namespace pgvector
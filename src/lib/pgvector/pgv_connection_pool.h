@@ -0,0 +1,104 @@
+#ifndef PGV_CONNECTION_POOL_H
+#define PGV_CONNECTION_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pgv_connection.h"
+
+namespace pgvector {
+
+struct PoolOptions {
+    size_t size = 4;
+    std::chrono::milliseconds acquire_timeout{5000};
+    // Idle connections older than this are pinged before being handed out
+    std::chrono::milliseconds health_check_interval{30000};
+    std::chrono::milliseconds initial_backoff{100};
+    std::chrono::milliseconds max_backoff{10000};
+    int max_reconnect_attempts = 5;
+};
+
+// Fixed-size pool of PGVConnection objects. Leased connections are checked
+// for health, reconnected with exponential backoff when broken, and carry
+// prepared statements for every table registered with prepare_table().
+class PGVConnectionPool {
+    struct Slot;
+
+public:
+    class Lease {
+    public:
+        Lease() : pool_(nullptr), slot_(nullptr) {}
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        explicit operator bool() const { return slot_ != nullptr; }
+        PGVConnection* get() const;
+        PGVConnection* operator->() const { return get(); }
+        PGVConnection& operator*() const { return *get(); }
+
+        // Marks the connection broken so it is reconnected before reuse
+        void invalidate();
+
+    private:
+        friend class PGVConnectionPool;
+        Lease(PGVConnectionPool* pool, Slot* slot) : pool_(pool), slot_(slot) {}
+        void release();
+
+        PGVConnectionPool* pool_;
+        Slot* slot_;
+    };
+
+    PGVConnectionPool(const std::string& connection_string, const PoolOptions& options = PoolOptions());
+    ~PGVConnectionPool();
+
+    PGVConnectionPool(const PGVConnectionPool&) = delete;
+    PGVConnectionPool& operator=(const PGVConnectionPool&) = delete;
+
+    // Opens every connection; returns false if none could be established
+    bool start();
+
+    // Blocks up to acquire_timeout, moving on to the next idle connection when
+    // one cannot be (re)established; returns an empty lease on timeout or once
+    // every connection has failed.
+    Lease acquire();
+
+    // Prepares statements for `table_name` on all current and future connections
+    bool prepare_table(const std::string& table_name);
+
+    size_t size() const { return slots_.size(); }
+    size_t available() const;
+
+private:
+    struct Slot {
+        std::unique_ptr<PGVConnection> connection;
+        std::chrono::steady_clock::time_point last_used;
+        bool in_use = false;
+        bool broken = false;
+    };
+
+    std::string conn_string_;
+    PoolOptions options_;
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::vector<std::string> tables_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+
+    using Deadline = std::chrono::steady_clock::time_point;
+    bool ensure_healthy(Slot& slot, Deadline deadline);
+    // Backoff sleeps end at `deadline`; no attempt is started after it
+    bool connect_with_backoff(Slot& slot, Deadline deadline);
+    void give_back(Slot* slot);
+};
+
+} // namespace pgvector
+
+#endif
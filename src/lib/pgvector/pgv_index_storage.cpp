@@ -0,0 +1,438 @@
+#include "pgv_connection.h"
+#include "pgv_binary.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+#if HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace pgvector {
+
+namespace {
+
+// Bumped whenever the chunk layout changes; older readers refuse newer versions
+const int32_t kStorageFormat = 1;
+const size_t kMaxChunkBytes = 256 * 1024 * 1024;
+const char* const kChunkCursor = "pgv_index_chunks";
+
+std::string versions_table(const std::string& table_name) {
+    return table_name + "_faiss_index_versions";
+}
+
+std::string chunks_table(const std::string& table_name) {
+    return table_name + "_faiss_index_chunks";
+}
+
+// CRC-32 (IEEE, reflected), the same checksum as zlib's crc32()
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size) {
+    static const struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+        }
+    } table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Compresses into `out`; returns false when the codec is unavailable or the
+// data does not shrink, in which case the chunk is stored raw.
+bool compress_chunk(IndexCodec codec, int level, const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    switch (codec) {
+#if HAVE_ZSTD
+    case IndexCodec::Zstd: {
+        out.resize(ZSTD_compressBound(size));
+        size_t written = ZSTD_compress(out.data(), out.size(), data, size, level);
+        if (ZSTD_isError(written) || written >= size) return false;
+        out.resize(written);
+        return true;
+    }
+#endif
+#if HAVE_LZ4
+    case IndexCodec::Lz4: {
+        out.resize(LZ4_compressBound(static_cast<int>(size)));
+        int written = LZ4_compress_default(reinterpret_cast<const char*>(data), reinterpret_cast<char*>(out.data()),
+                                           static_cast<int>(size), static_cast<int>(out.size()));
+        if (written <= 0 || static_cast<size_t>(written) >= size) return false;
+        out.resize(written);
+        return true;
+    }
+#endif
+    default:
+        // Referenced only by the codecs compiled in
+        (void)level;
+        (void)data;
+        (void)size;
+        (void)out;
+        return false;
+    }
+}
+
+bool decompress_chunk(IndexCodec codec, const char* data, size_t size, uint8_t* out, size_t raw_size) {
+    switch (codec) {
+    case IndexCodec::None:
+        if (size != raw_size) return false;
+        std::memcpy(out, data, size);
+        return true;
+#if HAVE_ZSTD
+    case IndexCodec::Zstd: {
+        size_t written = ZSTD_decompress(out, raw_size, data, size);
+        return !ZSTD_isError(written) && written == raw_size;
+    }
+#endif
+#if HAVE_LZ4
+    case IndexCodec::Lz4: {
+        int written = LZ4_decompress_safe(data, reinterpret_cast<char*>(out), static_cast<int>(size),
+                                          static_cast<int>(raw_size));
+        return written >= 0 && static_cast<size_t>(written) == raw_size;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+bool index_codec_available(IndexCodec codec) {
+    switch (codec) {
+    case IndexCodec::None:
+        return true;
+    case IndexCodec::Zstd:
+        return HAVE_ZSTD != 0;
+    case IndexCodec::Lz4:
+        return HAVE_LZ4 != 0;
+    }
+    return false;
+}
+
+IndexCodec default_index_codec() {
+    if (index_codec_available(IndexCodec::Zstd)) return IndexCodec::Zstd;
+    if (index_codec_available(IndexCodec::Lz4)) return IndexCodec::Lz4;
+    return IndexCodec::None;
+}
+
+int PGVConnection::save_index_stream(const std::string& table_name, const IndexProducer& produce,
+                                     const IndexStorageOptions& options, int64_t* saved_version) {
+    if (!is_connected()) return -2;
+    if (options.chunk_bytes == 0 || options.chunk_bytes > kMaxChunkBytes || !index_codec_available(options.codec)) {
+        std::cerr << "Invalid index storage options" << std::endl;
+        return -1;
+    }
+
+    const std::string versions = versions_table(table_name);
+    const std::string chunks = chunks_table(table_name);
+
+    if (!execute_query("BEGIN")) return -2;
+
+    bool ok = execute_query("CREATE TABLE IF NOT EXISTS " + versions +
+                            " (version bigserial PRIMARY KEY, format integer NOT NULL, chunk_bytes integer NOT NULL,"
+                            " chunk_count integer, total_bytes bigint, crc32 bigint,"
+                            " created_at timestamptz NOT NULL DEFAULT now())") &&
+              execute_query("CREATE TABLE IF NOT EXISTS " + chunks +
+                            " (version bigint NOT NULL REFERENCES " + versions + " (version) ON DELETE CASCADE,"
+                            " chunk_no integer NOT NULL, codec smallint NOT NULL, raw_bytes integer NOT NULL,"
+                            " crc32 bigint NOT NULL, data bytea NOT NULL, PRIMARY KEY (version, chunk_no))");
+
+    // The version row is completed (chunk_count set) only once every chunk is in
+    int64_t version = 0;
+    if (ok) {
+        char format_param[4];
+        char chunk_bytes_param[4];
+        binary::put_int32(format_param, kStorageFormat);
+        binary::put_int32(chunk_bytes_param, static_cast<int32_t>(options.chunk_bytes));
+        const char* values[2] = {format_param, chunk_bytes_param};
+        const int lengths[2] = {4, 4};
+        const int formats[2] = {1, 1};
+
+        PGresult* result = execute_params("", "INSERT INTO " + versions + " (format, chunk_bytes)"
+                                          " VALUES ($1::integer, $2::integer) RETURNING version",
+                                          2, values, lengths, formats, PGRES_TUPLES_OK);
+        ok = result && PQntuples(result) == 1 &&
+             binary::get_id(PQgetvalue(result, 0, 0), PQgetlength(result, 0, 0), version);
+        if (result) PQclear(result);
+    }
+
+    if (!ok) {
+        execute_query("ROLLBACK");
+        return -2;
+    }
+
+    const std::string insert_chunk = "INSERT INTO " + chunks + " (version, chunk_no, codec, raw_bytes, crc32, data)"
+                                     " VALUES ($1::bigint, $2::integer, $3::smallint, $4::integer, $5::bigint, $6::bytea)";
+
+    std::vector<uint8_t> buffer;
+    std::vector<uint8_t> compressed;
+    buffer.reserve(options.chunk_bytes);
+    int32_t chunk_no = 0;
+    uint64_t total_bytes = 0;
+    uint32_t total_crc = 0;
+    bool db_failed = false;
+
+    auto flush_chunk = [&]() -> bool {
+        if (buffer.empty()) return true;
+
+        uint32_t crc = crc32_update(0, buffer.data(), buffer.size());
+        total_crc = crc32_update(total_crc, buffer.data(), buffer.size());
+        total_bytes += buffer.size();
+
+        IndexCodec codec = options.codec;
+        const uint8_t* payload = buffer.data();
+        size_t payload_size = buffer.size();
+        if (codec != IndexCodec::None &&
+            compress_chunk(codec, options.compression_level, buffer.data(), buffer.size(), compressed)) {
+            payload = compressed.data();
+            payload_size = compressed.size();
+        } else {
+            codec = IndexCodec::None;
+        }
+
+        char version_param[8];
+        char chunk_param[4];
+        char codec_param[2];
+        char raw_param[4];
+        char crc_param[8];
+        binary::put_int64(version_param, version);
+        binary::put_int32(chunk_param, chunk_no);
+        binary::put_int16(codec_param, static_cast<int16_t>(codec));
+        binary::put_int32(raw_param, static_cast<int32_t>(buffer.size()));
+        binary::put_int64(crc_param, static_cast<int64_t>(crc));
+
+        // bytea goes over the wire as a binary parameter: no escaping, no literal
+        const char* values[6] = {version_param, chunk_param, codec_param, raw_param, crc_param,
+                                 reinterpret_cast<const char*>(payload)};
+        const int lengths[6] = {8, 4, 2, 4, 8, static_cast<int>(payload_size)};
+        const int formats[6] = {1, 1, 1, 1, 1, 1};
+
+        PGresult* result = execute_params("", insert_chunk, 6, values, lengths, formats, PGRES_COMMAND_OK);
+        if (!result) {
+            db_failed = true;
+            return false;
+        }
+        PQclear(result);
+
+        ++chunk_no;
+        buffer.clear();
+        return true;
+    };
+
+    IndexSink sink = [&](const uint8_t* data, size_t size) -> bool {
+        while (size > 0) {
+            size_t take = std::min(size, options.chunk_bytes - buffer.size());
+            buffer.insert(buffer.end(), data, data + take);
+            data += take;
+            size -= take;
+            if (buffer.size() == options.chunk_bytes && !flush_chunk()) return false;
+        }
+        return true;
+    };
+
+    int status = produce(sink);
+    if (status != 0 || db_failed || !flush_chunk()) {
+        execute_query("ROLLBACK");
+        return db_failed ? -2 : -4;
+    }
+
+    char version_param[8];
+    char count_param[4];
+    char total_param[8];
+    char crc_param[8];
+    binary::put_int64(version_param, version);
+    binary::put_int32(count_param, chunk_no);
+    binary::put_int64(total_param, static_cast<int64_t>(total_bytes));
+    binary::put_int64(crc_param, static_cast<int64_t>(total_crc));
+    const char* values[4] = {version_param, count_param, total_param, crc_param};
+    const int lengths[4] = {8, 4, 8, 8};
+    const int formats[4] = {1, 1, 1, 1};
+
+    PGresult* result = execute_params("", "UPDATE " + versions + " SET chunk_count = $2::integer,"
+                                      " total_bytes = $3::bigint, crc32 = $4::bigint WHERE version = $1::bigint",
+                                      4, values, lengths, formats, PGRES_COMMAND_OK);
+    ok = result != nullptr;
+    if (result) PQclear(result);
+
+    if (ok && options.keep_versions > 0) {
+        ok = execute_query("DELETE FROM " + versions + " WHERE version NOT IN (SELECT version FROM " + versions +
+                           " WHERE chunk_count IS NOT NULL ORDER BY version DESC LIMIT " +
+                           std::to_string(options.keep_versions) + ")");
+    }
+
+    if (!ok || !execute_query("COMMIT")) {
+        execute_query("ROLLBACK");
+        return -2;
+    }
+    if (saved_version) *saved_version = version;
+    return 0;
+}
+
+int PGVConnection::load_index_stream(const std::string& table_name, const IndexConsumer& consume,
+                                     int64_t* loaded_version) {
+    if (!is_connected()) return -2;
+
+    const std::string versions = versions_table(table_name);
+
+    // One snapshot for the version row and its chunks, so a concurrent save
+    // pruning old versions cannot pull chunks out from under the reader
+    if (!execute_query("BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY")) return -2;
+
+    PGresult* result = execute_query_result("SELECT to_regclass('" + versions + "') IS NOT NULL");
+    if (!result) {
+        execute_query("ROLLBACK");
+        return -2;
+    }
+    bool exists = PQntuples(result) == 1 && PQgetvalue(result, 0, 0)[0] == 't';
+    PQclear(result);
+    if (!exists) {
+        execute_query("ROLLBACK");
+        return -1;
+    }
+
+    result = execute_params("", "SELECT version, format, chunk_count, total_bytes, crc32 FROM " + versions +
+                            " WHERE chunk_count IS NOT NULL ORDER BY version DESC LIMIT 1",
+                            0, nullptr, nullptr, nullptr, PGRES_TUPLES_OK);
+    if (!result) {
+        execute_query("ROLLBACK");
+        return -2;
+    }
+    if (PQntuples(result) == 0) {
+        PQclear(result);
+        execute_query("ROLLBACK");
+        return -1;
+    }
+
+    int64_t version = binary::get_int64(PQgetvalue(result, 0, 0));
+    int32_t format = binary::get_int32(PQgetvalue(result, 0, 1));
+    int32_t chunk_count = binary::get_int32(PQgetvalue(result, 0, 2));
+    uint64_t total_bytes = static_cast<uint64_t>(binary::get_int64(PQgetvalue(result, 0, 3)));
+    uint32_t total_crc = static_cast<uint32_t>(binary::get_int64(PQgetvalue(result, 0, 4)));
+    PQclear(result);
+
+    if (format != kStorageFormat) {
+        std::cerr << "Unsupported index storage format " << format << std::endl;
+        execute_query("ROLLBACK");
+        return -4;
+    }
+
+    if (!execute_query(std::string("DECLARE ") + kChunkCursor + " NO SCROLL CURSOR FOR"
+                       " SELECT chunk_no, codec, raw_bytes, crc32, data FROM " + chunks_table(table_name) +
+                       " WHERE version = " + std::to_string(version) + " ORDER BY chunk_no")) {
+        execute_query("ROLLBACK");
+        return -2;
+    }
+
+    const std::string fetch = std::string("FETCH FORWARD 1 FROM ") + kChunkCursor;
+    std::vector<uint8_t> chunk;
+    size_t position = 0;
+    int32_t next_chunk = 0;
+    uint64_t read_bytes = 0;
+    uint32_t read_crc = 0;
+    bool db_failed = false;
+    bool corrupt = false;
+
+    // Pulls and verifies the next chunk; false at the end or on error
+    auto next = [&]() -> bool {
+        PGresult* row = execute_params("", fetch, 0, nullptr, nullptr, nullptr, PGRES_TUPLES_OK);
+        if (!row) {
+            db_failed = true;
+            return false;
+        }
+        if (PQntuples(row) == 0) {
+            PQclear(row);
+            return false;
+        }
+
+        int32_t chunk_no = binary::get_int32(PQgetvalue(row, 0, 0));
+        IndexCodec codec = static_cast<IndexCodec>(binary::get_int16(PQgetvalue(row, 0, 1)));
+        int32_t raw_bytes = binary::get_int32(PQgetvalue(row, 0, 2));
+        uint32_t crc = static_cast<uint32_t>(binary::get_int64(PQgetvalue(row, 0, 3)));
+
+        bool valid = chunk_no == next_chunk && raw_bytes > 0 && static_cast<size_t>(raw_bytes) <= kMaxChunkBytes;
+        if (valid) {
+            chunk.resize(raw_bytes);
+            valid = decompress_chunk(codec, PQgetvalue(row, 0, 4), PQgetlength(row, 0, 4), chunk.data(), chunk.size()) &&
+                    crc32_update(0, chunk.data(), chunk.size()) == crc;
+        }
+        PQclear(row);
+
+        if (!valid) {
+            std::cerr << "Index chunk " << next_chunk << " of version " << version << " failed verification" << std::endl;
+            corrupt = true;
+            return false;
+        }
+
+        read_crc = crc32_update(read_crc, chunk.data(), chunk.size());
+        read_bytes += chunk.size();
+        position = 0;
+        ++next_chunk;
+        return true;
+    };
+
+    IndexSource source = [&](uint8_t* data, size_t size) -> size_t {
+        size_t copied = 0;
+        while (copied < size) {
+            if (position == chunk.size() && (corrupt || db_failed || !next())) break;
+            size_t take = std::min(size - copied, chunk.size() - position);
+            std::memcpy(data + copied, chunk.data() + position, take);
+            position += take;
+            copied += take;
+        }
+        return copied;
+    };
+
+    int status = consume(source);
+
+    if (status == 0 && !corrupt && !db_failed) {
+        bool trailing = position < chunk.size() || next();
+        if (trailing || next_chunk != chunk_count || read_bytes != total_bytes || read_crc != total_crc) {
+            if (!db_failed) {
+                std::cerr << "Index version " << version << " does not match its checksum" << std::endl;
+                corrupt = true;
+            }
+        }
+    }
+
+    execute_query(std::string("CLOSE ") + kChunkCursor);
+    execute_query("COMMIT");
+
+    if (db_failed) return -2;
+    if (corrupt || status != 0) return -4;
+    if (loaded_version) *loaded_version = version;
+    return 0;
+}
+
+int64_t PGVConnection::latest_index_version(const std::string& table_name) {
+    if (!is_connected()) return -1;
+
+    const std::string versions = versions_table(table_name);
+
+    PGresult* result = execute_query_result("SELECT to_regclass('" + versions + "') IS NOT NULL");
+    if (!result) return -1;
+    bool exists = PQntuples(result) == 1 && PQgetvalue(result, 0, 0)[0] == 't';
+    PQclear(result);
+    if (!exists) return 0;
+
+    result = execute_params("", "SELECT coalesce(max(version), 0) FROM " + versions + " WHERE chunk_count IS NOT NULL",
+                            0, nullptr, nullptr, nullptr, PGRES_TUPLES_OK);
+    if (!result) return -1;
+
+    int64_t version = PQntuples(result) == 1 ? binary::get_int64(PQgetvalue(result, 0, 0)) : 0;
+    PQclear(result);
+    return version;
+}
+
+} // namespace pgvector
@@ -1,6 +1,14 @@
 #include "pgv_connection.h"
+#include "pgv_binary.h"
+#include "core/metrics.h"
+#include "core/result_cache.h"
+#include "faiss/simd_kernels.h"
 #include <stdexcept>
 #include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <locale>
 
 namespace pgvector {
 
@@ -11,10 +19,9 @@ std::vector<std::vector<float>> PGVConnection::fetch_vectors(const std::string&
         throw std::runtime_error("Database connection not established");
     }
     
-    // TODO: Add support for streaming large result sets with cursors
-    // TODO: Implement memory-efficient chunked loading for very large datasets
-    // TODO: Add vector validation and dimension consistency checks
-    // TODO: Support different vector formats and data types
+    // NOTE: Text-format loader kept for compatibility; the binary overload below
+    // streams through a cursor into a contiguous buffer, also returns ids and
+    // reads halfvec and sparsevec columns as well.
     
     std::stringstream query;
     query << "SELECT embedding FROM " << table_name;
@@ -67,6 +74,217 @@ std::vector<std::vector<float>> PGVConnection::fetch_vectors(const std::string&
     return result;
 }
 
+size_t PGVConnection::fetch_vectors(const std::string& table_name, int dimension, 
+                                    float* vectors, int64_t* ids, size_t max_rows, size_t fetch_rows) {
+    if (!conn_) {
+        throw std::runtime_error("Database connection not established");
+    }
+    
+    if (!vectors || !ids || dimension <= 0 || max_rows == 0) {
+        return 0;
+    }
+    
+    const std::string cursor_name = "pgv_fetch_cursor";
+    if (!open_vector_cursor(table_name, cursor_name)) {
+        throw std::runtime_error("Failed to open cursor: " + std::string(PQerrorMessage(conn_)));
+    }
+    
+    size_t total = 0;
+    try {
+        while (total < max_rows) {
+            size_t want = std::min(fetch_rows > 0 ? fetch_rows : max_rows, max_rows - total);
+            // Cleared on every path, including a decode error
+            std::unique_ptr<PGresult, decltype(&PQclear)> res(fetch_vector_chunk(cursor_name, want), PQclear);
+            if (!res) {
+                throw std::runtime_error("Cursor fetch failed: " + std::string(PQerrorMessage(conn_)));
+            }
+            
+            size_t rows = decode_vector_rows(res.get(), dimension, 
+                                             vectors + total * static_cast<size_t>(dimension), 
+                                             ids + total);
+            
+            total += rows;
+            if (rows < want) break;
+        }
+    } catch (...) {
+        close_vector_cursor(cursor_name, false);
+        throw;
+    }
+    
+    close_vector_cursor(cursor_name);
+    return total;
+}
+
+size_t PGVConnection::stream_vectors(const std::string& table_name, int dimension, size_t chunk_rows,
+                                     const VectorChunkCallback& on_chunk) {
+    if (!conn_) {
+        throw std::runtime_error("Database connection not established");
+    }
+    
+    if (dimension <= 0 || chunk_rows == 0 || !on_chunk) {
+        return 0;
+    }
+    
+    const std::string cursor_name = "pgv_stream_cursor";
+    if (!open_vector_cursor(table_name, cursor_name)) {
+        throw std::runtime_error("Failed to open cursor: " + std::string(PQerrorMessage(conn_)));
+    }
+    
+    std::vector<float> chunk_vectors(chunk_rows * static_cast<size_t>(dimension));
+    std::vector<int64_t> chunk_ids(chunk_rows);
+    size_t total = 0;
+    
+    try {
+        for (;;) {
+            std::unique_ptr<PGresult, decltype(&PQclear)> res(fetch_vector_chunk(cursor_name, chunk_rows), PQclear);
+            if (!res) {
+                throw std::runtime_error("Cursor fetch failed: " + std::string(PQerrorMessage(conn_)));
+            }
+            
+            size_t rows = decode_vector_rows(res.get(), dimension, chunk_vectors.data(), chunk_ids.data());
+            res.reset();
+            
+            if (rows == 0) break;
+            total += rows;
+            
+            if (!on_chunk(chunk_vectors.data(), chunk_ids.data(), rows) || rows < chunk_rows) break;
+        }
+    } catch (...) {
+        close_vector_cursor(cursor_name, false);
+        throw;
+    }
+    
+    close_vector_cursor(cursor_name);
+    return total;
+}
+
+bool PGVConnection::open_vector_cursor(const std::string& table_name, const std::string& cursor_name,
+                                       const TableSample* sample) {
+    std::string from = table_name;
+    if (sample) {
+        std::ostringstream clause;
+        clause.imbue(std::locale::classic());
+        clause << " TABLESAMPLE " << (sample->method == SampleMethod::System ? "SYSTEM" : "BERNOULLI")
+               << " (" << std::min(std::max(sample->percent, 0.0), 100.0) << ") REPEATABLE ("
+               << static_cast<int64_t>(sample->seed & 0x7FFFFFFFFFFFFFFFull) << ")";
+        from += clause.str();
+    }
+    
+    if (!execute_query("BEGIN")) return false;
+    
+    if (!execute_query("DECLARE " + cursor_name + " NO SCROLL CURSOR FOR SELECT id, embedding FROM " + from)) {
+        execute_query("ROLLBACK");
+        return false;
+    }
+    return true;
+}
+
+PGresult* PGVConnection::fetch_vector_chunk(const std::string& cursor_name, size_t rows) {
+    if (!is_connected()) return nullptr;
+    
+    // The Bind message's result format overrides the cursor's own format,
+    // so rows arrive in binary without declaring a BINARY cursor.
+    std::string sql = "FETCH FORWARD " + std::to_string(rows) + " FROM " + cursor_name;
+    metrics::Span span(metrics::Op::DbQuery);
+    PGresult* res = PQexecParams(conn_, sql.c_str(), 0, nullptr, nullptr, nullptr, nullptr, 1);
+    
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        span.status(-2);
+        std::cerr << "Query failed: " << PQerrorMessage(conn_) << std::endl;
+        PQclear(res);
+        return nullptr;
+    }
+    
+    const int fetched = PQntuples(res);
+    span.set_items(fetched);
+    for (int i = 0; i < fetched; ++i) {
+        span.add_bytes(PQgetlength(res, i, 1));
+    }
+    return res;
+}
+
+bool PGVConnection::close_vector_cursor(const std::string& cursor_name, bool commit) {
+    if (!commit) {
+        return execute_query("ROLLBACK");
+    }
+    
+    bool closed = execute_query("CLOSE " + cursor_name);
+    return execute_query(closed ? "COMMIT" : "ROLLBACK") && closed;
+}
+
+int64_t PGVConnection::estimate_rows(const std::string& table_name) {
+    const char* values[1] = {table_name.c_str()};
+    const int lengths[1] = {0};
+    const int formats[1] = {0};
+    PGresult* result = execute_params("", "SELECT reltuples::bigint FROM pg_class WHERE oid = $1::regclass",
+                                      1, values, lengths, formats, PGRES_TUPLES_OK);
+    if (!result) return -1;
+    
+    int64_t rows = -1;
+    if (PQntuples(result) == 1 && !PQgetisnull(result, 0, 0)) {
+        binary::get_id(PQgetvalue(result, 0, 0), PQgetlength(result, 0, 0), rows);
+    }
+    PQclear(result);
+    if (rows > 0) return rows;
+    
+    // Never analyzed: -1 since PostgreSQL 14, 0 before
+    result = execute_params("", "SELECT count(*) FROM " + table_name, 0, nullptr, nullptr, nullptr, PGRES_TUPLES_OK);
+    if (!result) return -1;
+    rows = -1;
+    if (PQntuples(result) == 1) {
+        binary::get_id(PQgetvalue(result, 0, 0), PQgetlength(result, 0, 0), rows);
+    }
+    PQclear(result);
+    return rows;
+}
+
+size_t PGVConnection::decode_vector_rows(const PGresult* result, int dimension, 
+                                         float* vectors, int64_t* ids) {
+    if (!result || PQnfields(result) < 2 || PQfformat(result, 0) != 1 || PQfformat(result, 1) != 1) {
+        throw std::runtime_error("Expected binary (id, embedding) result");
+    }
+    
+    int rows = PQntuples(result);
+    for (int i = 0; i < rows; ++i) {
+        if (PQgetisnull(result, i, 0) || PQgetisnull(result, i, 1)) {
+            throw std::runtime_error("NULL id or embedding at row " + std::to_string(i));
+        }
+        
+        if (!binary::get_id(PQgetvalue(result, i, 0), PQgetlength(result, i, 0), ids[i])) {
+            throw std::runtime_error("Unsupported id column type");
+        }
+        
+        if (!decode_embedding(PQgetvalue(result, i, 1), PQgetlength(result, i, 1),
+                              vectors + static_cast<size_t>(i) * dimension, dimension)) {
+            throw std::runtime_error("Vector dimension mismatch for id " + std::to_string(ids[i]));
+        }
+    }
+    
+    return static_cast<size_t>(rows);
+}
+
+bool PGVConnection::decode_embedding(const char* value, int length, float* out, int dimension) {
+    // A sparsevec starts with an int32 dimension, so its first int16 is 0
+    const bool dense = length >= static_cast<int>(binary::kVectorHeaderSize) && binary::get_int16(value) == dimension;
+    if (dense && length == static_cast<int>(binary::vector_size(dimension))) {
+        return binary::get_vector(value, length, out, dimension);
+    }
+    if (dense && length == static_cast<int>(binary::halfvec_size(dimension))) {
+        // Swapped to host order a block at a time on the stack, then widened
+        uint16_t halves[256];
+        const char* in = value + binary::kVectorHeaderSize;
+        for (int begin = 0; begin < dimension; begin += 256) {
+            const int n = std::min(256, dimension - begin);
+            for (int i = 0; i < n; ++i) {
+                halves[i] = binary::get_uint16(in + 2 * (begin + i));
+            }
+            simd::to_float(simd::ElementType::Float16, halves, out + begin, static_cast<size_t>(n));
+        }
+        return true;
+    }
+    return binary::get_sparsevec(value, length, out, dimension);
+}
+
 bool PGVConnection::store_vectors(const std::string& table_name, 
                                  const std::vector<std::vector<float>>& vectors,
                                  const std::vector<int64_t>& ids) {
@@ -78,51 +296,195 @@ bool PGVConnection::store_vectors(const std::string& table_name,
         throw std::runtime_error("Vector and ID count mismatch");
     }
     
-    // TODO: Implement batch insert with COPY protocol for better performance
-    // TODO: Add support for upsert operations (ON CONFLICT DO UPDATE)
     // TODO: Implement automatic batch size optimization based on available memory
     // TODO: Add progress callbacks for large batch operations
     // TODO: Support different conflict resolution strategies
     
-    // Begin transaction
-    PGresult* res = PQexec(conn_, "BEGIN");
-    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-        PQclear(res);
+    // A single COPY statement keeps the previous all-or-nothing semantics
+    CopyOptions options;
+    options.rows_per_transaction = 0;
+    
+    return copy_rows(table_name, ids.data(), ids.size(),
+                     [&vectors](size_t row, int& dimension) {
+                         dimension = static_cast<int>(vectors[row].size());
+                         return vectors[row].data();
+                     }, options);
+}
+
+bool PGVConnection::copy_vectors(const std::string& table_name, const float* vectors, 
+                                 const int64_t* ids, size_t count, int dimension,
+                                 const CopyOptions& options) {
+    if (!conn_) {
+        throw std::runtime_error("Database connection not established");
+    }
+    
+    if (!vectors || !ids || dimension <= 0) {
         return false;
     }
-    PQclear(res);
     
-    try {
-        for (size_t i = 0; i < vectors.size(); ++i) {
-            std::stringstream query;
-            query << "INSERT INTO " << table_name << " (id, embedding) VALUES (" 
-                  << ids[i] << ", '[";
+    return copy_rows(table_name, ids, count,
+                     [vectors, dimension](size_t row, int& row_dimension) {
+                         row_dimension = dimension;
+                         return vectors + row * static_cast<size_t>(dimension);
+                     }, options);
+}
+
+int64_t PGVConnection::delete_vectors(const std::string& table_name, const int64_t* ids, size_t count) {
+    const ResultCache::WriteScope write(results_);
+    if (!ids || count == 0) return 0;
+    
+    std::vector<char> ids_param(binary::int8_array_size(count));
+    binary::put_int8_array(ids_param.data(), ids, count);
+    
+    const char* values[1] = {ids_param.data()};
+    const int lengths[1] = {static_cast<int>(ids_param.size())};
+    const int formats[1] = {1};
+    
+    const std::string sql = "DELETE FROM " + table_name + " WHERE id = ANY($1::bigint[])";
+    PGresult* result = execute_params("", sql, 1, values, lengths, formats, PGRES_COMMAND_OK);
+    if (!result) return -1;
+    
+    int64_t deleted = std::strtoll(PQcmdTuples(result), nullptr, 10);
+    PQclear(result);
+    return deleted;
+}
+
+bool PGVConnection::upsert_vectors(const std::string& table_name, const float* vectors, const int64_t* ids,
+                                   size_t count, int dimension, const CopyOptions& options) {
+    if (!is_connected() || !vectors || !ids || dimension <= 0) return false;
+    if (count == 0) return true;
+    const ResultCache::WriteScope write(results_);
+    
+    // Rows are cleared at every commit, so the table is reused across batches
+    static const char* kStaging = "pgv_upsert_staging";
+    // One staging table per column type, so the COPY encoding always matches
+    const std::string staging = std::string(kStaging) + "_" + vector_column_sql(column_);
+    const std::string create_sql = "CREATE TEMP TABLE IF NOT EXISTS " + staging +
+                                   " (id bigint, embedding " + vector_column_sql(column_) + ") ON COMMIT DELETE ROWS";
+    // Later rows in the staging table win; ON CONFLICT may touch each id only once
+    const std::string merge_sql = "INSERT INTO " + table_name + " (id, embedding) "
+                                  "SELECT DISTINCT ON (id) id, embedding FROM " + staging +
+                                  " ORDER BY id, ctid DESC "
+                                  "ON CONFLICT (id) DO UPDATE SET embedding = EXCLUDED.embedding";
+    
+    CopyOptions single = options;
+    single.rows_per_transaction = 0;
+    const size_t rows_per_batch = options.rows_per_transaction > 0 ? options.rows_per_transaction : count;
+    
+    for (size_t begin = 0; begin < count; begin += rows_per_batch) {
+        size_t rows = std::min(count - begin, rows_per_batch);
+        const float* batch = vectors + begin * static_cast<size_t>(dimension);
+        
+        bool ok = execute_query("BEGIN") && execute_query(create_sql) &&
+                  copy_rows(staging, ids + begin, rows,
+                            [batch, dimension](size_t row, int& row_dimension) {
+                                row_dimension = dimension;
+                                return batch + row * static_cast<size_t>(dimension);
+                            }, single) &&
+                  execute_query(merge_sql) && execute_query("COMMIT");
+        if (!ok) {
+            execute_query("ROLLBACK");
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool PGVConnection::copy_rows(const std::string& table_name, const int64_t* ids, size_t count,
+                              const RowAccessor& row, const CopyOptions& options) {
+    if (!is_connected()) return false;
+    if (count == 0) return true;
+    const ResultCache::WriteScope write(results_);
+    
+    const std::string copy_sql = "COPY " + table_name + " (id, embedding) FROM STDIN (FORMAT BINARY)";
+    const size_t rows_per_copy = options.rows_per_transaction > 0 ? options.rows_per_transaction : count;
+    
+    metrics::Span span(metrics::Op::DbCopy);
+    
+    std::vector<char> buffer;
+    buffer.resize(std::max(options.flush_bytes, binary::kCopyHeaderSize) + binary::copy_row_size(0));
+    std::vector<uint16_t> halves;   // halfvec rows are narrowed here before the byte swap
+    
+    for (size_t begin = 0; begin < count; begin += rows_per_copy) {
+        size_t end = std::min(count, begin + rows_per_copy);
+        
+        PGresult* res = PQexec(conn_, copy_sql.c_str());
+        if (PQresultStatus(res) != PGRES_COPY_IN) {
+            std::cerr << "COPY failed: " << PQerrorMessage(conn_) << std::endl;
+            PQclear(res);
+            span.status(-2);
+            return false;
+        }
+        PQclear(res);
+        
+        bool ok = true;
+        binary::put_copy_header(buffer.data());
+        size_t used = binary::kCopyHeaderSize;
+        
+        for (size_t i = begin; i < end && ok; ++i) {
+            int dimension = 0;
+            const float* values = row(i, dimension);
+            size_t nonzeros = 0;
+            size_t value_size = binary::vector_size(dimension);
+            if (column_ == VectorColumn::Halfvec) {
+                value_size = binary::halfvec_size(dimension);
+            } else if (column_ == VectorColumn::Sparsevec) {
+                nonzeros = static_cast<size_t>(
+                    std::count_if(values, values + dimension, [](float v) { return v != 0.0f; }));
+                value_size = binary::sparsevec_size(nonzeros);
+            }
+            size_t row_size = binary::kCopyRowOverhead + value_size;
             
-            for (size_t j = 0; j < vectors[i].size(); ++j) {
-                if (j > 0) query << ",";
-                query << vectors[i][j];
+            if (used + row_size > buffer.size()) {
+                buffer.resize(used + row_size);
+            }
+            char* out = binary::put_copy_row_header(buffer.data() + used, ids[i], value_size);
+            if (column_ == VectorColumn::Halfvec) {
+                halves.resize(static_cast<size_t>(dimension));
+                simd::from_float(simd::ElementType::Float16, values, halves.data(), halves.size());
+                binary::put_halfvec(out, halves.data(), dimension);
+            } else if (column_ == VectorColumn::Sparsevec) {
+                binary::put_sparsevec(out, values, dimension, nonzeros);
+            } else {
+                binary::put_vector(out, values, dimension);
             }
-            query << "]')";
+            used += row_size;
             
-            res = PQexec(conn_, query.str().c_str());
+            if (used >= options.flush_bytes) {
+                ok = PQputCopyData(conn_, buffer.data(), static_cast<int>(used)) == 1;
+                span.add_bytes(used);
+                used = 0;
+            }
+        }
+        
+        if (ok) {
+            binary::put_copy_trailer(buffer.data() + used);
+            used += 2;
+            ok = PQputCopyData(conn_, buffer.data(), static_cast<int>(used)) == 1;
+            span.add_bytes(used);
+        }
+        
+        if (PQputCopyEnd(conn_, ok ? nullptr : "pgv_faiss: binary COPY aborted") != 1) {
+            ok = false;
+        }
+        
+        while ((res = PQgetResult(conn_)) != nullptr) {
             if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-                PQclear(res);
-                PQexec(conn_, "ROLLBACK");
-                return false;
+                std::cerr << "COPY failed: " << PQerrorMessage(conn_) << std::endl;
+                ok = false;
             }
             PQclear(res);
         }
         
-        // Commit transaction
-        res = PQexec(conn_, "COMMIT");
-        bool success = (PQresultStatus(res) == PGRES_COMMAND_OK);
-        PQclear(res);
-        return success;
-        
-    } catch (const std::exception&) {
-        PQexec(conn_, "ROLLBACK");
-        return false;
+        if (!ok) {
+            span.status(-2);
+            return false;
+        }
+        span.set_items(end);
     }
+    
+    return true;
 }
 
 } // namespace pgvector
@@ -0,0 +1,573 @@
+#include "pgv_faiss.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Exercises pgv_faiss_batch_search on an in-memory index (no database needed)
+
+// Counts C++ heap allocations made anywhere in the process
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* data = std::malloc(size ? size : 1)) {
+        return data;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* data) noexcept {
+    std::free(data);
+}
+
+void operator delete(void* data, size_t) noexcept {
+    std::free(data);
+}
+
+static bool check_ids(const int64_t* ids, size_t count, int64_t num_vectors) {
+    for (size_t i = 0; i < count; ++i) {
+        if (ids[i] < 0 || ids[i] >= num_vectors) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "=== Batch Search Test ===" << std::endl;
+    
+    const int dimension = 32;
+    const int num_vectors = 500;
+    const size_t nq = 8;
+    const size_t k = 5;
+    
+    pgv_faiss_config_t config = {0};
+    config.connection_string = nullptr;
+    config.dimension = dimension;
+    config.index_type = const_cast<char*>("Flat");
+    
+    pgv_faiss_index_t* index = nullptr;
+    if (pgv_faiss_init(&config, &index) != 0) {
+        std::cout << "✗ Failed to create in-memory index" << std::endl;
+        return 1;
+    }
+    
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    std::vector<float> vectors(num_vectors * dimension);
+    std::vector<int64_t> ids(num_vectors);
+    for (int i = 0; i < num_vectors; ++i) {
+        ids[i] = i;
+        for (int d = 0; d < dimension; ++d) {
+            vectors[i * dimension + d] = dis(gen);
+        }
+    }
+    
+    if (pgv_faiss_add_vectors(index, vectors.data(), ids.data(), num_vectors) != 0) {
+        std::cout << "✗ Failed to add vectors" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    
+    pgv_faiss_batch_result_t result = {0};
+    if (pgv_faiss_batch_search(index, vectors.data(), nq, k, &result) != 0 ||
+        result.nq != nq || result.k != k || !check_ids(result.ids, nq * k, num_vectors)) {
+        std::cout << "✗ pgv_faiss_batch_search returned an unexpected result" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ pgv_faiss_batch_search filled " << nq << " x " << k << " results" << std::endl;
+    pgv_faiss_free_batch_result(&result);
+    
+    std::vector<int64_t> out_ids(nq * k);
+    std::vector<float> out_distances(nq * k);
+    if (pgv_faiss_batch_search_into(index, vectors.data(), nq, k, out_ids.data(), out_distances.data()) != 0 ||
+        !check_ids(out_ids.data(), out_ids.size(), num_vectors)) {
+        std::cout << "✗ pgv_faiss_batch_search_into failed" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ pgv_faiss_batch_search_into wrote caller-owned buffers" << std::endl;
+    
+    // Queries are stored vectors, so an exact index returns each one first at distance 0
+    bool exact_ok = true;
+    for (size_t q = 0; exact_ok && q < nq; ++q) {
+        exact_ok = out_ids[q * k] == static_cast<int64_t>(q) && out_distances[q * k] < 1e-4f;
+        for (size_t i = 1; exact_ok && i < k; ++i) {
+            exact_ok = out_distances[q * k + i - 1] <= out_distances[q * k + i];
+        }
+    }
+    if (!exact_ok) {
+        std::cout << "✗ Flat search did not return exact nearest neighbours" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Flat search found every query's own vector first" << std::endl;
+    
+    pgv_faiss_search_params_t params = {0};
+    params.nprobe = 16;
+    params.ef_search = 64;
+    if (pgv_faiss_batch_search_with_params(index, vectors.data(), nq, k, &params, &result) != 0 ||
+        result.nq != nq || result.k != k || !check_ids(result.ids, nq * k, num_vectors)) {
+        std::cout << "✗ pgv_faiss_batch_search_with_params failed" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    pgv_faiss_free_batch_result(&result);
+    
+    pgv_faiss_result_t single = {0};
+    if (pgv_faiss_search_with_params(index, vectors.data(), k, &params, &single) != 0 ||
+        single.count != k || !check_ids(single.ids, single.count, num_vectors)) {
+        std::cout << "✗ pgv_faiss_search_with_params failed" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    pgv_faiss_free_result(&single);
+    std::cout << "✓ Per-call search parameters accepted" << std::endl;
+    
+    // After a warm-up call the caller-buffer search allocates nothing
+    size_t found = 0;
+    bool into_ok = pgv_faiss_search_into(index, vectors.data(), k, nullptr, out_ids.data(), out_distances.data(),
+                                         &found) == 0 && found == k && out_ids[0] == 0;
+    size_t allocated = allocations.load();
+    for (int i = 0; into_ok && i < 100; ++i) {
+        into_ok = pgv_faiss_search_into(index, vectors.data() + (i % num_vectors) * dimension, k, &params,
+                                        out_ids.data(), out_distances.data(), &found) == 0 &&
+                  found == k && out_ids[0] == i;
+    }
+    if (!into_ok || allocations.load() != allocated) {
+        std::cout << "✗ pgv_faiss_search_into failed or allocated" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ pgv_faiss_search_into searched without heap allocations" << std::endl;
+    
+    // One filter handle serves many searches; ids outside the index are harmless
+    std::vector<int64_t> allowed;
+    for (int64_t id = 0; id < num_vectors; id += 7) {
+        allowed.push_back(id);
+    }
+    allowed.push_back(int64_t(1) << 40);
+    pgv_faiss_id_filter_t* filter = nullptr;
+    if (pgv_faiss_id_filter_create(allowed.data(), allowed.size(), &filter) != 0 ||
+        pgv_faiss_id_filter_size(filter) != allowed.size()) {
+        std::cout << "✗ pgv_faiss_id_filter_create failed" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    params.filter = filter;
+    bool filtered_ok = pgv_faiss_batch_search_with_params(index, vectors.data(), nq, k, &params, &result) == 0;
+    for (size_t i = 0; filtered_ok && i < nq * k; ++i) {
+        filtered_ok = result.ids[i] >= 0 && result.ids[i] % 7 == 0;
+    }
+    pgv_faiss_free_batch_result(&result);
+    filtered_ok = filtered_ok && pgv_faiss_search_with_params(index, vectors.data(), k, &params, &single) == 0 &&
+                  single.count == k;
+    for (size_t i = 0; filtered_ok && i < single.count; ++i) {
+        filtered_ok = single.ids[i] % 7 == 0;
+    }
+    pgv_faiss_free_result(&single);
+    params.filter = nullptr;
+    pgv_faiss_id_filter_destroy(filter);
+    if (!filtered_ok) {
+        std::cout << "✗ Filtered search returned ids outside the filter" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Filtered search kept to the allowed ids" << std::endl;
+    
+    // Deleted ids disappear from results; an upsert brings one back
+    std::vector<int64_t> doomed;
+    for (int64_t id = 0; id < 50; ++id) {
+        doomed.push_back(id);
+    }
+    bool removed_ok = pgv_faiss_remove_vectors(index, nullptr, doomed.data(), doomed.size()) == 0 &&
+                      pgv_faiss_upsert_vectors(index, nullptr, vectors.data() + 7 * dimension, &doomed[7], 1) == 0 &&
+                      pgv_faiss_compact(index) == 0 &&
+                      pgv_faiss_batch_search(index, vectors.data(), nq, k, &result) == 0;
+    for (size_t i = 0; removed_ok && i < nq * k; ++i) {
+        removed_ok = result.ids[i] == 7 || result.ids[i] >= 50;
+    }
+    pgv_faiss_free_batch_result(&result);
+    // Rows stored after the removed ones keep their ids
+    for (int64_t probe : {int64_t(7), int64_t(50), int64_t(num_vectors / 2), int64_t(num_vectors - 1)}) {
+        removed_ok = removed_ok && pgv_faiss_search(index, vectors.data() + probe * dimension, 1, &single) == 0 &&
+                     single.count == 1 && single.ids[0] == probe;
+        pgv_faiss_free_result(&single);
+    }
+    if (!removed_ok || pgv_faiss_remove_vectors(index, "batch_test", doomed.data(), doomed.size()) != -2) {
+        std::cout << "✗ Deleted vectors were still returned" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Removed and upserted vectors" << std::endl;
+
+    // HNSW deletes by tombstone: vectors added after a delete must stay
+    // searchable and survive compaction, the deleted ones must not
+    pgv_faiss_config_t hnsw_config = config;
+    hnsw_config.index_type = const_cast<char*>("HNSW");
+    hnsw_config.compaction_threshold = -1.0;
+    pgv_faiss_index_t* hnsw = nullptr;
+    pgv_faiss_result_t closest = {};
+    const size_t half = num_vectors / 2;
+    bool tombstones_ok = pgv_faiss_init(&hnsw_config, &hnsw) == 0 &&
+                         pgv_faiss_add_vectors(hnsw, vectors.data(), ids.data(), half) == 0 &&
+                         pgv_faiss_remove_vectors(hnsw, nullptr, ids.data(), 10) == 0 &&
+                         pgv_faiss_add_vectors(hnsw, vectors.data() + half * dimension, ids.data() + half,
+                                               num_vectors - half) == 0;
+    for (int pass = 0; tombstones_ok && pass < 2; ++pass) {
+        const int64_t probes[2] = {3, num_vectors - 1};
+        for (int64_t probe : probes) {
+            tombstones_ok = tombstones_ok && pgv_faiss_search(hnsw, &vectors[probe * dimension], 1, &closest) == 0 &&
+                            closest.count == 1 && (probe < 10 ? closest.ids[0] != probe : closest.ids[0] == probe);
+            pgv_faiss_free_result(&closest);
+        }
+        tombstones_ok = tombstones_ok && (pass == 1 || pgv_faiss_compact(hnsw) == 0);
+    }
+    pgv_faiss_destroy(hnsw);
+    if (!tombstones_ok) {
+        std::cout << "✗ Vectors added after a tombstone delete were lost" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Adds after tombstone deletes survive search and compaction" << std::endl;
+    
+    if (pgv_faiss_batch_search(index, vectors.data(), 0, k, &result) != -1 ||
+        pgv_faiss_save_to_db(index, "batch_test") != -2 ||
+        pgv_faiss_hybrid_search(index, "batch_test", vectors.data(), k, nullptr, &single) != -2 ||
+        pgv_faiss_sync_start(index, "batch_test", 0) != -2 ||
+        pgv_faiss_sync_flush(index, nullptr) != -1) {
+        std::cout << "✗ Invalid arguments were not rejected" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    
+    // A registry always needs a database, so without one only its argument checks run
+    pgv_faiss_registry_config_t registry_config = {0};
+    registry_config.index = config;
+    pgv_faiss_registry_t* registry = nullptr;
+    if (pgv_faiss_registry_create(&registry_config, &registry) != -1 || registry ||
+        pgv_faiss_registry_create(nullptr, &registry) != -1 ||
+        pgv_faiss_registry_acquire(nullptr, "batch_test", &index) != -1 ||
+        pgv_faiss_registry_evict(nullptr, "batch_test") != -1 ||
+        pgv_faiss_registry_load(nullptr, nullptr, 0, 0, nullptr) != -1) {
+        std::cout << "✗ Invalid registry arguments were not rejected" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Invalid arguments rejected" << std::endl;
+    
+    pgv_faiss_destroy(index);
+    
+    // A sharded index merges per-shard results into one ascending top-k
+    config.shards = 4;
+    if (pgv_faiss_init(&config, &index) != 0) {
+        std::cout << "✗ Failed to create sharded index" << std::endl;
+        return 1;
+    }
+    bool sharded_ok = pgv_faiss_add_vectors(index, vectors.data(), nullptr, num_vectors) == -1 &&
+                      pgv_faiss_enable_batching(index, 16, 100) == -1 &&
+                      pgv_faiss_add_vectors(index, vectors.data(), ids.data(), num_vectors) == 0 &&
+                      pgv_faiss_batch_search(index, vectors.data(), nq, k, &result) == 0 &&
+                      check_ids(result.ids, nq * k, num_vectors);
+    for (size_t i = 0; sharded_ok && i < nq * k; ++i) {
+        sharded_ok = i % k == 0 ? result.ids[i] == static_cast<int64_t>(i / k)
+                                : result.distances[i - 1] <= result.distances[i];
+    }
+    pgv_faiss_free_batch_result(&result);
+    if (!sharded_ok) {
+        std::cout << "✗ Sharded search returned an unexpected result" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Sharded batch search merged " << config.shards << " shards" << std::endl;
+    
+    pgv_faiss_gpu_placement_t placement = PGV_FAISS_PLACEMENT_GPU;
+    size_t devices = 1;
+    if (pgv_faiss_get_gpu_stats(index, &placement, nullptr, 0, &devices) != 0 ||
+        placement != PGV_FAISS_PLACEMENT_CPU || devices != 0) {
+        std::cout << "✗ A CPU index reported GPU placement" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ GPU stats report a CPU placement" << std::endl;
+    
+    // Counters are process-wide; the failed add without ids above counts as an error
+    pgv_faiss_stats_t stats;
+    bool stats_ok = pgv_faiss_get_stats(index, &stats) == 0 &&
+                    stats.ntotal == static_cast<size_t>(num_vectors) && stats.shards == 4 &&
+                    stats.memory_bytes >= static_cast<size_t>(num_vectors) * dimension * sizeof(float) &&
+                    stats.ops[PGV_FAISS_OP_BATCH_SEARCH].count > 0 &&
+                    stats.ops[PGV_FAISS_OP_ADD].errors > 0 &&
+                    stats.ops[PGV_FAISS_OP_BATCH_SEARCH].p50_ns <= stats.ops[PGV_FAISS_OP_BATCH_SEARCH].max_ns;
+    
+    std::vector<pgv_faiss_span_t> spans;
+    pgv_faiss_set_span_callback([](const pgv_faiss_span_t* span, void* user_data) {
+        static_cast<std::vector<pgv_faiss_span_t>*>(user_data)->push_back(*span);
+    }, &spans);
+    stats_ok = stats_ok && pgv_faiss_batch_search(index, vectors.data(), nq, k, &result) == 0;
+    pgv_faiss_free_batch_result(&result);
+    pgv_faiss_set_span_callback(nullptr, nullptr);
+    stats_ok = stats_ok && spans.size() == 1 && std::string(spans[0].name) == "batch_search" &&
+               spans[0].items == nq && spans[0].end_unix_ns >= spans[0].start_unix_ns;
+    
+    pgv_faiss_set_metrics_enabled(0);
+    pgv_faiss_stats_t before;
+    pgv_faiss_get_stats(nullptr, &before);
+    stats_ok = stats_ok && pgv_faiss_batch_search(index, vectors.data(), nq, k, &result) == 0;
+    pgv_faiss_free_batch_result(&result);
+    pgv_faiss_get_stats(nullptr, &stats);
+    pgv_faiss_set_metrics_enabled(1);
+    stats_ok = stats_ok && stats.ops[PGV_FAISS_OP_BATCH_SEARCH].count == before.ops[PGV_FAISS_OP_BATCH_SEARCH].count;
+    
+    size_t text_length = 0;
+    stats_ok = stats_ok && pgv_faiss_export_prometheus(index, nullptr, 0, &text_length) == -3 && text_length > 0;
+    std::vector<char> text(text_length + 1);
+    stats_ok = stats_ok && pgv_faiss_export_prometheus(index, text.data(), text.size(), &text_length) == 0 &&
+               std::string(text.data()).find("pgv_faiss_index_vectors " + std::to_string(num_vectors)) != std::string::npos &&
+               std::string(text.data()).find("pgv_faiss_operation_duration_seconds_bucket{op=\"batch_search\",le=\"+Inf\"}") !=
+                   std::string::npos;
+    if (!stats_ok) {
+        std::cout << "✗ Stats, spans or Prometheus export were wrong" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Stats, spans and Prometheus export" << std::endl;
+    
+    // Cosine ignores vector length (<=>) and inner product ranks by -a.b (<#>)
+    pgv_faiss_config_t metric_config = {0};
+    metric_config.dimension = dimension;
+    metric_config.index_type = const_cast<char*>("Flat");
+    metric_config.metric = PGV_FAISS_METRIC_COSINE;
+    std::vector<float> scaled(vectors.begin(), vectors.begin() + dimension);
+    for (float& x : scaled) x *= 3.0f;
+    pgv_faiss_index_t* metric_index = nullptr;
+    pgv_faiss_result_t hit = {};
+    bool metric_ok = pgv_faiss_init(&metric_config, &metric_index) == 0 &&
+                     pgv_faiss_add_vectors(metric_index, vectors.data(), ids.data(), num_vectors) == 0 &&
+                     pgv_faiss_search(metric_index, scaled.data(), k, &hit) == 0 && hit.count == k &&
+                     hit.ids[0] == 0 && std::fabs(hit.distances[0]) < 1e-5f && hit.distances[1] > hit.distances[0];
+    pgv_faiss_free_result(&hit);
+    pgv_faiss_destroy(metric_index);
+    
+    float best_dot = -1e30f;
+    int64_t best_id = -1;
+    for (int i = 0; i < num_vectors; ++i) {
+        float dot = 0.0f;
+        for (int d = 0; d < dimension; ++d) dot += scaled[d] * vectors[i * dimension + d];
+        if (dot > best_dot) {
+            best_dot = dot;
+            best_id = i;
+        }
+    }
+    metric_config.metric = PGV_FAISS_METRIC_INNER_PRODUCT;
+    metric_index = nullptr;
+    metric_ok = metric_ok && pgv_faiss_init(&metric_config, &metric_index) == 0 &&
+                pgv_faiss_add_vectors(metric_index, vectors.data(), ids.data(), num_vectors) == 0 &&
+                pgv_faiss_search(metric_index, scaled.data(), k, &hit) == 0 && hit.count == k &&
+                hit.ids[0] == best_id && std::fabs(hit.distances[0] + best_dot) < 1e-3f &&
+                hit.distances[k - 1] >= hit.distances[0];
+    pgv_faiss_free_result(&hit);
+    pgv_faiss_destroy(metric_index);
+    
+    metric_config.metric = static_cast<pgv_faiss_metric_t>(7);
+    metric_index = nullptr;
+    metric_ok = metric_ok && pgv_faiss_init(&metric_config, &metric_index) == -1;
+    if (!metric_ok) {
+        std::cout << "✗ Cosine or inner-product search ranked wrongly" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Cosine and inner-product metrics" << std::endl;
+    
+    // Training: a Flat index needs none, and every variant wants an empty index
+    pgv_faiss_train_params_t train_params = {};
+    train_params.batches = 4;
+    pgv_faiss_index_t* untrained = nullptr;
+    bool train_ok = pgv_faiss_train(index, vectors.data(), num_vectors, &train_params) == -1 &&
+                    pgv_faiss_train(index, nullptr, num_vectors, nullptr) == -1 &&
+                    pgv_faiss_train_from_db(index, "items", &train_params, nullptr) == -1 &&
+                    pgv_faiss_load_training(index, "items") == -1 &&
+                    pgv_faiss_init(&config, &untrained) == 0 &&
+                    pgv_faiss_train(untrained, vectors.data(), num_vectors, &train_params) == 0 &&
+                    pgv_faiss_train_from_db(untrained, "items", &train_params, nullptr) == -2;
+    pgv_faiss_destroy(untrained);
+    if (!train_ok) {
+        std::cout << "✗ Training calls returned unexpected codes" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Training stage arguments checked" << std::endl;
+
+    // Values exact in both 16-bit formats survive a round trip bit for bit,
+    // int8 codes clamp at +-127 steps, and scale is only checked for INT8.
+    // 19 elements run both the SIMD blocks and the scalar tail.
+    const float exact[] = {1.0f, -2.5f, 0.0f, 0.125f, -96.0f, 3.0f, 0.5f, -0.75f, 24.0f, -1.0f,
+                           6.0f, 0.25f, -3.5f, 1.5f, 10.0f, -0.125f, 2.0f, 40.0f, -8.0f};
+    const size_t n = sizeof(exact) / sizeof(exact[0]);
+    std::vector<uint16_t> half16(n), brain16(n), crossed(n);
+    std::vector<float> back16(n), backbf(n), backcross(n);
+    bool convert_ok =
+        pgv_faiss_convert_vectors(exact, PGV_FAISS_FLOAT32, half16.data(), PGV_FAISS_FLOAT16, n, 0.0f) == 0 &&
+        pgv_faiss_convert_vectors(half16.data(), PGV_FAISS_FLOAT16, back16.data(), PGV_FAISS_FLOAT32, n, 0.0f) == 0 &&
+        pgv_faiss_convert_vectors(exact, PGV_FAISS_FLOAT32, brain16.data(), PGV_FAISS_BFLOAT16, n, 0.0f) == 0 &&
+        pgv_faiss_convert_vectors(brain16.data(), PGV_FAISS_BFLOAT16, backbf.data(), PGV_FAISS_FLOAT32, n, 0.0f) == 0 &&
+        pgv_faiss_convert_vectors(half16.data(), PGV_FAISS_FLOAT16, crossed.data(), PGV_FAISS_BFLOAT16, n, 0.0f) == 0 &&
+        pgv_faiss_convert_vectors(crossed.data(), PGV_FAISS_BFLOAT16, backcross.data(), PGV_FAISS_FLOAT32, n,
+                                  0.0f) == 0 &&
+        half16[0] == 0x3c00 && brain16[0] == 0x3f80;
+    for (size_t i = 0; convert_ok && i < n; ++i) {
+        convert_ok = back16[i] == exact[i] && backbf[i] == exact[i] && backcross[i] == exact[i];
+    }
+    std::vector<int8_t> clamped(n);
+    std::vector<float> backint(n);
+    convert_ok = convert_ok &&
+        pgv_faiss_convert_vectors(exact, PGV_FAISS_FLOAT32, clamped.data(), PGV_FAISS_INT8, n, 0.125f) == 0 &&
+        pgv_faiss_convert_vectors(clamped.data(), PGV_FAISS_INT8, backint.data(), PGV_FAISS_FLOAT32, n, 0.125f) == 0;
+    for (size_t i = 0; convert_ok && i < n; ++i) {
+        const float expected = std::min(std::max(exact[i], -127 * 0.125f), 127 * 0.125f);
+        convert_ok = backint[i] == expected && std::abs(clamped[i]) <= 127;
+    }
+    // NaN codes as 0 in the SIMD blocks and in the scalar tail alike
+    std::vector<float> with_nan(n, 1.0f);
+    with_nan[3] = with_nan[n - 2] = std::nanf("");
+    convert_ok = convert_ok &&
+        pgv_faiss_convert_vectors(with_nan.data(), PGV_FAISS_FLOAT32, clamped.data(), PGV_FAISS_INT8, n,
+                                  0.125f) == 0 && clamped[3] == 0 && clamped[n - 2] == 0 && clamped[0] == 8;
+    convert_ok = convert_ok &&
+        pgv_faiss_convert_vectors(exact, PGV_FAISS_FLOAT32, clamped.data(), PGV_FAISS_INT8, n, 0.125f) == 0;
+    convert_ok = convert_ok && clamped[4] == -127 && clamped[17] == 127 &&
+                 pgv_faiss_convert_vectors(exact, PGV_FAISS_FLOAT32, clamped.data(), PGV_FAISS_INT8, n, 0.0f) == -1 &&
+                 pgv_faiss_convert_vectors(clamped.data(), PGV_FAISS_INT8, half16.data(), PGV_FAISS_FLOAT16, n,
+                                           -1.0f) == -1;
+    if (!convert_ok) {
+        std::cout << "✗ Element type conversions did not round-trip" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ float16, bfloat16 and clamped int8 conversions round-trip" << std::endl;
+
+    // float16 and int8 rows go into the index without a float32 copy and still find themselves
+    std::vector<uint16_t> halves(vectors.size());
+    std::vector<int8_t> codes(vectors.size());
+    std::vector<float> widened(vectors.size());
+    const float step = 1.0f / 127.0f;
+    bool typed_ok = pgv_faiss_convert_vectors(vectors.data(), PGV_FAISS_FLOAT32, halves.data(), PGV_FAISS_FLOAT16,
+                                              vectors.size(), 1.0f) == 0 &&
+                    pgv_faiss_convert_vectors(halves.data(), PGV_FAISS_FLOAT16, codes.data(), PGV_FAISS_INT8,
+                                              vectors.size(), step) == 0 &&
+                    pgv_faiss_convert_vectors(halves.data(), PGV_FAISS_FLOAT16, widened.data(), PGV_FAISS_FLOAT32,
+                                              vectors.size(), 1.0f) == 0;
+    for (size_t i = 0; typed_ok && i < vectors.size(); ++i) {
+        typed_ok = std::fabs(widened[i] - vectors[i]) <= 1e-3f;
+    }
+    for (int type = PGV_FAISS_FLOAT16; typed_ok && type <= PGV_FAISS_INT8; type += 2) {
+        pgv_faiss_index_t* typed = nullptr;
+        const void* rows = type == PGV_FAISS_FLOAT16 ? static_cast<const void*>(halves.data()) : codes.data();
+        typed_ok = pgv_faiss_init(&config, &typed) == 0 &&
+                   pgv_faiss_add_vectors_typed(typed, rows, static_cast<pgv_faiss_vector_type_t>(type), step,
+                                               ids.data(), num_vectors) == 0 &&
+                   pgv_faiss_search(typed, vectors.data() + 3 * dimension, k, &hit) == 0 &&
+                   hit.count == k && hit.ids[0] == 3 && hit.distances[0] < 0.01f;
+        pgv_faiss_free_result(&hit);
+        pgv_faiss_destroy(typed);
+    }
+    typed_ok = typed_ok &&
+               pgv_faiss_add_vectors_typed(index, halves.data(), static_cast<pgv_faiss_vector_type_t>(9), 1.0f,
+                                           ids.data(), num_vectors) == -1 &&
+               pgv_faiss_add_vectors_typed(index, codes.data(), PGV_FAISS_INT8, 0.0f, ids.data(), num_vectors) == -1;
+    if (!typed_ok) {
+        std::cout << "✗ Reduced-precision vectors were converted or added wrongly" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ float16 and int8 vectors added" << std::endl;
+
+    // A radius just above the 20th distance keeps exactly the top 20, and an
+    // iterator paged 7 at a time returns them in the same order
+    const size_t deep = 20;
+    std::vector<int64_t> top_ids(2 * deep);
+    std::vector<float> top_distances(2 * deep);
+    bool range_ok = pgv_faiss_batch_search_into(index, vectors.data(), 2, deep, top_ids.data(),
+                                                top_distances.data()) == 0;
+    const float radius = std::nextafter(std::max(top_distances[deep - 1], top_distances[2 * deep - 1]), 1e30f);
+    pgv_faiss_range_result_t range = {0};
+    range_ok = range_ok && pgv_faiss_range_search(index, vectors.data(), 2, radius, nullptr, &range) == 0 &&
+               range.nq == 2 && range.lims[0] == 0;
+    for (size_t q = 0; range_ok && q < 2; ++q) {
+        size_t begin = range.lims[q];
+        range_ok = range.lims[q + 1] - begin >= deep;
+        for (size_t i = 0; range_ok && i < deep; ++i) {
+            range_ok = range.ids[begin + i] == top_ids[q * deep + i] && range.distances[begin + i] < radius;
+        }
+    }
+    pgv_faiss_free_range_result(&range);
+
+    pgv_faiss_iterator_t* iterator = nullptr;
+    std::vector<int64_t> paged;
+    range_ok = range_ok && pgv_faiss_iterator_create(index, vectors.data(), nullptr, &iterator) == 0;
+    while (range_ok && paged.size() < deep) {
+        int64_t page_ids[7];
+        float page_distances[7];
+        size_t count = 0;
+        range_ok = pgv_faiss_iterator_next(iterator, 7, page_ids, page_distances, &count) == 0 && count == 7;
+        paged.insert(paged.end(), page_ids, page_ids + count);
+    }
+    for (size_t i = 0; range_ok && i < deep; ++i) {
+        range_ok = paged[i] == top_ids[i];
+    }
+    size_t none = 1;
+    range_ok = range_ok && pgv_faiss_iterator_next(iterator, 0, top_ids.data(), top_distances.data(), &none) == -1 &&
+               none == 0 && pgv_faiss_range_search(index, nullptr, 1, radius, nullptr, &range) == -1 &&
+               pgv_faiss_iterator_create(index, nullptr, nullptr, &iterator) == -1;
+    pgv_faiss_iterator_destroy(iterator);
+    if (!range_ok) {
+        std::cout << "✗ Range search or iterator disagreed with top-k search" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Range search and paged iterator match top-k search" << std::endl;
+
+    // A repeated query hits, a slightly moved one is a near hit, and removing
+    // the nearest vector retires both
+    pgv_faiss_config_t cache_config = config;
+    cache_config.shards = 0;
+    cache_config.result_cache_mb = 1;
+    cache_config.result_cache_epsilon = 0.01f;
+    pgv_faiss_index_t* cached = nullptr;
+    std::vector<float> moved(vectors.begin() + 60 * dimension, vectors.begin() + 61 * dimension);
+    moved[0] += 0.001f;
+    pgv_faiss_stats_t cache_stats;
+    bool cache_ok = pgv_faiss_init(&cache_config, &cached) == 0 &&
+                    pgv_faiss_add_vectors(cached, vectors.data(), ids.data(), num_vectors) == 0;
+    for (int round = 0; cache_ok && round < 3; ++round) {
+        cache_ok = pgv_faiss_search(cached, round == 2 ? moved.data() : &vectors[60 * dimension], k, &hit) == 0 &&
+                   hit.count == k && hit.ids[0] == 60;
+        pgv_faiss_free_result(&hit);
+    }
+    cache_ok = cache_ok && pgv_faiss_get_stats(cached, &cache_stats) == 0 && cache_stats.result_cache_hits == 2 &&
+               cache_stats.result_cache_near_hits == 1 && cache_stats.result_cache_misses == 1 &&
+               cache_stats.result_cache_entries == 1;
+    const int64_t nearest = 60;
+    cache_ok = cache_ok && pgv_faiss_remove_vectors(cached, nullptr, &nearest, 1) == 0 &&
+               pgv_faiss_search(cached, moved.data(), k, &hit) == 0 && hit.count == k && hit.ids[0] != 60 &&
+               pgv_faiss_get_stats(cached, &cache_stats) == 0 && cache_stats.result_cache_hits == 2;
+    pgv_faiss_free_result(&hit);
+    pgv_faiss_destroy(cached);
+    if (!cache_ok) {
+        std::cout << "✗ Result cache served wrong or stale results" << std::endl;
+        pgv_faiss_destroy(index);
+        return 1;
+    }
+    std::cout << "✓ Result cache hits, near hits and invalidation" << std::endl;
+
+    pgv_faiss_destroy(index);
+    std::cout << "✅ Test completed successfully!" << std::endl;
+    return 0;
+}
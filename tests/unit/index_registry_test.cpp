@@ -0,0 +1,191 @@
+#include "pgv_faiss.h"
+#include "core/index_registry.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Exercises IndexRegistry over in-memory indexes (no database needed)
+
+namespace {
+
+const size_t table_bytes = 100;
+
+// Opens empty Flat indexes, counting opens per table and destroyed handles
+struct Tables {
+    std::mutex mutex;
+    std::map<std::string, int> opens;
+    std::atomic<int> destroyed{0};
+    std::chrono::milliseconds delay{0};
+
+    int opened(const std::string& table) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return opens[table];
+    }
+
+    IndexRegistry::Opener opener() {
+        return [this](const std::string& table, pgvector::PGVConnection* connection, bool,
+                      IndexRegistry::Handle& handle) {
+            if (connection) {
+                return -1;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++opens[table];
+            }
+            std::this_thread::sleep_for(delay);
+            if (!handle) {
+                pgv_faiss_config_t config = {0};
+                config.dimension = 4;
+                config.index_type = const_cast<char*>("Flat");
+                pgv_faiss_index_t* index = nullptr;
+                if (pgv_faiss_init(&config, &index) != 0) {
+                    return -2;
+                }
+                handle.reset(index, [this](pgv_faiss_index_t* index) {
+                    ++destroyed;
+                    pgv_faiss_destroy(index);
+                });
+            }
+            return 0;
+        };
+    }
+};
+
+IndexRegistry::Footprint fixed_footprint() {
+    return [](pgv_faiss_index_t*) { return table_bytes; };
+}
+
+} // namespace
+
+int main() {
+    std::cout << "=== Index Registry Test ===" << std::endl;
+
+    // Tables open on their first acquire and stay resident
+    {
+        Tables tables;
+        IndexRegistry registry(RegistryOptions(), tables.opener(), fixed_footprint());
+        if (!registry.start() || registry.stats().loads != 0 || tables.opened("a") != 0) {
+            std::cout << "✗ Registry opened tables before they were acquired" << std::endl;
+            return 1;
+        }
+
+        pgv_faiss_index_t* first = nullptr;
+        pgv_faiss_index_t* second = nullptr;
+        int status = registry.acquire("a", &first);
+        registry.release(first);
+        if (status == 0) status = registry.acquire("a", &second);
+        registry.release(second);
+
+        RegistryStats stats = registry.stats();
+        if (status != 0 || !first || first != second || tables.opened("a") != 1 || stats.loads != 1 ||
+            stats.hits != 1 || stats.resident != 1 || stats.resident_bytes != table_bytes || stats.acquired != 0) {
+            std::cout << "✗ Lazy open failed (status " << status << ", opens " << tables.opened("a")
+                      << ", hits " << stats.hits << ")" << std::endl;
+            return 1;
+        }
+        std::cout << "✓ Tables open lazily on their first acquire" << std::endl;
+    }
+
+    // Concurrent acquires of a table being opened wait for that one open
+    {
+        Tables tables;
+        tables.delay = std::chrono::milliseconds(50);
+        IndexRegistry registry(RegistryOptions(), tables.opener(), fixed_footprint());
+
+        const size_t threads = 8;
+        std::vector<pgv_faiss_index_t*> acquired(threads, nullptr);
+        std::vector<int> status(threads, -1);
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] { status[t] = registry.acquire("b", &acquired[t]); });
+        }
+        for (auto& worker : workers) worker.join();
+
+        bool same = true;
+        for (size_t t = 0; t < threads; ++t) {
+            same = same && status[t] == 0 && acquired[t] && acquired[t] == acquired[0];
+        }
+        RegistryStats stats = registry.stats();
+        for (auto* index : acquired) registry.release(index);
+        if (!same || tables.opened("b") != 1 || stats.loads != 1 || stats.hits != threads - 1) {
+            std::cout << "✗ Concurrent acquires opened the table " << tables.opened("b") << " times" << std::endl;
+            return 1;
+        }
+        std::cout << "✓ Concurrent acquires of one table share a single open" << std::endl;
+    }
+
+    // Over the budget the least recently acquired idle table goes, never an acquired one
+    {
+        Tables tables;
+        RegistryOptions options;
+        options.memory_budget = table_bytes * 2 + table_bytes / 2;
+        IndexRegistry registry(options, tables.opener(), fixed_footprint());
+
+        pgv_faiss_index_t* held = nullptr;
+        pgv_faiss_index_t* index = nullptr;
+        int status = registry.acquire("a", &held);
+        if (status == 0) status = registry.acquire("b", &index);
+        registry.release(index);
+        if (status == 0) status = registry.acquire("c", &index);
+        registry.release(index);
+
+        RegistryStats stats = registry.stats();
+        bool ok = status == 0 && stats.evictions == 1 && stats.resident == 2 &&
+                  stats.resident_bytes <= options.memory_budget;
+
+        // a was least recently acquired but is held, so b went instead
+        pgv_faiss_index_t* again = nullptr;
+        if (ok) ok = registry.acquire("a", &again) == 0 && again == held && tables.opened("a") == 1;
+        registry.release(again);
+        if (ok) ok = registry.acquire("b", &index) == 0 && tables.opened("b") == 2;
+        registry.release(index);
+        registry.release(held);
+        if (!ok) {
+            std::cout << "✗ Eviction under the memory budget dropped the wrong table (evictions "
+                      << stats.evictions << ")" << std::endl;
+            return 1;
+        }
+        std::cout << "✓ Eviction under the memory budget skips acquired tables" << std::endl;
+    }
+
+    // A rebuild replaces the resident handle; the old one lives until its last release
+    {
+        Tables tables;
+        IndexRegistry registry(RegistryOptions(), tables.opener(), fixed_footprint());
+
+        pgv_faiss_index_t* old_index = nullptr;
+        int status = registry.acquire("d", &old_index);
+        std::vector<int> codes;
+        if (status == 0) status = registry.load({"d"}, true, codes);
+
+        pgv_faiss_index_t* new_index = nullptr;
+        if (status == 0) status = registry.acquire("d", &new_index);
+        bool ok = status == 0 && new_index != old_index && tables.opened("d") == 2 && tables.destroyed == 0;
+
+        // The replaced index still serves calls while acquired
+        pgv_faiss_stats_t stats = {};
+        const float vector[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+        const int64_t id = 7;
+        if (ok) ok = pgv_faiss_add_vectors(old_index, vector, &id, 1) == 0 &&
+                     pgv_faiss_get_stats(old_index, &stats) == 0 && stats.ntotal == 1;
+
+        registry.release(old_index);
+        if (ok) ok = tables.destroyed == 1;
+        registry.release(new_index);
+        if (ok) ok = tables.destroyed == 1 && registry.stats().resident == 1;
+        if (!ok) {
+            std::cout << "✗ Replaced handle did not survive until its last release (destroyed "
+                      << tables.destroyed << ")" << std::endl;
+            return 1;
+        }
+        std::cout << "✓ A replaced handle survives until its last release" << std::endl;
+    }
+
+    std::cout << "\n=== Index registry test completed successfully ===" << std::endl;
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include "core/scratch_arena.h"
+#include <cstring>
+#include <iostream>
+
+// Exercises ScratchArena scope nesting on the calling thread
+
+int main() {
+    std::cout << "=== Scratch Arena Test ===" << std::endl;
+
+    // Each inner scope needs more than the block holds; its overflow
+    // allocation must be gone when it ends, not when the outer scope does
+    const size_t inner_bytes = 160 * 1024;
+    bool nested_ok = true;
+    {
+        ScratchArena::Scope outer;
+        float* kept = outer.allocate<float>(16);
+        std::memset(kept, 0, 16 * sizeof(float));
+        const size_t held = ScratchArena::local_overflow();
+        for (int i = 0; nested_ok && i < 2000; ++i) {
+            ScratchArena::Scope inner;
+            char* data = inner.allocate<char>(inner_bytes);
+            std::memset(data, i & 0xff, inner_bytes);
+            nested_ok = ScratchArena::local_overflow() <= held + 1;
+        }
+        nested_ok = nested_ok && ScratchArena::local_overflow() == held;
+    }
+    nested_ok = nested_ok && ScratchArena::local_overflow() == 0;
+    if (!nested_ok) {
+        std::cout << "✗ Inner scopes kept their overflow allocations" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ Inner scopes free their overflow allocations" << std::endl;
+
+    // The block is regrown to one inner scope's demand, not the sum of all
+    const size_t capacity = ScratchArena::local_capacity();
+    if (capacity < inner_bytes || capacity > 4 * inner_bytes) {
+        std::cout << "✗ Block grew to " << capacity << " bytes" << std::endl;
+        return 1;
+    }
+    bool reuse_ok = true;
+    {
+        ScratchArena::Scope outer;
+        for (int i = 0; reuse_ok && i < 100; ++i) {
+            ScratchArena::Scope inner;
+            inner.allocate<char>(inner_bytes);
+            reuse_ok = ScratchArena::local_overflow() == 0;
+        }
+    }
+    if (!reuse_ok || ScratchArena::local_capacity() != capacity) {
+        std::cout << "✗ Regrown block was not reused" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ Block sized to the largest scope and reused" << std::endl;
+
+    std::cout << "\n=== Scratch arena test completed successfully ===" << std::endl;
+    return 0;
+}